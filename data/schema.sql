@@ -0,0 +1,39 @@
+-- planetplus
+-- Database schema, every statement must be idempotent.
+
+CREATE TABLE IF NOT EXISTS records (
+    map_uid VARCHAR(64) NOT NULL,
+    login VARCHAR(64) NOT NULL,
+    time INT NOT NULL,
+    timestamp BIGINT NOT NULL,
+    PRIMARY KEY (map_uid, login),
+    KEY records_by_time (map_uid, time)
+);
+
+CREATE TABLE IF NOT EXISTS player_stats (
+    login VARCHAR(64) NOT NULL PRIMARY KEY,
+    playtime BIGINT NOT NULL DEFAULT 0,
+    finishes INT UNSIGNED NOT NULL DEFAULT 0,
+    wins INT UNSIGNED NOT NULL DEFAULT 0,
+    maps_finished INT UNSIGNED NOT NULL DEFAULT 0
+);
+
+CREATE TABLE IF NOT EXISTS map_stats (
+    map_uid VARCHAR(64) NOT NULL PRIMARY KEY,
+    playtime BIGINT NOT NULL DEFAULT 0,
+    finishes INT UNSIGNED NOT NULL DEFAULT 0,
+    players INT UNSIGNED NOT NULL DEFAULT 0
+);
+
+CREATE TABLE IF NOT EXISTS map_finishers (
+    map_uid VARCHAR(64) NOT NULL,
+    login VARCHAR(64) NOT NULL,
+    PRIMARY KEY (map_uid, login)
+);
+
+CREATE TABLE IF NOT EXISTS karma (
+    map_uid VARCHAR(64) NOT NULL,
+    login VARCHAR(64) NOT NULL,
+    vote TINYINT NOT NULL,
+    PRIMARY KEY (map_uid, login)
+);
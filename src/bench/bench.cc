@@ -0,0 +1,417 @@
+#include "bench.h"
+
+#include <algorithm>
+#include <atomic>
+#include <charconv>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <ctime>
+#include <fstream>
+#include <new>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "cli/tools.h"
+
+namespace
+{
+std::atomic<std::uint64_t> allocated {0};
+} // namespace
+
+// Counted, so a benchmark shows the allocations a path makes
+void* operator new(std::size_t size)
+{
+    allocated.fetch_add(1, std::memory_order_relaxed);
+    if (void* block = std::malloc(size != 0 ? size : 1))
+    {
+        return block;
+    }
+    throw std::bad_alloc();
+}
+
+void operator delete(void* block) noexcept
+{
+    std::free(block);
+}
+
+void operator delete(void* block, std::size_t) noexcept
+{
+    std::free(block);
+}
+
+namespace bench
+{
+namespace
+{
+constexpr std::uint64_t kDefaultSeed = 42;
+constexpr std::size_t kDefaultRepetitions = 5;
+
+struct Benchmark
+{
+    std::string name;
+    std::size_t iterations;
+    Function fn;
+};
+
+std::vector<Benchmark>& registry()
+{
+    static std::vector<Benchmark> benchmarks;
+    return benchmarks;
+}
+
+/**
+ * @brief Nanoseconds per operation over the repetitions of a benchmark.
+ */
+struct Result
+{
+    std::string name;
+    std::size_t iterations {0};
+    std::string skipped;
+    std::vector<double> runs;
+    double allocations {0}; // per operation, in the last run
+    double bytes {0};       // likewise
+    double median {0};
+    double min {0};
+    double mean {0};
+    double stddev {0};
+
+    void summarize()
+    {
+        if (runs.empty())
+        {
+            return;
+        }
+        std::vector<double> sorted = runs;
+        std::sort(sorted.begin(), sorted.end());
+        std::size_t middle = sorted.size() / 2;
+        median = sorted.size() % 2 == 1
+            ? sorted[middle]
+            : (sorted[middle - 1] + sorted[middle]) / 2;
+        min = sorted.front();
+
+        for (double run : runs)
+        {
+            mean += run;
+        }
+        mean /= static_cast<double>(runs.size());
+        for (double run : runs)
+        {
+            stddev += (run - mean) * (run - mean);
+        }
+        stddev = std::sqrt(stddev / static_cast<double>(runs.size()));
+    }
+
+    /**
+     * @brief Megabytes per second at the median, 0 without bytes.
+     */
+    double throughput() const
+    {
+        return median > 0 ? 1000 * bytes / median : 0;
+    }
+};
+
+void appendJsonString(std::string& out, const std::string& text)
+{
+    out += '"';
+    for (char c : text)
+    {
+        if (c == '"' || c == '\\')
+        {
+            out += '\\';
+        }
+        out += c;
+    }
+    out += '"';
+}
+
+void appendJsonNumber(std::string& out, double value)
+{
+    char buffer[32];
+    int length = std::snprintf(buffer, sizeof(buffer), "%.3f", value);
+    out.append(buffer, static_cast<std::size_t>(length));
+}
+
+std::string toJson(const std::vector<Result>& results, std::uint64_t seed,
+    std::size_t repetitions)
+{
+    std::time_t now = std::time(nullptr);
+    char date[32];
+    std::strftime(date, sizeof(date), "%Y-%m-%dT%H:%M:%SZ", std::gmtime(&now));
+
+    std::string out = "{\n  \"context\": {\"date\": ";
+    appendJsonString(out, date);
+    out += ", \"compiler\": ";
+    appendJsonString(out, __VERSION__);
+#ifdef NDEBUG
+    out += ", \"assertions\": false";
+#else
+    out += ", \"assertions\": true";
+#endif
+    out += ", \"threads\": " +
+        std::to_string(std::thread::hardware_concurrency()) +
+        ", \"seed\": " + std::to_string(seed) +
+        ", \"repetitions\": " + std::to_string(repetitions) +
+        "},\n  \"benchmarks\": [";
+
+    for (std::size_t i = 0; i < results.size(); ++i)
+    {
+        const Result& result = results[i];
+        out += i == 0 ? "\n    {\"name\": " : ",\n    {\"name\": ";
+        appendJsonString(out, result.name);
+        out += ", \"iterations\": " + std::to_string(result.iterations);
+        if (!result.skipped.empty())
+        {
+            out += ", \"skipped\": ";
+            appendJsonString(out, result.skipped);
+            out += '}';
+            continue;
+        }
+        out += ", \"ns_per_op\": ";
+        appendJsonNumber(out, result.median);
+        out += ", \"min_ns_per_op\": ";
+        appendJsonNumber(out, result.min);
+        out += ", \"mean_ns_per_op\": ";
+        appendJsonNumber(out, result.mean);
+        out += ", \"stddev_ns_per_op\": ";
+        appendJsonNumber(out, result.stddev);
+        out += ", \"allocs_per_op\": ";
+        appendJsonNumber(out, result.allocations);
+        if (result.bytes > 0)
+        {
+            out += ", \"mb_per_s\": ";
+            appendJsonNumber(out, result.throughput());
+        }
+        out += ", \"runs\": [";
+        for (std::size_t run = 0; run < result.runs.size(); ++run)
+        {
+            if (run != 0)
+            {
+                out += ", ";
+            }
+            appendJsonNumber(out, result.runs[run]);
+        }
+        out += "]}";
+    }
+    out += "\n  ]\n}\n";
+    return out;
+}
+
+template <typename T>
+bool parseNumber(const std::string& text, T& value)
+{
+    auto [ptr, error] =
+        std::from_chars(text.data(), text.data() + text.size(), value);
+    return error == std::errc() && ptr == text.data() + text.size();
+}
+} // namespace
+
+State::State(std::size_t iterations, std::uint64_t seed)
+    : iterations_(iterations)
+    , seed_(seed)
+{
+}
+
+std::size_t State::iterations() const
+{
+    return iterations_;
+}
+
+std::uint64_t State::seed() const
+{
+    return seed_;
+}
+
+void State::skip(std::string reason)
+{
+    skipped_ = std::move(reason);
+}
+
+void State::start()
+{
+    started_ = true;
+    allocationsAtStart_ = allocationCount();
+    start_ = Clock::now();
+}
+
+void State::stop()
+{
+    stop_ = Clock::now();
+    allocationsAtStop_ = allocationCount();
+    stopped_ = true;
+}
+
+std::chrono::nanoseconds State::elapsed() const
+{
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(stop_ - start_);
+}
+
+std::uint64_t State::allocations() const
+{
+    return allocationsAtStop_ - allocationsAtStart_;
+}
+
+void State::setBytesProcessed(std::uint64_t bytes)
+{
+    bytes_ = bytes;
+}
+
+std::uint64_t allocationCount()
+{
+    return allocated.load(std::memory_order_relaxed);
+}
+
+Registrar::Registrar(const std::string& name, std::size_t iterations, Function fn)
+{
+    registry().push_back(Benchmark {name, iterations, std::move(fn)});
+}
+
+class Runner
+{
+  public:
+    /**
+     * @return Nanoseconds per operation, or a negative value if skipped.
+     */
+    static double run(const Benchmark& benchmark, std::size_t iterations,
+        std::uint64_t seed, std::string& skipped, double& allocations,
+        double& bytes)
+    {
+        State state(iterations, seed);
+        auto before = State::Clock::now();
+        std::uint64_t allocatedBefore = allocationCount();
+        benchmark.fn(state);
+        std::uint64_t allocatedAfter = allocationCount();
+        auto after = State::Clock::now();
+
+        if (!state.skipped_.empty())
+        {
+            skipped = state.skipped_;
+            return -1;
+        }
+        if (!state.started_)
+        {
+            state.start_ = before;
+            state.allocationsAtStart_ = allocatedBefore;
+        }
+        if (!state.stopped_)
+        {
+            state.stop_ = after;
+            state.allocationsAtStop_ = allocatedAfter;
+        }
+        allocations = static_cast<double>(state.allocations()) /
+            static_cast<double>(iterations);
+        bytes = static_cast<double>(state.bytes_) /
+            static_cast<double>(iterations);
+        return static_cast<double>(state.elapsed().count()) /
+            static_cast<double>(iterations);
+    }
+};
+} // namespace bench
+
+int main(int argc, char const* argv[])
+{
+    // planetplus-bench [FILTER] [--json FILE] [--repetitions N] [--seed N]
+    std::string filter;
+    std::string jsonPath;
+    std::size_t repetitions = bench::kDefaultRepetitions;
+    std::uint64_t seed = bench::kDefaultSeed;
+    for (int i = 1; i < argc; ++i)
+    {
+        std::string argument = argv[i];
+        std::string value = i + 1 < argc ? argv[i + 1] : "";
+        if (argument == "--json" && !value.empty())
+        {
+            jsonPath = value;
+            ++i;
+        }
+        else if (argument == "--repetitions" &&
+            bench::parseNumber(value, repetitions) && repetitions > 0)
+        {
+            ++i;
+        }
+        else if (argument == "--seed" && bench::parseNumber(value, seed))
+        {
+            ++i;
+        }
+        else if (argument.rfind("--", 0) == 0)
+        {
+            cli_tools::printError("Usage: planetplus-bench [FILTER] "
+                                  "[--json FILE] [--repetitions N] [--seed N]");
+            return CLI_EXIT_FAILURE;
+        }
+        else
+        {
+            // Only run benchmarks whose name contains it
+            filter = argument;
+        }
+    }
+
+    std::vector<bench::Result> results;
+    std::printf("%-40s %12s %12s %12s %7s %10s %10s\n", "benchmark",
+        "iterations", "ns/op", "min", "stddev", "allocs/op", "MB/s");
+    for (const bench::Benchmark& benchmark : bench::registry())
+    {
+        if (benchmark.name.find(filter) == std::string::npos)
+        {
+            continue;
+        }
+
+        bench::Result& result = results.emplace_back();
+        result.name = benchmark.name;
+        result.iterations = benchmark.iterations;
+
+        // Caches, allocator and lazily built data sets are warm afterwards
+        std::size_t warmup =
+            std::max<std::size_t>(1, benchmark.iterations / 10);
+        if (bench::Runner::run(benchmark, warmup, seed, result.skipped,
+                result.allocations, result.bytes) >= 0)
+        {
+            for (std::size_t i = 0; i < repetitions; ++i)
+            {
+                double perOp = bench::Runner::run(benchmark,
+                    benchmark.iterations, seed, result.skipped,
+                    result.allocations, result.bytes);
+                if (perOp < 0)
+                {
+                    break;
+                }
+                result.runs.push_back(perOp);
+            }
+        }
+
+        if (!result.skipped.empty())
+        {
+            std::printf("%-40s %12s  %s\n", benchmark.name.c_str(), "skipped",
+                result.skipped.c_str());
+            continue;
+        }
+        result.summarize();
+        std::printf("%-40s %12zu %12.1f %12.1f %6.1f%% %10.2f",
+            benchmark.name.c_str(), benchmark.iterations, result.median,
+            result.min,
+            result.mean > 0 ? 100 * result.stddev / result.mean : 0.0,
+            result.allocations);
+        if (result.bytes > 0)
+        {
+            std::printf(" %10.1f\n", result.throughput());
+        }
+        else
+        {
+            std::printf(" %10s\n", "-");
+        }
+    }
+
+    if (!jsonPath.empty())
+    {
+        std::ofstream file(jsonPath, std::ios::trunc);
+        file << bench::toJson(results, seed, repetitions);
+        if (!file)
+        {
+            cli_tools::printError(
+                "Failed to write " + cli_tools::bold(jsonPath));
+            return CLI_EXIT_FAILURE;
+        }
+    }
+    return CLI_EXIT_SUCCESS;
+}
@@ -0,0 +1,121 @@
+#ifndef BENCH_H
+#define BENCH_H
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <string>
+
+namespace bench
+{
+/**
+ * @brief Handed to every benchmark run.
+ *
+ * The benchmark must perform `iterations` operations. Setup done before
+ * start() is not measured. Every benchmark is run once as a warmup with a
+ * tenth of its iterations, then several times, so it must not rely on
+ * state left by a previous run.
+ */
+class State
+{
+  public:
+    State(std::size_t iterations, std::uint64_t seed);
+
+    std::size_t iterations() const;
+
+    /**
+     * @brief Seed for the random data of the benchmark, the same for every
+     *        run unless changed with --seed.
+     */
+    std::uint64_t seed() const;
+
+    /**
+     * @brief Marks the benchmark as not runnable here, e.g. without a
+     *        database, and why.
+     */
+    void skip(std::string reason);
+
+    /**
+     * @brief Starts the clock, everything before is considered setup.
+     */
+    void start();
+
+    /**
+     * @brief Stops the clock, everything after is considered teardown.
+     */
+    void stop();
+
+    std::chrono::nanoseconds elapsed() const;
+
+    /**
+     * @brief Heap allocations between start() and stop(), from any thread.
+     */
+    std::uint64_t allocations() const;
+
+    /**
+     * @brief Bytes gone through by all the iterations, reported as a
+     *        throughput next to the time per operation.
+     */
+    void setBytesProcessed(std::uint64_t bytes);
+
+  private:
+    using Clock = std::chrono::steady_clock;
+
+    std::size_t iterations_;
+    std::uint64_t seed_;
+    std::string skipped_;
+    Clock::time_point start_;
+    Clock::time_point stop_;
+    std::uint64_t allocationsAtStart_ {0};
+    std::uint64_t allocationsAtStop_ {0};
+    std::uint64_t bytes_ {0};
+    bool started_ {false};
+    bool stopped_ {false};
+
+    friend class Runner;
+};
+
+using Function = std::function<void(State& state)>;
+
+/**
+ * @brief Calls to operator new so far: the bench replaces it to count them.
+ */
+std::uint64_t allocationCount();
+
+/**
+ * @brief Registers a benchmark, see PLANETPLUS_BENCHMARK.
+ */
+struct Registrar
+{
+    Registrar(const std::string& name, std::size_t iterations, Function fn);
+};
+
+/**
+ * @brief Keeps a value alive so the optimizer cannot drop its computation.
+ */
+template <typename T>
+inline void doNotOptimize(const T& value)
+{
+    asm volatile("" : : "r,m"(value) : "memory");
+}
+} // namespace bench
+
+#define BENCH_CONCAT_(a, b) a##b
+#define BENCH_CONCAT(a, b) BENCH_CONCAT_(a, b)
+
+/**
+ * Defines a benchmark running `iterations` operations:
+ *
+ *     PLANETPLUS_BENCHMARK("utils.trim", 1000000)(bench::State& state)
+ *     {
+ *         ...
+ *     }
+ */
+#define PLANETPLUS_BENCHMARK(name, iterations)                                 \
+    static void BENCH_CONCAT(benchFunction, __LINE__)(bench::State&);          \
+    static bench::Registrar BENCH_CONCAT(benchRegistrar, __LINE__)(            \
+        name, iterations, BENCH_CONCAT(benchFunction, __LINE__));              \
+    static void BENCH_CONCAT(benchFunction, __LINE__)
+
+#endif
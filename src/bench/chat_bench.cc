@@ -0,0 +1,116 @@
+#include <chrono>
+#include <cstdint>
+#include <random>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "bench.h"
+#include "chat/commands.h"
+#include "chat/ratelimit.h"
+
+namespace
+{
+void addCommands(chat::Router& router, std::uint64_t& calls)
+{
+    chat::Handler count = [&calls](const chat::Context&,
+                              const chat::Arguments& arguments) {
+        calls += arguments.size() + 1;
+    };
+
+    const char* playerCommands[] = {"rec", "recs", "top", "pb", "rank",
+        "karma", "list", "help", "cp", "stats", "server", "players", "time",
+        "map", "nextmap", "jukebox", "jukebox list", "jukebox drop", "pm",
+        "donate"};
+    for (const char* name : playerCommands)
+    {
+        router.add({name, {}, chat::Permission::PLAYER, 0, "", count});
+    }
+
+    const char* adminCommands[] = {"skip", "restart", "replay", "endround",
+        "kick", "ban", "unban", "mute", "unmute", "warn", "setpassword",
+        "setspecpassword", "setname", "addmap", "removemap", "shuffle",
+        "pause", "unpause", "mode", "settings"};
+    for (const char* name : adminCommands)
+    {
+        router.add({std::string("admin ") + name, {name},
+            chat::Permission::ADMIN, 0, "", count});
+    }
+    router.compile();
+}
+} // namespace
+
+PLANETPLUS_BENCHMARK("chat.dispatch_mixed", 1000000)(bench::State& state)
+{
+    std::uint64_t calls = 0;
+    chat::Router router;
+    addCommands(router, calls);
+
+    // Mostly player commands, some abbreviations, typos and plain chat
+    const std::vector<std::string> lines = {"/rec", "/karma ++", "/top 10",
+        "/admin skip", "/adm sk", "/pm bob \"see you later\"", "/jukebox list",
+        "/Rec", "/help karma", "/restart", "/nope", "gg", "/admin kick bob",
+        "/admin set", "/cp 3", "/kick alice spamming"};
+    std::vector<chat::Context> contexts = {
+        {"player", chat::Permission::PLAYER},
+        {"admin", chat::Permission::ADMIN}};
+
+    std::mt19937 random(42);
+    std::uniform_int_distribution<std::size_t> pickLine(0, lines.size() - 1);
+    std::vector<std::uint16_t> order(4096);
+    for (std::uint16_t& index : order)
+    {
+        index = static_cast<std::uint16_t>(pickLine(random));
+    }
+
+    std::uint64_t statuses = 0;
+    state.start();
+    for (std::size_t i = 0; i < state.iterations(); ++i)
+    {
+        const std::string& line = lines[order[i & 4095]];
+        chat::Result result = router.dispatch(line, contexts[i & 1]);
+        statuses += static_cast<std::uint64_t>(result.status);
+    }
+    state.stop();
+    bench::doNotOptimize(statuses + calls);
+}
+
+PLANETPLUS_BENCHMARK("chat.tokenize", 1000000)(bench::State& state)
+{
+    std::string_view line = "/admin setpassword \"correct horse\" 12 yes";
+    std::uint64_t total = 0;
+
+    state.start();
+    for (std::size_t i = 0; i < state.iterations(); ++i)
+    {
+        chat::Arguments arguments(line.substr(1));
+        total += arguments.size() + *arguments.get<int>(3);
+    }
+    state.stop();
+    bench::doNotOptimize(total);
+}
+
+PLANETPLUS_BENCHMARK("chat.ratelimit_check", 1000000)(bench::State& state)
+{
+    chat::RateLimiter limiter {chat::RateLimitSettings()};
+    std::vector<std::string> logins;
+    for (std::size_t i = 0; i < 500; ++i)
+    {
+        logins.push_back("player" + std::to_string(i));
+    }
+
+    // One simulated millisecond per line, a few logins flood
+    auto now = chat::RateLimiter::Clock::now();
+    std::uint64_t decisions = 0;
+    state.start();
+    for (std::size_t i = 0; i < state.iterations(); ++i)
+    {
+        const std::string& login = logins[(i % 7 == 0) ? 0 : i % 500];
+        chat::Verdict verdict = limiter.check(login,
+            (i & 3) == 0 ? chat::Event::COMMAND : chat::Event::CHAT,
+            now + std::chrono::milliseconds(i));
+        decisions += static_cast<std::uint64_t>(verdict.decision);
+    }
+    state.stop();
+    bench::doNotOptimize(decisions);
+}
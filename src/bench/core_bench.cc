@@ -0,0 +1,124 @@
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <queue>
+#include <random>
+#include <vector>
+
+#include "bench.h"
+#include "core/timerwheel.h"
+
+namespace
+{
+constexpr std::size_t kLiveTimers = 10000;
+
+using Clock = core::TimerWheel::Clock;
+} // namespace
+
+// AFK checks and vote timeouts: most timers are cancelled before they fire
+PLANETPLUS_BENCHMARK("timers.wheel_schedule_cancel", 1000000)(
+    bench::State& state)
+{
+    auto start = Clock::now();
+    core::TimerWheel wheel(std::chrono::milliseconds(10), start);
+    std::mt19937 random(42);
+    std::uniform_int_distribution<int> delay(10, 600000);
+    std::vector<core::TimerId> live;
+    std::uint64_t fired = 0;
+    for (std::size_t i = 0; i < kLiveTimers; ++i)
+    {
+        live.push_back(wheel.after(
+            std::chrono::milliseconds(delay(random)), [&fired] { ++fired; }));
+    }
+
+    state.start();
+    for (std::size_t i = 0; i < state.iterations(); ++i)
+    {
+        std::size_t slot = i % kLiveTimers;
+        wheel.cancel(live[slot]);
+        live[slot] = wheel.after(
+            std::chrono::milliseconds(delay(random)), [&fired] { ++fired; });
+        if ((i & 1023) == 0)
+        {
+            wheel.advance(start + std::chrono::milliseconds(i / 64));
+        }
+    }
+    state.stop();
+    bench::doNotOptimize(fired);
+}
+
+PLANETPLUS_BENCHMARK("timers.heap_schedule_cancel", 1000000)(
+    bench::State& state)
+{
+    // Same workload on a priority queue, cancelled entries are skipped lazily
+    struct Entry
+    {
+        Clock::time_point due;
+        std::uint64_t id;
+        std::function<void()> callback;
+        bool operator>(const Entry& other) const
+        {
+            return due > other.due;
+        }
+    };
+    std::priority_queue<Entry, std::vector<Entry>, std::greater<Entry>> heap;
+    std::vector<std::uint64_t> live;
+    std::vector<char> cancelled;
+
+    auto start = Clock::now();
+    std::mt19937 random(42);
+    std::uniform_int_distribution<int> delay(10, 600000);
+    std::uint64_t fired = 0;
+    auto schedule = [&](Clock::time_point now) {
+        std::uint64_t id = cancelled.size();
+        cancelled.push_back(0);
+        heap.push({now + std::chrono::milliseconds(delay(random)), id,
+            [&fired] { ++fired; }});
+        return id;
+    };
+    for (std::size_t i = 0; i < kLiveTimers; ++i)
+    {
+        live.push_back(schedule(start));
+    }
+
+    state.start();
+    for (std::size_t i = 0; i < state.iterations(); ++i)
+    {
+        auto now = start + std::chrono::milliseconds(i / 64);
+        std::size_t slot = i % kLiveTimers;
+        cancelled[live[slot]] = 1;
+        live[slot] = schedule(now);
+        if ((i & 1023) == 0)
+        {
+            while (!heap.empty() && heap.top().due <= now)
+            {
+                if (!cancelled[heap.top().id])
+                {
+                    heap.top().callback();
+                }
+                heap.pop();
+            }
+        }
+    }
+    state.stop();
+    bench::doNotOptimize(fired + heap.size());
+}
+
+PLANETPLUS_BENCHMARK("timers.wheel_fire", 1000000)(bench::State& state)
+{
+    auto start = Clock::now();
+    core::TimerWheel wheel(std::chrono::milliseconds(10), start);
+    std::mt19937 random(7);
+    std::uniform_int_distribution<int> delay(0, 60000);
+    std::uint64_t fired = 0;
+
+    state.start();
+    for (std::size_t i = 0; i < state.iterations(); ++i)
+    {
+        wheel.after(
+            std::chrono::milliseconds(delay(random)), [&fired] { ++fired; });
+    }
+    wheel.advance(start + std::chrono::minutes(2));
+    state.stop();
+    bench::doNotOptimize(fired);
+}
@@ -0,0 +1,73 @@
+#include <algorithm>
+#include <cstdlib>
+#include <filesystem>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "bench.h"
+#include "utils/config.h"
+#include "utils/database.h"
+
+namespace
+{
+constexpr std::size_t kBatch = 500; // rows per INSERT, as at the end of a map
+constexpr const char* kMapUid = "planetplus-bench";
+
+std::vector<std::vector<records::Record>> batchesOf(
+    std::size_t rows, std::uint64_t seed)
+{
+    std::mt19937 random(static_cast<std::mt19937::result_type>(seed));
+    std::uniform_int_distribution<std::int32_t> time(30000, 90000);
+    std::vector<std::vector<records::Record>> batches;
+    for (std::size_t first = 0; first < rows; first += kBatch)
+    {
+        std::vector<records::Record>& batch = batches.emplace_back();
+        for (std::size_t i = first; i < std::min(first + kBatch, rows); ++i)
+        {
+            batch.push_back(records::Record {"player" + std::to_string(i),
+                time(random), static_cast<std::int64_t>(i)});
+        }
+    }
+    return batches;
+}
+} // namespace
+
+// Needs PLANETPLUS_BENCH_DB, a configuration file whose [database] is a
+// local stand-in with the schema loaded. Never point it at production: the
+// records of the bench map are wiped.
+PLANETPLUS_BENCHMARK("db.save_records_batch", 100000)(bench::State& state)
+{
+    const char* path = std::getenv("PLANETPLUS_BENCH_DB");
+    if (path == nullptr || !std::filesystem::exists(path))
+    {
+        state.skip("set PLANETPLUS_BENCH_DB to a configuration file with "
+                   "the [database] of a local stand-in");
+        return;
+    }
+
+    config::Config config(path);
+    config.load();
+    database::Manager manager(path, &config);
+    if (!manager.connect())
+    {
+        state.skip("cannot connect to the database of PLANETPLUS_BENCH_DB");
+        return;
+    }
+
+    std::string wipe =
+        "DELETE FROM records WHERE map_uid = '" + std::string(kMapUid) + "'";
+    manager.executeQuery(wipe);
+    std::vector<std::vector<records::Record>> batches =
+        batchesOf(state.iterations(), state.seed());
+
+    state.start();
+    for (const std::vector<records::Record>& rows : batches)
+    {
+        manager.saveRecords(kMapUid, rows);
+    }
+    state.stop();
+
+    manager.executeQuery(wipe);
+    manager.disconnect();
+}
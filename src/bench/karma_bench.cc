@@ -0,0 +1,139 @@
+#include <atomic>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#include "bench.h"
+#include "karma/karma.h"
+#include "utils/logins.h"
+
+namespace
+{
+constexpr std::size_t kThreads = 4;
+constexpr std::size_t kPlayers = 256; // per thread
+
+std::vector<utils::LoginId> players(std::size_t count)
+{
+    std::vector<utils::LoginId> ids;
+    for (std::size_t i = 0; i < count; ++i)
+    {
+        ids.push_back(utils::logins().intern("karma" + std::to_string(i)));
+    }
+    return ids;
+}
+
+/// End of a round: every player of every shard votes, and changes its mind.
+template <typename Function>
+void burst(bench::State& state, Function vote)
+{
+    std::vector<utils::LoginId> ids = players(kThreads * kPlayers);
+    std::vector<std::thread> threads;
+    std::atomic<bool> go {false};
+    std::size_t each = state.iterations() / kThreads;
+    for (std::size_t t = 0; t < kThreads; ++t)
+    {
+        threads.emplace_back([&go, &vote, &ids, each, t] {
+            while (!go.load(std::memory_order_acquire))
+            {
+            }
+            for (std::size_t i = 0; i < each; ++i)
+            {
+                vote(ids[t * kPlayers + i % kPlayers],
+                    (i / kPlayers) % 2 == 0 ? karma::Vote::PLUS
+                                            : karma::Vote::MINUS);
+            }
+        });
+    }
+
+    state.start();
+    go.store(true, std::memory_order_release);
+    for (std::thread& thread : threads)
+    {
+        thread.join();
+    }
+    state.stop();
+}
+} // namespace
+
+PLANETPLUS_BENCHMARK("karma.vote", 4000000)(bench::State& state)
+{
+    karma::MapVotes votes("bench");
+    std::vector<utils::LoginId> ids = players(kPlayers);
+
+    state.start();
+    for (std::size_t i = 0; i < state.iterations(); ++i)
+    {
+        votes.vote(ids[i % kPlayers],
+            i % 3 == 0 ? karma::Vote::MINUS : karma::Vote::PLUS);
+    }
+    state.stop();
+    bench::doNotOptimize(votes.score().percent());
+}
+
+PLANETPLUS_BENCHMARK("karma.vote_contended", 4000000)(bench::State& state)
+{
+    karma::MapVotes votes("bench");
+    burst(state, [&votes](utils::LoginId login, karma::Vote vote) {
+        votes.vote(login, vote);
+    });
+    bench::doNotOptimize(votes.score().percent());
+}
+
+// Same burst with the votes of a map behind a mutex
+PLANETPLUS_BENCHMARK("karma.locked_vote_contended", 4000000)(
+    bench::State& state)
+{
+    std::mutex mutex;
+    std::unordered_map<utils::LoginId, karma::Vote> last;
+    karma::Score score;
+    burst(state,
+        [&mutex, &last, &score](utils::LoginId login, karma::Vote vote) {
+            std::lock_guard<std::mutex> lock(mutex);
+            karma::Vote& before = last[login];
+            if (before == vote)
+            {
+                return;
+            }
+            (before == karma::Vote::PLUS ? score.plus : score.minus) -=
+                before != karma::Vote::NONE ? 1 : 0;
+            (vote == karma::Vote::PLUS ? score.plus : score.minus) += 1;
+            before = vote;
+        });
+    bench::doNotOptimize(score.percent());
+}
+
+// The widget reading the score while the votes come in
+PLANETPLUS_BENCHMARK("karma.score", 10000000)(bench::State& state)
+{
+    karma::MapVotes votes("bench");
+    std::vector<utils::LoginId> ids = players(kPlayers);
+    for (utils::LoginId login : ids)
+    {
+        votes.vote(login, karma::Vote::PLUS);
+    }
+
+    state.start();
+    for (std::size_t i = 0; i < state.iterations(); ++i)
+    {
+        bench::doNotOptimize(votes.score().percent());
+    }
+    state.stop();
+}
+
+// Batching the votes of a map for writing, per changed vote
+PLANETPLUS_BENCHMARK("karma.take_changes", 4096)(bench::State& state)
+{
+    karma::MapVotes votes("bench");
+    for (utils::LoginId login : players(state.iterations()))
+    {
+        votes.vote(login, karma::Vote::PLUS);
+    }
+
+    state.start();
+    karma::Rows rows = votes.takeChanges();
+    state.stop();
+    bench::doNotOptimize(rows.size());
+}
@@ -0,0 +1,64 @@
+#include <filesystem>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "bench.h"
+#include "utils/log.h"
+
+namespace
+{
+constexpr std::size_t kWriters = 4;
+
+std::string logPath()
+{
+    return (std::filesystem::temp_directory_path() / "planetplus-bench.log")
+        .string();
+}
+} // namespace
+
+// Chat lines of a busy server, until they are all on disk
+PLANETPLUS_BENCHMARK("log.write", 1000000)(bench::State& state)
+{
+    std::filesystem::remove(logPath());
+    logging::Writer log(logPath());
+    std::string message = "player1234: gg wp, see you next map";
+
+    state.start();
+    for (std::size_t i = 0; i < state.iterations(); ++i)
+    {
+        log.write("lobby", message);
+    }
+    log.flush();
+    state.stop();
+    bench::doNotOptimize(log.lines());
+}
+
+// Every shard thread logging into the shared file
+PLANETPLUS_BENCHMARK("log.write_4_threads", 1000000)(bench::State& state)
+{
+    std::filesystem::remove(logPath());
+    logging::Writer log(logPath());
+    std::string message = "player1234: gg wp, see you next map";
+    std::size_t each = state.iterations() / kWriters;
+
+    state.start();
+    std::vector<std::thread> threads;
+    for (std::size_t t = 0; t < kWriters; ++t)
+    {
+        threads.emplace_back([&log, &message, each, t] {
+            std::string source = "shard" + std::to_string(t);
+            for (std::size_t i = 0; i < each; ++i)
+            {
+                log.write(source, message);
+            }
+        });
+    }
+    for (std::thread& thread : threads)
+    {
+        thread.join();
+    }
+    log.flush();
+    state.stop();
+    bench::doNotOptimize(log.lines());
+}
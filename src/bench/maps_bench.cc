@@ -0,0 +1,199 @@
+#include <cstdint>
+#include <filesystem>
+#include <fstream>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "bench.h"
+#include "maps/gbx.h"
+#include "maps/library.h"
+
+namespace
+{
+constexpr std::size_t kMaps = 500;
+constexpr std::size_t kThumbnailSize = 16 * 1024;
+constexpr std::size_t kBodySize = 128 * 1024;
+
+class Writer
+{
+  public:
+    void u8(std::uint8_t value)
+    {
+        bytes.push_back(static_cast<char>(value));
+    }
+
+    void u32(std::uint32_t value)
+    {
+        for (int i = 0; i < 4; ++i)
+        {
+            u8(static_cast<std::uint8_t>(value >> (8 * i)));
+        }
+    }
+
+    void string(const std::string& value)
+    {
+        u32(static_cast<std::uint32_t>(value.size()));
+        bytes += value;
+    }
+
+    void lookback(const std::string& value)
+    {
+        u32(0x40000000);
+        string(value);
+    }
+
+    std::string bytes;
+};
+
+/**
+ * @brief A synthetic map as written by the ManiaPlanet editor: header
+ *        chunks with the map identity and times, a thumbnail, then a body
+ *        that the scanner must never read.
+ */
+std::string syntheticMap(std::size_t i, std::mt19937& random)
+{
+    Writer times;
+    times.u8(11);
+    times.u32(0);
+    for (std::uint32_t medal : {60000u, 50000u, 45000u})
+    {
+        times.u32(medal);
+    }
+    times.u32(40000 + static_cast<std::uint32_t>(i));
+    for (int k = 0; k < 7; ++k)
+    {
+        times.u32(0);
+    }
+
+    Writer common;
+    common.u8(11);
+    common.u32(3); // lookback version
+    common.lookback("SyntheticUid" + std::to_string(i) + "xxxxxxxxxxxx");
+    common.lookback("Stadium");
+    common.lookback("author" + std::to_string(i % 50));
+    common.string("$o$fffSynthetic map " + std::to_string(i));
+    common.u8(6);
+    common.u32(0);
+    common.string("");
+
+    Writer thumbnail;
+    thumbnail.u32(1);
+    thumbnail.u32(static_cast<std::uint32_t>(kThumbnailSize));
+    thumbnail.bytes += "<Thumbnail.jpg>";
+    thumbnail.bytes.append(kThumbnailSize, '\xAB');
+    thumbnail.bytes += "</Thumbnail.jpg>";
+    thumbnail.bytes += "<Comments>";
+    thumbnail.u32(0);
+    thumbnail.bytes += "</Comments>";
+
+    Writer author;
+    author.u32(0);
+    author.u32(0);
+    author.string("author" + std::to_string(i % 50));
+    author.string("$f00Author " + std::to_string(i % 50));
+    author.string("World|Europe|France");
+    author.string("");
+
+    std::vector<std::pair<std::uint32_t, const Writer*>> chunks = {
+        {maps::gbx::kChunkTimes, &times}, {maps::gbx::kChunkCommon, &common},
+        {maps::gbx::kChunkThumbnail, &thumbnail},
+        {maps::gbx::kChunkAuthor, &author}};
+
+    Writer userData;
+    userData.u32(static_cast<std::uint32_t>(chunks.size()));
+    for (auto& [id, chunk] : chunks)
+    {
+        userData.u32(id);
+        userData.u32(static_cast<std::uint32_t>(chunk->bytes.size()));
+    }
+    for (auto& [id, chunk] : chunks)
+    {
+        userData.bytes += chunk->bytes;
+    }
+
+    Writer file;
+    file.bytes = "GBX";
+    file.u8(6);
+    file.u8(0);
+    file.bytes += "BUCR";
+    file.u32(maps::gbx::kMapClassId);
+    file.u32(static_cast<std::uint32_t>(userData.bytes.size()));
+    file.bytes += userData.bytes;
+    file.u32(42); // node count, then the compressed body
+    for (std::size_t k = 0; k < kBodySize; ++k)
+    {
+        file.u8(static_cast<std::uint8_t>(random()));
+    }
+    return file.bytes;
+}
+
+const std::filesystem::path& corpus()
+{
+    static std::filesystem::path directory = [] {
+        auto path =
+            std::filesystem::temp_directory_path() / "planetplus-bench-maps";
+        std::filesystem::remove_all(path);
+        std::filesystem::create_directories(path / "nested");
+        std::mt19937 random(42);
+        for (std::size_t i = 0; i < kMaps; ++i)
+        {
+            auto name = (i % 2 ? path / "nested" : path) /
+                ("map" + std::to_string(i) + ".Map.Gbx");
+            std::ofstream out(name, std::ios::binary);
+            out << syntheticMap(i, random);
+        }
+        return path;
+    }();
+    return directory;
+}
+} // namespace
+
+PLANETPLUS_BENCHMARK("maps.parse_header", 100000)(bench::State& state)
+{
+    std::mt19937 random(1);
+    std::string map = syntheticMap(1, random);
+    auto data = reinterpret_cast<const unsigned char*>(map.data());
+
+    state.start();
+    for (std::size_t i = 0; i < state.iterations(); ++i)
+    {
+        maps::MapInfo info;
+        bench::doNotOptimize(maps::gbx::parseMapHeader(data, map.size(), info));
+    }
+    state.stop();
+}
+
+// Startup without an index: every map is mapped and parsed, per file timing
+PLANETPLUS_BENCHMARK("maps.scan_without_index", kMaps)(bench::State& state)
+{
+    std::string directory = corpus().string();
+    std::string index = (corpus() / "maps.idx").string();
+    std::filesystem::remove(index);
+
+    state.start();
+    maps::Library library(index);
+    maps::ScanStats stats = library.scan(directory);
+    library.save();
+    state.stop();
+    bench::doNotOptimize(stats.parsed);
+}
+
+// Restart with an up to date index: nothing is parsed, per file timing
+PLANETPLUS_BENCHMARK("maps.scan_with_index", kMaps)(bench::State& state)
+{
+    std::string directory = corpus().string();
+    std::string index = (corpus() / "maps.idx").string();
+    {
+        maps::Library warmup(index);
+        warmup.scan(directory);
+        warmup.save();
+    }
+
+    state.start();
+    maps::Library library(index);
+    library.load();
+    maps::ScanStats stats = library.scan(directory);
+    state.stop();
+    bench::doNotOptimize(stats.reused);
+}
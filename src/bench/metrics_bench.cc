@@ -0,0 +1,130 @@
+#include <atomic>
+#include <cstdint>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "bench.h"
+#include "metrics/registry.h"
+#include "metrics/tracing.h"
+
+namespace
+{
+constexpr std::size_t kThreads = 4;
+
+/// Runs iterations / kThreads increments on each of kThreads threads.
+template <typename Function>
+void contended(bench::State& state, Function increment)
+{
+    std::vector<std::thread> threads;
+    std::atomic<bool> go {false};
+    std::size_t each = state.iterations() / kThreads;
+    for (std::size_t t = 0; t < kThreads; ++t)
+    {
+        threads.emplace_back([&go, &increment, each] {
+            while (!go.load(std::memory_order_acquire))
+            {
+            }
+            for (std::size_t i = 0; i < each; ++i)
+            {
+                increment();
+            }
+        });
+    }
+
+    state.start();
+    go.store(true, std::memory_order_release);
+    for (std::thread& thread : threads)
+    {
+        thread.join();
+    }
+    state.stop();
+}
+} // namespace
+
+// Every shard thread counting callbacks into the same counter
+PLANETPLUS_BENCHMARK("metrics.counter_contended", 4000000)(
+    bench::State& state)
+{
+    metrics::Registry registry;
+    metrics::Counter& counter =
+        registry.counter("bench_total", "Contended counter");
+    contended(state, [&counter] { counter.add(); });
+    bench::doNotOptimize(counter.value());
+}
+
+PLANETPLUS_BENCHMARK("metrics.atomic_contended", 4000000)(
+    bench::State& state)
+{
+    // Same workload on a single atomic, every increment bounces its line
+    std::atomic<std::uint64_t> counter {0};
+    contended(state,
+        [&counter] { counter.fetch_add(1, std::memory_order_relaxed); });
+    bench::doNotOptimize(counter.load());
+}
+
+PLANETPLUS_BENCHMARK("metrics.histogram_record", 4000000)(
+    bench::State& state)
+{
+    metrics::Registry registry;
+    metrics::Histogram& histogram =
+        registry.histogram("bench_seconds", "Latencies", {}, 1e-6);
+    std::uint64_t value = 1;
+    state.start();
+    for (std::size_t i = 0; i < state.iterations(); ++i)
+    {
+        value = value * 6364136223846793005ULL + 1442695040888963407ULL;
+        histogram.record(value >> 44); // up to ~1 s in microseconds
+    }
+    state.stop();
+    bench::doNotOptimize(histogram.snapshot().count);
+}
+
+PLANETPLUS_BENCHMARK("metrics.render_200_series", 1000)(bench::State& state)
+{
+    metrics::Registry registry;
+    for (int shard = 0; shard < 50; ++shard)
+    {
+        metrics::Labels labels {{"shard", "server" + std::to_string(shard)}};
+        registry.counter("bench_callbacks_total", "Callbacks", labels).add(42);
+        registry.counter("bench_calls_total", "Calls", labels).add(7);
+        registry.gauge("bench_queue_bytes", "Queue", labels).set(1024);
+        registry.histogram("bench_lag_seconds", "Lag", labels, 1e-6)
+            .record(250);
+    }
+
+    std::string out;
+    state.start();
+    for (std::size_t i = 0; i < state.iterations(); ++i)
+    {
+        out.clear();
+        registry.render(out);
+    }
+    state.stop();
+    bench::doNotOptimize(out.size());
+}
+
+// Spans stay in the callback path, outside of captures they must be free
+PLANETPLUS_BENCHMARK("metrics.span_disabled", 10000000)(bench::State& state)
+{
+    state.start();
+    for (std::size_t i = 0; i < state.iterations(); ++i)
+    {
+        tracing::Span span("bench");
+        bench::doNotOptimize(i);
+    }
+    state.stop();
+}
+
+PLANETPLUS_BENCHMARK("metrics.span_capturing", 1000000)(bench::State& state)
+{
+    tracing::start();
+    state.start();
+    for (std::size_t i = 0; i < state.iterations(); ++i)
+    {
+        tracing::Span span("bench", "ManiaPlanet.PlayerChat");
+        bench::doNotOptimize(i);
+    }
+    state.stop();
+    tracing::stop("/dev/null");
+}
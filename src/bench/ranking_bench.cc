@@ -0,0 +1,72 @@
+#include <cstdint>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "bench.h"
+#include "ranking/live.h"
+#include "utils/logins.h"
+
+namespace
+{
+constexpr std::size_t kPlayers = 250;
+constexpr std::size_t kCheckpoints = 20;
+} // namespace
+
+PLANETPLUS_BENCHMARK("ranking.checkpoint_250_players", 1000000)(
+    bench::State& state)
+{
+    // Interned once when the players connect, as the callbacks would
+    std::vector<utils::LoginId> logins;
+    for (std::size_t i = 0; i < kPlayers; ++i)
+    {
+        logins.push_back(
+            utils::logins().intern("player" + std::to_string(i)));
+    }
+
+    ranking::LiveRanking live(kCheckpoints);
+    std::vector<std::size_t> reached(kPlayers, 0);
+    std::vector<std::int32_t> times(kPlayers, 0);
+    std::mt19937 random(42);
+    std::uniform_int_distribution<std::size_t> pick(0, kPlayers - 1);
+    std::uniform_int_distribution<std::int32_t> split(2000, 4000);
+
+    state.start();
+    for (std::size_t i = 0; i < state.iterations(); ++i)
+    {
+        std::size_t player = pick(random);
+        if (reached[player] == kCheckpoints)
+        {
+            // finished, start another round for everyone
+            live.newRound();
+            std::fill(reached.begin(), reached.end(), 0);
+            std::fill(times.begin(), times.end(), 0);
+        }
+        times[player] += split(random);
+        bench::doNotOptimize(
+            live.onCheckpoint(logins[player], reached[player]++, times[player])
+                .position);
+    }
+    state.stop();
+}
+
+PLANETPLUS_BENCHMARK("ranking.changes_since", 1000000)(bench::State& state)
+{
+    ranking::LiveRanking live(kCheckpoints);
+    std::mt19937 random(7);
+    std::uniform_int_distribution<std::int32_t> split(2000, 4000);
+    for (std::size_t i = 0; i < kPlayers; ++i)
+    {
+        live.onCheckpoint("player" + std::to_string(i), 0, split(random));
+    }
+
+    std::uint64_t tick = live.tick();
+    state.start();
+    for (std::size_t i = 0; i < state.iterations(); ++i)
+    {
+        ranking::Diff diff = live.changesSince(tick);
+        tick = diff.tick;
+        bench::doNotOptimize(diff.changes.size());
+    }
+    state.stop();
+}
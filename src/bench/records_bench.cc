@@ -0,0 +1,181 @@
+#include <cstdint>
+#include <cstdio>
+#include <filesystem>
+#include <random>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "bench.h"
+#include "records/archive.h"
+#include "records/records.h"
+
+namespace
+{
+constexpr std::size_t kRecords = 1000000;
+
+std::string loginOf(std::size_t i)
+{
+    return "player" + std::to_string(i);
+}
+
+std::vector<records::Record> millionRows()
+{
+    std::mt19937 random(42);
+    std::uniform_int_distribution<std::int32_t> time(30000, 90000);
+    std::vector<records::Record> rows;
+    rows.reserve(kRecords);
+    for (std::size_t i = 0; i < kRecords; ++i)
+    {
+        rows.push_back(records::Record {
+            loginOf(i), time(random), static_cast<std::int64_t>(i)});
+    }
+    return rows;
+}
+
+records::MapRecords& millionRecords()
+{
+    static records::MapRecords map = [] {
+        records::MapRecords m("bench");
+        m.load(millionRows());
+        return m;
+    }();
+    return map;
+}
+
+// A server with a long history: 1000 maps of 1000 records, 20000 players
+constexpr std::size_t kArchiveMaps = 1000;
+constexpr std::size_t kArchivePlayers = 20000;
+
+std::string archivePath()
+{
+    return (std::filesystem::temp_directory_path() / "planetplus-bench.ppr")
+        .string();
+}
+
+std::vector<std::vector<records::Record>> archiveRows()
+{
+    std::mt19937 random(42);
+    std::uniform_int_distribution<std::size_t> player(0, kArchivePlayers - 1);
+    std::uniform_int_distribution<std::int32_t> time(30000, 90000);
+    std::uniform_int_distribution<std::int64_t> when(1500000000, 1700000000);
+    std::vector<std::vector<records::Record>> maps(kArchiveMaps);
+    for (std::vector<records::Record>& rows : maps)
+    {
+        for (std::size_t i = 0; i < kRecords / kArchiveMaps; ++i)
+        {
+            rows.push_back(
+                records::Record {loginOf(player(random)), time(random),
+                    when(random)});
+        }
+    }
+    return maps;
+}
+
+bool saveArchive(std::vector<std::vector<records::Record>> maps)
+{
+    records::ArchiveWriter writer;
+    for (std::size_t map = 0; map < maps.size(); ++map)
+    {
+        writer.add("map" + std::to_string(map), std::move(maps[map]));
+    }
+    return writer.save(archivePath());
+}
+} // namespace
+
+PLANETPLUS_BENCHMARK("records.load_1M", 1)(bench::State& state)
+{
+    std::vector<records::Record> rows = millionRows();
+    state.start();
+    records::MapRecords map("bench");
+    map.load(std::move(rows));
+    state.stop();
+    bench::doNotOptimize(map.size());
+}
+
+PLANETPLUS_BENCHMARK("records.rank_of_1M", 1000000)(bench::State& state)
+{
+    records::MapRecords& map = millionRecords();
+    std::vector<std::string> logins;
+    std::mt19937 random(7);
+    std::uniform_int_distribution<std::size_t> pick(0, kRecords - 1);
+    for (std::size_t i = 0; i < 4096; ++i)
+    {
+        logins.push_back(loginOf(pick(random)));
+    }
+
+    state.start();
+    for (std::size_t i = 0; i < state.iterations(); ++i)
+    {
+        bench::doNotOptimize(map.rankOf(logins[i & 4095]));
+    }
+    state.stop();
+}
+
+PLANETPLUS_BENCHMARK("records.submit_1M", 200000)(bench::State& state)
+{
+    records::MapRecords& map = millionRecords();
+    std::mt19937 random(11);
+    std::uniform_int_distribution<std::size_t> pick(0, kRecords - 1);
+    std::uniform_int_distribution<std::int32_t> time(20000, 90000);
+
+    state.start();
+    for (std::size_t i = 0; i < state.iterations(); ++i)
+    {
+        bench::doNotOptimize(
+            map.submit(loginOf(pick(random)), time(random), 0).rank);
+    }
+    state.stop();
+}
+
+PLANETPLUS_BENCHMARK("records.around_1M", 200000)(bench::State& state)
+{
+    records::MapRecords& map = millionRecords();
+    std::string login = loginOf(kRecords / 2);
+
+    state.start();
+    for (std::size_t i = 0; i < state.iterations(); ++i)
+    {
+        bench::doNotOptimize(map.around(login, 5).size());
+    }
+    state.stop();
+}
+
+// --export-records once the rows are read: encoding and writing the file
+PLANETPLUS_BENCHMARK("records.archive_save_1M", 1)(bench::State& state)
+{
+    std::vector<std::vector<records::Record>> maps = archiveRows();
+    state.start();
+    bool saved = saveArchive(std::move(maps));
+    state.stop();
+    std::error_code error;
+    state.setBytesProcessed(std::filesystem::file_size(archivePath(), error));
+    bench::doNotOptimize(saved);
+}
+
+// --import-records of an archive before the rows are sent: every map decoded
+PLANETPLUS_BENCHMARK("records.archive_read_1M", 1)(bench::State& state)
+{
+    if (!std::filesystem::exists(archivePath()))
+    {
+        saveArchive(archiveRows());
+    }
+
+    std::size_t read = 0;
+    state.start();
+    records::Archive archive;
+    if (archive.open(archivePath()))
+    {
+        std::vector<records::Record> rows;
+        for (std::size_t map = 0; map < archive.maps(); ++map)
+        {
+            archive.read(map, rows);
+            read += rows.size();
+        }
+    }
+    state.stop();
+    std::error_code error;
+    state.setBytesProcessed(std::filesystem::file_size(archivePath(), error));
+    std::remove(archivePath().c_str());
+    bench::doNotOptimize(read);
+}
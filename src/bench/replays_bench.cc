@@ -0,0 +1,102 @@
+#include <cstdint>
+#include <filesystem>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "bench.h"
+#include "replays/store.h"
+#include "utils/sha256.h"
+
+namespace
+{
+constexpr std::size_t kReplaySize = 256 * 1024;
+
+/// A compressed body behind a header that compresses well, as in a Gbx
+std::string syntheticReplay(std::mt19937_64& random)
+{
+    std::string replay;
+    replay.reserve(kReplaySize);
+    while (replay.size() < kReplaySize / 4)
+    {
+        replay += "<header type=\"replay\" exever=\"3.3.0\" login=\"bench\"/>";
+    }
+    while (replay.size() < kReplaySize)
+    {
+        replay += static_cast<char>(random());
+    }
+    return replay;
+}
+
+std::string freshDirectory(const char* name)
+{
+    auto path = std::filesystem::temp_directory_path() / name;
+    std::filesystem::remove_all(path);
+    return path.string() + "/";
+}
+} // namespace
+
+PLANETPLUS_BENCHMARK("replays.sha256", 256)(bench::State& state)
+{
+    std::mt19937_64 random(state.seed());
+    std::string replay = syntheticReplay(random);
+
+    state.start();
+    for (std::size_t i = 0; i < state.iterations(); ++i)
+    {
+        bench::doNotOptimize(utils::Sha256::of(replay));
+    }
+    state.stop();
+    state.setBytesProcessed(state.iterations() * replay.size());
+}
+
+// Ghosts saved for every improvement, most of them the same files: one in
+// eight is new, the rest only gain a reference
+PLANETPLUS_BENCHMARK("replays.add_deduplicated", 256)(bench::State& state)
+{
+    std::mt19937_64 random(state.seed());
+    std::vector<std::string> distinct;
+    for (std::size_t i = 0; i < state.iterations() / 8 + 1; ++i)
+    {
+        distinct.push_back(syntheticReplay(random));
+    }
+    replays::Store store(freshDirectory("planetplus-bench-replays"));
+    store.open();
+
+    state.start();
+    for (std::size_t i = 0; i < state.iterations(); ++i)
+    {
+        store.add("map" + std::to_string(i % 16),
+            "player" + std::to_string(i), 60000, distinct[i / 8]);
+    }
+    store.flush();
+    state.stop();
+    state.setBytesProcessed(state.iterations() * kReplaySize);
+    bench::doNotOptimize(store.stats().storedBytes);
+}
+
+PLANETPLUS_BENCHMARK("replays.find", 1000000)(bench::State& state)
+{
+    replays::Store store(freshDirectory("planetplus-bench-replays-find"));
+    store.open();
+    for (std::size_t i = 0; i < 4096; ++i)
+    {
+        store.add("map" + std::to_string(i % 64),
+            "player" + std::to_string(i), 60000, std::to_string(i));
+    }
+    store.flush();
+    std::vector<std::string> logins;
+    for (std::size_t i = 0; i < 4096; ++i)
+    {
+        logins.push_back("player" + std::to_string(i));
+    }
+
+    state.start();
+    for (std::size_t i = 0; i < state.iterations(); ++i)
+    {
+        std::size_t player = i % 4096;
+        bench::doNotOptimize(
+            store.find("map" + std::to_string(player % 64), logins[player]));
+    }
+    state.stop();
+}
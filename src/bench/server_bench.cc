@@ -0,0 +1,344 @@
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "bench.h"
+#include "core/eventloop.h"
+#include "core/task.h"
+#include "server/gbxremote.h"
+#include "server/xmlrpc.h"
+
+namespace
+{
+constexpr std::size_t kConcurrentCalls = 10000;
+constexpr std::size_t kCallbackBatch = 250; // callbacks written at once
+
+/**
+ * @brief Stand-in dedicated server on the other end of a socket pair,
+ *        answering every call with a GetVersion like struct.
+ */
+class StandIn
+{
+  public:
+    StandIn(core::EventLoop& loop, int fd)
+        : loop_(loop)
+        , fd_(fd)
+    {
+        std::string header = "GBXRemote 2";
+        appendU32(static_cast<std::uint32_t>(header.size()));
+        output_ += header;
+        loop_.watch(fd_, POLLIN | POLLOUT, [this](short revents) {
+            onReady(revents);
+        });
+
+        xmlrpc::encodeResponse(response_,
+            xmlrpc::Value(xmlrpc::Value::Struct {
+                {"Name", xmlrpc::Value("ManiaPlanet")},
+                {"TitleId", xmlrpc::Value("TMStadium@nadeo")},
+                {"Version", xmlrpc::Value("3.3.0")},
+                {"Build", xmlrpc::Value("2019-10-23_20_00")},
+                {"ApiVersion", xmlrpc::Value("2013-04-16")},
+            }));
+    }
+
+    ~StandIn()
+    {
+        loop_.unwatch(fd_);
+        ::close(fd_);
+    }
+
+  private:
+    core::EventLoop& loop_;
+    int fd_;
+    std::string input_;
+    std::string output_;
+    std::string response_;
+    std::string method_;
+    std::vector<xmlrpc::Value> params_;
+
+    void appendU32(std::uint32_t value)
+    {
+        for (int shift = 0; shift < 32; shift += 8)
+        {
+            output_ += static_cast<char>((value >> shift) & 0xFF);
+        }
+    }
+
+    static std::uint32_t readU32(const char* data)
+    {
+        const auto* bytes = reinterpret_cast<const unsigned char*>(data);
+        return static_cast<std::uint32_t>(bytes[0]) |
+            static_cast<std::uint32_t>(bytes[1]) << 8 |
+            static_cast<std::uint32_t>(bytes[2]) << 16 |
+            static_cast<std::uint32_t>(bytes[3]) << 24;
+    }
+
+    void onReady(short revents)
+    {
+        if ((revents & POLLIN) != 0)
+        {
+            char buffer[64 * 1024];
+            ssize_t received;
+            while ((received = ::recv(fd_, buffer, sizeof(buffer), 0)) > 0)
+            {
+                input_.append(buffer, static_cast<std::size_t>(received));
+            }
+
+            std::size_t offset = 0;
+            while (input_.size() - offset >= 8)
+            {
+                std::uint32_t size = readU32(input_.data() + offset);
+                std::uint32_t handle = readU32(input_.data() + offset + 4);
+                if (input_.size() - offset - 8 < size)
+                {
+                    break;
+                }
+                std::string_view xml(input_.data() + offset + 8, size);
+                xmlrpc::decodeCall(xml, method_, params_);
+                appendU32(static_cast<std::uint32_t>(response_.size()));
+                appendU32(handle);
+                output_ += response_;
+                offset += 8 + size;
+            }
+            input_.erase(0, offset);
+        }
+
+        std::size_t written = 0;
+        while (written < output_.size())
+        {
+            ssize_t count = ::send(fd_, output_.data() + written,
+                output_.size() - written, MSG_NOSIGNAL);
+            if (count <= 0)
+            {
+                break;
+            }
+            written += static_cast<std::size_t>(count);
+        }
+        output_.erase(0, written);
+        loop_.modify(fd_, output_.empty() ? POLLIN : (POLLIN | POLLOUT));
+    }
+};
+
+void appendU32(std::string& out, std::uint32_t value)
+{
+    for (int shift = 0; shift < 32; shift += 8)
+    {
+        out += static_cast<char>((value >> shift) & 0xFF);
+    }
+}
+
+/// kCallbackBatch PlayerChat callbacks, framed as the server sends them.
+std::string chatCallbacks()
+{
+    std::string frames;
+    for (std::size_t i = 0; i < kCallbackBatch; ++i)
+    {
+        std::string xml;
+        std::vector<xmlrpc::Value> params;
+        params.emplace_back(static_cast<std::int32_t>(i + 1));
+        params.emplace_back("player" + std::to_string(i));
+        params.emplace_back(std::string("gg, nice run on this map"));
+        params.emplace_back(false);
+        xmlrpc::encodeCall(xml, "ManiaPlanet.PlayerChat", params);
+        appendU32(frames, static_cast<std::uint32_t>(xml.size()));
+        appendU32(frames, 0); // callbacks have the high bit clear
+        frames += xml;
+    }
+    return frames;
+}
+
+core::Task<> roundTrip(server::GbxRemote& remote, std::size_t& done,
+    server::Priority priority = server::Priority::GAMEPLAY)
+{
+    xmlrpc::Response response =
+        co_await remote.call("GetVersion", {}, priority);
+    if (!response.fault && response.value.find("Version") != nullptr)
+    {
+        ++done;
+    }
+}
+
+core::Task<> widget(server::GbxRemote& remote, const std::string& xml)
+{
+    std::vector<xmlrpc::Value> params;
+    params.emplace_back(xml);
+    params.emplace_back(0);
+    params.emplace_back(false);
+    co_await remote.call(
+        "SendDisplayManialinkPage", std::move(params), server::Priority::UI);
+}
+
+/**
+ * @brief Round trips of calls of priority made while widgets are queued,
+ *        64 pages of 4 KiB per call.
+ */
+void callBehindWidgets(bench::State& state, server::Priority priority)
+{
+    int fds[2];
+    if (::socketpair(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0,
+            fds) != 0)
+    {
+        return;
+    }
+
+    core::EventLoop loop;
+    StandIn standIn(loop, fds[1]);
+    server::GbxRemote remote(loop);
+    remote.attach(fds[0]);
+    while (!remote.connected())
+    {
+        loop.runOnce(std::chrono::milliseconds(100));
+    }
+
+    std::string xml = "<manialink id=\"bench\">";
+    while (xml.size() < 4096)
+    {
+        xml += "<label pos=\"0 0\" text=\"$fffRecords\"/>";
+    }
+    xml += "</manialink>";
+    for (std::size_t i = 0; i < state.iterations() * 64; ++i)
+    {
+        core::spawn(widget(remote, xml));
+    }
+
+    std::size_t done = 0;
+    state.start();
+    for (std::size_t i = 0; i < state.iterations(); ++i)
+    {
+        core::spawn(roundTrip(remote, done, priority));
+        while (done == i)
+        {
+            loop.runOnce(std::chrono::milliseconds(100));
+        }
+    }
+    state.stop();
+    while (remote.pending() > 0)
+    {
+        loop.runOnce(std::chrono::milliseconds(100));
+    }
+    bench::doNotOptimize(done);
+}
+} // namespace
+
+// Plugins and widgets all querying the server at the start of a map
+PLANETPLUS_BENCHMARK("server.coroutine_round_trips", 100000)(
+    bench::State& state)
+{
+    int fds[2];
+    if (::socketpair(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0,
+            fds) != 0)
+    {
+        return;
+    }
+
+    core::EventLoop loop;
+    StandIn standIn(loop, fds[1]);
+    server::GbxRemote remote(loop);
+    remote.attach(fds[0]);
+    while (!remote.connected())
+    {
+        loop.runOnce(std::chrono::milliseconds(100));
+    }
+
+    std::size_t done = 0;
+    state.start();
+    for (std::size_t started = 0; started < state.iterations();)
+    {
+        std::size_t batch =
+            std::min(kConcurrentCalls, state.iterations() - started);
+        for (std::size_t i = 0; i < batch; ++i)
+        {
+            core::spawn(roundTrip(remote, done));
+        }
+        started += batch;
+        while (remote.pending() > 0)
+        {
+            loop.runOnce(std::chrono::milliseconds(100));
+        }
+    }
+    state.stop();
+    bench::doNotOptimize(done);
+}
+
+// A busy server streaming chat: socket reads, framing, decoding, dispatch
+PLANETPLUS_BENCHMARK("server.callback_dispatch", 200000)(bench::State& state)
+{
+    int fds[2];
+    if (::socketpair(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0,
+            fds) != 0)
+    {
+        return;
+    }
+
+    std::string handshake;
+    appendU32(handshake, 11);
+    handshake += "GBXRemote 2";
+    ::send(fds[1], handshake.data(), handshake.size(), MSG_NOSIGNAL);
+
+    core::EventLoop loop;
+    server::GbxRemote remote(loop);
+    remote.attach(fds[0]);
+    while (!remote.connected())
+    {
+        loop.runOnce(std::chrono::milliseconds(100));
+    }
+
+    std::size_t received = 0;
+    std::size_t characters = 0;
+    remote.onCallback([&received, &characters](const std::string& method,
+                          const std::vector<xmlrpc::Value>& params) {
+        if (method == "ManiaPlanet.PlayerChat" && params.size() >= 4)
+        {
+            characters += params[2].asString().size();
+            ++received;
+        }
+    });
+
+    std::string frames = chatCallbacks();
+    std::size_t batches = state.iterations() / kCallbackBatch;
+    std::size_t sent = 0;
+    std::size_t offset = 0;
+    state.start();
+    while (received < batches * kCallbackBatch)
+    {
+        // Keep the socket full, the client drains it on the loop
+        while (sent < batches)
+        {
+            ssize_t count = ::send(fds[1], frames.data() + offset,
+                frames.size() - offset, MSG_NOSIGNAL);
+            if (count <= 0)
+            {
+                break;
+            }
+            offset += static_cast<std::size_t>(count);
+            if (offset == frames.size())
+            {
+                offset = 0;
+                ++sent;
+            }
+        }
+        loop.runOnce(std::chrono::milliseconds(100));
+    }
+    state.stop();
+    remote.close();
+    ::close(fds[1]);
+    bench::doNotOptimize(characters);
+}
+
+// An admin action while widgets flood the connection, ahead of them
+PLANETPLUS_BENCHMARK("server.admin_behind_widgets", 50)(bench::State& state)
+{
+    callBehindWidgets(state, server::Priority::ADMIN);
+}
+
+// The same call in the lane of the widgets: what one queue for all did
+PLANETPLUS_BENCHMARK("server.admin_behind_widgets_fifo", 50)(
+    bench::State& state)
+{
+    callBehindWidgets(state, server::Priority::UI);
+}
@@ -0,0 +1,211 @@
+#include <algorithm>
+#include <cstdint>
+#include <filesystem>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "bench.h"
+#include "stats/stats.h"
+#include "utils/logins.h"
+
+namespace
+{
+constexpr std::size_t kPlayers = 100000;
+constexpr std::size_t kMaps = 500;
+
+std::string loginOf(std::size_t i)
+{
+    return "stats" + std::to_string(i);
+}
+
+std::string mapOf(std::size_t i)
+{
+    return "map" + std::to_string(i);
+}
+
+/**
+ * @brief The tables of a long running server, as read on a cold start.
+ */
+const stats::Rows& rows(std::uint64_t seed)
+{
+    static stats::Rows rows = [seed] {
+        std::mt19937_64 random(seed);
+        stats::Rows out;
+        for (std::size_t i = 0; i < kPlayers; ++i)
+        {
+            stats::PlayerStats player;
+            player.finishes = static_cast<std::uint32_t>(random() % 500);
+            player.mapsFinished =
+                std::min<std::uint32_t>(player.finishes, random() % 100);
+            player.wins = static_cast<std::uint32_t>(random() % 20);
+            player.playtime = static_cast<std::int64_t>(random() % 360000);
+            out.players.emplace_back(loginOf(i), player);
+        }
+        for (std::size_t i = 0; i < kMaps; ++i)
+        {
+            out.maps.emplace_back(mapOf(i), stats::MapStats {});
+        }
+        return out;
+    }();
+    return rows;
+}
+
+stats::Aggregator& loaded(std::uint64_t seed)
+{
+    static stats::Aggregator aggregator;
+    static bool ready = [seed] {
+        aggregator.load(rows(seed));
+        return true;
+    }();
+    bench::doNotOptimize(ready);
+    return aggregator;
+}
+
+std::string snapshotPath()
+{
+    return (std::filesystem::temp_directory_path() / "planetplus-bench.snap")
+        .string();
+}
+
+std::vector<utils::LoginId> randomPlayers(std::uint64_t seed)
+{
+    std::mt19937_64 random(seed);
+    std::vector<utils::LoginId> players;
+    for (std::size_t i = 0; i < 4096; ++i)
+    {
+        players.push_back(
+            utils::logins().intern(loginOf(random() % kPlayers)));
+    }
+    return players;
+}
+} // namespace
+
+// Cold start: the only time the tables are read
+PLANETPLUS_BENCHMARK("stats.load_100k", 3)(bench::State& state)
+{
+    const stats::Rows& tables = rows(state.seed());
+    stats::Aggregator aggregator;
+
+    state.start();
+    for (std::size_t i = 0; i < state.iterations(); ++i)
+    {
+        aggregator.load(tables);
+    }
+    state.stop();
+    bench::doNotOptimize(aggregator.ranked());
+}
+
+// A finish updates the counters and moves the player in the server rank
+PLANETPLUS_BENCHMARK("stats.finish_100k", 1000000)(bench::State& state)
+{
+    stats::Aggregator& aggregator = loaded(state.seed());
+    std::vector<utils::LoginId> players = randomPlayers(state.seed());
+    std::vector<std::string> maps;
+    for (std::size_t i = 0; i < kMaps; ++i)
+    {
+        maps.push_back(mapOf(i));
+    }
+
+    state.start();
+    for (std::size_t i = 0; i < state.iterations(); ++i)
+    {
+        aggregator.onFinish(players[i & 4095], maps[i % kMaps]);
+    }
+    state.stop();
+    aggregator.takeChanges();
+}
+
+PLANETPLUS_BENCHMARK("stats.rank_of_100k", 1000000)(bench::State& state)
+{
+    stats::Aggregator& aggregator = loaded(state.seed());
+    std::vector<utils::LoginId> players = randomPlayers(state.seed());
+
+    state.start();
+    for (std::size_t i = 0; i < state.iterations(); ++i)
+    {
+        bench::doNotOptimize(aggregator.rankOf(players[i & 4095]));
+    }
+    state.stop();
+}
+
+// What a refresh cost before: every player ranked again, per refresh
+PLANETPLUS_BENCHMARK("stats.full_rerank_100k", 20)(bench::State& state)
+{
+    const stats::Rows& tables = rows(state.seed());
+    std::vector<std::pair<const stats::PlayerStats*, std::size_t>> order;
+
+    state.start();
+    for (std::size_t i = 0; i < state.iterations(); ++i)
+    {
+        order.clear();
+        for (std::size_t p = 0; p < tables.players.size(); ++p)
+        {
+            order.emplace_back(&tables.players[p].second, p);
+        }
+        std::sort(order.begin(), order.end(),
+            [](const auto& a, const auto& b) {
+                if (a.first->wins != b.first->wins)
+                {
+                    return a.first->wins > b.first->wins;
+                }
+                if (a.first->mapsFinished != b.first->mapsFinished)
+                {
+                    return a.first->mapsFinished > b.first->mapsFinished;
+                }
+                return a.first->finishes != b.first->finishes
+                    ? a.first->finishes > b.first->finishes
+                    : a.second < b.second;
+            });
+        bench::doNotOptimize(order.front().second);
+    }
+    state.stop();
+}
+
+// A checkpoint, per changed row: iterations players played since the last
+PLANETPLUS_BENCHMARK("stats.take_changes", 4096)(bench::State& state)
+{
+    stats::Aggregator& aggregator = loaded(state.seed());
+    for (std::size_t i = 0; i < state.iterations(); ++i)
+    {
+        aggregator.addPlaytime(
+            utils::logins().intern(loginOf(i % kPlayers)), "map0", 1);
+    }
+
+    state.start();
+    stats::Rows rows = aggregator.takeChanges();
+    state.stop();
+    bench::doNotOptimize(rows.players.size());
+}
+
+PLANETPLUS_BENCHMARK("stats.snapshot_save_100k", 3)(bench::State& state)
+{
+    const stats::Rows& tables = rows(state.seed());
+    std::string path = snapshotPath();
+
+    state.start();
+    for (std::size_t i = 0; i < state.iterations(); ++i)
+    {
+        bench::doNotOptimize(stats::saveSnapshot(path, tables));
+    }
+    state.stop();
+}
+
+// Warm start: the snapshot mapped, checked and loaded, to compare with
+// stats.load_100k plus reading the tables on a cold start
+PLANETPLUS_BENCHMARK("stats.snapshot_start_100k", 3)(bench::State& state)
+{
+    std::string path = snapshotPath();
+    stats::saveSnapshot(path, rows(state.seed()));
+    stats::Aggregator aggregator;
+
+    state.start();
+    for (std::size_t i = 0; i < state.iterations(); ++i)
+    {
+        stats::Rows snapshot;
+        bench::doNotOptimize(stats::loadSnapshot(path, snapshot));
+        aggregator.load(snapshot, false);
+    }
+    state.stop();
+    bench::doNotOptimize(aggregator.ranked());
+}
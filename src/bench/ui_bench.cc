@@ -0,0 +1,155 @@
+#include <chrono>
+#include <cstdint>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "bench.h"
+#include "records/records.h"
+#include "ui/manialink.h"
+#include "ui/widgets.h"
+
+namespace
+{
+constexpr std::size_t kPlayers = 200;
+
+std::vector<records::Record> recordRows()
+{
+    std::vector<records::Record> rows;
+    for (std::size_t i = 0; i < ui::kWidgetRows; ++i)
+    {
+        rows.push_back({(i % 5 == 0 ? "$f00<Team> " : "$fffPlayer ") +
+                std::to_string(i),
+            static_cast<std::int32_t>(45000 + i * 137), 0});
+    }
+    return rows;
+}
+
+std::string escape(const std::string& text)
+{
+    std::string out;
+    for (char c : text)
+    {
+        switch (c)
+        {
+            case '&':
+                out += "&amp;";
+                break;
+            case '<':
+                out += "&lt;";
+                break;
+            case '>':
+                out += "&gt;";
+                break;
+            case '"':
+                out += "&quot;";
+                break;
+            case '\'':
+                out += "&apos;";
+                break;
+            default:
+                out += c;
+        }
+    }
+    return out;
+}
+
+std::string formatTime(std::int32_t time)
+{
+    std::string seconds = std::to_string(time / 1000 % 60);
+    std::string millis = std::to_string(time % 1000);
+    return std::to_string(time / 60000) + ":" +
+        std::string(2 - seconds.size(), '0') + seconds + "." +
+        std::string(3 - millis.size(), '0') + millis;
+}
+
+std::string widget(const std::string& title, std::size_t version)
+{
+    std::string xml = "<frame pos=\"-160 80\"><label text=\"" + title + "\"/>";
+    for (std::size_t row = 0; row < 20; ++row)
+    {
+        xml += "<label pos=\"0 -" + std::to_string(row * 4) + "\" text=\"" +
+            std::to_string(version * 31 + row) + "\"/>";
+    }
+    return xml + "</frame>";
+}
+} // namespace
+
+// One iteration is one loop tick (50 ms): the records widget changes every
+// 20 ticks, live ranking every tick, 20 players get a checkpoint widget.
+PLANETPLUS_BENCHMARK("ui.tick_200_players", 5000)(bench::State& state)
+{
+    ui::ManialinkEngine engine;
+    std::vector<std::string> logins;
+    for (std::size_t i = 0; i < kPlayers; ++i)
+    {
+        logins.push_back("player" + std::to_string(i));
+        engine.connect(logins.back());
+    }
+
+    std::mt19937 random(42);
+    std::uniform_int_distribution<std::size_t> pick(0, kPlayers - 1);
+    auto now = ui::ManialinkEngine::Clock::now();
+    std::size_t calls = 0;
+
+    state.start();
+    for (std::size_t i = 0; i < state.iterations(); ++i)
+    {
+        engine.showAll("records", widget("Records", i / 20));
+        engine.showAll("ranking", widget("Live", i));
+        for (std::size_t j = 0; j < 20; ++j)
+        {
+            engine.show(logins[pick(random)], "checkpoint",
+                widget("Checkpoint", i + j));
+        }
+        calls += engine.tick(now + std::chrono::milliseconds(50 * i)).size();
+    }
+    state.stop();
+    bench::doNotOptimize(calls + engine.counters().bytesSaved);
+}
+
+PLANETPLUS_BENCHMARK("ui.records_widget_template", 20000)(bench::State& state)
+{
+    std::vector<records::Record> rows = recordRows();
+    std::size_t bytes = 0;
+
+    state.start();
+    for (std::size_t i = 0; i < state.iterations(); ++i)
+    {
+        bytes += ui::recordsWidget(rows).size();
+    }
+    state.stop();
+    bench::doNotOptimize(bytes);
+}
+
+PLANETPLUS_BENCHMARK("ui.records_widget_concat", 20000)(bench::State& state)
+{
+    std::vector<records::Record> rows = recordRows();
+    std::size_t bytes = 0;
+
+    state.start();
+    for (std::size_t i = 0; i < state.iterations(); ++i)
+    {
+        std::string rowsXml;
+        for (std::size_t rank = 0; rank < rows.size(); ++rank)
+        {
+            rowsXml += "<frame pos=\"0 -" + std::to_string(8 + rank * 4) +
+                "\"><label pos=\"2 0\" size=\"6 4\" textsize=\"1\" text=\"" +
+                std::to_string(rank + 1) +
+                ".\"/><label pos=\"9 0\" size=\"26 4\" textsize=\"1\" "
+                "text=\"" +
+                escape(rows[rank].login) +
+                "\"/><label pos=\"48 0\" halign=\"right\" size=\"12 4\" "
+                "textsize=\"1\" text=\"" +
+                formatTime(rows[rank].time) + "\"/></frame>";
+        }
+        std::string xml = "<frame pos=\"-160 80\" z-index=\"1\"><quad "
+                          "size=\"50 50\" bgcolor=\"0008\"/><label "
+                          "pos=\"25 -2\" halign=\"center\" textsize=\"2\" "
+                          "text=\"" +
+            escape("Local records") + "\"/>" + rowsXml + "</frame>";
+        bytes += xml.size();
+    }
+    state.stop();
+    bench::doNotOptimize(bytes);
+}
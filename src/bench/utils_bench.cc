@@ -0,0 +1,341 @@
+#include <filesystem>
+#include <fstream>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "bench.h"
+#include "utils/config.h"
+#include "utils/json.h"
+#include "utils/logins.h"
+#include "utils/utils.h"
+
+namespace
+{
+constexpr std::size_t kSections = 200;
+constexpr std::size_t kKeys = 50; // per section, 10000 lines in total
+
+std::string sectionOf(std::size_t i)
+{
+    return "server.shard" + std::to_string(i);
+}
+
+std::string keyOf(std::size_t i)
+{
+    return "setting_" + std::to_string(i);
+}
+
+/**
+ * @brief Configuration of a large multi-server setup, written once.
+ */
+const std::string& largeConfig(std::uint64_t seed)
+{
+    static std::string path = [seed] {
+        auto file = std::filesystem::temp_directory_path() /
+            "planetplus-bench-config.conf";
+        std::mt19937_64 random(seed);
+        std::ofstream out(file);
+        out << "# Configuration file for PlanetPlus\n\n[planetplus]\n"
+               "owners = \"owner1, owner2\"\n"
+               "admins = \"admin1, admin2, admin3, admin4\"\n\n";
+        for (std::size_t section = 0; section < kSections; ++section)
+        {
+            out << "[" << sectionOf(section) << "]\n";
+            for (std::size_t key = 0; key < kKeys; ++key)
+            {
+                out << "  " << keyOf(key) << " = \"" << random() << "\"\n";
+            }
+            out << "\n";
+        }
+        return file.string();
+    }();
+    return path;
+}
+
+std::string loginList(std::mt19937_64& random, std::size_t count)
+{
+    std::vector<std::string> logins;
+    for (std::size_t i = 0; i < count; ++i)
+    {
+        logins.push_back("player" + std::to_string(random() % 100000));
+    }
+    return utils::join(logins, ", ");
+}
+
+/**
+ * @brief Trackmania.Event.WayPoint payloads as a 64 player server sends
+ *        them, modelled on a capture: 16 checkpoints, a few nicknames
+ *        with escapes.
+ */
+const std::vector<std::string>& waypoints(std::uint64_t seed)
+{
+    static std::vector<std::string> payloads = [seed] {
+        std::mt19937_64 random(seed);
+        std::vector<std::string> out;
+        for (std::size_t i = 0; i < 1024; ++i)
+        {
+            std::size_t player = random() % 64;
+            std::size_t checkpoint = random() % 16;
+            std::int64_t time = 0;
+            std::string splits;
+            for (std::size_t c = 0; c <= checkpoint; ++c)
+            {
+                time += 2500 + static_cast<std::int64_t>(random() % 1500);
+                if (c != 0)
+                {
+                    splits += ',';
+                }
+                splits += std::to_string(time);
+            }
+            std::string login = player % 16 == 0
+                ? "pl\\u00e9yer" + std::to_string(player)
+                : "player" + std::to_string(player);
+            out.push_back("{\"time\": " + std::to_string(8641234 + i * 37) +
+                ",\"login\": \"" + login +
+                "\",\"accountid\": \"a1b2c3d4-e5f6-4a7b-8c9d-" +
+                std::to_string(100000000000 + player) +
+                "\",\"racetime\": " + std::to_string(time) +
+                ",\"laptime\": " + std::to_string(time) +
+                ",\"checkpointinrace\": " + std::to_string(checkpoint) +
+                ",\"checkpointinlap\": " + std::to_string(checkpoint) +
+                ",\"isendrace\": " + (checkpoint == 15 ? "true" : "false") +
+                ",\"isendlap\": " + (checkpoint == 15 ? "true" : "false") +
+                ",\"isinfinitelaps\": false,\"isindependentlaps\": false" +
+                ",\"curracecheckpoints\": [" + splits +
+                "],\"curlapcheckpoints\": [" + splits +
+                "],\"blockid\": \"#" + std::to_string(random() % 100000) +
+                "\",\"speed\": " + std::to_string(random() % 400) +
+                ".25,\"distance\": " + std::to_string(random() % 9000) +
+                ".5}");
+        }
+        return out;
+    }();
+    return payloads;
+}
+
+std::uint64_t totalSize(
+    const std::vector<std::string>& payloads, std::size_t iterations)
+{
+    std::uint64_t bytes = 0;
+    for (std::size_t i = 0; i < iterations; ++i)
+    {
+        bytes += payloads[i & 1023].size();
+    }
+    return bytes;
+}
+} // namespace
+
+// Startup of a process managing many servers, per file
+PLANETPLUS_BENCHMARK("config.load_10k_lines", 50)(bench::State& state)
+{
+    const std::string& path = largeConfig(state.seed());
+
+    state.start();
+    for (std::size_t i = 0; i < state.iterations(); ++i)
+    {
+        config::Config config(path);
+        config.load();
+        bench::doNotOptimize(config.sections().size());
+    }
+    state.stop();
+}
+
+PLANETPLUS_BENCHMARK("config.get", 1000000)(bench::State& state)
+{
+    config::Config config(largeConfig(state.seed()));
+    config.load();
+
+    std::mt19937_64 random(state.seed());
+    std::vector<std::pair<std::string, std::string>> lookups;
+    for (std::size_t i = 0; i < 4096; ++i)
+    {
+        lookups.emplace_back(
+            sectionOf(random() % kSections), keyOf(random() % kKeys));
+    }
+
+    state.start();
+    for (std::size_t i = 0; i < state.iterations(); ++i)
+    {
+        const auto& [section, key] = lookups[i & 4095];
+        bench::doNotOptimize(config.get(section, key).size());
+    }
+    state.stop();
+}
+
+// The admin lists of the configuration, 16 logins
+PLANETPLUS_BENCHMARK("utils.split", 1000000)(bench::State& state)
+{
+    std::mt19937_64 random(state.seed());
+    std::string list = loginList(random, 16);
+
+    state.start();
+    for (std::size_t i = 0; i < state.iterations(); ++i)
+    {
+        bench::doNotOptimize(utils::split(list, ", ").size());
+    }
+    state.stop();
+}
+
+PLANETPLUS_BENCHMARK("utils.join", 1000000)(bench::State& state)
+{
+    std::mt19937_64 random(state.seed());
+    std::vector<std::string> logins = utils::split(loginList(random, 16), ", ");
+
+    state.start();
+    for (std::size_t i = 0; i < state.iterations(); ++i)
+    {
+        bench::doNotOptimize(utils::join(logins, ", ").size());
+    }
+    state.stop();
+}
+
+// Every configuration line is trimmed, then its key and value
+PLANETPLUS_BENCHMARK("utils.trim", 1000000)(bench::State& state)
+{
+    const std::string line = "   port = \"5000\"\t  ";
+    std::string copy;
+
+    state.start();
+    for (std::size_t i = 0; i < state.iterations(); ++i)
+    {
+        copy = line;
+        utils::trim(copy);
+        bench::doNotOptimize(copy.size());
+    }
+    state.stop();
+}
+
+// Every callback names a player the table already knows
+PLANETPLUS_BENCHMARK("utils.login_intern", 1000000)(bench::State& state)
+{
+    std::vector<std::string> logins;
+    for (std::size_t i = 0; i < 4096; ++i)
+    {
+        logins.push_back("player" + std::to_string(i));
+        utils::logins().intern(logins.back());
+    }
+
+    state.start();
+    for (std::size_t i = 0; i < state.iterations(); ++i)
+    {
+        bench::doNotOptimize(utils::logins().intern(logins[i & 4095]));
+    }
+    state.stop();
+}
+
+// Four shards interning at once, one in sixteen logins new
+PLANETPLUS_BENCHMARK("utils.login_intern_4_threads", 1000000)(
+    bench::State& state)
+{
+    static std::uint64_t round = 0;
+    ++round;
+
+    state.start();
+    std::vector<std::thread> threads;
+    for (std::size_t t = 0; t < 4; ++t)
+    {
+        threads.emplace_back([&state, t] {
+            std::string login;
+            for (std::size_t i = t; i < state.iterations(); i += 4)
+            {
+                std::size_t player = i % 16 == 0 ? i : i & 4095;
+                login = "bench" + std::to_string(round) + "-" +
+                    std::to_string(player);
+                bench::doNotOptimize(utils::logins().intern(login));
+            }
+        });
+    }
+    for (std::thread& thread : threads)
+    {
+        thread.join();
+    }
+    state.stop();
+}
+
+PLANETPLUS_BENCHMARK("utils.login_name", 1000000)(bench::State& state)
+{
+    std::vector<utils::LoginId> ids;
+    for (std::size_t i = 0; i < 4096; ++i)
+    {
+        ids.push_back(utils::logins().intern("player" + std::to_string(i)));
+    }
+
+    state.start();
+    for (std::size_t i = 0; i < state.iterations(); ++i)
+    {
+        bench::doNotOptimize(utils::logins().name(ids[i & 4095]).size());
+    }
+    state.stop();
+}
+
+// Finding the structure of a waypoint, no field read
+PLANETPLUS_BENCHMARK("json.waypoint_index", 1000000)(bench::State& state)
+{
+    const std::vector<std::string>& payloads = waypoints(state.seed());
+    json::Parser parser;
+
+    state.start();
+    for (std::size_t i = 0; i < state.iterations(); ++i)
+    {
+        bench::doNotOptimize(parser.parse(payloads[i & 1023]));
+    }
+    state.stop();
+    state.setBytesProcessed(totalSize(payloads, state.iterations()));
+}
+
+// What the shard reads of every waypoint
+PLANETPLUS_BENCHMARK("json.waypoint_fields", 1000000)(bench::State& state)
+{
+    const std::vector<std::string>& payloads = waypoints(state.seed());
+    json::Parser parser;
+
+    state.start();
+    for (std::size_t i = 0; i < state.iterations(); ++i)
+    {
+        parser.parse(payloads[i & 1023]);
+        json::Value event = parser.root();
+        bench::doNotOptimize(event.find("login").asString().size());
+        bench::doNotOptimize(event.find("racetime").asInt());
+        bench::doNotOptimize(event.find("checkpointinrace").asInt());
+        bench::doNotOptimize(event.find("isendrace").asBool());
+    }
+    state.stop();
+    state.setBytesProcessed(totalSize(payloads, state.iterations()));
+}
+
+// Every field and split read, for comparison with the lazy path
+PLANETPLUS_BENCHMARK("json.waypoint_everything", 1000000)(
+    bench::State& state)
+{
+    const std::vector<std::string>& payloads = waypoints(state.seed());
+    json::Parser parser;
+
+    state.start();
+    for (std::size_t i = 0; i < state.iterations(); ++i)
+    {
+        parser.parse(payloads[i & 1023]);
+        for (json::Value field = parser.root().first(); field;
+             field = field.next())
+        {
+            if (field.type() == json::Value::Type::ARRAY)
+            {
+                for (json::Value split = field.first(); split;
+                     split = split.next())
+                {
+                    bench::doNotOptimize(split.asInt());
+                }
+            }
+            else if (field.type() == json::Value::Type::STRING)
+            {
+                bench::doNotOptimize(field.asString().size());
+            }
+            else
+            {
+                bench::doNotOptimize(field.asDouble());
+            }
+        }
+    }
+    state.stop();
+    state.setBytesProcessed(totalSize(payloads, state.iterations()));
+}
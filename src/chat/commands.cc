@@ -0,0 +1,377 @@
+#include "commands.h"
+
+#include <algorithm>
+#include <map>
+
+#include "cli/tools.h"
+#include "utils/utils.h"
+
+namespace chat
+{
+namespace
+{
+char lower(char c)
+{
+    return (c >= 'A' && c <= 'Z') ? static_cast<char>(c - 'A' + 'a') : c;
+}
+
+// Command words are matched case-insensitively, "/Rec" runs "/rec"
+int compareWords(std::string_view a, std::string_view b)
+{
+    std::size_t length = std::min(a.size(), b.size());
+    for (std::size_t i = 0; i < length; ++i)
+    {
+        char x = lower(a[i]);
+        char y = lower(b[i]);
+        if (x != y)
+        {
+            return x < y ? -1 : 1;
+        }
+    }
+    if (a.size() == b.size())
+    {
+        return 0;
+    }
+    return a.size() < b.size() ? -1 : 1;
+}
+
+bool startsWith(std::string_view word, std::string_view prefix)
+{
+    return word.size() >= prefix.size() &&
+        compareWords(word.substr(0, prefix.size()), prefix) == 0;
+}
+
+struct WordLess
+{
+    bool operator()(std::string_view a, std::string_view b) const
+    {
+        return compareWords(a, b) < 0;
+    }
+};
+} // namespace
+
+void Permissions::load(config::Config& config)
+{
+    levels_.clear();
+    const std::pair<config::ConfigType, Permission> lists[] = {
+        {config::ConfigType::ADMIN, Permission::ADMIN},
+        {config::ConfigType::MASTERADMIN, Permission::MASTERADMIN},
+        {config::ConfigType::OWNER, Permission::OWNER}};
+
+    // A login listed twice keeps its highest level
+    for (const auto& [type, permission] : lists)
+    {
+        for (const std::string& entry : config.get(type))
+        {
+            std::string login = entry;
+            utils::trim(login); // lists are saved as "a, b"
+            if (!login.empty())
+            {
+                utils::LoginId id = utils::logins().intern(login);
+                set(id, std::max(levelOf(id), permission));
+            }
+        }
+    }
+}
+
+void Permissions::set(std::string_view login, Permission permission)
+{
+    set(utils::logins().intern(login), permission);
+}
+
+void Permissions::set(utils::LoginId login, Permission permission)
+{
+    if (login != utils::Logins::kNone)
+    {
+        levels_[login] = permission;
+    }
+}
+
+Permission Permissions::levelOf(std::string_view login) const
+{
+    // find(), not intern(): players nobody listed are not worth a copy
+    return levelOf(utils::logins().find(login));
+}
+
+Permission Permissions::levelOf(utils::LoginId login) const
+{
+    auto it = levels_.find(login);
+    return it == levels_.end() ? Permission::PLAYER : it->second;
+}
+
+Arguments::Arguments(std::string_view line)
+    : line_(line)
+{
+    std::size_t i = 0;
+    while (count_ < kMaxTokens)
+    {
+        while (i < line.size() && line[i] == ' ')
+        {
+            ++i;
+        }
+        if (i == line.size())
+        {
+            break;
+        }
+
+        std::size_t start = i;
+        std::size_t end;
+        if (count_ == kMaxTokens - 1)
+        {
+            end = line.size();
+            while (line[end - 1] == ' ')
+            {
+                --end;
+            }
+            i = line.size();
+        }
+        else if (line[i] == '"')
+        {
+            start = ++i;
+            while (i < line.size() && line[i] != '"')
+            {
+                ++i;
+            }
+            end = i;
+            if (i < line.size())
+            {
+                ++i; // closing quote
+            }
+        }
+        else
+        {
+            while (i < line.size() && line[i] != ' ')
+            {
+                ++i;
+            }
+            end = i;
+        }
+        tokens_[count_++] = line.substr(start, end - start);
+    }
+}
+
+std::size_t Arguments::size() const
+{
+    return count_;
+}
+
+bool Arguments::empty() const
+{
+    return count_ == 0;
+}
+
+std::string_view Arguments::operator[](std::size_t index) const
+{
+    return index < count_ ? tokens_[index] : std::string_view();
+}
+
+Arguments Arguments::from(std::size_t index) const
+{
+    Arguments arguments;
+    arguments.line_ = line_;
+    for (std::size_t i = index; i < count_; ++i)
+    {
+        arguments.tokens_[arguments.count_++] = tokens_[i];
+    }
+    return arguments;
+}
+
+std::string_view Arguments::rest(std::size_t index) const
+{
+    if (index >= count_)
+    {
+        return std::string_view();
+    }
+
+    std::size_t start = static_cast<std::size_t>(
+        tokens_[index].data() - line_.data());
+    if (start > 0 && line_[start - 1] == '"')
+    {
+        --start;
+    }
+    std::size_t end = line_.size();
+    while (end > start && line_[end - 1] == ' ')
+    {
+        --end;
+    }
+    return line_.substr(start, end - start);
+}
+
+void Router::add(Command command)
+{
+    commands_.push_back(std::move(command));
+    compiled_ = false;
+}
+
+void Router::compile()
+{
+    // Build a map based tree first, then lay it out breadth first so the
+    // children of a node are contiguous and sorted
+    struct Pending
+    {
+        std::map<std::string_view, std::size_t, WordLess> children;
+        std::uint32_t command {kNone};
+    };
+    std::vector<Pending> tree(1);
+
+    auto insert = [&](std::string_view path, std::uint32_t command) {
+        std::size_t node = 0;
+        std::size_t i = 0;
+        while (i < path.size())
+        {
+            std::size_t end = std::min(path.find(' ', i), path.size());
+            if (end > i)
+            {
+                std::string_view word = path.substr(i, end - i);
+                auto it = tree[node].children.find(word);
+                if (it == tree[node].children.end())
+                {
+                    tree.emplace_back();
+                    it = tree[node].children.emplace(word, tree.size() - 1)
+                             .first;
+                }
+                node = it->second;
+            }
+            i = end + 1;
+        }
+
+        if (node == 0)
+        {
+            return;
+        }
+        if (tree[node].command != kNone)
+        {
+            cli_tools::printWarning("Duplicate chat command: " +
+                cli_tools::bold(std::string(path)));
+            return;
+        }
+        tree[node].command = command;
+    };
+
+    for (std::uint32_t i = 0; i < commands_.size(); ++i)
+    {
+        insert(commands_[i].name, i);
+        for (const std::string& alias : commands_[i].aliases)
+        {
+            insert(alias, i);
+        }
+    }
+
+    nodes_.assign(tree.size(), Node());
+    edges_.clear();
+    std::vector<std::size_t> queue = {0};
+    std::vector<std::uint32_t> position(tree.size(), 0);
+    for (std::size_t head = 0; head < queue.size(); ++head)
+    {
+        const Pending& pending = tree[queue[head]];
+        Node& node = nodes_[position[queue[head]]];
+        node.command = pending.command;
+        node.firstEdge = static_cast<std::uint32_t>(edges_.size());
+        node.edgeCount = static_cast<std::uint32_t>(pending.children.size());
+        for (const auto& [word, child] : pending.children)
+        {
+            position[child] = static_cast<std::uint32_t>(queue.size());
+            queue.push_back(child);
+            edges_.push_back({word, position[child]});
+        }
+    }
+    compiled_ = true;
+}
+
+Result Router::dispatch(std::string_view line, const Context& context) const
+{
+    Arguments arguments;
+    Result result = resolve(line, arguments);
+    if (result.status != Status::OK)
+    {
+        return result;
+    }
+
+    const Command& command = *result.command;
+    if (context.permission < command.permission)
+    {
+        result.status = Status::DENIED;
+        return result;
+    }
+    if (arguments.size() < command.minArguments)
+    {
+        result.status = Status::BAD_ARGUMENTS;
+        return result;
+    }
+    if (command.handler)
+    {
+        command.handler(context, arguments);
+    }
+    return result;
+}
+
+Result Router::resolve(std::string_view line, Arguments& arguments) const
+{
+    if (line.empty() || line[0] != '/')
+    {
+        return {Status::NOT_A_COMMAND, nullptr};
+    }
+    if (!compiled_)
+    {
+        return {Status::UNKNOWN, nullptr};
+    }
+
+    Arguments words(line.substr(1));
+    std::uint32_t node = 0;
+    std::uint32_t command = kNone;
+    std::size_t depth = 0;
+    bool ambiguous = false;
+    for (std::size_t i = 0; i < words.size(); ++i)
+    {
+        std::uint32_t next = child(nodes_[node], words[i]);
+        if (next == kNone || next == kAmbiguous)
+        {
+            ambiguous = next == kAmbiguous;
+            break;
+        }
+        node = next;
+        if (nodes_[node].command != kNone)
+        {
+            command = nodes_[node].command;
+            depth = i + 1;
+            ambiguous = false;
+        }
+    }
+
+    if (command == kNone)
+    {
+        return {ambiguous ? Status::AMBIGUOUS : Status::UNKNOWN, nullptr};
+    }
+    arguments = words.from(depth);
+    return {Status::OK, &commands_[command]};
+}
+
+const std::vector<Command>& Router::commands() const
+{
+    return commands_;
+}
+
+std::uint32_t Router::child(const Node& node, std::string_view word) const
+{
+    auto first = edges_.begin() + node.firstEdge;
+    auto last = first + node.edgeCount;
+    auto it = std::lower_bound(first, last, word,
+        [](const Edge& edge, std::string_view value) {
+            return compareWords(edge.word, value) < 0;
+        });
+
+    if (it == last || !startsWith(it->word, word))
+    {
+        return kNone;
+    }
+    if (it->word.size() == word.size())
+    {
+        return it->node; // exact match, even if it prefixes other words
+    }
+    if (it + 1 != last && startsWith((it + 1)->word, word))
+    {
+        return kAmbiguous;
+    }
+    return it->node;
+}
+} // namespace chat
@@ -0,0 +1,237 @@
+#ifndef CHAT_COMMANDS_H
+#define CHAT_COMMANDS_H
+
+#include <array>
+#include <charconv>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <type_traits>
+#include <unordered_map>
+#include <vector>
+
+#include "utils/config.h"
+#include "utils/logins.h"
+
+namespace chat
+{
+/**
+ * @brief Permission levels, each one includes the ones below.
+ */
+enum class Permission
+{
+    PLAYER,
+    ADMIN,
+    MASTERADMIN,
+    OWNER
+};
+
+/**
+ * @brief Permission level of every login listed in the configuration.
+ */
+class Permissions
+{
+  public:
+    /**
+     * @brief Reads the owners, masteradmins and admins lists.
+     */
+    void load(config::Config& config);
+
+    void set(std::string_view login, Permission permission);
+    void set(utils::LoginId login, Permission permission);
+
+    Permission levelOf(std::string_view login) const;
+    Permission levelOf(utils::LoginId login) const;
+
+  private:
+    std::unordered_map<utils::LoginId, Permission> levels_;
+};
+
+/**
+ * @brief Arguments of a command, views into the chat line.
+ *
+ * Tokens are split on spaces, double quotes group words. Nothing is
+ * allocated: tokens are string_views and parsing goes through from_chars.
+ */
+class Arguments
+{
+  public:
+    static constexpr std::size_t kMaxTokens = 16;
+
+    Arguments() = default;
+
+    /**
+     * @brief Splits line into tokens. Tokens past kMaxTokens are kept whole
+     *        in the last one.
+     */
+    explicit Arguments(std::string_view line);
+
+    std::size_t size() const;
+    bool empty() const;
+    std::string_view operator[](std::size_t index) const;
+
+    /**
+     * @brief Arguments from index on, e.g. the words of a message.
+     */
+    Arguments from(std::size_t index) const;
+
+    /**
+     * @brief The raw text from token index to the end of the line.
+     */
+    std::string_view rest(std::size_t index) const;
+
+    /**
+     * @brief Token index converted to T: integers, floating point, bool
+     *        (1/0, true/false, yes/no, on/off) or std::string_view.
+     */
+    template <typename T>
+    std::optional<T> get(std::size_t index) const
+    {
+        if (index >= count_)
+        {
+            return std::nullopt;
+        }
+        std::string_view token = tokens_[index];
+
+        if constexpr (std::is_same_v<T, std::string_view>)
+        {
+            return token;
+        }
+        else if constexpr (std::is_same_v<T, bool>)
+        {
+            if (token == "1" || token == "true" || token == "yes" ||
+                token == "on")
+            {
+                return true;
+            }
+            if (token == "0" || token == "false" || token == "no" ||
+                token == "off")
+            {
+                return false;
+            }
+            return std::nullopt;
+        }
+        else
+        {
+            static_assert(std::is_arithmetic_v<T>, "unsupported argument type");
+            T value {};
+            const char* last = token.data() + token.size();
+            auto [ptr, error] = std::from_chars(token.data(), last, value);
+            if (error != std::errc() || ptr != last)
+            {
+                return std::nullopt;
+            }
+            return value;
+        }
+    }
+
+  private:
+    std::array<std::string_view, kMaxTokens> tokens_ {};
+    std::size_t count_ {0};
+    std::string_view line_;
+};
+
+/**
+ * @brief Who sent a command.
+ */
+struct Context
+{
+    std::string_view login;
+    Permission permission {Permission::PLAYER};
+};
+
+using Handler = std::function<void(const Context&, const Arguments&)>;
+
+/**
+ * @brief A chat command, e.g. "admin skip" for "/admin skip".
+ */
+struct Command
+{
+    std::string name;                 // words separated by one space
+    std::vector<std::string> aliases; // other names, e.g. "skip"
+    Permission permission {Permission::PLAYER};
+    std::size_t minArguments {0};
+    std::string usage; // shown when arguments are missing
+    Handler handler;
+};
+
+enum class Status
+{
+    OK,
+    NOT_A_COMMAND, // the line does not start with '/'
+    UNKNOWN,
+    AMBIGUOUS, // an abbreviation matches several commands
+    DENIED,
+    BAD_ARGUMENTS
+};
+
+struct Result
+{
+    Status status {Status::UNKNOWN};
+    const Command* command {nullptr};
+};
+
+/**
+ * @brief Chat command registry and dispatcher.
+ *
+ * Commands are registered at startup then compiled into a trie of words,
+ * stored as flat sorted arrays. Dispatching walks the trie one word at a
+ * time with a binary search per level; any unambiguous prefix of a word is
+ * accepted ("/adm sk" runs "/admin skip").
+ */
+class Router
+{
+  public:
+    void add(Command command);
+
+    /**
+     * @brief Builds the dispatch trie, must be called after the last add().
+     */
+    void compile();
+
+    /**
+     * @brief Runs the command of a chat line.
+     *
+     * @param line    Chat text, e.g. "/karma ++".
+     * @param context Sender of the line.
+     */
+    Result dispatch(std::string_view line, const Context& context) const;
+
+    /**
+     * @brief Finds the command of a chat line without running it.
+     */
+    Result resolve(std::string_view line, Arguments& arguments) const;
+
+    const std::vector<Command>& commands() const;
+
+  private:
+    static constexpr std::uint32_t kNone = static_cast<std::uint32_t>(-1);
+    static constexpr std::uint32_t kAmbiguous = kNone - 1;
+
+    struct Node
+    {
+        std::uint32_t firstEdge {0};
+        std::uint32_t edgeCount {0};
+        std::uint32_t command {kNone};
+    };
+
+    struct Edge
+    {
+        std::string_view word; // views into commands_ names and aliases
+        std::uint32_t node;
+    };
+
+    std::vector<Command> commands_;
+    std::vector<Node> nodes_;
+    std::vector<Edge> edges_;
+    bool compiled_ {false};
+
+    /// Child of node for word, kNone if missing, kAmbiguous if unclear.
+    std::uint32_t child(const Node& node, std::string_view word) const;
+};
+} // namespace chat
+
+#endif
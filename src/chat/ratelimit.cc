@@ -0,0 +1,304 @@
+#include "ratelimit.h"
+
+#include <algorithm>
+#include <charconv>
+#include <cmath>
+#include <string>
+#include <type_traits>
+
+#include "cli/tools.h"
+
+namespace chat
+{
+namespace
+{
+// A bucket word: last refill in milliseconds since the limiter was created,
+// then the token count in thousandths, biased to be unsigned. Zero is a
+// bucket that was never used, i.e. a full one.
+constexpr int kTokenBits = 24;
+constexpr std::int64_t kTokenBias = std::int64_t(1) << (kTokenBits - 1);
+constexpr double kMaxMilliTokens = 8000000.0;
+constexpr std::size_t kMaxProbes = 16;
+
+std::uint64_t encode(std::int64_t ms, double milliTokens)
+{
+    auto tokens = static_cast<std::int64_t>(std::llround(milliTokens));
+    return (static_cast<std::uint64_t>(ms) << kTokenBits) |
+        static_cast<std::uint64_t>(tokens + kTokenBias);
+}
+
+std::int64_t lastRefill(std::uint64_t word)
+{
+    return static_cast<std::int64_t>(word >> kTokenBits);
+}
+
+double milliTokens(std::uint64_t word)
+{
+    auto tokens = static_cast<std::int64_t>(
+        word & ((std::uint64_t(1) << kTokenBits) - 1));
+    return static_cast<double>(tokens - kTokenBias);
+}
+
+template <typename T>
+void readSetting(config::Config& config, const std::string& shard,
+    const std::string& key, T& value)
+{
+    std::string section = config.sectionFor("ratelimit", key, shard);
+    if (!config.has(section, key))
+    {
+        return;
+    }
+
+    std::string text = config.get(section, key);
+    T parsed {};
+    auto [ptr, error] =
+        std::from_chars(text.data(), text.data() + text.size(), parsed);
+    bool negative = false;
+    if constexpr (std::is_signed_v<T>)
+    {
+        negative = parsed < 0;
+    }
+    if (error != std::errc() || ptr != text.data() + text.size() || negative)
+    {
+        cli_tools::printWarning("Invalid rate limit setting " +
+            cli_tools::bold(key) + ", using the default.");
+        return;
+    }
+    value = parsed;
+}
+} // namespace
+
+RateLimitSettings RateLimitSettings::fromConfig(
+    config::Config& config, const std::string& shard)
+{
+    RateLimitSettings settings;
+    std::int64_t maxDelay = settings.maxDelay.count();
+    std::int64_t muteFor = settings.muteFor.count();
+    readSetting(config, shard, "chat_rate", settings.chat.rate);
+    readSetting(config, shard, "chat_burst", settings.chat.burst);
+    readSetting(config, shard, "command_rate", settings.command.rate);
+    readSetting(config, shard, "command_burst", settings.command.burst);
+    readSetting(config, shard, "max_delay", maxDelay);
+    readSetting(config, shard, "mute_after", settings.muteAfter);
+    readSetting(config, shard, "mute_seconds", muteFor);
+    readSetting(config, shard, "slots", settings.slots);
+    settings.maxDelay = std::chrono::milliseconds(maxDelay);
+    settings.muteFor = std::chrono::seconds(muteFor);
+    return settings;
+}
+
+RateLimiter::RateLimiter(const RateLimitSettings& settings)
+    : idleMs_(0)
+    , muteAfter_(settings.muteAfter)
+    , muteFor_(settings.muteFor)
+    , epoch_(Clock::now())
+{
+    const Limits* limits[2] = {&settings.chat, &settings.command};
+    for (int i = 0; i < 2; ++i)
+    {
+        Bucket& bucket = buckets_[i];
+        bucket.rate = limits[i]->rate; // per second is milli per millisecond
+        bucket.burst = std::clamp(limits[i]->burst * 1000, 1000.0,
+            kMaxMilliTokens);
+        bucket.debt = std::min(
+            bucket.rate * static_cast<double>(settings.maxDelay.count()),
+            kMaxMilliTokens);
+        if (bucket.rate > 0)
+        {
+            idleMs_ = std::max(idleMs_, static_cast<std::int64_t>(std::ceil(
+                (bucket.burst + bucket.debt) / bucket.rate)));
+        }
+    }
+
+    std::size_t size = 64;
+    while (size < settings.slots)
+    {
+        size *= 2;
+    }
+    mask_ = size - 1;
+    slots_ = std::make_unique<Slot[]>(size);
+}
+
+void RateLimiter::setMuteHook(MuteHook hook)
+{
+    muteHook_ = std::move(hook);
+}
+
+std::chrono::seconds RateLimiter::muteFor() const
+{
+    return muteFor_;
+}
+
+Verdict RateLimiter::check(std::string_view login, Event event)
+{
+    return check(login, event, Clock::now());
+}
+
+Verdict RateLimiter::check(
+    std::string_view login, Event event, Clock::time_point now)
+{
+    const Bucket& bucket = buckets_[static_cast<int>(event)];
+    if (bucket.rate <= 0)
+    {
+        allowed_.fetch_add(1, std::memory_order_relaxed);
+        return Verdict(); // a rate of 0 disables the limit
+    }
+
+    std::int64_t nowMs =
+        std::chrono::duration_cast<std::chrono::milliseconds>(now - epoch_)
+            .count();
+    std::uint64_t key = std::hash<std::string_view>()(login);
+    Slot* slot = find(key == 0 ? 1 : key, nowMs, true);
+    if (slot == nullptr)
+    {
+        untracked_.fetch_add(1, std::memory_order_relaxed);
+        return Verdict();
+    }
+
+    std::atomic<std::uint64_t>& word =
+        slot->buckets[static_cast<int>(event)];
+    std::uint64_t old = word.load(std::memory_order_relaxed);
+    Verdict verdict;
+    while (true)
+    {
+        double tokens = bucket.burst;
+        if (old != 0)
+        {
+            std::int64_t elapsed = std::max<std::int64_t>(0,
+                nowMs - lastRefill(old));
+            tokens = std::min(bucket.burst,
+                milliTokens(old) + static_cast<double>(elapsed) * bucket.rate);
+        }
+
+        double left = tokens - 1000;
+        if (left >= 0)
+        {
+            verdict = Verdict();
+        }
+        else if (-left <= bucket.debt)
+        {
+            verdict.decision = Decision::DELAY;
+            verdict.delay = std::chrono::milliseconds(
+                static_cast<std::int64_t>(std::ceil(-left / bucket.rate)));
+        }
+        else
+        {
+            verdict.decision = Decision::REJECT;
+            break;
+        }
+
+        if (word.compare_exchange_weak(old, encode(nowMs, left),
+                std::memory_order_relaxed))
+        {
+            break;
+        }
+    }
+
+    switch (verdict.decision)
+    {
+        case Decision::ALLOW:
+            allowed_.fetch_add(1, std::memory_order_relaxed);
+            if (slot->strikes.load(std::memory_order_relaxed) != 0)
+            {
+                slot->strikes.store(0, std::memory_order_relaxed);
+            }
+            break;
+        case Decision::DELAY:
+            delayed_.fetch_add(1, std::memory_order_relaxed);
+            break;
+        case Decision::REJECT:
+        {
+            rejected_.fetch_add(1, std::memory_order_relaxed);
+            std::uint32_t strikes =
+                slot->strikes.fetch_add(1, std::memory_order_relaxed) + 1;
+            if (muteAfter_ != 0 && strikes == muteAfter_)
+            {
+                muted_.fetch_add(1, std::memory_order_relaxed);
+                if (muteHook_)
+                {
+                    muteHook_(login, strikes);
+                }
+            }
+            break;
+        }
+    }
+    return verdict;
+}
+
+void RateLimiter::forget(std::string_view login)
+{
+    std::uint64_t key = std::hash<std::string_view>()(login);
+    Slot* slot = find(key == 0 ? 1 : key, 0, false);
+    if (slot != nullptr)
+    {
+        slot->buckets[0].store(0, std::memory_order_relaxed);
+        slot->buckets[1].store(0, std::memory_order_relaxed);
+        slot->strikes.store(0, std::memory_order_relaxed);
+    }
+}
+
+RateLimitCounters RateLimiter::counters() const
+{
+    RateLimitCounters counters;
+    counters.allowed = allowed_.load(std::memory_order_relaxed);
+    counters.delayed = delayed_.load(std::memory_order_relaxed);
+    counters.rejected = rejected_.load(std::memory_order_relaxed);
+    counters.muted = muted_.load(std::memory_order_relaxed);
+    counters.untracked = untracked_.load(std::memory_order_relaxed);
+    return counters;
+}
+
+RateLimiter::Slot* RateLimiter::find(
+    std::uint64_t key, std::int64_t nowMs, bool create)
+{
+    for (std::size_t probe = 0; probe < kMaxProbes; ++probe)
+    {
+        Slot& slot = slots_[(key + probe) & mask_];
+        std::uint64_t current = slot.key.load(std::memory_order_acquire);
+        if (current == key)
+        {
+            return &slot;
+        }
+        if (current == 0)
+        {
+            if (!create)
+            {
+                return nullptr;
+            }
+            if (slot.key.compare_exchange_strong(
+                    current, key, std::memory_order_acq_rel) ||
+                current == key)
+            {
+                return &slot;
+            }
+        }
+    }
+    if (!create)
+    {
+        return nullptr;
+    }
+
+    // Crowded: take over a slot whose buckets have refilled, its owner
+    // would start from full buckets anyway
+    for (std::size_t probe = 0; probe < kMaxProbes; ++probe)
+    {
+        Slot& slot = slots_[(key + probe) & mask_];
+        std::uint64_t chat = slot.buckets[0].load(std::memory_order_relaxed);
+        std::uint64_t command =
+            slot.buckets[1].load(std::memory_order_relaxed);
+        bool idle = (chat == 0 || nowMs - lastRefill(chat) > idleMs_) &&
+            (command == 0 || nowMs - lastRefill(command) > idleMs_);
+        std::uint64_t current = slot.key.load(std::memory_order_acquire);
+        if (idle &&
+            slot.key.compare_exchange_strong(
+                current, key, std::memory_order_acq_rel))
+        {
+            slot.buckets[0].store(0, std::memory_order_relaxed);
+            slot.buckets[1].store(0, std::memory_order_relaxed);
+            slot.strikes.store(0, std::memory_order_relaxed);
+            return &slot;
+        }
+    }
+    return nullptr;
+}
+} // namespace chat
@@ -0,0 +1,153 @@
+#ifndef CHAT_RATELIMIT_H
+#define CHAT_RATELIMIT_H
+
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <string>
+#include <string_view>
+
+#include "utils/config.h"
+
+namespace chat
+{
+enum class Event
+{
+    CHAT,
+    COMMAND
+};
+
+enum class Decision
+{
+    ALLOW,
+    DELAY, // over the limit, accept after delay
+    REJECT
+};
+
+struct Verdict
+{
+    Decision decision {Decision::ALLOW};
+    std::chrono::milliseconds delay {0};
+};
+
+/**
+ * @brief Token bucket of one event kind: rate tokens per second, up to burst.
+ */
+struct Limits
+{
+    double rate {1.0};
+    double burst {5.0};
+};
+
+/**
+ * @brief The [ratelimit] section of the configuration.
+ */
+struct RateLimitSettings
+{
+    Limits chat {1.0, 5.0};
+    Limits command {0.5, 3.0};
+    std::chrono::milliseconds maxDelay {2000}; // longer waits are rejected
+    std::uint32_t muteAfter {10}; // rejections in a row, 0 to never mute
+    std::chrono::seconds muteFor {300}; // 0 to mute until the restart
+    std::size_t slots {4096};     // logins tracked at the same time
+
+    /**
+     * @brief Reads the [ratelimit] section, missing keys keep their default.
+     *
+     * @param shard Server name, its [ratelimit.NAME] keys take precedence.
+     */
+    static RateLimitSettings fromConfig(
+        config::Config& config, const std::string& shard = "");
+};
+
+/**
+ * @brief What the rate limiter did since it was created.
+ */
+struct RateLimitCounters
+{
+    std::uint64_t allowed {0};
+    std::uint64_t delayed {0};
+    std::uint64_t rejected {0};
+    std::uint64_t muted {0};
+    std::uint64_t untracked {0}; // allowed because the table was full
+};
+
+/**
+ * @brief Per login token buckets for chat lines and commands.
+ *
+ * Meant to be checked first thing on every chat callback, before logging,
+ * parsing or any database work. Buckets live in a fixed open addressing
+ * table keyed by a 64-bit hash of the login; each bucket is one packed
+ * atomic word (last refill time, fixed point tokens) updated with a CAS,
+ * so callback threads never take a lock. A slot whose buckets are full
+ * again holds no information and is reused when the table is crowded.
+ */
+class RateLimiter
+{
+  public:
+    using Clock = std::chrono::steady_clock;
+
+    /// Called once when a login reaches muteAfter rejections in a row.
+    using MuteHook =
+        std::function<void(std::string_view login, std::uint32_t rejected)>;
+
+    explicit RateLimiter(const RateLimitSettings& settings);
+
+    void setMuteHook(MuteHook hook);
+
+    /**
+     * @brief How long the mute hook should keep a login muted, 0 for good.
+     */
+    std::chrono::seconds muteFor() const;
+
+    /**
+     * @brief Takes a token from the bucket of login for event.
+     */
+    Verdict check(std::string_view login, Event event);
+    Verdict check(std::string_view login, Event event, Clock::time_point now);
+
+    /**
+     * @brief Refills the buckets of login, e.g. when an admin unmutes it.
+     */
+    void forget(std::string_view login);
+
+    RateLimitCounters counters() const;
+
+  private:
+    struct alignas(32) Slot
+    {
+        std::atomic<std::uint64_t> key {0};
+        std::atomic<std::uint64_t> buckets[2] {};
+        std::atomic<std::uint32_t> strikes {0};
+    };
+
+    struct Bucket
+    {
+        double rate;  // milli tokens per millisecond
+        double burst; // milli tokens
+        double debt;  // milli tokens that may be borrowed by a delay
+    };
+
+    Bucket buckets_[2];
+    std::int64_t idleMs_; // time after which every bucket is full again
+    std::uint32_t muteAfter_;
+    std::chrono::seconds muteFor_;
+    std::size_t mask_;
+    std::unique_ptr<Slot[]> slots_;
+    Clock::time_point epoch_;
+    MuteHook muteHook_;
+
+    std::atomic<std::uint64_t> allowed_ {0};
+    std::atomic<std::uint64_t> delayed_ {0};
+    std::atomic<std::uint64_t> rejected_ {0};
+    std::atomic<std::uint64_t> muted_ {0};
+    std::atomic<std::uint64_t> untracked_ {0};
+
+    Slot* find(std::uint64_t key, std::int64_t nowMs, bool create);
+};
+} // namespace chat
+
+#endif
@@ -1,14 +1,20 @@
 #include "commands.h"
 
+#include <fstream>
+#include <iostream>
+#include <optional>
+#include <sstream>
 #include <string>
 #include <vector>
 
+#include "cli/control.h"
 #include "cli/tools.h"
 #include "utils/config.h"
+#include "utils/utils.h"
 
-namespace cli_commands
+namespace
 {
-int planetplusGetConfig(std::string section, std::string key)
+std::string baseDir()
 {
     std::string base_dir_path = BASE_DIR;
     base_dir_path += "planetplus/";
@@ -16,36 +22,200 @@ int planetplusGetConfig(std::string section, std::string key)
 #ifndef _WIN32
     base_dir_path = std::getenv("HOME") + base_dir_path;
 #endif
+    return base_dir_path;
+}
 
-    config::Config config(base_dir_path + "config/config.conf");
-    config.load();
+/**
+ * @brief Asks the running daemon, if any.
+ *
+ * @return Nothing if no daemon runs, the caller then reads the file.
+ */
+std::optional<control::Reply> askDaemon(
+    const std::string& base_dir_path, const std::vector<std::string>& request)
+{
+    control::Client client;
+    if (!client.connect(control::socketPath(base_dir_path)))
+    {
+        return std::nullopt;
+    }
+    std::optional<control::Reply> reply = client.request(request);
+    if (!reply)
+    {
+        cli_tools::printWarning(
+            "! The daemon did not answer, using the configuration file.");
+    }
+    return reply;
+}
+
+/**
+ * @brief A line of --config-batch: "get SECTION KEY" or
+ *        "set SECTION KEY VALUE", the value being the rest of the line.
+ *
+ * @return false for an empty line or a comment.
+ */
+bool parseBatchLine(std::string line, std::vector<std::string>& request)
+{
+    utils::trim(line);
+    request.clear();
+    if (line.empty() || line[0] == '#')
+    {
+        return false;
+    }
+    std::istringstream in(line);
+    std::string field;
+    for (int i = 0; i < 3 && in >> field; ++i)
+    {
+        request.push_back(field);
+    }
+    std::string value;
+    std::getline(in, value);
+    utils::trim(value);
+    if (!value.empty() || (!request.empty() && request[0] == "set"))
+    {
+        request.push_back(value);
+    }
+    return true;
+}
+} // namespace
+
+namespace cli_commands
+{
+int planetplusGetConfig(std::string section, std::string key)
+{
+    std::string base_dir_path = baseDir();
 
-    std::string value = config.get(section, key);
+    std::string value;
+    if (auto reply = askDaemon(base_dir_path, {"get", section, key}))
+    {
+        if (!reply->ok)
+        {
+            cli_tools::printWarning(reply->value);
+        }
+        value = reply->ok ? reply->value : "";
+    }
+    else
+    {
+        config::Config config(base_dir_path + "config/config.conf");
+        config.load();
+        control::Reply local = control::answer(config, {"get", section, key});
+        if (!local.ok)
+        {
+            cli_tools::printWarning(local.value);
+        }
+        value = local.ok ? local.value : "";
+    }
 
     std::cout << section << "." << key << " = " << cli_tools::bold(value) << std::endl;
-    
-    config.save();
     return CLI_EXIT_SUCCESS;
 }
 
 int planetplusSetConfig(
     std::string section, std::string key, std::string value)
 {
-    std::string base_dir_path = BASE_DIR;
-    base_dir_path += "planetplus/";
+    std::string base_dir_path = baseDir();
 
-#ifndef _WIN32
-    base_dir_path = std::getenv("HOME") + base_dir_path;
-#endif
-
-    config::Config config(base_dir_path + "config/config.conf");
-    config.load();
+    // The daemon saves the file itself, writing it here would race with it
+    if (auto reply = askDaemon(base_dir_path, {"set", section, key, value}))
+    {
+        if (!reply->ok)
+        {
+            cli_tools::printError(reply->value);
+            return CLI_EXIT_FAILURE;
+        }
+        value = reply->value;
+    }
+    else
+    {
+        config::Config config(base_dir_path + "config/config.conf");
+        config.load();
 
-    config.set(section, key, value);
-    config.save();
+        control::Reply local =
+            control::answer(config, {"set", section, key, value});
+        if (!local.ok)
+        {
+            cli_tools::printError(local.value);
+            return CLI_EXIT_FAILURE;
+        }
+        config.save();
+        value = local.value;
+    }
 
     std::cout << section << "." << key << " = " << cli_tools::bold(value) << std::endl;
 
     return CLI_EXIT_SUCCESS;
 }
-} // namespace cli_commands
\ No newline at end of file
+
+int planetplusConfigBatch(std::string path)
+{
+    std::string base_dir_path = baseDir();
+
+    std::ifstream file;
+    if (!path.empty() && path != "-")
+    {
+        file.open(path);
+        if (!file.is_open())
+        {
+            cli_tools::printError("! Cannot read " + cli_tools::bold(path));
+            return CLI_EXIT_FAILURE;
+        }
+    }
+    std::istream& in = file.is_open() ? file : std::cin;
+
+    std::vector<std::vector<std::string>> batch;
+    std::vector<std::string> request;
+    std::string line;
+    while (std::getline(in, line))
+    {
+        if (parseBatchLine(line, request))
+        {
+            batch.push_back(request);
+        }
+    }
+
+    // One connection, or one load and at most one save, for all of them
+    std::vector<control::Reply> replies;
+    control::Client client;
+    if (client.connect(control::socketPath(base_dir_path)))
+    {
+        replies = client.requests(batch);
+        if (replies.size() < batch.size())
+        {
+            cli_tools::printError("! The daemon stopped answering after " +
+                std::to_string(replies.size()) + " requests.");
+            return CLI_EXIT_FAILURE;
+        }
+    }
+    else
+    {
+        config::Config config(base_dir_path + "config/config.conf");
+        config.load();
+        bool changed = false;
+        for (const std::vector<std::string>& fields : batch)
+        {
+            replies.push_back(control::answer(config, fields));
+            changed = changed || (replies.back().ok && fields[0] == "set");
+        }
+        if (changed)
+        {
+            config.save();
+        }
+    }
+
+    int status = CLI_EXIT_SUCCESS;
+    for (std::size_t i = 0; i < batch.size(); ++i)
+    {
+        if (!replies[i].ok)
+        {
+            cli_tools::printWarning(replies[i].value);
+            status = CLI_EXIT_FAILURE;
+        }
+        else if (batch[i].size() >= 3)
+        {
+            std::cout << batch[i][1] << "." << batch[i][2] << " = "
+                      << replies[i].value << "\n";
+        }
+    }
+    std::cout << std::flush;
+    return status;
+}
+} // namespace cli_commands
@@ -10,9 +10,20 @@ void planetplusHelp()
                  "  -h, --help     display this help and exit\n"
                  "  -v, --version  output version information and exit\n"
                  "  --setup        setup the planetplus server\n"
+                 "    --from FILE  without questions, see data/setup.conf\n"
                  "  --test         test the planetplus server\n"
                  "  --get-config   get the value of a configuration key\n"
                  "  --set-config   set the value of a configuration key\n"
+                 "  --config-batch [FILE]  get and set lines, from stdin\n"
+                 "                 without FILE\n"
+                 "  --scan-maps    index the maps of a directory\n"
+                 "  --import-records FILE  load records into the database\n"
+                 "  --export-records FILE  save every record to FILE\n"
+                 "  --plugins      list the installed plugins\n"
+                 "  --reload-plugin NAME  reload a plugin in the daemon\n"
+                 "  --run          manage the configured servers\n"
+                 "    --trace N    trace the first N seconds (or SIGUSR1)\n"
+                 "  --daemon       --run, and answer the config commands\n"
                  "\n"
                  "Please report bugs on GitHub or on Discord (DISCORD_INVITE_LINK)."
               << std::endl;
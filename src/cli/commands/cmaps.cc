@@ -0,0 +1,48 @@
+#include "commands.h"
+
+#include <filesystem>
+#include <iostream>
+#include <string>
+
+#include "cli/tools.h"
+#include "maps/library.h"
+
+namespace cli_commands
+{
+int planetplusScanMaps(std::string directory)
+{
+    std::string base_dir_path = BASE_DIR;
+    base_dir_path += "planetplus/";
+
+#ifndef _WIN32
+    base_dir_path = std::getenv("HOME") + base_dir_path;
+#endif
+
+    if (!std::filesystem::is_directory(directory))
+    {
+        cli_tools::printError(
+            "! Not a directory: " + cli_tools::bold(directory));
+        return CLI_EXIT_FAILURE;
+    }
+
+    maps::Library library(base_dir_path + "database/maps.idx");
+    library.load();
+
+    maps::ScanStats stats = library.scan(directory);
+    if (!library.save())
+    {
+        cli_tools::printWarning("! Failed to save the map index, next scan "
+                                "will parse every map again.");
+    }
+
+    cli_tools::printSuccess("Indexed " +
+        cli_tools::bold(std::to_string(library.maps().size())) + " maps in " +
+        std::to_string(stats.duration.count()) + " ms");
+    std::cout << "  files found: " << stats.files << "\n"
+              << "  parsed:      " << stats.parsed << "\n"
+              << "  unchanged:   " << stats.reused << "\n"
+              << "  invalid:     " << stats.failed << std::endl;
+
+    return CLI_EXIT_SUCCESS;
+}
+} // namespace cli_commands
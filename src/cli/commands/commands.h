@@ -28,23 +28,90 @@ void planetplusHelp();
  */
 void planetplusSetup();
 
+/**
+ * @brief Set up an instance from a file instead of questions: a config file
+ *        whose [setup] section says where and how, the other sections
+ *        being written to the new configuration. See data/setup.conf.
+ *        Creates the database and its tables when the server is reachable.
+ */
+int planetplusSetupFrom(const std::string& path);
+
 /**
  * @brief Print the current version of the planetplus server/instance.
  */
 void planetplusVersion();
 
 /**
- * @brief Change config values
+ * @brief Print a config value, asked to the daemon when one runs
  *
  */
 int planetplusGetConfig(std::string section, std::string key);
 
 /**
- * @brief Change config values
+ * @brief Change config values, through the daemon when one runs
  *
  */
 int planetplusSetConfig(
     std::string section, std::string key, std::string value);
+
+/**
+ * @brief Run many "get SECTION KEY" and "set SECTION KEY VALUE" lines at
+ *        once, from a file or from stdin when path is empty or "-". All go
+ *        to the daemon on one connection when one runs, otherwise the file
+ *        is read once and saved once.
+ *
+ */
+int planetplusConfigBatch(std::string path);
+
+/**
+ * @brief Index every map of a directory and print a summary.
+ *        Unchanged files are taken from the index of the previous scan.
+ *
+ */
+int planetplusScanMaps(std::string directory);
+
+/**
+ * @brief Load local records into the database, from a file of
+ *        --export-records or from MAP_UID,LOGIN,TIME,TIMESTAMP lines.
+ *        Maps are loaded in parallel, through LOAD DATA LOCAL INFILE when
+ *        the server allows it. Existing records are kept when better.
+ *
+ */
+int planetplusImportRecords(std::string path);
+
+/**
+ * @brief Write every local record of the database to a compact columnar
+ *        file, see records::Archive.
+ *
+ */
+int planetplusExportRecords(std::string path);
+
+/**
+ * @brief Print the name and version of every plugin of the plugins
+ *        directory, read from the files without loading them.
+ *
+ */
+int planetplusListPlugins();
+
+/**
+ * @brief Have the running daemon reload a plugin on every server, e.g.
+ *        after its file was replaced by a new build.
+ *
+ */
+int planetplusReloadPlugin(std::string name);
+
+/**
+ * @brief Manage every configured server until SIGINT or SIGTERM.
+ *        Each [server.NAME] section is a server with its own event loop
+ *        thread; the map index, database connections and log are shared.
+ *        SIGUSR1 traces the next seconds to logs/trace-DATE.json.
+ *
+ * @param traceSeconds Seconds to trace from the start, 0 for none. Also the
+ *                     length of the SIGUSR1 traces when set.
+ * @param daemon Also answer --get-config and --set-config on the control
+ *               socket, from the configuration loaded at start.
+ */
+int planetplusRun(int traceSeconds = 0, bool daemon = false);
 }
 
 #endif
\ No newline at end of file
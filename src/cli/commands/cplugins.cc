@@ -0,0 +1,88 @@
+#include "commands.h"
+
+#include <filesystem>
+#include <iostream>
+#include <optional>
+#include <string>
+#include <vector>
+
+#include "cli/control.h"
+#include "cli/tools.h"
+#include "plugins/manager.h"
+
+namespace cli_commands
+{
+int planetplusListPlugins()
+{
+    std::string base_dir_path = BASE_DIR;
+    base_dir_path += "planetplus/";
+
+#ifndef _WIN32
+    base_dir_path = std::getenv("HOME") + base_dir_path;
+#endif
+
+    std::string plugins_path = base_dir_path + "plugins/";
+    if (!std::filesystem::is_directory(plugins_path))
+    {
+        cli_tools::printError("! No plugins directory: " +
+            cli_tools::bold(plugins_path) + "\nPlease run --setup first.");
+        return CLI_EXIT_FAILURE;
+    }
+
+    // Read from the files: listing them runs no plugin code
+    std::vector<std::string> paths = plugins::pluginFiles(plugins_path);
+    if (paths.empty())
+    {
+        cli_tools::printInfo("No plugins in " + cli_tools::bold(plugins_path));
+        return CLI_EXIT_SUCCESS;
+    }
+
+    for (const std::string& path : paths)
+    {
+        if (std::optional<plugins::Info> plugin = plugins::inspect(path))
+        {
+            std::cout << "  " << plugin->name << " " << plugin->version
+                      << "  (" << path << ")" << std::endl;
+        }
+        else
+        {
+            std::cout << "  ?  (" << path << ", no "
+                      << PLANETPLUS_PLUGIN_INFO << ")" << std::endl;
+        }
+    }
+    return CLI_EXIT_SUCCESS;
+}
+
+int planetplusReloadPlugin(std::string name)
+{
+    std::string base_dir_path = BASE_DIR;
+    base_dir_path += "planetplus/";
+
+#ifndef _WIN32
+    base_dir_path = std::getenv("HOME") + base_dir_path;
+#endif
+
+    // Plugins only run in the daemon, which reloads them on every server
+    control::Client client;
+    if (!client.connect(control::socketPath(base_dir_path)))
+    {
+        cli_tools::printError("! No daemon running, start one with " +
+            cli_tools::bold("--daemon"));
+        return CLI_EXIT_FAILURE;
+    }
+    std::optional<control::Reply> reply =
+        client.request({"plugin", "reload", name});
+    if (!reply)
+    {
+        cli_tools::printError("! The daemon did not answer.");
+        return CLI_EXIT_FAILURE;
+    }
+    if (!reply->ok)
+    {
+        cli_tools::printError(reply->value);
+        return CLI_EXIT_FAILURE;
+    }
+    cli_tools::printSuccess(reply->value);
+    return CLI_EXIT_SUCCESS;
+}
+} // namespace cli_commands
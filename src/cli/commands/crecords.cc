@@ -0,0 +1,302 @@
+#include "commands.h"
+
+#include <algorithm>
+#include <atomic>
+#include <charconv>
+#include <chrono>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "cli/tools.h"
+#include "records/archive.h"
+#include "utils/config.h"
+
+#ifdef PLANETPLUS_HAS_DATABASE
+#include "utils/database.h"
+#endif
+
+namespace cli_commands
+{
+#ifdef PLANETPLUS_HAS_DATABASE
+namespace
+{
+using Clock = std::chrono::steady_clock;
+
+// Connections importing at once, each loading one map at a time
+constexpr unsigned kImportConnections = 4;
+
+long long elapsedMs(Clock::time_point start)
+{
+    return std::chrono::duration_cast<std::chrono::milliseconds>(
+        Clock::now() - start)
+        .count();
+}
+
+/**
+ * @brief Reads MAP_UID,LOGIN,TIME,TIMESTAMP lines, commas or tabs, grouped
+ *        by map. Lines that do not parse, a header for one, are counted.
+ */
+bool readText(const std::string& path,
+    std::vector<std::pair<std::string, std::vector<records::Record>>>& maps,
+    std::size_t& skipped)
+{
+    std::ifstream in(path);
+    if (!in.is_open())
+    {
+        return false;
+    }
+
+    std::unordered_map<std::string, std::size_t> index;
+    std::string line;
+    while (std::getline(in, line))
+    {
+        if (!line.empty() && line.back() == '\r')
+        {
+            line.pop_back();
+        }
+        std::string_view fields[4];
+        std::size_t count = 0;
+        std::size_t start = 0;
+        while (count < 4)
+        {
+            std::size_t end = line.find_first_of(",\t", start);
+            fields[count++] = std::string_view(line).substr(start,
+                end == std::string::npos ? std::string::npos : end - start);
+            if (end == std::string::npos)
+            {
+                break;
+            }
+            start = end + 1;
+        }
+
+        records::Record record;
+        if (count != 4 || fields[0].empty() || fields[1].empty() ||
+            std::from_chars(fields[2].data(),
+                fields[2].data() + fields[2].size(), record.time)
+                    .ec != std::errc() ||
+            std::from_chars(fields[3].data(),
+                fields[3].data() + fields[3].size(), record.timestamp)
+                    .ec != std::errc())
+        {
+            ++skipped;
+            continue;
+        }
+        record.login = fields[1];
+
+        auto [it, inserted] =
+            index.try_emplace(std::string(fields[0]), maps.size());
+        if (inserted)
+        {
+            maps.emplace_back(it->first, std::vector<records::Record>());
+        }
+        maps[it->second].second.push_back(std::move(record));
+    }
+    return true;
+}
+} // namespace
+#endif
+
+int planetplusImportRecords(std::string path)
+{
+#ifdef PLANETPLUS_HAS_DATABASE
+    std::string base_dir_path = BASE_DIR;
+    base_dir_path += "planetplus/";
+
+#ifndef _WIN32
+    base_dir_path = std::getenv("HOME") + base_dir_path;
+#endif
+
+    std::string config_path = base_dir_path + "config/config.conf";
+    if (!std::filesystem::exists(config_path))
+    {
+        cli_tools::printError("! No configuration file: " +
+            cli_tools::bold(config_path) + "\nPlease run --setup first.");
+        return CLI_EXIT_FAILURE;
+    }
+    config::Config config(config_path);
+    config.load();
+
+    // An archive of --export-records is decoded a map at a time by the
+    // workers, a text file is read whole first
+    Clock::time_point start = Clock::now();
+    records::Archive archive;
+    bool fromArchive = archive.open(path);
+    std::vector<std::pair<std::string, std::vector<records::Record>>> text;
+    std::size_t skipped = 0;
+    if (!fromArchive && !readText(path, text, skipped))
+    {
+        cli_tools::printError("! Cannot read " + cli_tools::bold(path));
+        return CLI_EXIT_FAILURE;
+    }
+    std::size_t maps = fromArchive ? archive.maps() : text.size();
+
+    std::atomic<std::size_t> next {0};
+    std::atomic<std::size_t> imported {0};
+    std::atomic<std::size_t> failed {0};
+    auto worker = [&]() {
+        database::Manager manager("", &config);
+        manager.localInfile = true;
+        if (!manager.connect())
+        {
+            // Left to the other connections
+            return;
+        }
+        std::vector<records::Record> rows;
+        for (std::size_t i = next.fetch_add(1); i < maps;
+             i = next.fetch_add(1))
+        {
+            std::string uid;
+            if (fromArchive)
+            {
+                uid = archive.uid(i);
+                if (!archive.read(i, rows))
+                {
+                    cli_tools::printError("! Damaged records for " + uid);
+                    failed.fetch_add(1);
+                    continue;
+                }
+            }
+            else
+            {
+                uid = text[i].first;
+                rows = std::move(text[i].second);
+            }
+            if (manager.importRecords(uid, rows) == 0)
+            {
+                imported.fetch_add(rows.size());
+            }
+            else
+            {
+                failed.fetch_add(1);
+            }
+        }
+        manager.disconnect();
+    };
+
+    unsigned threads = std::max<unsigned>(1,
+        std::min<std::size_t>(std::min(kImportConnections,
+                                  std::thread::hardware_concurrency()),
+            maps));
+    std::vector<std::thread> workers;
+    for (unsigned i = 1; i < threads; ++i)
+    {
+        workers.emplace_back(worker);
+    }
+    worker();
+    for (std::thread& thread : workers)
+    {
+        thread.join();
+    }
+
+    if (next.load() < maps)
+    {
+        cli_tools::printError("! Could not connect to the database.");
+        return CLI_EXIT_FAILURE;
+    }
+
+    cli_tools::printSuccess("Imported " +
+        cli_tools::bold(std::to_string(imported.load())) + " records of " +
+        std::to_string(maps) + " maps in " + std::to_string(elapsedMs(start)) +
+        " ms");
+    if (skipped > 0)
+    {
+        cli_tools::printWarning(
+            "! Skipped " + std::to_string(skipped) + " unreadable lines.");
+    }
+    if (failed.load() > 0)
+    {
+        cli_tools::printWarning("! " + std::to_string(failed.load()) +
+            " maps were not imported.");
+        return CLI_EXIT_FAILURE;
+    }
+    return CLI_EXIT_SUCCESS;
+#else
+    (void)path;
+    cli_tools::printError("! Built without database support.");
+    return CLI_EXIT_FAILURE;
+#endif
+}
+
+int planetplusExportRecords(std::string path)
+{
+#ifdef PLANETPLUS_HAS_DATABASE
+    std::string base_dir_path = BASE_DIR;
+    base_dir_path += "planetplus/";
+
+#ifndef _WIN32
+    base_dir_path = std::getenv("HOME") + base_dir_path;
+#endif
+
+    std::string config_path = base_dir_path + "config/config.conf";
+    if (!std::filesystem::exists(config_path))
+    {
+        cli_tools::printError("! No configuration file: " +
+            cli_tools::bold(config_path) + "\nPlease run --setup first.");
+        return CLI_EXIT_FAILURE;
+    }
+    config::Config config(config_path);
+    config.load();
+
+    database::Manager manager("", &config);
+    if (!manager.connect())
+    {
+        return CLI_EXIT_FAILURE;
+    }
+
+    // One streamed query, rows arrive map after map and each map is
+    // encoded as soon as the next one starts
+    Clock::time_point start = Clock::now();
+    records::ArchiveWriter writer;
+    std::string uid;
+    std::vector<records::Record> rows;
+    bool read = manager.scanRecords(
+        [&](const std::string& map_uid, records::Record record) {
+            if (map_uid != uid)
+            {
+                if (!rows.empty())
+                {
+                    writer.add(uid, std::move(rows));
+                    rows.clear();
+                }
+                uid = map_uid;
+            }
+            rows.push_back(std::move(record));
+        });
+    manager.disconnect();
+    if (!read)
+    {
+        return CLI_EXIT_FAILURE;
+    }
+    if (!rows.empty())
+    {
+        writer.add(uid, std::move(rows));
+    }
+
+    if (!writer.save(path))
+    {
+        cli_tools::printError("! Cannot write " + cli_tools::bold(path));
+        return CLI_EXIT_FAILURE;
+    }
+
+    std::error_code error;
+    std::uintmax_t bytes = std::filesystem::file_size(path, error);
+    cli_tools::printSuccess("Exported " +
+        cli_tools::bold(std::to_string(writer.records())) + " records of " +
+        std::to_string(writer.maps()) + " maps in " +
+        std::to_string(elapsedMs(start)) + " ms");
+    std::cout << "  file: " << path << " (" << (error ? 0 : bytes)
+              << " bytes)" << std::endl;
+    return CLI_EXIT_SUCCESS;
+#else
+    (void)path;
+    cli_tools::printError("! Built without database support.");
+    return CLI_EXIT_FAILURE;
+#endif
+}
+} // namespace cli_commands
@@ -0,0 +1,531 @@
+#include "commands.h"
+
+#include <pthread.h>
+#include <signal.h>
+
+#include <algorithm>
+#include <charconv>
+#include <chrono>
+#include <ctime>
+#include <filesystem>
+#include <future>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "cli/control.h"
+#include "cli/tools.h"
+#include "core/threadpool.h"
+#include "karma/karma.h"
+#include "maps/library.h"
+#include "metrics/exporter.h"
+#include "metrics/registry.h"
+#include "metrics/tracing.h"
+#include "replays/store.h"
+#include "server/shard.h"
+#include "stats/stats.h"
+#include "utils/config.h"
+#include "utils/log.h"
+
+namespace
+{
+constexpr int kMetricsInterval = 60; // seconds between two metrics lines
+constexpr int kTraceWindow = 10;     // seconds traced on SIGUSR1
+// Wait of a plugin reload request, below the timeout of control::Client
+constexpr std::chrono::milliseconds kReloadTimeout {1500};
+
+using Clock = std::chrono::steady_clock;
+
+/**
+ * @brief A trace running until a deadline, see tracing::start().
+ */
+struct Trace
+{
+    std::string path;
+    Clock::time_point end;
+    bool running {false};
+
+    void start(const std::string& logs_dir, int seconds)
+    {
+        if (running || !tracing::start())
+        {
+            return;
+        }
+        std::time_t now = std::chrono::system_clock::to_time_t(
+            std::chrono::system_clock::now());
+        std::tm local {};
+        localtime_r(&now, &local);
+        char stamp[32];
+        std::strftime(stamp, sizeof(stamp), "%Y%m%d-%H%M%S", &local);
+
+        path = logs_dir + "trace-" + stamp + ".json";
+        end = Clock::now() + std::chrono::seconds(seconds);
+        running = true;
+        cli_tools::printSuccess("Tracing for " + std::to_string(seconds) +
+            " seconds to " + cli_tools::bold(path));
+    }
+
+    void finish(logging::Writer& log)
+    {
+        if (!running)
+        {
+            return;
+        }
+        running = false;
+        if (auto summary = tracing::stop(path))
+        {
+            std::string message = "Wrote " + std::to_string(summary->spans) +
+                " spans to " + path;
+            if (summary->dropped != 0)
+            {
+                message += ", dropped " + std::to_string(summary->dropped);
+            }
+            cli_tools::printSuccess(message);
+            log.write("planetplus", message);
+        }
+    }
+};
+
+/**
+ * @brief Starts the endpoint of the [metrics] section, if it has a port.
+ */
+bool startExporter(config::Config& config, metrics::Exporter& exporter)
+{
+    if (!config.has("metrics", "port"))
+    {
+        return false;
+    }
+    std::string port = config.get("metrics", "port");
+    if (port.empty())
+    {
+        return false;
+    }
+
+    std::uint16_t number = 0;
+    auto [ptr, error] =
+        std::from_chars(port.data(), port.data() + port.size(), number);
+    if (error != std::errc() || ptr != port.data() + port.size())
+    {
+        cli_tools::printWarning("! Invalid metrics port " +
+            cli_tools::bold(port) + ", metrics are not served.");
+        return false;
+    }
+
+    std::string address = config.has("metrics", "address")
+        ? config.get("metrics", "address")
+        : "127.0.0.1";
+    if (!exporter.listen(address, number))
+    {
+        return false;
+    }
+    cli_tools::printSuccess("Serving metrics on " +
+        cli_tools::bold("http://" + address + ":" +
+            std::to_string(exporter.port()) + "/metrics"));
+    return true;
+}
+
+std::string describe(const server::ShardMetrics& metrics)
+{
+    return std::string(metrics.connected ? "up" : "down") +
+        ", callbacks " + std::to_string(metrics.callbacks) + ", calls " +
+        std::to_string(metrics.calls) + ", faults " +
+        std::to_string(metrics.faults) + ", chat " +
+        std::to_string(metrics.chatLines) + ", chat rejected " +
+        std::to_string(metrics.chatRejected) + ", disconnects " +
+        std::to_string(metrics.disconnects);
+}
+
+long long elapsedMs(Clock::time_point start)
+{
+    return std::chrono::duration_cast<std::chrono::milliseconds>(
+        Clock::now() - start)
+        .count();
+}
+} // namespace
+
+namespace cli_commands
+{
+int planetplusRun(int traceSeconds, bool daemon)
+{
+    std::string base_dir_path = BASE_DIR;
+    base_dir_path += "planetplus/";
+
+#ifndef _WIN32
+    base_dir_path = std::getenv("HOME") + base_dir_path;
+#endif
+
+    std::string config_path = base_dir_path + "config/config.conf";
+    if (!std::filesystem::exists(config_path))
+    {
+        cli_tools::printError("! No configuration file: " +
+            cli_tools::bold(config_path) + "\nPlease run --setup first.");
+        return CLI_EXIT_FAILURE;
+    }
+
+    config::Config config(config_path);
+    config.load();
+
+    std::vector<server::ShardSettings> settings =
+        server::ShardSettings::fromConfig(config);
+    if (settings.empty() && daemon)
+    {
+        cli_tools::printWarning("! No server configured, only answering on "
+                                "the control socket.");
+    }
+    else if (settings.empty())
+    {
+        cli_tools::printError("! No server configured, set " +
+            cli_tools::bold("[server]") + " or add " +
+            cli_tools::bold("[server.NAME]") + " sections to " +
+            cli_tools::bold(config_path));
+        return CLI_EXIT_FAILURE;
+    }
+
+    // Signals are taken by this thread only, shard threads inherit the mask
+    sigset_t signals;
+    sigemptyset(&signals);
+    sigaddset(&signals, SIGINT);
+    sigaddset(&signals, SIGTERM);
+    sigaddset(&signals, SIGUSR1);
+    pthread_sigmask(SIG_BLOCK, &signals, nullptr);
+
+    logging::Writer log(base_dir_path + "logs/server.log");
+    if (!log.isOpen())
+    {
+        return CLI_EXIT_FAILURE;
+    }
+
+    maps::Library maps(base_dir_path + "database/maps.idx");
+    if (!maps.load())
+    {
+        cli_tools::printWarning("! No map index, run --scan-maps to build it.");
+    }
+
+    // Metrics and control requests share one loop, off the server threads.
+    // Listening first, so that a daemon already running is found before
+    // anything is opened; the loop only runs once the servers are built
+    core::EventLoop adminLoop;
+    metrics::Exporter exporter(metrics::global(), adminLoop);
+    control::Server control(config, adminLoop);
+    bool exporting = startExporter(config, exporter);
+    if (daemon)
+    {
+        std::string socket = control::socketPath(base_dir_path);
+        if (!control.listen(socket))
+        {
+            return CLI_EXIT_FAILURE;
+        }
+        cli_tools::printSuccess(
+            "Answering config commands on " + cli_tools::bold(socket));
+    }
+
+    core::ThreadPool pool;
+
+    replays::Store replays(base_dir_path + "replays/");
+    if (!replays.open())
+    {
+        cli_tools::printWarning("! Could not open the replay store in " +
+            cli_tools::bold(base_dir_path + "replays/") + ".");
+    }
+
+#ifdef PLANETPLUS_HAS_DATABASE
+    // Local records of the servers, read on map changes and written on
+    // finishes without blocking their loops
+    database::Pool database(
+        config, pool, std::min<std::size_t>(settings.size(), 4));
+    bool connected = database.connect();
+    if (!connected)
+    {
+        cli_tools::printWarning("! Running without database.");
+    }
+
+    // Statistics start from the snapshot of the last run when there is one,
+    // the tables are then read in the background to catch up with what
+    // other servers wrote. Otherwise they are read here, once, and only
+    // written after, from the thread of the aggregator on a connection of
+    // its own
+    std::string snapshotPath = base_dir_path + "database/stats.snap";
+    Clock::time_point loadStart = Clock::now();
+    stats::Rows statsRows;
+    bool fromSnapshot = stats::loadSnapshot(snapshotPath, statsRows);
+    database::Manager statsDatabase("", &config);
+    bool persistStats = connected && statsDatabase.connect();
+    if (persistStats && !fromSnapshot && !statsDatabase.loadStats(statsRows))
+    {
+        cli_tools::printWarning("! Could not read the statistics, run "
+                                "--setup to create their tables.");
+        statsDatabase.disconnect();
+        persistStats = false;
+    }
+    stats::Aggregator stats(
+        persistStats ? stats::Aggregator::Writer(
+                           [&statsDatabase](const stats::Rows& rows) {
+                               return statsDatabase.saveStats(rows) == 0;
+                           })
+                     : stats::Aggregator::Writer(),
+        stats::Aggregator::kDefaultInterval,
+        [snapshotPath](const stats::Rows& rows) {
+            return stats::saveSnapshot(snapshotPath, rows);
+        });
+    bool validating = fromSnapshot && persistStats;
+    stats.load(statsRows, !validating);
+    if (fromSnapshot || persistStats)
+    {
+        log.write("planetplus",
+            std::string("Loaded statistics from the ") +
+                (fromSnapshot ? "snapshot" : "database") + " in " +
+                std::to_string(elapsedMs(loadStart)) + " ms");
+    }
+
+    std::jthread statsValidation;
+    if (validating)
+    {
+        // Settings read here: the configuration is not thread safe
+        auto check = std::make_unique<database::Manager>("", &config);
+        statsValidation = std::jthread([check = std::move(check), &stats,
+                                           &statsRows, &log] {
+            Clock::time_point start = Clock::now();
+            stats::Rows tables;
+            bool read = check->connect();
+            if (read)
+            {
+                read = check->loadStats(tables);
+                check->disconnect();
+            }
+            if (!read)
+            {
+                // Written as they are, as if the tables matched
+                log.write("planetplus",
+                    "Could not check the statistics snapshot");
+                tables = statsRows;
+            }
+            stats.reconcile(statsRows, tables);
+            log.write("planetplus",
+                "Checked the statistics snapshot against the database in " +
+                    std::to_string(elapsedMs(start)) + " ms");
+        });
+    }
+
+    // Karma votes are loaded and written per map, also on a connection of
+    // their own so that voting never waits on the database
+    database::Manager karmaDatabase("", &config);
+    bool persistKarma = connected && karmaDatabase.connect();
+    karma::Tally karma(persistKarma
+            ? karma::Tally::Loader(
+                  [&karmaDatabase](const std::string& uid, karma::Rows& rows) {
+                      return karmaDatabase.loadKarma(uid, rows);
+                  })
+            : karma::Tally::Loader(),
+        persistKarma
+            ? karma::Tally::Writer([&karmaDatabase](const std::string& uid,
+                                       const karma::Rows& rows) {
+                  return karmaDatabase.saveKarma(uid, rows) == 0;
+              })
+            : karma::Tally::Writer());
+
+    server::Shared shared {
+        pool, maps, log, stats, karma, replays, base_dir_path + "plugins/"};
+    if (connected)
+    {
+        shared.database = &database;
+    }
+#else
+    // Without a database the snapshot is all that outlives the process
+    std::string snapshotPath = base_dir_path + "database/stats.snap";
+    Clock::time_point loadStart = Clock::now();
+    stats::Rows statsRows;
+    bool fromSnapshot = stats::loadSnapshot(snapshotPath, statsRows);
+    stats::Aggregator stats({}, stats::Aggregator::kDefaultInterval,
+        [snapshotPath](const stats::Rows& rows) {
+            return stats::saveSnapshot(snapshotPath, rows);
+        });
+    stats.load(statsRows);
+    if (fromSnapshot)
+    {
+        log.write("planetplus",
+            "Loaded statistics from the snapshot in " +
+                std::to_string(elapsedMs(loadStart)) + " ms");
+    }
+    karma::Tally karma;
+    server::Shared shared {
+        pool, maps, log, stats, karma, replays, base_dir_path + "plugins/"};
+#endif
+
+    // Started before the servers so their connection is in it
+    tracing::setThreadName("main");
+    Trace trace;
+    if (traceSeconds > 0)
+    {
+        trace.start(base_dir_path + "logs/", traceSeconds);
+    }
+
+    unsigned cores = std::max(1u, std::thread::hardware_concurrency());
+    std::vector<std::unique_ptr<server::Shard>> shards;
+    for (std::size_t i = 0; i < settings.size(); ++i)
+    {
+        shards.push_back(
+            std::make_unique<server::Shard>(settings[i], config, shared));
+        shards.back()->start(static_cast<int>(i % cores));
+        cli_tools::printSuccess("Started server " +
+            cli_tools::bold(settings[i].name) + " (" + settings[i].host + ":" +
+            std::to_string(settings[i].port) + ")");
+    }
+    log.write("planetplus", "Managing " + std::to_string(shards.size()) +
+            " servers on " + std::to_string(cores) + " cores");
+
+    // Every server runs its own copy of the plugins. The library is shared:
+    // unloaded everywhere first so that the new file is the one read
+    control.handle("plugin",
+        [&shards](const std::vector<std::string>& request) {
+            if (request.size() != 3 || request[1] != "reload")
+            {
+                return control::Reply {false, "Usage: plugin reload NAME"};
+            }
+            const std::string& name = request[2];
+            auto deadline = Clock::now() + kReloadTimeout;
+
+            std::vector<std::future<std::string>> unloads;
+            for (const auto& shard : shards)
+            {
+                unloads.push_back(shard->unloadPlugin(name));
+            }
+            std::vector<std::string> paths(shards.size());
+            bool late = false;
+            for (std::size_t i = 0; i < unloads.size(); ++i)
+            {
+                if (unloads[i].wait_until(deadline) ==
+                    std::future_status::ready)
+                {
+                    paths[i] = unloads[i].get();
+                }
+                else
+                {
+                    late = true; // still unloads, but is not loaded again
+                }
+            }
+
+            std::vector<std::future<bool>> loads;
+            for (std::size_t i = 0; i < shards.size(); ++i)
+            {
+                if (!paths[i].empty())
+                {
+                    loads.push_back(shards[i]->loadPlugin(paths[i]));
+                }
+            }
+            std::size_t reloaded = 0;
+            for (std::future<bool>& load : loads)
+            {
+                if (load.wait_until(deadline) == std::future_status::ready &&
+                    load.get())
+                {
+                    ++reloaded;
+                }
+            }
+
+            if (loads.empty() && !late)
+            {
+                return control::Reply {false, "No plugin named " + name};
+            }
+            std::string summary = "Reloaded " + name + " on " +
+                std::to_string(reloaded) + " of " +
+                std::to_string(shards.size()) + " servers";
+            return control::Reply {!late && reloaded == loads.size(),
+                late ? summary + ", some did not unload in time" : summary};
+        });
+
+    // The servers read the configuration the control requests change,
+    // and it is not thread safe: they are all built by now
+    std::thread adminThread;
+    if (exporting || daemon)
+    {
+        adminThread = std::thread([&adminLoop] {
+            tracing::setThreadName("admin");
+            adminLoop.run();
+        });
+    }
+
+    Clock::time_point nextMetrics =
+        Clock::now() + std::chrono::seconds(kMetricsInterval);
+    while (true)
+    {
+        Clock::time_point wake =
+            trace.running ? std::min(nextMetrics, trace.end) : nextMetrics;
+        auto wait = std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::max(wake - Clock::now(), Clock::duration::zero()));
+        timespec timeout {
+            static_cast<std::time_t>(wait.count() / 1000000000),
+            static_cast<long>(wait.count() % 1000000000)};
+
+        int signal = sigtimedwait(&signals, nullptr, &timeout);
+        if (signal == SIGINT || signal == SIGTERM)
+        {
+            break;
+        }
+        if (signal == SIGUSR1)
+        {
+            trace.start(base_dir_path + "logs/",
+                traceSeconds > 0 ? traceSeconds : kTraceWindow);
+        }
+
+        Clock::time_point now = Clock::now();
+        if (trace.running && now >= trace.end)
+        {
+            trace.finish(log);
+        }
+        if (now >= nextMetrics)
+        {
+            for (const auto& shard : shards)
+            {
+                log.write(shard->settings().name, describe(shard->metrics()));
+            }
+            nextMetrics = now + std::chrono::seconds(kMetricsInterval);
+        }
+    }
+
+    std::cout << std::endl;
+    for (const auto& shard : shards)
+    {
+        shard->stop();
+        std::cout << "  " << shard->settings().name << ": "
+                  << describe(shard->metrics()) << std::endl;
+    }
+#ifdef PLANETPLUS_HAS_DATABASE
+    // Records still queued are written, before the loops their queries
+    // resume on are destroyed with the shards
+    database.close();
+#endif
+    if (adminThread.joinable())
+    {
+        adminLoop.post([&exporter, &control, &adminLoop] {
+            exporter.close();
+            control.close();
+            adminLoop.stop();
+        });
+        adminThread.join();
+    }
+    trace.finish(log); // what was captured until the signal
+#ifdef PLANETPLUS_HAS_DATABASE
+    if (statsValidation.joinable())
+    {
+        statsValidation.join(); // nothing is written before it is done
+    }
+#endif
+    stats.flush();
+#ifdef PLANETPLUS_HAS_DATABASE
+    if (persistStats)
+    {
+        statsDatabase.disconnect();
+    }
+    karma.flush();
+    if (persistKarma)
+    {
+        karmaDatabase.disconnect();
+    }
+
+#endif
+    log.write("planetplus", "Stopped");
+    return CLI_EXIT_SUCCESS;
+}
+} // namespace cli_commands
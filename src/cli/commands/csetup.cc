@@ -1,46 +1,36 @@
 #include "commands.h"
 
+#include <dlfcn.h>
+#include <fcntl.h>
+#include <netdb.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cerrno>
 #include <filesystem>
 #include <fstream>
+#include <future>
+#include <map>
+#include <memory>
+#include <sstream>
 #include <string>
+#include <vector>
 
 #include "cli/tools.h"
 #include "utils/config.h"
 #include "utils/utils.h"
 
-namespace
-{
-/**
- * @brief Check if user has mariadb installed
- *
- * @return int
- */
-int checkForMariadb()
-{
-#ifdef _WIN32
-    return system("mariadb --version");
-#else
-    return system("mariadb --version");
+#ifdef PLANETPLUS_HAS_DATABASE
+#include "utils/database.h"
 #endif
-}
 
-int checkForCurl()
+namespace
 {
-#ifdef _WIN32
-    return system("curl --version");
-#else
-    return system("curl --version");
-#endif
-}
+constexpr int kProbeTimeout = 2000; // milliseconds to reach the database
 
-/**
- * @brief Creates the default configuration file.
- *
- * @param filePath The path to the configuration file.
- */
-void createDefaultConfigFile(const std::string& filePath)
-{
-    std::string configContent = R"(
+const char* const kDefaultConfig = R"(
 # This is the default configuration.
 # This file is automatically generated. Do not modify it unless you know what you are doing.
 
@@ -62,196 +52,445 @@ host = ""
 port = ""
 login = ""
 password = ""
+
+# More servers: one [server.NAME] section each, keys left out are taken
+# from [server]. A [ratelimit.NAME] section overrides [ratelimit] for one.
+
+[ratelimit]
+chat_rate = "1"
+chat_burst = "5"
+command_rate = "0.5"
+command_burst = "3"
+max_delay = "2000"
+mute_after = "10"
+mute_seconds = "300"
+slots = "4096"
+
+[plugins]
+queue_depth = "1024"
+cpu_budget = "100"
+
+[metrics]
+address = "127.0.0.1"
+port = "9180"
 )";
 
-    std::ofstream config_file(filePath);
-    if (config_file.is_open())
-    {
-        config_file << configContent;
-        config_file.close();
-    }
-    else
-    {
-        cli_tools::printWarning(
-            "! Failed to create default configuration file: " +
-            cli_tools::bold(filePath));
-    }
-}
-} // namespace
+/// Values of the new configuration, by section then key.
+using Values =
+    std::map<std::string, std::vector<std::pair<std::string, std::string>>>;
 
-namespace cli_commands
-{
-void planetplusSetup()
+/**
+ * @brief One requirement, checked in-process.
+ */
+struct Probe
 {
-    cli_tools::clearScreen();
-    std::cout << "> Setting up PlanetPlus...\n" << std::endl;
+    std::string name;
+    bool required {false};
+    bool passed {false};
+    std::string detail;
+};
 
+std::string defaultBaseDir()
+{
     std::string base_dir_path = BASE_DIR;
     base_dir_path += "planetplus/";
 
 #ifndef _WIN32
     base_dir_path = std::getenv("HOME") + base_dir_path;
 #endif
+    return base_dir_path;
+}
 
-    if (std::filesystem::exists(base_dir_path))
+/**
+ * @brief The default configuration with the given values: keys it has are
+ *        replaced in place, so its comments stay, the others are added at
+ *        the end of their section or in new sections.
+ */
+std::string renderConfig(const Values& values)
+{
+    std::vector<std::string> lines;
+    std::map<std::string, std::size_t> sectionEnd; // after its last key
+    std::map<std::string, std::vector<std::string>> written;
+
+    std::istringstream input(kDefaultConfig);
+    std::string line;
+    std::string section;
+    while (std::getline(input, line))
     {
-        cli_tools::printWarning(
-            "! Directory already exists: " + cli_tools::bold(base_dir_path));
-        if (cli_tools::confirmAction(
-                "Do you want to overwrite it?\nThis will erase everything in "
-                "the planetplus folder !"))
+        std::string trimmed = line;
+        utils::trim(trimmed);
+        if (trimmed.size() > 2 && trimmed.front() == '[' &&
+            trimmed.back() == ']')
+        {
+            section = trimmed.substr(1, trimmed.size() - 2);
+            sectionEnd[section] = lines.size() + 1;
+        }
+        else if (!section.empty() && !trimmed.empty() && trimmed[0] != '#' &&
+            trimmed.find('=') != std::string::npos)
         {
-            if (cli_tools::removeDir(base_dir_path.c_str()) == 0)
+            std::string key = trimmed.substr(0, trimmed.find('='));
+            utils::trim(key);
+            auto given = values.find(section);
+            if (given != values.end())
             {
-                cli_tools::printSuccess(
-                    "Removed directory: " + cli_tools::bold(base_dir_path));
-                putchar('\n');
+                for (const auto& [name, value] : given->second)
+                {
+                    if (name == key)
+                    {
+                        line = key + " = \"" + value + "\"";
+                        written[section].push_back(key);
+                    }
+                }
             }
-            else
+            sectionEnd[section] = lines.size() + 1;
+        }
+        lines.push_back(line);
+    }
+
+    // Inserted from the bottom up so the indices above stay right
+    std::vector<std::pair<std::size_t, std::string>> insertions;
+    std::string appended;
+    for (const auto& [name, pairs] : values)
+    {
+        std::string missing;
+        const std::vector<std::string>& done = written[name];
+        for (const auto& [key, value] : pairs)
+        {
+            if (std::find(done.begin(), done.end(), key) == done.end())
             {
-                cli_tools::printError("! Failed to remove directory: " +
-                    cli_tools::bold(base_dir_path));
-                return;
+                missing += key + " = \"" + value + "\"\n";
             }
         }
+        if (missing.empty())
+        {
+            continue;
+        }
+        auto end = sectionEnd.find(name);
+        if (end != sectionEnd.end())
+        {
+            missing.pop_back();
+            insertions.emplace_back(end->second, missing);
+        }
+        else
+        {
+            appended += "\n[" + name + "]\n" + missing;
+        }
     }
-
-    if (cli_tools::createDir(base_dir_path.c_str()) == 0)
+    std::sort(insertions.rbegin(), insertions.rend());
+    for (const auto& [index, text] : insertions)
     {
-        cli_tools::printSuccess(
-            "Created directory: " + cli_tools::bold(base_dir_path));
+        lines.insert(lines.begin() + static_cast<std::ptrdiff_t>(index), text);
     }
-    else
+
+    std::string out;
+    for (const std::string& rendered : lines)
     {
-        cli_tools::printError(
-            "! Failed to create directory: " + cli_tools::bold(base_dir_path));
-        return;
+        out += rendered;
+        out += '\n';
     }
+    return out + appended;
+}
 
-    std::string config_path = base_dir_path + "config/";
+Probe probeLibrary(std::string name, bool required,
+    std::vector<std::string> candidates)
+{
+    Probe probe {std::move(name), required, false, ""};
+    for (const std::string& soname : candidates)
+    {
+        if (void* handle = ::dlopen(soname.c_str(), RTLD_LAZY | RTLD_LOCAL))
+        {
+            ::dlclose(handle);
+            probe.passed = true;
+            probe.detail = soname;
+            return probe;
+        }
+    }
+    probe.detail = "not found, tried " + utils::join(candidates, ", ");
+    return probe;
+}
 
-    if (cli_tools::createDir(config_path.c_str()) == 0)
+/**
+ * @brief Whether something accepts TCP connections on host:port.
+ */
+Probe probeServer(std::string name, std::string host, std::string port)
+{
+    Probe probe {std::move(name), false, false, ""};
+
+    addrinfo hints {};
+    hints.ai_family = AF_UNSPEC;
+    hints.ai_socktype = SOCK_STREAM;
+    addrinfo* found = nullptr;
+    int error = ::getaddrinfo(host.c_str(), port.c_str(), &hints, &found);
+    if (error != 0)
     {
-        cli_tools::printSuccess(
-            "Created directory: " + cli_tools::bold(config_path));
+        probe.detail = ::gai_strerror(error);
+        return probe;
     }
-    else
+    std::unique_ptr<addrinfo, void (*)(addrinfo*)> addresses(
+        found, ::freeaddrinfo);
+
+    for (addrinfo* address = found; address != nullptr && !probe.passed;
+         address = address->ai_next)
     {
-        cli_tools::printError(
-            "! Failed to create directory: " + cli_tools::bold(config_path));
-        return;
+        int fd = ::socket(address->ai_family,
+            address->ai_socktype | SOCK_NONBLOCK | SOCK_CLOEXEC,
+            address->ai_protocol);
+        if (fd < 0)
+        {
+            continue;
+        }
+        if (::connect(fd, address->ai_addr, address->ai_addrlen) == 0)
+        {
+            probe.passed = true;
+        }
+        else if (errno == EINPROGRESS)
+        {
+            pollfd watched {fd, POLLOUT, 0};
+            int status = 0;
+            socklen_t length = sizeof(status);
+            probe.passed = ::poll(&watched, 1, kProbeTimeout) == 1 &&
+                ::getsockopt(fd, SOL_SOCKET, SO_ERROR, &status, &length) ==
+                    0 &&
+                status == 0;
+        }
+        ::close(fd);
     }
+    probe.detail = probe.passed ? "reachable on " + host + ":" + port
+                                : "nothing answers on " + host + ":" + port;
+    return probe;
+}
 
-    // create default configuration file
-    createDefaultConfigFile(config_path + "config.conf");
+/**
+ * @brief Starts every requirement check at once, they mostly wait. The
+ *        database server is last, and only checked when db_host is given.
+ */
+std::vector<std::future<Probe>> startProbes(
+    const std::string& db_host, const std::string& db_port)
+{
+    std::vector<std::future<Probe>> probes;
+    probes.push_back(std::async(std::launch::async, probeLibrary,
+        "MariaDB client", true,
+        std::vector<std::string> {"libmariadb.so.3", "libmariadb.so",
+            "libmysqlclient.so.21", "libmysqlclient.so"}));
+    probes.push_back(std::async(std::launch::async, probeLibrary, "cURL",
+        false, std::vector<std::string> {"libcurl.so.4", "libcurl.so"}));
+    if (!db_host.empty())
+    {
+        probes.push_back(std::async(std::launch::async, probeServer,
+            "MariaDB server", db_host, db_port));
+    }
+    return probes;
+}
 
-    std::string logs_path = base_dir_path + "logs/";
+/**
+ * @brief Prints the result of every check.
+ *
+ * @return false if a required one failed.
+ */
+bool reportProbes(std::vector<std::future<Probe>>& probes,
+    std::vector<Probe>& results)
+{
+    bool passed = true;
+    for (std::future<Probe>& future : probes)
+    {
+        Probe probe = future.get();
+        std::string line = probe.name + ": " + probe.detail;
+        if (probe.passed)
+        {
+            cli_tools::printSuccess(line);
+        }
+        else if (probe.required)
+        {
+            cli_tools::printError("! " + line);
+            passed = false;
+        }
+        else
+        {
+            cli_tools::printWarning("! " + line);
+        }
+        results.push_back(std::move(probe));
+    }
+    return passed;
+}
 
-    if (cli_tools::createDir(logs_path.c_str()) == 0)
+/**
+ * @brief Creates the directories and log files of an instance, keeping
+ *        whatever already exists.
+ */
+bool createTree(const std::string& base_dir_path)
+{
+    for (const char* directory :
+        {"config/", "logs/", "plugins/", "database/", "replays/"})
     {
-        cli_tools::printSuccess(
-            "Created directory: " + cli_tools::bold(logs_path));
+        std::error_code error;
+        std::filesystem::create_directories(base_dir_path + directory, error);
+        if (error)
+        {
+            cli_tools::printError("! Failed to create directory: " +
+                cli_tools::bold(base_dir_path + directory) + ": " +
+                error.message());
+            return false;
+        }
     }
-    else
+
+    for (const char* log : {"logs/server.log", "logs/chat.log"})
     {
-        cli_tools::printError(
-            "! Failed to create directory: " + cli_tools::bold(logs_path));
-        return;
+        std::ofstream file(base_dir_path + log, std::ios::app);
+        if (!file)
+        {
+            cli_tools::printError("! Failed to create file: " +
+                cli_tools::bold(base_dir_path + log));
+            return false;
+        }
     }
+    cli_tools::printSuccess(
+        "Created directory: " + cli_tools::bold(base_dir_path));
+    return true;
+}
 
-    // create log files
-    std::string server_log_file = logs_path + "server.log";
-    std::string chat_log_file = logs_path + "chat.log";
+bool removeTree(const std::string& base_dir_path)
+{
+    std::error_code error;
+    std::filesystem::remove_all(base_dir_path, error);
+    if (error)
+    {
+        cli_tools::printError("! Failed to remove directory: " +
+            cli_tools::bold(base_dir_path) + ": " + error.message());
+        return false;
+    }
+    cli_tools::printSuccess(
+        "Removed directory: " + cli_tools::bold(base_dir_path));
+    return true;
+}
 
-    if (cli_tools::createFile(server_log_file.c_str(), "w") == 0)
+bool writeConfig(const std::string& path, const Values& values)
+{
+    std::ofstream file(path, std::ios::trunc);
+    file << renderConfig(values);
+    if (!file)
     {
-        cli_tools::printSuccess(
-            "Created file: " + cli_tools::bold(server_log_file));
+        cli_tools::printError(
+            "! Failed to write the configuration: " + cli_tools::bold(path));
+        return false;
     }
-    else
+    cli_tools::printSuccess(
+        "Configuration written to " + cli_tools::bold(path));
+    return true;
+}
+
+std::string valueOf(const Values& values, const std::string& section,
+    const std::string& key, const std::string& fallback)
+{
+    auto it = values.find(section);
+    if (it != values.end())
     {
-        cli_tools::printWarning(
-            "! Failed to create file: " + cli_tools::bold(server_log_file));
-        return;
+        for (const auto& [name, value] : it->second)
+        {
+            if (name == key && !value.empty())
+            {
+                return value;
+            }
+        }
     }
+    return fallback;
+}
 
-    if (cli_tools::createFile(chat_log_file.c_str(), "w") == 0)
+/**
+ * @brief The values of a setup file, every section but [setup].
+ */
+Values valuesOf(config::Config& spec)
+{
+    Values values;
+    for (const std::string& section : spec.sections())
     {
-        cli_tools::printSuccess(
-            "Created file: " + cli_tools::bold(chat_log_file));
+        if (section == "setup")
+        {
+            continue;
+        }
+        for (const std::string& key : spec.keys(section))
+        {
+            values[section].emplace_back(key, spec.get(section, key));
+        }
     }
-    else
+
+    const std::pair<config::ConfigType, const char*> lists[] = {
+        {config::ConfigType::OWNER, "owners"},
+        {config::ConfigType::MASTERADMIN, "masteradmins"},
+        {config::ConfigType::ADMIN, "admins"}};
+    for (const auto& [type, key] : lists)
     {
-        cli_tools::printWarning(
-            "! Failed to create file: " + cli_tools::bold(chat_log_file));
-        return;
+        std::vector<std::string> logins = spec.get(type);
+        for (std::string& login : logins)
+        {
+            utils::trim(login);
+        }
+        if (!logins.empty())
+        {
+            values["planetplus"].emplace_back(key, utils::join(logins, ", "));
+        }
     }
+    return values;
+}
+} // namespace
 
-    // Check for requirements
+namespace cli_commands
+{
+void planetplusSetup()
+{
+    cli_tools::clearScreen();
+    std::cout << "> Setting up PlanetPlus...\n" << std::endl;
 
-    std::cout << "\n> Checking for requirements..." << std::endl;
+    std::string base_dir_path = defaultBaseDir();
 
-    // Check for MariaDB
-    std::cout << "\nChecking for MariaDB..." << std::endl;
-    if (checkForMariadb() == 0)
+    if (std::filesystem::exists(base_dir_path))
     {
-        cli_tools::printSuccess("MariaDB is installed !");
+        cli_tools::printWarning(
+            "! Directory already exists: " + cli_tools::bold(base_dir_path));
+        if (cli_tools::confirmAction(
+                "Do you want to overwrite it?\nThis will erase everything in "
+                "the planetplus folder !"))
+        {
+            if (!removeTree(base_dir_path))
+            {
+                return;
+            }
+            putchar('\n');
+        }
     }
-    else
+
+    // Checked while the tree is created
+    auto probes = startProbes("", "");
+    if (!createTree(base_dir_path))
     {
-        cli_tools::printError(
-            "! MariaDB is not installed !\nPlease install MariaDB and try "
-            "again.\n");
-#ifdef _WIN32
-        std::cout << "https://www.mariadbtutorial.com/getting-started/"
-                     "install-mariadb/"
-                  << std::endl;
-#endif
         return;
     }
 
-    // Check for cURL
-    std::cout << "\nChecking for cURL..." << std::endl;
-    if (checkForCurl() == 0)
-    {
-        cli_tools::printSuccess("cURL is installed !");
-    }
-    else
+    std::string config_path = base_dir_path + "config/";
+
+    std::cout << "\n> Checking for requirements..." << std::endl;
+    std::vector<Probe> results;
+    if (!reportProbes(probes, results))
     {
-        cli_tools::printError(
-            "! cURL is not installed !\nPlease install cURL and try again.\n");
+        writeConfig(config_path + "config.conf", {});
+        cli_tools::printError("Please install MariaDB and try again.\n");
 #ifdef _WIN32
-        std::cout << "cURL already installed ? Try adding it to your PATH\n"
-                     "https://curl.se/windows/"
+        std::cout << "https://www.mariadbtutorial.com/getting-started/"
+                     "install-mariadb/"
                   << std::endl;
 #endif
-    }
-
-    // Creating database folder
-    std::cout << "\n> Creating database folder...\n" << std::endl;
-
-    std::string database_path = base_dir_path + "database/";
-
-    if (cli_tools::createDir(database_path.c_str()) == 0)
-    {
-        cli_tools::printSuccess(
-            "Created directory: " + cli_tools::bold(config_path));
-    }
-    else
-    {
-        cli_tools::printError(
-            "! Failed to create directory: " + cli_tools::bold(config_path));
         return;
     }
 
-    // Database setup
     std::cout << "\n> Setting up Config file..." << std::endl;
     cli_tools::printInfo("Leave blank (whitespace) if you don't know, you will be able to change it later. See --help.\n");
 
-    config::Config config(config_path + "config.conf");
-    config.load();
-
+    Values values;
     std::string owner = cli_tools::getInput("Enter the server owner ID: ");
+    utils::trim(owner);
+    if (!owner.empty())
+    {
+        values["planetplus"].emplace_back("owners", owner);
+    }
 
     std::string db_host = cli_tools::getInput("Enter your MariaDB host: ");
     std::string db_port = cli_tools::getInput("Enter your MariaDB port: ");
@@ -259,8 +498,6 @@ void planetplusSetup()
     std::string db_password =
         cli_tools::getInput("Enter your MariaDB password: ");
 
-    std::cout << "\n> Saving database credentials..." << std::endl;
-
     utils::trim(db_host);
     utils::trim(db_port);
 
@@ -273,13 +510,9 @@ void planetplusSetup()
     {
         db_port = "3306";
     }
-    
-    config.set("database", "host", db_host);
-    config.set("database", "port", db_port);
-    config.set("database", "user", db_user);
-    config.set("database", "password", db_password);
-    config.save();
-    cli_tools::printSuccess("Database credentials saved !\n");
+
+    values["database"] = {{"host", db_host}, {"port", db_port},
+        {"user", db_user}, {"password", db_password}};
 
     // Server setup
     std::string server_host = cli_tools::getInput("Enter your server host: ");
@@ -289,13 +522,79 @@ void planetplusSetup()
     std::string server_password =
         cli_tools::getInput("Enter your server password: ");
 
-    std::cout << "\n> Saving server credentials..." << std::endl;
-    config.set("server", "host", server_host);
-    config.set("server", "port", server_port);
-    config.set("server", "login", server_login);
-    config.set("server", "password", server_password);
-    config.save();
-    cli_tools::printSuccess("Server credentials saved !\n");
-    cli_tools::printSuccess("Configuration can be found in " + cli_tools::bold(config_path + "config.conf"));
+    values["server"] = {{"host", server_host}, {"port", server_port},
+        {"login", server_login}, {"password", server_password}};
+
+    std::cout << "\n> Saving the configuration..." << std::endl;
+    writeConfig(config_path + "config.conf", values);
+}
+
+int planetplusSetupFrom(const std::string& path)
+{
+    if (!std::filesystem::exists(path))
+    {
+        cli_tools::printError("! No setup file: " + cli_tools::bold(path));
+        return CLI_EXIT_FAILURE;
+    }
+    config::Config spec(path);
+    spec.load();
+
+    std::string base_dir_path = defaultBaseDir();
+    if (spec.has("setup", "base_dir") && !spec.get("setup", "base_dir").empty())
+    {
+        base_dir_path = spec.get("setup", "base_dir");
+        if (base_dir_path.back() != '/')
+        {
+            base_dir_path += '/';
+        }
+    }
+    auto flag = [&spec](const std::string& key, bool fallback) {
+        return spec.has("setup", key) ? spec.get("setup", key) == "true"
+                                      : fallback;
+    };
+
+    Values values = valuesOf(spec);
+    auto probes = startProbes(valueOf(values, "database", "host", "localhost"),
+        valueOf(values, "database", "port", "3306"));
+
+    if (flag("overwrite", false) && std::filesystem::exists(base_dir_path) &&
+        !removeTree(base_dir_path))
+    {
+        return CLI_EXIT_FAILURE;
+    }
+    std::string config_path = base_dir_path + "config/config.conf";
+    if (!createTree(base_dir_path) || !writeConfig(config_path, values))
+    {
+        return CLI_EXIT_FAILURE;
+    }
+
+    std::vector<Probe> results;
+    bool passed = reportProbes(probes, results);
+    if (!flag("create_database", true))
+    {
+        return passed ? CLI_EXIT_SUCCESS : CLI_EXIT_FAILURE;
+    }
+    if (!results.back().passed)
+    {
+        cli_tools::printWarning(
+            "! Database not created, run --setup again once it is up.");
+        return CLI_EXIT_FAILURE;
+    }
+
+#ifdef PLANETPLUS_HAS_DATABASE
+    config::Config config(config_path);
+    config.load();
+    database::Manager manager(config_path, &config);
+    if (!manager.provision())
+    {
+        return CLI_EXIT_FAILURE;
+    }
+    cli_tools::printSuccess("Database " + cli_tools::bold(manager.name) +
+        " is ready.");
+#else
+    cli_tools::printWarning(
+        "! Built without database support, the database is not created.");
+#endif
+    return passed ? CLI_EXIT_SUCCESS : CLI_EXIT_FAILURE;
 }
-} // namespace cli_commands
\ No newline at end of file
+} // namespace cli_commands
@@ -0,0 +1,476 @@
+#include "control.h"
+
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <string_view>
+
+#include "cli/tools.h"
+#include "utils/utils.h"
+
+namespace control
+{
+namespace
+{
+constexpr int kClientTimeout = 2; // seconds before giving up on the daemon
+
+std::string encode(const std::vector<std::string>& fields)
+{
+    std::string line;
+    for (std::size_t i = 0; i < fields.size(); ++i)
+    {
+        if (i != 0)
+        {
+            line += '\t';
+        }
+        for (char c : fields[i])
+        {
+            switch (c)
+            {
+                case '\\':
+                    line += "\\\\";
+                    break;
+                case '\t':
+                    line += "\\t";
+                    break;
+                case '\n':
+                    line += "\\n";
+                    break;
+                default:
+                    line += c;
+            }
+        }
+    }
+    line += '\n';
+    return line;
+}
+
+std::vector<std::string> decode(std::string_view line)
+{
+    std::vector<std::string> fields(1);
+    for (std::size_t i = 0; i < line.size(); ++i)
+    {
+        char c = line[i];
+        if (c == '\t')
+        {
+            fields.emplace_back();
+        }
+        else if (c == '\\' && i + 1 < line.size())
+        {
+            char escaped = line[++i];
+            fields.back() +=
+                escaped == 't' ? '\t' : escaped == 'n' ? '\n' : escaped;
+        }
+        else
+        {
+            fields.back() += c;
+        }
+    }
+    return fields;
+}
+
+bool addressOf(const std::string& path, sockaddr_un& address)
+{
+    address = {};
+    address.sun_family = AF_UNIX;
+    if (path.size() >= sizeof(address.sun_path))
+    {
+        return false;
+    }
+    std::memcpy(address.sun_path, path.c_str(), path.size() + 1);
+    return true;
+}
+
+Reply error(std::string message)
+{
+    return Reply {false, std::move(message)};
+}
+
+/// The admin lists of [planetplus] are not plain keys, see config::Config.
+std::optional<config::ConfigType> listOf(const std::string& key)
+{
+    if (key == "owners")
+    {
+        return config::ConfigType::OWNER;
+    }
+    if (key == "masteradmins")
+    {
+        return config::ConfigType::MASTERADMIN;
+    }
+    if (key == "admins")
+    {
+        return config::ConfigType::ADMIN;
+    }
+    return std::nullopt;
+}
+} // namespace
+
+std::string socketPath(const std::string& base_dir)
+{
+    return base_dir + "planetplus.sock";
+}
+
+Server::Server(config::Config& config, core::EventLoop& loop)
+    : config_(config)
+    , loop_(loop)
+{
+}
+
+Server::~Server()
+{
+    close();
+}
+
+void Server::handle(const std::string& command, Handler handler)
+{
+    handlers_[command] = std::move(handler);
+}
+
+bool Server::listen(const std::string& path)
+{
+    close();
+
+    sockaddr_un address;
+    if (!addressOf(path, address))
+    {
+        cli_tools::printError(
+            "Control socket path too long: " + cli_tools::bold(path));
+        return false;
+    }
+
+    if (Client probe; probe.connect(path))
+    {
+        cli_tools::printError("A daemon is already running on " +
+            cli_tools::bold(path));
+        return false;
+    }
+    ::unlink(path.c_str()); // left by a daemon that did not stop cleanly
+
+    // The configuration holds passwords, only its owner may ask for it.
+    // On Linux the socket file takes the mode of the socket when it is
+    // bound: a chmod() after bind() would leave a window where anyone could
+    // connect, and umask() would change the mode of files other threads
+    // create meanwhile
+    listener_ =
+        ::socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    int bound = -1;
+    if (listener_ >= 0 && ::fchmod(listener_, S_IRUSR | S_IWUSR) == 0)
+    {
+        bound = ::bind(listener_, reinterpret_cast<sockaddr*>(&address),
+            sizeof(address));
+    }
+    if (bound != 0)
+    {
+        cli_tools::printError("Failed to create the control socket " +
+            cli_tools::bold(path) + ": " + std::strerror(errno));
+        close();
+        return false;
+    }
+    path_ = path;
+
+    if (::listen(listener_, 16) != 0)
+    {
+        cli_tools::printError("Failed to listen on " + cli_tools::bold(path) +
+            ": " + std::strerror(errno));
+        close();
+        return false;
+    }
+
+    loop_.watch(listener_, POLLIN, [this](short) { accept(); });
+    return true;
+}
+
+void Server::close()
+{
+    while (!connections_.empty())
+    {
+        drop(connections_.begin()->first);
+    }
+    if (listener_ >= 0)
+    {
+        loop_.unwatch(listener_);
+        ::close(listener_);
+        listener_ = -1;
+    }
+    if (!path_.empty())
+    {
+        ::unlink(path_.c_str());
+        path_.clear();
+    }
+}
+
+void Server::accept()
+{
+    while (true)
+    {
+        int fd = ::accept4(listener_, nullptr, nullptr,
+            SOCK_NONBLOCK | SOCK_CLOEXEC);
+        if (fd < 0)
+        {
+            return;
+        }
+        connections_.emplace(fd, Connection());
+        loop_.watch(fd, POLLIN,
+            [this, fd](short revents) { onReady(fd, revents); });
+    }
+}
+
+void Server::onReady(int fd, short revents)
+{
+    auto it = connections_.find(fd);
+    if (it == connections_.end())
+    {
+        return;
+    }
+    Connection& connection = it->second;
+
+    if ((revents & (POLLIN | POLLHUP | POLLERR)) != 0)
+    {
+        char buffer[4096];
+        while (true)
+        {
+            ssize_t received = ::recv(fd, buffer, sizeof(buffer), 0);
+            if (received > 0)
+            {
+                connection.input.append(
+                    buffer, static_cast<std::size_t>(received));
+                continue;
+            }
+            if (received == 0 || (errno != EAGAIN && errno != EINTR))
+            {
+                drop(fd); // the client is done
+                return;
+            }
+            if (errno == EAGAIN)
+            {
+                break;
+            }
+        }
+
+        std::size_t start = 0;
+        std::size_t end;
+        while ((end = connection.input.find('\n', start)) != std::string::npos)
+        {
+            std::string_view line(connection.input.data() + start, end - start);
+            std::vector<std::string> request = decode(line);
+            auto handler = handlers_.find(request[0]);
+            Reply reply = handler != handlers_.end()
+                ? handler->second(request)
+                : answer(config_, request);
+            if (reply.ok && request[0] == "set")
+            {
+                config_.save();
+            }
+            connection.output +=
+                encode({reply.ok ? "ok" : "error", reply.value});
+            start = end + 1;
+        }
+        connection.input.erase(0, start);
+        if (connection.input.size() > kMaxLine)
+        {
+            drop(fd);
+            return;
+        }
+    }
+
+    std::size_t written = 0;
+    while (written < connection.output.size())
+    {
+        ssize_t sent = ::send(fd, connection.output.data() + written,
+            connection.output.size() - written, MSG_NOSIGNAL);
+        if (sent < 0)
+        {
+            if (errno == EINTR)
+            {
+                continue;
+            }
+            if (errno == EAGAIN)
+            {
+                break;
+            }
+            drop(fd);
+            return;
+        }
+        written += static_cast<std::size_t>(sent);
+    }
+    connection.output.erase(0, written);
+    loop_.modify(fd, connection.output.empty() ? POLLIN : POLLIN | POLLOUT);
+}
+
+Reply answer(config::Config& config, const std::vector<std::string>& request)
+{
+    const std::string& command = request[0];
+    if (command == "ping")
+    {
+        return Reply {true, "pong"};
+    }
+    if ((command != "get" || request.size() != 3) &&
+        (command != "set" || request.size() != 4))
+    {
+        return error("Unknown request: " + command);
+    }
+
+    const std::string& section = request[1];
+    const std::string& key = request[2];
+    std::optional<config::ConfigType> list;
+    if (section == "planetplus")
+    {
+        list = listOf(key);
+    }
+    if (list)
+    {
+        if (command == "set")
+        {
+            // Logins are added to the list, those already in it kept once
+            for (std::string login : utils::split(request[3], ","))
+            {
+                utils::trim(login);
+                const std::vector<std::string>& logins = config.get(*list);
+                if (!login.empty() &&
+                    std::find(logins.begin(), logins.end(), login) ==
+                        logins.end())
+                {
+                    config.set(login, *list);
+                }
+            }
+        }
+        return Reply {true, utils::join(config.get(*list), ", ")};
+    }
+
+    std::vector<std::string> sections = config.sections();
+    if (std::find(sections.begin(), sections.end(), section) ==
+        sections.end())
+    {
+        return error("Section not found: " + section);
+    }
+    if (!config.has(section, key))
+    {
+        return error("Key not found: " + key);
+    }
+    if (command == "get")
+    {
+        return Reply {true, config.get(section, key)};
+    }
+    config.set(section, key, request[3]);
+    return Reply {true, request[3]};
+}
+
+void Server::drop(int fd)
+{
+    loop_.unwatch(fd);
+    ::close(fd);
+    connections_.erase(fd);
+}
+
+Client::~Client()
+{
+    if (fd_ >= 0)
+    {
+        ::close(fd_);
+    }
+}
+
+bool Client::connect(const std::string& path)
+{
+    sockaddr_un address;
+    if (!addressOf(path, address))
+    {
+        return false;
+    }
+    fd_ = ::socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (fd_ < 0)
+    {
+        return false;
+    }
+    if (::connect(fd_, reinterpret_cast<sockaddr*>(&address),
+            sizeof(address)) != 0)
+    {
+        ::close(fd_);
+        fd_ = -1;
+        return false;
+    }
+
+    timeval timeout {kClientTimeout, 0};
+    ::setsockopt(fd_, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+    ::setsockopt(fd_, SOL_SOCKET, SO_SNDTIMEO, &timeout, sizeof(timeout));
+    return true;
+}
+
+std::optional<Reply> Client::request(const std::vector<std::string>& fields)
+{
+    std::vector<Reply> replies = requests({fields});
+    if (replies.empty())
+    {
+        return std::nullopt;
+    }
+    return replies[0];
+}
+
+std::vector<Reply> Client::requests(
+    const std::vector<std::vector<std::string>>& batch)
+{
+    std::vector<Reply> replies;
+    if (fd_ < 0)
+    {
+        return replies;
+    }
+
+    // All written at once, the daemon answers them in order
+    std::string line;
+    for (const std::vector<std::string>& fields : batch)
+    {
+        line += encode(fields);
+    }
+    std::size_t written = 0;
+    while (written < line.size())
+    {
+        ssize_t sent = ::send(fd_, line.data() + written,
+            line.size() - written, MSG_NOSIGNAL);
+        if (sent < 0 && errno == EINTR)
+        {
+            continue;
+        }
+        if (sent <= 0)
+        {
+            return replies;
+        }
+        written += static_cast<std::size_t>(sent);
+    }
+
+    std::size_t start = 0;
+    while (replies.size() < batch.size())
+    {
+        std::size_t end = input_.find('\n', start);
+        if (end == std::string::npos)
+        {
+            input_.erase(0, start);
+            start = 0;
+            char buffer[4096];
+            ssize_t received = ::recv(fd_, buffer, sizeof(buffer), 0);
+            if (received < 0 && errno == EINTR)
+            {
+                continue;
+            }
+            if (received <= 0)
+            {
+                break;
+            }
+            input_.append(buffer, static_cast<std::size_t>(received));
+            continue;
+        }
+
+        std::vector<std::string> reply =
+            decode(std::string_view(input_).substr(start, end - start));
+        replies.push_back(
+            Reply {reply[0] == "ok", reply.size() > 1 ? reply[1] : ""});
+        start = end + 1;
+    }
+    input_.erase(0, start);
+    return replies;
+}
+} // namespace control
@@ -0,0 +1,136 @@
+#ifndef CLI_CONTROL_H
+#define CLI_CONTROL_H
+
+#include <functional>
+#include <map>
+#include <optional>
+#include <string>
+#include <vector>
+
+#include "core/eventloop.h"
+#include "utils/config.h"
+
+/**
+ * Control socket of a running daemon, so that the CLI commands do not
+ * re-read and re-write the configuration on every call.
+ *
+ * One request per line, fields separated by tabs (tabs, newlines and
+ * backslashes escaped as \t, \n and \\); one reply line per request,
+ * "ok" or "error" then the value or the message:
+ *
+ *     get	server	host       ->  ok	127.0.0.1
+ *     set	server	port	5001   ->  ok	5001
+ *     get	nope	host       ->  error	Section not found: nope
+ *
+ * Setting owners, masteradmins or admins adds the comma separated logins
+ * to that list. The daemon answers requests of its own through
+ * Server::handle(), e.g. "plugin	reload	NAME".
+ */
+namespace control
+{
+/**
+ * @brief Where the daemon of a base directory listens.
+ */
+std::string socketPath(const std::string& base_dir);
+
+struct Reply
+{
+    bool ok {false};
+    std::string value; // the message of an error
+};
+
+/**
+ * @brief Answers one request from config, as the daemon does. A set is not
+ *        saved, the caller saves once it is done.
+ */
+Reply answer(config::Config& config, const std::vector<std::string>& request);
+
+/**
+ * @brief Answers the requests of the CLI from the configuration the daemon
+ *        keeps loaded. Runs on an event loop; several requests may come on
+ *        one connection.
+ */
+class Server
+{
+  public:
+    Server(config::Config& config, core::EventLoop& loop);
+    ~Server();
+
+    Server(const Server&) = delete;
+    Server& operator=(const Server&) = delete;
+
+    /// Answers a request, on the loop of the server.
+    using Handler = std::function<Reply(const std::vector<std::string>&)>;
+
+    /**
+     * @brief Answers requests whose first field is command with handler
+     *        instead of the configuration. Before the loop runs.
+     */
+    void handle(const std::string& command, Handler handler);
+
+    /**
+     * @brief Fails if another daemon answers on path; a socket left by one
+     *        that died is replaced.
+     */
+    bool listen(const std::string& path);
+
+    void close();
+
+  private:
+    static constexpr std::size_t kMaxLine = 64 * 1024;
+
+    struct Connection
+    {
+        std::string input;
+        std::string output;
+    };
+
+    config::Config& config_;
+    core::EventLoop& loop_;
+    std::string path_;
+    int listener_ {-1};
+    std::map<int, Connection> connections_;
+    std::map<std::string, Handler> handlers_;
+
+    void accept();
+    void onReady(int fd, short revents);
+    void drop(int fd);
+};
+
+/**
+ * @brief Blocking connection to the daemon, for the CLI commands.
+ */
+class Client
+{
+  public:
+    Client() = default;
+    ~Client();
+
+    Client(const Client&) = delete;
+    Client& operator=(const Client&) = delete;
+
+    /**
+     * @return false if no daemon listens on path.
+     */
+    bool connect(const std::string& path);
+
+    /**
+     * @return Nothing if the daemon went away or did not answer in time.
+     */
+    std::optional<Reply> request(const std::vector<std::string>& fields);
+
+    /**
+     * @brief Sends every request at once and reads the replies, in order.
+     *
+     * @return Fewer replies than requests if the daemon went away.
+     */
+    std::vector<Reply> requests(
+        const std::vector<std::vector<std::string>>& batch);
+
+  private:
+    int fd_ {-1};
+    std::string input_;
+};
+} // namespace control
+
+#endif
@@ -0,0 +1,82 @@
+#include "arena.h"
+
+#include <algorithm>
+#include <cstring>
+
+#if !defined(NDEBUG) && !defined(PLANETPLUS_ARENA_POISON)
+#define PLANETPLUS_ARENA_POISON
+#endif
+
+namespace core
+{
+Arena::Arena(std::size_t capacity)
+    : buffer_(new std::byte[capacity])
+    , capacity_(capacity)
+{
+    resource_.emplace(
+        buffer_.get(), capacity_, std::pmr::new_delete_resource());
+}
+
+void Arena::reset()
+{
+    ++stats_.resets;
+    if (used_ == 0)
+    {
+        return;
+    }
+
+    stats_.peak = std::max(stats_.peak, used_);
+    resource_.reset(); // gives the overflow back to the heap
+    if (used_ > capacity_)
+    {
+        ++stats_.overflows;
+        while (capacity_ < used_)
+        {
+            capacity_ *= 2;
+        }
+        buffer_.reset(new std::byte[capacity_]);
+    }
+#ifdef PLANETPLUS_ARENA_POISON
+    else
+    {
+        std::memset(buffer_.get(), 0xDB, used_);
+    }
+#endif
+    used_ = 0;
+    resource_.emplace(
+        buffer_.get(), capacity_, std::pmr::new_delete_resource());
+}
+
+std::size_t Arena::used() const
+{
+    return used_;
+}
+
+std::size_t Arena::capacity() const
+{
+    return capacity_;
+}
+
+const Arena::Stats& Arena::stats() const
+{
+    return stats_;
+}
+
+void* Arena::do_allocate(std::size_t bytes, std::size_t alignment)
+{
+    ++stats_.allocations;
+    stats_.bytes += bytes;
+    used_ += bytes + alignment - 1; // at worst, for the padding
+    return resource_->allocate(bytes, alignment);
+}
+
+void Arena::do_deallocate(void*, std::size_t, std::size_t)
+{
+    // Everything goes at once, in reset()
+}
+
+bool Arena::do_is_equal(const std::pmr::memory_resource& other) const noexcept
+{
+    return this == &other;
+}
+} // namespace core
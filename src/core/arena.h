@@ -0,0 +1,74 @@
+#ifndef ARENA_H
+#define ARENA_H
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <memory_resource>
+#include <optional>
+
+namespace core
+{
+/**
+ * @brief Scratch memory of one event loop tick.
+ *
+ * A monotonic buffer: allocating is a pointer bump, deallocating does
+ * nothing, and reset() hands everything back at once. Handlers put their
+ * temporaries in std::pmr containers built on it (see scratch()), so a
+ * callback that formats a line or decodes a document does not go through
+ * malloc. A tick needing more than the buffer gets the rest from the heap;
+ * the buffer then grows on the next reset() so later ticks fit again.
+ *
+ * Debug builds, or builds with PLANETPLUS_ARENA_POISON, fill the buffer
+ * with 0xDB on reset(): a pointer kept past its tick reads garbage at once
+ * instead of data that looks right.
+ *
+ * Not thread safe, owned by an EventLoop.
+ */
+class Arena : public std::pmr::memory_resource
+{
+  public:
+    static constexpr std::size_t kDefaultCapacity = 64 * 1024;
+
+    struct Stats
+    {
+        std::uint64_t resets {0};
+        std::uint64_t allocations {0}; // since the arena was created
+        std::uint64_t bytes {0};       // likewise
+        std::uint64_t overflows {0};   // ticks that went to the heap
+        std::size_t peak {0};          // most bytes used in one tick
+    };
+
+    explicit Arena(std::size_t capacity = kDefaultCapacity);
+
+    Arena(const Arena&) = delete;
+    Arena& operator=(const Arena&) = delete;
+
+    /**
+     * @brief Frees everything allocated since the last reset.
+     */
+    void reset();
+
+    /**
+     * @brief Bytes handed out since the last reset.
+     */
+    std::size_t used() const;
+
+    std::size_t capacity() const;
+    const Stats& stats() const;
+
+  private:
+    std::unique_ptr<std::byte[]> buffer_;
+    std::size_t capacity_;
+    std::size_t used_ {0};
+    std::optional<std::pmr::monotonic_buffer_resource> resource_;
+    Stats stats_;
+
+    void* do_allocate(std::size_t bytes, std::size_t alignment) override;
+    void do_deallocate(void*, std::size_t, std::size_t) override;
+    bool do_is_equal(
+        const std::pmr::memory_resource& other) const noexcept override;
+};
+} // namespace core
+
+#endif
@@ -0,0 +1,225 @@
+#include "eventloop.h"
+
+#include <fcntl.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+
+#include "cli/tools.h"
+
+namespace core
+{
+namespace
+{
+thread_local EventLoop* currentLoop = nullptr;
+
+/// Makes a loop current for the duration of a runOnce() call.
+class CurrentLoop
+{
+  public:
+    explicit CurrentLoop(EventLoop* loop)
+        : previous_(currentLoop)
+    {
+        currentLoop = loop;
+    }
+
+    ~CurrentLoop()
+    {
+        currentLoop = previous_;
+    }
+
+  private:
+    EventLoop* previous_;
+};
+} // namespace
+
+EventLoop::EventLoop(std::chrono::milliseconds tick)
+    : timers_(tick)
+{
+    int fds[2];
+    if (::pipe2(fds, O_NONBLOCK | O_CLOEXEC) != 0)
+    {
+        cli_tools::printError(
+            "Failed to create the event loop pipe: " +
+            std::string(std::strerror(errno)));
+        return;
+    }
+    wakeRead_ = fds[0];
+    wakeWrite_ = fds[1];
+}
+
+EventLoop::~EventLoop()
+{
+    if (wakeRead_ >= 0)
+    {
+        ::close(wakeRead_);
+        ::close(wakeWrite_);
+    }
+}
+
+EventLoop* EventLoop::current()
+{
+    return currentLoop;
+}
+
+std::pmr::memory_resource* scratch()
+{
+    return currentLoop != nullptr ? &currentLoop->arena()
+                                  : std::pmr::new_delete_resource();
+}
+
+TimerWheel& EventLoop::timers()
+{
+    return timers_;
+}
+
+Arena& EventLoop::arena()
+{
+    return arena_;
+}
+
+void EventLoop::watch(int fd, short events, IoCallback callback)
+{
+    watches_.push_back({fd, events, std::move(callback)});
+}
+
+void EventLoop::modify(int fd, short events)
+{
+    for (Watch& watch : watches_)
+    {
+        if (watch.fd == fd && !watch.removed)
+        {
+            watch.events = events;
+        }
+    }
+}
+
+void EventLoop::unwatch(int fd)
+{
+    for (Watch& watch : watches_)
+    {
+        if (watch.fd == fd)
+        {
+            watch.removed = true;
+        }
+    }
+    if (!dispatching_)
+    {
+        watches_.erase(std::remove_if(watches_.begin(), watches_.end(),
+                           [](const Watch& watch) { return watch.removed; }),
+            watches_.end());
+    }
+}
+
+void EventLoop::post(Job task)
+{
+    bool wake;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        wake = posted_.empty();
+        posted_.push_back(std::move(task));
+    }
+    if (wake && wakeWrite_ >= 0)
+    {
+        char byte = 1;
+        while (::write(wakeWrite_, &byte, 1) < 0 && errno == EINTR)
+        {
+        }
+    }
+}
+
+void EventLoop::run()
+{
+    stopped_.store(false, std::memory_order_relaxed);
+    while (!stopped_.load(std::memory_order_relaxed))
+    {
+        runOnce(std::chrono::milliseconds(-1));
+    }
+}
+
+void EventLoop::runOnce(std::chrono::milliseconds maxWait)
+{
+    CurrentLoop current(this);
+    ++depth_;
+
+    std::chrono::milliseconds timeout = timers_.nextTimeout(Clock::now());
+    if (maxWait.count() >= 0 && (timeout.count() < 0 || maxWait < timeout))
+    {
+        timeout = maxWait;
+    }
+
+    std::pmr::vector<pollfd> fds(&arena_);
+    fds.reserve(watches_.size() + 1);
+    fds.push_back({wakeRead_, POLLIN, 0});
+    for (const Watch& watch : watches_)
+    {
+        fds.push_back({watch.fd, watch.events, 0});
+    }
+
+    int ready = ::poll(fds.data(), fds.size(), static_cast<int>(timeout.count()));
+    if (ready < 0 && errno != EINTR)
+    {
+        cli_tools::printError(
+            "poll() failed: " + std::string(std::strerror(errno)));
+    }
+
+    if (ready > 0)
+    {
+        if (fds[0].revents != 0)
+        {
+            char buffer[64];
+            while (::read(wakeRead_, buffer, sizeof(buffer)) > 0)
+            {
+            }
+        }
+
+        // Callbacks may watch or unwatch: index the watches of this round
+        dispatching_ = true;
+        std::size_t count = fds.size() - 1;
+        for (std::size_t i = 0; i < count; ++i)
+        {
+            if (fds[i + 1].revents != 0 && !watches_[i].removed)
+            {
+                IoCallback callback = watches_[i].callback;
+                callback(fds[i + 1].revents);
+            }
+        }
+        dispatching_ = false;
+        watches_.erase(std::remove_if(watches_.begin(), watches_.end(),
+                           [](const Watch& watch) { return watch.removed; }),
+            watches_.end());
+    }
+
+    runPosted();
+    timers_.advance(Clock::now());
+
+    if (--depth_ == 0)
+    {
+        arena_.reset(); // fds only has a no-op deallocate left to do
+    }
+}
+
+void EventLoop::stop()
+{
+    stopped_.store(true, std::memory_order_relaxed);
+    post([] {});
+}
+
+void EventLoop::runPosted()
+{
+    // The two vectors trade their memory instead of allocating every time
+    std::vector<Job> tasks = std::move(running_);
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        tasks.swap(posted_);
+    }
+    for (Job& task : tasks)
+    {
+        task();
+    }
+    tasks.clear();
+    running_ = std::move(tasks);
+}
+} // namespace core
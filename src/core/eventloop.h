@@ -0,0 +1,208 @@
+#ifndef EVENTLOOP_H
+#define EVENTLOOP_H
+
+#include <poll.h>
+
+#include <atomic>
+#include <chrono>
+#include <coroutine>
+#include <cstddef>
+#include <functional>
+#include <memory_resource>
+#include <mutex>
+#include <vector>
+
+#include "core/arena.h"
+#include "core/threadpool.h"
+#include "core/timerwheel.h"
+
+namespace core
+{
+/**
+ * @brief Single threaded event loop: file descriptors, timers and tasks
+ *        posted from other threads.
+ *
+ * Waits in poll() until a descriptor is ready, the next timer of the wheel
+ * is due or a task is posted (through a self pipe), then runs everything
+ * that is ready on the thread calling run(). Its arena is reset once all of
+ * that ran, see scratch().
+ */
+class EventLoop
+{
+  public:
+    using Clock = TimerWheel::Clock;
+    using IoCallback = std::function<void(short revents)>;
+
+    explicit EventLoop(
+        std::chrono::milliseconds tick = std::chrono::milliseconds(10));
+    ~EventLoop();
+
+    EventLoop(const EventLoop&) = delete;
+    EventLoop& operator=(const EventLoop&) = delete;
+
+    /**
+     * @brief The loop running on the calling thread, nullptr outside of
+     *        run() and runOnce().
+     */
+    static EventLoop* current();
+
+    TimerWheel& timers();
+
+    /**
+     * @brief Scratch memory of the tick being run, see scratch().
+     */
+    Arena& arena();
+
+    /**
+     * @brief Calls callback with the poll() revents when fd is ready.
+     *
+     * @param events POLLIN, POLLOUT...
+     */
+    void watch(int fd, short events, IoCallback callback);
+    void modify(int fd, short events);
+    void unwatch(int fd);
+
+    /**
+     * @brief Runs task on the loop thread. Thread safe.
+     */
+    void post(Job task);
+
+    /**
+     * @brief Runs until stop() is called.
+     */
+    void run();
+
+    /**
+     * @brief Waits at most maxWait for something to do, and does it.
+     */
+    void runOnce(std::chrono::milliseconds maxWait);
+
+    /**
+     * @brief Makes run() return. Thread safe.
+     */
+    void stop();
+
+  private:
+    struct Watch
+    {
+        int fd;
+        short events;
+        IoCallback callback;
+        bool removed {false};
+    };
+
+    TimerWheel timers_;
+    Arena arena_;
+    std::vector<Watch> watches_;
+    bool dispatching_ {false};
+    int depth_ {0}; // runOnce() calls in progress, the arena waits for all
+    int wakeRead_ {-1};
+    int wakeWrite_ {-1};
+    std::mutex mutex_;
+    std::vector<Job> posted_;
+    std::vector<Job> running_; // the memory of posted_ between two runs
+    std::atomic<bool> stopped_ {false};
+
+    void runPosted();
+};
+
+/**
+ * @brief Memory for temporaries of the current tick: the arena of the loop
+ *        running on this thread, the heap outside of one.
+ *
+ *     std::pmr::string line(core::scratch());
+ *     line += login;
+ *
+ * Freed when the tick ends, so nothing allocated from it may be kept: not
+ * in a member, not across a co_await.
+ */
+std::pmr::memory_resource* scratch();
+
+/**
+ * @brief Awaitable suspending a coroutine on the timer wheel of a loop.
+ */
+struct SleepAwaiter
+{
+    EventLoop* loop;
+    EventLoop::Clock::duration delay;
+
+    bool await_ready() const noexcept
+    {
+        return delay <= EventLoop::Clock::duration::zero();
+    }
+
+    bool await_suspend(std::coroutine_handle<> handle) const
+    {
+        if (loop == nullptr)
+        {
+            return false; // no loop to wake us up, do not sleep
+        }
+        loop->timers().after(delay, [handle] { handle.resume(); });
+        return true;
+    }
+
+    void await_resume() const noexcept {}
+};
+
+/**
+ * @brief co_await sleepFor(5s): resumes the coroutine on the current loop
+ *        once delay elapsed.
+ */
+inline SleepAwaiter sleepFor(EventLoop::Clock::duration delay)
+{
+    return SleepAwaiter {EventLoop::current(), delay};
+}
+
+inline SleepAwaiter sleepFor(
+    EventLoop& loop, EventLoop::Clock::duration delay)
+{
+    return SleepAwaiter {&loop, delay};
+}
+
+/**
+ * @brief Awaitable suspending a coroutine until fd is ready, resumes with
+ *        the poll() revents.
+ */
+struct IoAwaiter
+{
+    EventLoop* loop;
+    int fd;
+    short events;
+    short revents {0};
+
+    bool await_ready() const noexcept
+    {
+        return loop == nullptr;
+    }
+
+    void await_suspend(std::coroutine_handle<> handle)
+    {
+        loop->watch(fd, events, [this, handle](short ready) {
+            revents = ready;
+            loop->unwatch(fd);
+            handle.resume();
+        });
+    }
+
+    short await_resume() const noexcept
+    {
+        return revents;
+    }
+};
+
+/**
+ * @brief co_await waitFor(fd, POLLOUT): resumes the coroutine on the current
+ *        loop once fd is ready.
+ */
+inline IoAwaiter waitFor(int fd, short events)
+{
+    return IoAwaiter {EventLoop::current(), fd, events};
+}
+
+inline IoAwaiter waitFor(EventLoop& loop, int fd, short events)
+{
+    return IoAwaiter {&loop, fd, events};
+}
+} // namespace core
+
+#endif
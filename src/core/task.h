@@ -0,0 +1,392 @@
+#ifndef TASK_H
+#define TASK_H
+
+#include <coroutine>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <optional>
+#include <type_traits>
+#include <utility>
+
+#include "cli/tools.h"
+#include "core/eventloop.h"
+#include "core/threadpool.h"
+
+namespace core
+{
+template <typename T>
+class Task;
+
+namespace detail
+{
+/**
+ * @brief Resumes whoever awaited the task once it is done.
+ */
+struct FinalAwaiter
+{
+    bool await_ready() const noexcept
+    {
+        return false;
+    }
+
+    template <typename Promise>
+    std::coroutine_handle<> await_suspend(
+        std::coroutine_handle<Promise> handle) const noexcept
+    {
+        std::coroutine_handle<> continuation = handle.promise().continuation;
+        return continuation ? continuation : std::noop_coroutine();
+    }
+
+    void await_resume() const noexcept {}
+};
+
+struct PromiseBase
+{
+    std::coroutine_handle<> continuation;
+    std::exception_ptr exception;
+
+    std::suspend_always initial_suspend() const noexcept
+    {
+        return {};
+    }
+
+    FinalAwaiter final_suspend() const noexcept
+    {
+        return {};
+    }
+
+    void unhandled_exception()
+    {
+        exception = std::current_exception();
+    }
+};
+
+template <typename T>
+struct Promise : PromiseBase
+{
+    std::optional<T> value;
+
+    Task<T> get_return_object();
+
+    template <typename U>
+    void return_value(U&& result)
+    {
+        value.emplace(std::forward<U>(result));
+    }
+
+    T take()
+    {
+        if (exception)
+        {
+            std::rethrow_exception(exception);
+        }
+        return std::move(*value);
+    }
+};
+
+template <>
+struct Promise<void> : PromiseBase
+{
+    Task<void> get_return_object();
+
+    void return_void() const noexcept {}
+
+    void take()
+    {
+        if (exception)
+        {
+            std::rethrow_exception(exception);
+        }
+    }
+};
+} // namespace detail
+
+/**
+ * @brief Lazily started coroutine returning T.
+ *
+ * Nothing runs until the task is awaited (or given to spawn()); the
+ * awaiting coroutine is then resumed directly when the task finishes, with
+ * no trip through the loop. Exceptions propagate to the awaiter.
+ *
+ *     core::Task<int> answer()
+ *     {
+ *         co_await core::sleepFor(std::chrono::seconds(1));
+ *         co_return 42;
+ *     }
+ */
+template <typename T = void>
+class [[nodiscard]] Task
+{
+  public:
+    using promise_type = detail::Promise<T>;
+    using Handle = std::coroutine_handle<promise_type>;
+
+    explicit Task(Handle handle)
+        : handle_(handle)
+    {
+    }
+
+    Task(Task&& other) noexcept
+        : handle_(std::exchange(other.handle_, nullptr))
+    {
+    }
+
+    Task& operator=(Task&& other) noexcept
+    {
+        if (this != &other)
+        {
+            if (handle_)
+            {
+                handle_.destroy();
+            }
+            handle_ = std::exchange(other.handle_, nullptr);
+        }
+        return *this;
+    }
+
+    Task(const Task&) = delete;
+    Task& operator=(const Task&) = delete;
+
+    ~Task()
+    {
+        if (handle_)
+        {
+            handle_.destroy();
+        }
+    }
+
+    bool await_ready() const noexcept
+    {
+        return !handle_ || handle_.done();
+    }
+
+    std::coroutine_handle<> await_suspend(
+        std::coroutine_handle<> awaiting) noexcept
+    {
+        handle_.promise().continuation = awaiting;
+        return handle_;
+    }
+
+    T await_resume()
+    {
+        if (!handle_)
+        {
+            // Moved from or released: there is no result to give
+            std::terminate();
+        }
+        return handle_.promise().take();
+    }
+
+    /**
+     * @brief Gives up ownership of the coroutine, see spawn().
+     */
+    Handle release()
+    {
+        return std::exchange(handle_, nullptr);
+    }
+
+  private:
+    Handle handle_;
+};
+
+namespace detail
+{
+template <typename T>
+Task<T> Promise<T>::get_return_object()
+{
+    return Task<T>(std::coroutine_handle<Promise<T>>::from_promise(*this));
+}
+
+inline Task<void> Promise<void>::get_return_object()
+{
+    return Task<void>(std::coroutine_handle<Promise<void>>::from_promise(*this));
+}
+
+/// Coroutine frame destroying itself when done, used by spawn().
+struct Detached
+{
+    struct promise_type
+    {
+        Detached get_return_object() const noexcept
+        {
+            return {};
+        }
+
+        std::suspend_never initial_suspend() const noexcept
+        {
+            return {};
+        }
+
+        std::suspend_never final_suspend() const noexcept
+        {
+            return {};
+        }
+
+        void return_void() const noexcept {}
+
+        void unhandled_exception() const noexcept
+        {
+            std::terminate(); // nobody left to report it to
+        }
+    };
+};
+
+inline Detached runDetached(Task<void> task)
+{
+    co_await task;
+}
+} // namespace detail
+
+/**
+ * @brief Starts a task nobody awaits. It runs until its first suspension
+ *        right away, and frees itself when done.
+ */
+inline void spawn(Task<void> task)
+{
+    detail::runDetached(std::move(task));
+}
+
+/**
+ * @brief Awaitable running a blocking function on a pool or a strand, then
+ *        resuming the coroutine on its event loop with the result.
+ *
+ * The function and its result live in state shared with the job, not in
+ * the coroutine frame: the frame may be destroyed while the job runs, e.g.
+ * when a loop shuts down, and is then not resumed. The loop must outlive
+ * the jobs of the executor.
+ */
+template <typename Executor, typename Function>
+class Offload
+{
+  public:
+    using Result = std::invoke_result_t<Function&>;
+
+    Offload(Executor& executor, EventLoop& loop, Function function)
+        : executor_(executor)
+        , loop_(loop)
+        , state_(std::make_shared<State>(std::move(function)))
+    {
+    }
+
+    Offload(Offload&&) = default;
+    Offload(const Offload&) = delete;
+    Offload& operator=(const Offload&) = delete;
+
+    ~Offload()
+    {
+        if (state_)
+        {
+            // On the loop thread, like the resumption it cancels
+            state_->abandoned = true;
+        }
+    }
+
+    bool await_ready() const noexcept
+    {
+        return false;
+    }
+
+    void await_suspend(std::coroutine_handle<> handle)
+    {
+        auto job = [state = state_, &loop = loop_, handle] {
+            state->run();
+            loop.post([state, handle] {
+                if (!state->abandoned)
+                {
+                    handle.resume();
+                }
+            });
+        };
+        if constexpr (std::is_same_v<Executor, Strand>)
+        {
+            // A full strand holds the job back instead of running it here:
+            // the strand is what keeps its connection on one thread at a
+            // time. A closed one drops it, and the coroutine stays
+            // suspended like one whose loop stopped
+            executor_.enqueue(std::move(job));
+        }
+        else
+        {
+            executor_.post(std::move(job));
+        }
+    }
+
+    Result await_resume()
+    {
+        if constexpr (!std::is_void_v<Result>)
+        {
+            return std::move(*state_->result);
+        }
+    }
+
+  private:
+    struct State
+    {
+        explicit State(Function job)
+            : function(std::move(job))
+        {
+        }
+
+        Function function;
+        std::conditional_t<std::is_void_v<Result>, bool,
+            std::optional<Result>>
+            result {};
+        bool abandoned {false};
+
+        void run()
+        {
+            if constexpr (std::is_void_v<Result>)
+            {
+                function();
+            }
+            else
+            {
+                result.emplace(function());
+            }
+        }
+    };
+
+    Executor& executor_;
+    EventLoop& loop_;
+    std::shared_ptr<State> state_;
+};
+
+namespace detail
+{
+inline EventLoop& currentLoop()
+{
+    EventLoop* loop = EventLoop::current();
+    if (loop == nullptr)
+    {
+        // Nothing could resume the coroutine: a bug, not a runtime error
+        cli_tools::printError("!! core::offload() outside of an event loop");
+        std::terminate();
+    }
+    return *loop;
+}
+} // namespace detail
+
+/**
+ * @brief co_await offload(pool, [] { return blockingQuery(); }): the
+ *        function runs on the pool, the coroutine resumes on the current
+ *        loop. Use a Strand to keep calls on one connection in order.
+ *        Only from a coroutine running on an event loop. The function is
+ *        kept until the job ran: capture by value what it uses, and pass a
+ *        named lambda, GCC 12 copies lambda temporaries of a co_await
+ *        bitwise.
+ */
+template <typename Function>
+Offload<ThreadPool, Function> offload(ThreadPool& pool, Function function)
+{
+    return {pool, detail::currentLoop(), std::move(function)};
+}
+
+template <typename Function>
+Offload<Strand, Function> offload(Strand& strand, Function function)
+{
+    return {strand, detail::currentLoop(), std::move(function)};
+}
+} // namespace core
+
+#endif
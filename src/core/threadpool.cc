@@ -0,0 +1,202 @@
+#include "threadpool.h"
+
+#include <time.h>
+
+#include <algorithm>
+
+namespace core
+{
+namespace
+{
+std::int64_t threadCpuNanos()
+{
+    timespec ts;
+    ::clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts);
+    return static_cast<std::int64_t>(ts.tv_sec) * 1000000000 + ts.tv_nsec;
+}
+} // namespace
+
+ThreadPool::ThreadPool(unsigned threads)
+{
+    if (threads == 0)
+    {
+        threads = std::max(1u, std::thread::hardware_concurrency());
+    }
+    for (unsigned i = 0; i < threads; ++i)
+    {
+        workers_.emplace_back(&ThreadPool::workerLoop, this);
+    }
+}
+
+ThreadPool::~ThreadPool()
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        stopping_ = true;
+    }
+    wakeUp_.notify_all();
+    for (std::thread& worker : workers_)
+    {
+        worker.join();
+    }
+}
+
+void ThreadPool::post(Job task)
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        tasks_.push_back(std::move(task));
+    }
+    wakeUp_.notify_one();
+}
+
+std::size_t ThreadPool::size() const
+{
+    return workers_.size();
+}
+
+void ThreadPool::workerLoop()
+{
+    while (true)
+    {
+        Job task;
+        {
+            std::unique_lock<std::mutex> lock(mutex_);
+            wakeUp_.wait(lock, [this] { return stopping_ || !tasks_.empty(); });
+            if (tasks_.empty())
+            {
+                return; // stopping and nothing left to run
+            }
+            task = std::move(tasks_.front());
+            tasks_.pop_front();
+        }
+        task();
+    }
+}
+
+std::shared_ptr<Strand> Strand::create(ThreadPool& pool, std::size_t maxQueued)
+{
+    return std::shared_ptr<Strand>(new Strand(pool, maxQueued));
+}
+
+Strand::Strand(ThreadPool& pool, std::size_t maxQueued)
+    : pool_(pool)
+    , maxQueued_(maxQueued)
+{
+}
+
+bool Strand::post(Job task)
+{
+    bool schedule = false;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (closed_ || tasks_.size() >= maxQueued_)
+        {
+            ++rejected_;
+            return false;
+        }
+        schedule = pushLocked(std::move(task));
+    }
+    if (schedule)
+    {
+        pool_.post([self = shared_from_this()] { self->run(); });
+    }
+    return true;
+}
+
+bool Strand::enqueue(Job task)
+{
+    bool schedule = false;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (closed_)
+        {
+            ++rejected_;
+            return false;
+        }
+        if (tasks_.size() >= maxQueued_ || !waiting_.empty())
+        {
+            // run() moves it to the queue once a task made room
+            waiting_.push_back(std::move(task));
+            return true;
+        }
+        schedule = pushLocked(std::move(task));
+    }
+    if (schedule)
+    {
+        pool_.post([self = shared_from_this()] { self->run(); });
+    }
+    return true;
+}
+
+bool Strand::pushLocked(Job task)
+{
+    tasks_.push_back(std::move(task));
+    highWater_ = std::max(highWater_, tasks_.size());
+    if (scheduled_)
+    {
+        return false;
+    }
+    scheduled_ = true;
+    return true;
+}
+
+void Strand::close()
+{
+    std::unique_lock<std::mutex> lock(mutex_);
+    closed_ = true;
+    idle_.wait(lock, [this] { return !scheduled_; });
+}
+
+StrandStats Strand::stats() const
+{
+    StrandStats stats;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        stats.rejected = rejected_;
+        stats.queued = tasks_.size();
+        stats.waiting = waiting_.size();
+        stats.highWater = highWater_;
+    }
+    stats.executed = executed_.load(std::memory_order_relaxed);
+    stats.cpuTime = cpuTime();
+    return stats;
+}
+
+std::chrono::nanoseconds Strand::cpuTime() const
+{
+    return std::chrono::nanoseconds(cpuNanos_.load(std::memory_order_relaxed));
+}
+
+void Strand::run()
+{
+    // Run a batch then give the pool thread back, so a busy strand does not
+    // starve the others
+    for (std::size_t i = 0; i < kBatch; ++i)
+    {
+        Job task;
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            if (tasks_.empty())
+            {
+                scheduled_ = false;
+                idle_.notify_all();
+                return;
+            }
+            task = std::move(tasks_.front());
+            tasks_.pop_front();
+            if (!waiting_.empty())
+            {
+                tasks_.push_back(std::move(waiting_.front()));
+                waiting_.pop_front();
+            }
+        }
+
+        std::int64_t start = threadCpuNanos();
+        task();
+        cpuNanos_.fetch_add(threadCpuNanos() - start, std::memory_order_relaxed);
+        executed_.fetch_add(1, std::memory_order_relaxed);
+    }
+    pool_.post([self = shared_from_this()] { self->run(); });
+}
+} // namespace core
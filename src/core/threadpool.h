@@ -0,0 +1,133 @@
+#ifndef THREADPOOL_H
+#define THREADPOOL_H
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace core
+{
+using Job = std::function<void()>;
+
+/**
+ * @brief Fixed set of worker threads running posted tasks.
+ */
+class ThreadPool
+{
+  public:
+    /**
+     * @param threads Number of workers, 0 for one per core.
+     */
+    explicit ThreadPool(unsigned threads = 0);
+
+    /**
+     * @brief Runs the tasks already posted, then joins the workers.
+     */
+    ~ThreadPool();
+
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool& operator=(const ThreadPool&) = delete;
+
+    void post(Job task);
+
+    std::size_t size() const;
+
+  private:
+    std::vector<std::thread> workers_;
+    std::deque<Job> tasks_;
+    std::mutex mutex_;
+    std::condition_variable wakeUp_;
+    bool stopping_ {false};
+
+    void workerLoop();
+};
+
+/**
+ * @brief Counters of a Strand.
+ */
+struct StrandStats
+{
+    std::uint64_t executed {0};
+    std::uint64_t rejected {0}; // posted while the queue was full or closed
+    std::size_t queued {0};
+    std::size_t waiting {0}; // from enqueue(), for room in the queue
+    std::size_t highWater {0}; // deepest the queue has been
+    std::chrono::nanoseconds cpuTime {0};
+};
+
+/**
+ * @brief Serialized executor on a ThreadPool.
+ *
+ * Tasks posted to a strand run one at a time, in order, on any pool
+ * thread, so the code behind it needs no locking. The queue is bounded:
+ * post() fails instead of growing it past maxQueued, enqueue() holds the
+ * task back until there is room. CPU time is measured
+ * per task with the thread CPU clock, so blocking on I/O is not counted.
+ */
+class Strand : public std::enable_shared_from_this<Strand>
+{
+  public:
+    static std::shared_ptr<Strand> create(
+        ThreadPool& pool, std::size_t maxQueued = 1024);
+
+    /**
+     * @return false if the queue is full or the strand is closed.
+     */
+    bool post(Job task);
+
+    /**
+     * @brief Like post(), but a full queue does not lose the task: it waits
+     *        in order behind the queue and moves in as the strand drains.
+     *        For callers suspended until their task ran, so that each of
+     *        them holds back at most one.
+     * @return false if the strand is closed.
+     */
+    bool enqueue(Job task);
+
+    /**
+     * @brief Refuses new tasks and waits until the queued ones have run.
+     *        Must not be called from a task of this strand.
+     */
+    void close();
+
+    StrandStats stats() const;
+
+    /**
+     * @brief CPU time spent in the tasks so far, without locking.
+     */
+    std::chrono::nanoseconds cpuTime() const;
+
+  private:
+    Strand(ThreadPool& pool, std::size_t maxQueued);
+
+    static constexpr std::size_t kBatch = 16; // tasks per pool turn
+
+    ThreadPool& pool_;
+    std::size_t maxQueued_;
+    mutable std::mutex mutex_;
+    std::condition_variable idle_;
+    std::deque<Job> tasks_;
+    std::deque<Job> waiting_; // enqueued while tasks_ was full
+    bool scheduled_ {false};
+    bool closed_ {false};
+    std::size_t highWater_ {0};
+    std::uint64_t rejected_ {0};
+    std::atomic<std::uint64_t> executed_ {0};
+    std::atomic<std::int64_t> cpuNanos_ {0};
+
+    /// Queues with mutex_ held, true if run() must be scheduled.
+    bool pushLocked(Job task);
+
+    void run();
+};
+} // namespace core
+
+#endif
@@ -0,0 +1,275 @@
+#include "timerwheel.h"
+
+#include <algorithm>
+
+namespace core
+{
+TimerWheel::TimerWheel(std::chrono::milliseconds tick, Clock::time_point start)
+    : tick_(std::max(tick, std::chrono::milliseconds(1)))
+    , start_(start)
+{
+    heads_.fill(kNil);
+}
+
+TimerId TimerWheel::after(Clock::duration delay, Callback callback)
+{
+    return schedule(delay, 0, std::move(callback));
+}
+
+TimerId TimerWheel::every(Clock::duration interval, Callback callback)
+{
+    return schedule(
+        interval, std::max<std::uint64_t>(1, ticksFor(interval)),
+        std::move(callback));
+}
+
+bool TimerWheel::cancel(TimerId id)
+{
+    auto index = static_cast<std::uint32_t>(id);
+    auto generation = static_cast<std::uint32_t>(id >> 32);
+    if (id == 0 || index >= nodes_.size() ||
+        nodes_[index].generation != generation || nodes_[index].list == kNil)
+    {
+        return false;
+    }
+    unlink(index);
+    release(index);
+    return true;
+}
+
+std::size_t TimerWheel::advance(Clock::time_point now)
+{
+    if (now < start_)
+    {
+        return 0;
+    }
+    auto target = static_cast<std::uint64_t>((now - start_) / tick_);
+    if (size_ == 0)
+    {
+        current_ = std::max(current_, target + 1);
+        return 0;
+    }
+
+    std::size_t fired = 0;
+    while (current_ <= target)
+    {
+        std::uint32_t slot = current_ & kSlotMask;
+        if (slot == 0)
+        {
+            cascade(1);
+        }
+
+        // Detach the whole slot: callbacks may schedule into it again
+        heads_[kFiring] = heads_[slot];
+        heads_[slot] = kNil;
+        for (std::uint32_t i = heads_[kFiring]; i != kNil; i = nodes_[i].next)
+        {
+            nodes_[i].list = kFiring;
+        }
+        ++current_;
+
+        while (heads_[kFiring] != kNil)
+        {
+            std::uint32_t index = heads_[kFiring];
+            unlink(index);
+            Node& node = nodes_[index];
+            Callback callback = std::move(node.callback);
+            std::uint32_t generation = node.generation;
+
+            if (node.period != 0)
+            {
+                node.expiry = current_ - 1 + node.period;
+                place(index);
+            }
+            else
+            {
+                release(index);
+            }
+
+            callback(); // may schedule, and grow nodes_
+            ++fired;
+
+            // Periodic timers keep their callback unless cancelled meanwhile
+            if (nodes_[index].generation == generation &&
+                nodes_[index].list != kNil)
+            {
+                nodes_[index].callback = std::move(callback);
+            }
+        }
+
+        if (size_ == 0)
+        {
+            current_ = std::max(current_, target + 1);
+        }
+    }
+    return fired;
+}
+
+std::chrono::milliseconds TimerWheel::nextTimeout(Clock::time_point now) const
+{
+    if (size_ == 0)
+    {
+        return std::chrono::milliseconds(-1);
+    }
+
+    // First non empty slot of the finest wheel, or the next cascade
+    std::uint64_t due = current_ + (kSlots - (current_ & kSlotMask));
+    for (std::uint64_t tick = current_; tick < current_ + kSlots; ++tick)
+    {
+        if (tick != current_ && (tick & kSlotMask) == 0)
+        {
+            due = tick;
+            break;
+        }
+        if (heads_[tick & kSlotMask] != kNil)
+        {
+            due = tick;
+            break;
+        }
+    }
+
+    Clock::time_point at =
+        start_ + std::chrono::duration_cast<Clock::duration>(tick_ * due);
+    if (at <= now)
+    {
+        return std::chrono::milliseconds(0);
+    }
+    return std::chrono::ceil<std::chrono::milliseconds>(at - now);
+}
+
+std::size_t TimerWheel::size() const
+{
+    return size_;
+}
+
+TimerWheel::Clock::time_point TimerWheel::now() const
+{
+    return start_ +
+        std::chrono::duration_cast<Clock::duration>(tick_ * current_);
+}
+
+TimerId TimerWheel::schedule(
+    Clock::duration delay, std::uint64_t period, Callback callback)
+{
+    std::uint32_t index;
+    if (free_.empty())
+    {
+        index = static_cast<std::uint32_t>(nodes_.size());
+        nodes_.emplace_back();
+        nodes_[index].generation = 1;
+    }
+    else
+    {
+        index = free_.back();
+        free_.pop_back();
+    }
+
+    Node& node = nodes_[index];
+    node.callback = std::move(callback);
+    node.expiry = current_ + ticksFor(delay);
+    node.period = period;
+    place(index);
+    ++size_;
+    return (static_cast<TimerId>(node.generation) << 32) | index;
+}
+
+std::uint64_t TimerWheel::ticksFor(Clock::duration delay) const
+{
+    if (delay <= Clock::duration::zero())
+    {
+        return 0;
+    }
+    auto nanos = std::chrono::duration_cast<std::chrono::nanoseconds>(delay);
+    return static_cast<std::uint64_t>((nanos + tick_ - std::chrono::nanoseconds(1)) / tick_);
+}
+
+void TimerWheel::place(std::uint32_t index)
+{
+    Node& node = nodes_[index];
+    std::uint64_t expiry = std::max(node.expiry, current_);
+    std::uint64_t delta = expiry - current_;
+
+    int level = 0;
+    while (level < kLevels - 1 &&
+        delta >= (std::uint64_t(1) << (kSlotBits * (level + 1))))
+    {
+        ++level;
+    }
+    if (delta >= (std::uint64_t(1) << (kSlotBits * kLevels)))
+    {
+        // Past the last wheel: park at its end, it cascades back later
+        expiry = current_ + (std::uint64_t(1) << (kSlotBits * kLevels)) - 1;
+        node.expiry = std::max(node.expiry, expiry);
+    }
+
+    std::uint32_t slot = (expiry >> (kSlotBits * level)) & kSlotMask;
+    link(index, static_cast<std::uint32_t>(level) * kSlots + slot);
+}
+
+void TimerWheel::link(std::uint32_t index, std::uint32_t list)
+{
+    Node& node = nodes_[index];
+    node.list = list;
+    node.prev = kNil;
+    node.next = heads_[list];
+    if (node.next != kNil)
+    {
+        nodes_[node.next].prev = index;
+    }
+    heads_[list] = index;
+}
+
+void TimerWheel::unlink(std::uint32_t index)
+{
+    Node& node = nodes_[index];
+    if (node.prev != kNil)
+    {
+        nodes_[node.prev].next = node.next;
+    }
+    else
+    {
+        heads_[node.list] = node.next;
+    }
+    if (node.next != kNil)
+    {
+        nodes_[node.next].prev = node.prev;
+    }
+    node.prev = node.next = kNil;
+}
+
+void TimerWheel::release(std::uint32_t index)
+{
+    Node& node = nodes_[index];
+    node.callback = nullptr;
+    node.list = kNil;
+    ++node.generation;
+    if (node.generation == 0)
+    {
+        node.generation = 1; // keep ids non zero
+    }
+    free_.push_back(index);
+    --size_;
+}
+
+void TimerWheel::cascade(int level)
+{
+    std::uint32_t slot =
+        (current_ >> (kSlotBits * level)) & kSlotMask;
+    std::uint32_t list = static_cast<std::uint32_t>(level) * kSlots + slot;
+
+    // Move the coarser slot first when this wheel wraps too
+    if (slot == 0 && level + 1 < kLevels)
+    {
+        cascade(level + 1);
+    }
+
+    std::uint32_t index = heads_[list];
+    heads_[list] = kNil;
+    while (index != kNil)
+    {
+        std::uint32_t next = nodes_[index].next;
+        place(index);
+        index = next;
+    }
+}
+} // namespace core
@@ -0,0 +1,111 @@
+#ifndef TIMERWHEEL_H
+#define TIMERWHEEL_H
+
+#include <array>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <vector>
+
+namespace core
+{
+/**
+ * @brief Handle of a scheduled timer, 0 is never a valid one.
+ */
+using TimerId = std::uint64_t;
+
+/**
+ * @brief Hashed hierarchical timer wheel.
+ *
+ * Time is cut in ticks (10 ms by default). Four wheels of 256 slots cover
+ * 2^32 ticks: a timer goes in the slot of the finest wheel its delay fits
+ * in, and moves down a wheel each time the finer one wraps around. Timers
+ * are nodes of a pool linked in their slot, so scheduling and cancelling
+ * are O(1) whatever the number of timers, and every timer due in the same
+ * tick fires in one batch.
+ *
+ * Not thread safe, owned by an EventLoop.
+ */
+class TimerWheel
+{
+  public:
+    using Clock = std::chrono::steady_clock;
+    using Callback = std::function<void()>;
+
+    explicit TimerWheel(
+        std::chrono::milliseconds tick = std::chrono::milliseconds(10),
+        Clock::time_point start = Clock::now());
+
+    /**
+     * @brief Runs callback once, delay after now. Delays are rounded up to
+     *        the next tick.
+     */
+    TimerId after(Clock::duration delay, Callback callback);
+
+    /**
+     * @brief Runs callback every interval until cancelled.
+     */
+    TimerId every(Clock::duration interval, Callback callback);
+
+    /**
+     * @return false if the timer already fired or was cancelled.
+     */
+    bool cancel(TimerId id);
+
+    /**
+     * @brief Fires every timer due at now.
+     *
+     * @return The number of callbacks run.
+     */
+    std::size_t advance(Clock::time_point now);
+
+    /**
+     * @brief Time until advance() has something to do: exact when the next
+     *        timer is within 256 ticks, a lower bound otherwise. -1 if no
+     *        timer is scheduled.
+     */
+    std::chrono::milliseconds nextTimeout(Clock::time_point now) const;
+
+    std::size_t size() const;
+    Clock::time_point now() const;
+
+  private:
+    static constexpr int kLevels = 4;
+    static constexpr int kSlotBits = 8;
+    static constexpr std::uint32_t kSlots = 1u << kSlotBits;
+    static constexpr std::uint32_t kSlotMask = kSlots - 1;
+    static constexpr std::uint32_t kNil = static_cast<std::uint32_t>(-1);
+    static constexpr std::uint32_t kFiring = kLevels * kSlots; // list id
+
+    struct Node
+    {
+        Callback callback;
+        std::uint64_t expiry {0}; // tick
+        std::uint64_t period {0}; // ticks, 0 for one shot timers
+        std::uint32_t prev {kNil};
+        std::uint32_t next {kNil};
+        std::uint32_t list {kNil}; // slot holding the node, kNil if free
+        std::uint32_t generation {0};
+    };
+
+    std::chrono::nanoseconds tick_;
+    Clock::time_point start_;
+    std::uint64_t current_ {0}; // next tick to process
+    std::vector<Node> nodes_;
+    std::vector<std::uint32_t> free_;
+    std::array<std::uint32_t, kLevels * kSlots + 1> heads_; // + firing list
+    std::size_t size_ {0};
+
+    TimerId schedule(Clock::duration delay, std::uint64_t period,
+        Callback callback);
+    std::uint64_t ticksFor(Clock::duration delay) const;
+    void place(std::uint32_t index);
+    void link(std::uint32_t index, std::uint32_t list);
+    void unlink(std::uint32_t index);
+    void release(std::uint32_t index);
+    void cascade(int level);
+};
+} // namespace core
+
+#endif
@@ -0,0 +1,318 @@
+#include "karma.h"
+
+namespace karma
+{
+namespace
+{
+std::uint8_t codeOf(Vote vote)
+{
+    switch (vote)
+    {
+    case Vote::PLUS:
+        return 1;
+    case Vote::MINUS:
+        return 2;
+    default:
+        return 0;
+    }
+}
+
+Vote voteOfCode(std::uint8_t code)
+{
+    switch (code & 3)
+    {
+    case 1:
+        return Vote::PLUS;
+    case 2:
+        return Vote::MINUS;
+    default:
+        return Vote::NONE;
+    }
+}
+
+/// What a vote adds to the counts word
+std::uint64_t weightOf(Vote vote)
+{
+    switch (vote)
+    {
+    case Vote::PLUS:
+        return std::uint64_t {1} << 32;
+    case Vote::MINUS:
+        return 1;
+    default:
+        return 0;
+    }
+}
+} // namespace
+
+std::uint32_t Score::votes() const
+{
+    return plus + minus;
+}
+
+int Score::percent() const
+{
+    std::uint64_t total = std::uint64_t {plus} + minus;
+    if (total == 0)
+    {
+        return 0;
+    }
+    return static_cast<int>((std::uint64_t {plus} * 100 + total / 2) / total);
+}
+
+MapVotes::MapVotes(std::string uid)
+    : uid_(std::move(uid))
+{
+}
+
+MapVotes::~MapVotes()
+{
+    for (std::atomic<Slot*>& block : blocks_)
+    {
+        delete[] block.load(std::memory_order_relaxed);
+    }
+}
+
+const std::string& MapVotes::uid() const
+{
+    return uid_;
+}
+
+Vote MapVotes::vote(utils::LoginId login, Vote vote)
+{
+    Slot* slot = createSlot(login);
+    if (slot == nullptr)
+    {
+        return Vote::NONE;
+    }
+    Vote before = voteOfCode(slot->exchange(
+        static_cast<std::uint8_t>(codeOf(vote) | kChanged),
+        std::memory_order_acq_rel));
+    if (before != vote)
+    {
+        // Wraps around for a vote taken back, the counts never go below 0
+        counts_.fetch_add(
+            weightOf(vote) - weightOf(before), std::memory_order_relaxed);
+    }
+    return before;
+}
+
+Vote MapVotes::voteOf(utils::LoginId login) const
+{
+    const Slot* found = slot(login);
+    return found != nullptr
+        ? voteOfCode(found->load(std::memory_order_relaxed))
+        : Vote::NONE;
+}
+
+Score MapVotes::score() const
+{
+    std::uint64_t counts = counts_.load(std::memory_order_relaxed);
+    return Score {static_cast<std::uint32_t>(counts >> 32),
+        static_cast<std::uint32_t>(counts)};
+}
+
+void MapVotes::load(const Rows& rows)
+{
+    for (const auto& [login, vote] : rows)
+    {
+        Slot* slot = vote != Vote::NONE
+            ? createSlot(utils::logins().intern(login))
+            : nullptr;
+        std::uint8_t empty = 0;
+        if (slot != nullptr &&
+            slot->compare_exchange_strong(empty, codeOf(vote),
+                std::memory_order_acq_rel, std::memory_order_relaxed))
+        {
+            counts_.fetch_add(weightOf(vote), std::memory_order_relaxed);
+        }
+    }
+}
+
+Rows MapVotes::takeChanges()
+{
+    Rows rows;
+    for (std::size_t block = 0; block < kMaxBlocks; ++block)
+    {
+        Slot* slots = blocks_[block].load(std::memory_order_acquire);
+        if (slots == nullptr)
+        {
+            continue;
+        }
+        for (std::size_t i = 0; i < kBlockSize; ++i)
+        {
+            if ((slots[i].load(std::memory_order_relaxed) & kChanged) == 0)
+            {
+                continue;
+            }
+            std::uint8_t code = slots[i].fetch_and(
+                static_cast<std::uint8_t>(~kChanged),
+                std::memory_order_acq_rel);
+            auto login = static_cast<utils::LoginId>(block * kBlockSize + i);
+            rows.emplace_back(
+                std::string(utils::logins().name(login)), voteOfCode(code));
+        }
+    }
+    return rows;
+}
+
+MapVotes::Slot* MapVotes::slot(utils::LoginId login) const
+{
+    std::size_t block = login / kBlockSize;
+    if (login == utils::Logins::kNone || block >= kMaxBlocks)
+    {
+        return nullptr;
+    }
+    Slot* slots = blocks_[block].load(std::memory_order_acquire);
+    return slots != nullptr ? slots + login % kBlockSize : nullptr;
+}
+
+MapVotes::Slot* MapVotes::createSlot(utils::LoginId login)
+{
+    Slot* found = slot(login);
+    std::size_t block = login / kBlockSize;
+    if (found != nullptr || login == utils::Logins::kNone ||
+        block >= kMaxBlocks)
+    {
+        return found;
+    }
+
+    // Whoever publishes a block first wins, the others drop theirs
+    Slot* fresh = new Slot[kBlockSize]();
+    Slot* current = nullptr;
+    if (!blocks_[block].compare_exchange_strong(current, fresh,
+            std::memory_order_acq_rel, std::memory_order_acquire))
+    {
+        delete[] fresh;
+        return current + login % kBlockSize;
+    }
+    return fresh + login % kBlockSize;
+}
+
+Tally::Tally(Loader loader, Writer writer)
+    : loader_(std::move(loader))
+    , writer_(std::move(writer))
+{
+    if (loader_ || writer_)
+    {
+        thread_ = std::thread(&Tally::run, this);
+    }
+}
+
+Tally::~Tally()
+{
+    if (thread_.joinable())
+    {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            stopping_ = true;
+        }
+        wakeUp_.notify_one();
+        thread_.join();
+    }
+}
+
+MapVotes* Tally::open(std::string_view uid)
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto it = maps_.find(uid);
+    if (it == maps_.end())
+    {
+        std::string key(uid);
+        it = maps_.emplace(key, Entry {std::make_unique<MapVotes>(key), 0})
+                 .first;
+        if (loader_)
+        {
+            ++it->second.users;
+            jobs_.push_back(Job {it->second.votes.get(), true, {}});
+            wakeUp_.notify_one();
+        }
+    }
+    ++it->second.users;
+    return it->second.votes.get();
+}
+
+void Tally::close(MapVotes* map)
+{
+    if (map == nullptr)
+    {
+        return;
+    }
+    Rows rows;
+    if (writer_)
+    {
+        rows = map->takeChanges();
+    }
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (!rows.empty())
+    {
+        ++maps_.find(map->uid())->second.users;
+        jobs_.push_back(Job {map, false, std::move(rows)});
+        wakeUp_.notify_one();
+    }
+    releaseLocked(map);
+}
+
+void Tally::flush()
+{
+    std::unique_lock<std::mutex> lock(mutex_);
+    done_.wait(lock, [this] { return jobs_.empty() && !busy_; });
+}
+
+void Tally::releaseLocked(MapVotes* map)
+{
+    auto it = maps_.find(map->uid());
+    if (--it->second.users == 0)
+    {
+        maps_.erase(it);
+    }
+}
+
+void Tally::run()
+{
+    std::unique_lock<std::mutex> lock(mutex_);
+    while (true)
+    {
+        wakeUp_.wait(lock, [this] { return stopping_ || !jobs_.empty(); });
+        if (jobs_.empty())
+        {
+            break; // stopping, and everything queued is done
+        }
+        Job job = std::move(jobs_.front());
+        jobs_.pop_front();
+        std::vector<std::pair<std::string, Rows>> retry;
+        if (!job.load)
+        {
+            retry.swap(failed_);
+        }
+        busy_ = true;
+        lock.unlock();
+
+        if (job.load)
+        {
+            Rows rows;
+            if (loader_(job.map->uid(), rows))
+            {
+                job.map->load(rows);
+            }
+        }
+        else
+        {
+            retry.emplace_back(job.map->uid(), std::move(job.rows));
+            std::erase_if(retry, [this](const auto& batch) {
+                return writer_(batch.first, batch.second);
+            });
+        }
+
+        lock.lock();
+        for (auto& batch : retry)
+        {
+            failed_.push_back(std::move(batch));
+        }
+        releaseLocked(job.map);
+        busy_ = false;
+        done_.notify_all();
+    }
+}
+} // namespace karma
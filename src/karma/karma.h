@@ -0,0 +1,205 @@
+#ifndef KARMA_H
+#define KARMA_H
+
+#include <array>
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include "utils/logins.h"
+
+namespace karma
+{
+/**
+ * @brief A vote on a map, "++" or "--" in the chat.
+ */
+enum class Vote : std::int8_t
+{
+    MINUS = -1,
+    NONE = 0, // never voted, or took the vote back
+    PLUS = 1
+};
+
+/**
+ * @brief Votes of a map, as stored: login and vote.
+ */
+using Rows = std::vector<std::pair<std::string, Vote>>;
+
+struct Score
+{
+    std::uint32_t plus {0};
+    std::uint32_t minus {0};
+
+    std::uint32_t votes() const;
+
+    /**
+     * @brief Share of "++", rounded, 0 without any vote.
+     */
+    int percent() const;
+};
+
+/**
+ * @brief The votes of one map, updated and read without locks.
+ *
+ * Both counts are the halves of one atomic word, so a vote is a single
+ * fetch_add and score() always reads a pair that existed. The last vote of
+ * every player is one byte of a table indexed by login id, in blocks
+ * allocated on first use: a re-vote exchanges the byte and moves the
+ * counts by the difference, so voting twice the same way counts once.
+ *
+ * Opened and closed by a Tally.
+ */
+class MapVotes
+{
+  public:
+    explicit MapVotes(std::string uid);
+    ~MapVotes();
+
+    MapVotes(const MapVotes&) = delete;
+    MapVotes& operator=(const MapVotes&) = delete;
+
+    const std::string& uid() const;
+
+    /**
+     * @brief Records the vote of login, thread safe.
+     *
+     * @return Its previous vote.
+     */
+    Vote vote(utils::LoginId login, Vote vote);
+
+    Vote voteOf(utils::LoginId login) const;
+
+    Score score() const;
+
+    /**
+     * @brief Adds stored votes, except for players who voted meanwhile.
+     *        Nothing loaded is considered changed.
+     */
+    void load(const Rows& rows);
+
+    /**
+     * @brief Votes changed since the last call.
+     */
+    Rows takeChanges();
+
+  private:
+    static constexpr std::size_t kBlockSize = 65536; // players per block
+    static constexpr std::size_t kMaxBlocks = 4096;  // 2^28 logins
+    static constexpr std::uint8_t kChanged = 0x80;   // flag of a slot
+
+    using Slot = std::atomic<std::uint8_t>;
+
+    std::string uid_;
+    // "++" in the high half, "--" in the low one
+    alignas(64) std::atomic<std::uint64_t> counts_ {0};
+    std::array<std::atomic<Slot*>, kMaxBlocks> blocks_ {};
+
+    Slot* slot(utils::LoginId login) const;
+    Slot* createSlot(utils::LoginId login);
+};
+
+/**
+ * @brief The maps being voted on, with their votes loaded and written on a
+ *        thread of the tally.
+ *
+ * A shard opens its map when it starts and closes it when it ends: the
+ * votes are loaded once by the first shard to open it, and written in one
+ * batch on every close, in the order of the requests so that a write and
+ * the load of a map opened again right after do not cross. Votes
+ * themselves never go through the thread nor take a lock, see MapVotes.
+ */
+class Tally
+{
+  public:
+    /**
+     * @brief Reads the votes of a map, false if it failed.
+     */
+    using Loader = std::function<bool(const std::string& uid, Rows& rows)>;
+
+    /**
+     * @brief Persists votes of a map, false if it failed: they are tried
+     *        again with the next batch.
+     */
+    using Writer =
+        std::function<bool(const std::string& uid, const Rows& rows)>;
+
+    /**
+     * @param loader E.g. database::Manager::loadKarma(), none to start every
+     *               map without votes.
+     * @param writer E.g. database::Manager::saveKarma(), none to keep the
+     *               votes in memory only.
+     */
+    explicit Tally(Loader loader = {}, Writer writer = {});
+
+    /**
+     * @brief Writes what is still queued.
+     */
+    ~Tally();
+
+    Tally(const Tally&) = delete;
+    Tally& operator=(const Tally&) = delete;
+
+    /**
+     * @brief The votes of map uid, valid until the matching close(). They
+     *        may still be loading.
+     */
+    MapVotes* open(std::string_view uid);
+
+    /**
+     * @brief Queues the votes changed on map for writing. The map is freed
+     *        once nothing has it opened and its writes are done.
+     */
+    void close(MapVotes* map);
+
+    /**
+     * @brief Waits until what is queued is loaded and written.
+     */
+    void flush();
+
+  private:
+    struct Entry
+    {
+        std::unique_ptr<MapVotes> votes;
+        std::size_t users {0}; // open() calls and queued jobs
+    };
+
+    /// A load (no rows) or a write of one map
+    struct Job
+    {
+        MapVotes* map;
+        bool load;
+        Rows rows;
+    };
+
+    using Maps = std::map<std::string, Entry, std::less<>>;
+
+    Loader loader_;
+    Writer writer_;
+
+    std::mutex mutex_;
+    Maps maps_;
+    std::deque<Job> jobs_;
+    std::vector<std::pair<std::string, Rows>> failed_;
+    std::condition_variable wakeUp_;
+    std::condition_variable done_;
+    bool busy_ {false};
+    bool stopping_ {false};
+    std::thread thread_;
+
+    void releaseLocked(MapVotes* map);
+    void run();
+};
+} // namespace karma
+
+#endif
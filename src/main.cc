@@ -1,3 +1,4 @@
+#include <charconv>
 #include <iostream>
 #include <string>
 
@@ -24,7 +25,18 @@ int main(int argc, char const* argv[])
         else if (tmp == "--version" || tmp == "-v")
             cli_commands::planetplusVersion();
         else if (tmp == "--setup")
+        {
+            if (argIt + 1 < argc && string(argv[argIt + 1]) == "--from")
+            {
+                if (argIt + 2 >= argc)
+                {
+                    cli_tools::printError("Not enough arguments for --from");
+                    return CLI_EXIT_FAILURE;
+                }
+                return cli_commands::planetplusSetupFrom(argv[argIt + 2]);
+            }
             cli_commands::planetplusSetup();
+        }
         else if (tmp == "--test")
         {
             std::string value = "\"planetplus\"";
@@ -63,6 +75,73 @@ int main(int argc, char const* argv[])
                 argv[argIt], argv[argIt + 1], argv[argIt + 2]);
             argIt += 2;
         }
+        else if (tmp == "--config-batch")
+        {
+            // Reads stdin without a file, or with "-"
+            std::string path;
+            if (argIt + 1 < argc && argv[argIt + 1][0] != '-')
+            {
+                path = argv[++argIt];
+            }
+            else if (argIt + 1 < argc && string(argv[argIt + 1]) == "-")
+            {
+                ++argIt;
+            }
+            return cli_commands::planetplusConfigBatch(path);
+        }
+        else if (tmp == "--scan-maps")
+        {
+            if (argIt + 1 >= argc)
+            {
+                cli_tools::printError("Not enough arguments for --scan-maps");
+                return CLI_EXIT_FAILURE;
+            }
+            argIt++;
+            return cli_commands::planetplusScanMaps(argv[argIt]);
+        }
+        else if (tmp == "--import-records" || tmp == "--export-records")
+        {
+            if (argIt + 1 >= argc)
+            {
+                cli_tools::printError("Not enough arguments for " + tmp);
+                return CLI_EXIT_FAILURE;
+            }
+            argIt++;
+            return tmp == "--import-records"
+                ? cli_commands::planetplusImportRecords(argv[argIt])
+                : cli_commands::planetplusExportRecords(argv[argIt]);
+        }
+        else if (tmp == "--plugins")
+            return cli_commands::planetplusListPlugins();
+        else if (tmp == "--reload-plugin")
+        {
+            if (argIt + 1 >= argc)
+            {
+                cli_tools::printError(
+                    "Not enough arguments for --reload-plugin");
+                return CLI_EXIT_FAILURE;
+            }
+            return cli_commands::planetplusReloadPlugin(argv[argIt + 1]);
+        }
+        else if (tmp == "--run" || tmp == "--daemon")
+        {
+            int traceSeconds = 0;
+            if (argIt + 1 < argc && string(argv[argIt + 1]) == "--trace")
+            {
+                string seconds = argIt + 2 < argc ? argv[argIt + 2] : "";
+                auto [ptr, error] = std::from_chars(seconds.data(),
+                    seconds.data() + seconds.size(), traceSeconds);
+                if (error != std::errc() || traceSeconds <= 0 ||
+                    ptr != seconds.data() + seconds.size())
+                {
+                    cli_tools::printError(
+                        "--trace expects a number of seconds");
+                    return CLI_EXIT_FAILURE;
+                }
+            }
+            return cli_commands::planetplusRun(
+                traceSeconds, tmp == "--daemon");
+        }
         else
         {
             cli_tools::printError("Unknown argument: " + tmp);
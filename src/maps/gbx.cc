@@ -0,0 +1,299 @@
+#include "gbx.h"
+
+#include <cstring>
+#include <string>
+#include <vector>
+
+namespace maps
+{
+namespace gbx
+{
+namespace
+{
+/**
+ * @brief Bounds checked little endian reader over a byte range.
+ *
+ * Any read past the end sets failed() and returns zeroes, so callers only
+ * check once at the end.
+ */
+class Reader
+{
+  public:
+    Reader(const unsigned char* data, std::size_t size)
+        : data_(data)
+        , size_(size)
+    {
+    }
+
+    bool failed() const
+    {
+        return failed_;
+    }
+
+    std::size_t offset() const
+    {
+        return offset_;
+    }
+
+    void skip(std::size_t count)
+    {
+        if (count > size_ - offset_)
+        {
+            failed_ = true;
+            offset_ = size_;
+            return;
+        }
+        offset_ += count;
+    }
+
+    std::uint8_t u8()
+    {
+        if (offset_ + 1 > size_)
+        {
+            failed_ = true;
+            return 0;
+        }
+        return data_[offset_++];
+    }
+
+    std::uint16_t u16()
+    {
+        std::uint16_t value = 0;
+        copy(&value, sizeof(value));
+        return value;
+    }
+
+    std::uint32_t u32()
+    {
+        std::uint32_t value = 0;
+        copy(&value, sizeof(value));
+        return value;
+    }
+
+    std::string string()
+    {
+        std::uint32_t length = u32();
+        if (failed_ || length > size_ - offset_)
+        {
+            failed_ = true;
+            return std::string();
+        }
+        std::string value(reinterpret_cast<const char*>(data_ + offset_), length);
+        offset_ += length;
+        return value;
+    }
+
+    /**
+     * Lookback strings: identifiers that are written once then referenced by
+     * index. The state is per header chunk.
+     */
+    std::string lookback()
+    {
+        if (!lookbackVersionRead_)
+        {
+            u32(); // lookback version, 3 for every ManiaPlanet file
+            lookbackVersionRead_ = true;
+        }
+
+        std::uint32_t value = u32();
+        if (value == 0xFFFFFFFF)
+        {
+            return std::string();
+        }
+        if ((value & 0xC0000000) == 0)
+        {
+            return collectionName(value);
+        }
+
+        std::uint32_t index = value & 0x3FFFFFFF;
+        if (index == 0)
+        {
+            lookbacks_.push_back(string());
+            return lookbacks_.back();
+        }
+        if (index > lookbacks_.size())
+        {
+            failed_ = true;
+            return std::string();
+        }
+        return lookbacks_[index - 1];
+    }
+
+  private:
+    const unsigned char* data_;
+    std::size_t size_;
+    std::size_t offset_ {0};
+    bool failed_ {false};
+    bool lookbackVersionRead_ {false};
+    std::vector<std::string> lookbacks_;
+
+    void copy(void* out, std::size_t count)
+    {
+        if (count > size_ - offset_)
+        {
+            failed_ = true;
+            offset_ = size_;
+            return;
+        }
+        std::memcpy(out, data_ + offset_, count);
+        offset_ += count;
+    }
+
+    static std::string collectionName(std::uint32_t id)
+    {
+        switch (id)
+        {
+            case 6:
+            case 26:
+                return "Stadium";
+            case 11:
+                return "Valley";
+            case 12:
+                return "Canyon";
+            case 13:
+                return "Lagoon";
+            default:
+                return std::to_string(id);
+        }
+    }
+};
+
+void readTimes(Reader reader, MapInfo& info)
+{
+    std::uint8_t version = reader.u8();
+    if (version < 3)
+    {
+        reader.lookback(); // uid
+        reader.lookback(); // environment
+        reader.lookback(); // author
+        reader.string();   // name
+    }
+    reader.u32(); // unused bool
+    if (version >= 1)
+    {
+        reader.u32(); // bronze
+        reader.u32(); // silver
+        reader.u32(); // gold
+        std::uint32_t authorTime = reader.u32();
+        if (!reader.failed())
+        {
+            info.authorTime = static_cast<std::int32_t>(authorTime);
+        }
+    }
+}
+
+void readCommon(Reader reader, MapInfo& info)
+{
+    reader.u8(); // version
+    std::string uid = reader.lookback();
+    std::string environment = reader.lookback();
+    std::string author = reader.lookback();
+    std::string name = reader.string();
+    if (reader.failed())
+    {
+        return;
+    }
+    info.uid = std::move(uid);
+    info.environment = std::move(environment);
+    info.authorLogin = std::move(author);
+    info.name = std::move(name);
+}
+
+void readAuthor(Reader reader, MapInfo& info)
+{
+    reader.u32(); // version
+    reader.u32(); // author version
+    std::string login = reader.string();
+    std::string nickname = reader.string();
+    if (reader.failed())
+    {
+        return;
+    }
+    if (info.authorLogin.empty())
+    {
+        info.authorLogin = std::move(login);
+    }
+    info.authorNickname = std::move(nickname);
+}
+} // namespace
+
+bool parseMapHeader(const unsigned char* data, std::size_t size, MapInfo& info)
+{
+    Reader reader(data, size);
+
+    char magic[3] = {static_cast<char>(reader.u8()),
+        static_cast<char>(reader.u8()), static_cast<char>(reader.u8())};
+    if (reader.failed() || std::memcmp(magic, "GBX", 3) != 0)
+    {
+        return false;
+    }
+
+    std::uint16_t version = reader.u16();
+    if (version < 6)
+    {
+        return false; // pre ManiaPlanet files have no chunk table
+    }
+    reader.skip(4); // format: 'B', ref table and body compression, 'R'
+
+    if (reader.u32() != kMapClassId)
+    {
+        return false;
+    }
+
+    std::uint32_t userDataSize = reader.u32();
+    std::size_t userDataStart = reader.offset();
+    std::uint32_t chunkCount = reader.u32();
+    if (reader.failed() || chunkCount > 64)
+    {
+        return false;
+    }
+
+    struct Entry
+    {
+        std::uint32_t id;
+        std::uint32_t size;
+    };
+    Entry entries[64];
+    for (std::uint32_t i = 0; i < chunkCount; ++i)
+    {
+        entries[i].id = reader.u32();
+        entries[i].size = reader.u32() & 0x7FFFFFFF; // high bit: heavy chunk
+    }
+    if (reader.failed())
+    {
+        return false;
+    }
+
+    // Chunk data follows the table in the same order. Jump from chunk to
+    // chunk so the thumbnail pages are never touched.
+    std::size_t offset = reader.offset();
+    std::size_t userDataEnd = userDataStart + userDataSize;
+    for (std::uint32_t i = 0; i < chunkCount; ++i)
+    {
+        if (offset + entries[i].size > userDataEnd || userDataEnd > size)
+        {
+            return false;
+        }
+
+        Reader chunk(data + offset, entries[i].size);
+        switch (entries[i].id)
+        {
+            case kChunkTimes:
+                readTimes(chunk, info);
+                break;
+            case kChunkCommon:
+                readCommon(chunk, info);
+                break;
+            case kChunkAuthor:
+                readAuthor(chunk, info);
+                break;
+            default:
+                break; // thumbnail, xml header, ...
+        }
+        offset += entries[i].size;
+    }
+
+    return !info.uid.empty();
+}
+} // namespace gbx
+} // namespace maps
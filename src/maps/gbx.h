@@ -0,0 +1,52 @@
+#ifndef GBX_H
+#define GBX_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+namespace maps
+{
+/**
+ * @brief What a server manager needs to know about a map file.
+ */
+struct MapInfo
+{
+    std::string path;
+    std::string uid;
+    std::string name;
+    std::string authorLogin;
+    std::string authorNickname;
+    std::string environment;
+    std::int32_t authorTime {-1}; // milliseconds, -1 if unknown
+
+    // Used to tell whether the file changed since it was indexed
+    std::int64_t mtime {0};
+    std::uint64_t size {0};
+};
+
+namespace gbx
+{
+constexpr std::uint32_t kMapClassId = 0x03043000;
+constexpr std::uint32_t kChunkTimes = 0x03043002;
+constexpr std::uint32_t kChunkCommon = 0x03043003;
+constexpr std::uint32_t kChunkThumbnail = 0x03043007;
+constexpr std::uint32_t kChunkAuthor = 0x03043008;
+
+/**
+ * @brief Parses the header of a .Map.Gbx file.
+ *
+ * Only the header chunks holding the map identity and times are read, the
+ * thumbnail and the body are skipped, so with a memory mapped file only the
+ * first pages are ever loaded from disk.
+ *
+ * @param data Start of the file.
+ * @param size Size of the file.
+ * @param info Filled with what was found, path/mtime/size are left as is.
+ * @return true if the file is a map and its uid could be read.
+ */
+bool parseMapHeader(const unsigned char* data, std::size_t size, MapInfo& info);
+} // namespace gbx
+} // namespace maps
+
+#endif
@@ -0,0 +1,388 @@
+#include "library.h"
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <atomic>
+#include <cctype>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <thread>
+#include <utility>
+
+#include "cli/tools.h"
+
+namespace maps
+{
+namespace
+{
+constexpr char kIndexMagic[4] = {'P', 'P', 'M', 'I'};
+constexpr std::uint32_t kIndexVersion = 2;
+
+// Smallest entries of the index: empty strings, used to bound the counts
+constexpr std::uint64_t kMinMapEntry = 6 * sizeof(std::uint16_t) +
+    sizeof(std::int32_t) + sizeof(std::int64_t) + sizeof(std::uint64_t);
+constexpr std::uint64_t kMinInvalidEntry =
+    sizeof(std::uint16_t) + sizeof(std::int64_t) + sizeof(std::uint64_t);
+
+bool isMapFile(const std::filesystem::path& path)
+{
+    std::string name = path.filename().string();
+    const std::string suffix = ".map.gbx";
+    if (name.size() < suffix.size())
+    {
+        return false;
+    }
+    std::transform(name.end() - suffix.size(), name.end(),
+        name.end() - suffix.size(), [](unsigned char c) { return std::tolower(c); });
+    return name.compare(name.size() - suffix.size(), suffix.size(), suffix) == 0;
+}
+
+// Index file primitives, little endian as written by the host
+template <typename T>
+void put(std::ostream& out, T value)
+{
+    out.write(reinterpret_cast<const char*>(&value), sizeof(value));
+}
+
+void putString(std::ostream& out, const std::string& value)
+{
+    put<std::uint16_t>(out, static_cast<std::uint16_t>(value.size()));
+    out.write(value.data(), static_cast<std::streamsize>(value.size()));
+}
+
+template <typename T>
+bool get(std::istream& in, T& value)
+{
+    return static_cast<bool>(
+        in.read(reinterpret_cast<char*>(&value), sizeof(value)));
+}
+
+bool getString(std::istream& in, std::string& value)
+{
+    std::uint16_t length = 0;
+    if (!get(in, length))
+    {
+        return false;
+    }
+    value.resize(length);
+    return static_cast<bool>(in.read(value.data(), length));
+}
+
+/// A count of entries no smaller than minEntry, false if the rest of the
+/// file cannot hold that many.
+bool getCount(std::istream& in, std::uint64_t fileSize, std::uint64_t minEntry,
+    std::uint32_t& count)
+{
+    if (!get(in, count))
+    {
+        return false;
+    }
+    std::streamoff offset = in.tellg();
+    return offset >= 0 &&
+        count <= (fileSize - static_cast<std::uint64_t>(offset)) / minEntry;
+}
+} // namespace
+
+bool readMapFile(const std::string& path, MapInfo& info)
+{
+    int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0)
+    {
+        return false;
+    }
+
+    struct stat st;
+    if (::fstat(fd, &st) != 0 || st.st_size == 0)
+    {
+        ::close(fd);
+        return false;
+    }
+
+    auto size = static_cast<std::size_t>(st.st_size);
+    void* data = ::mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+    ::close(fd);
+    if (data == MAP_FAILED)
+    {
+        return false;
+    }
+
+    // Only the header is read: no read-ahead of the body
+    ::madvise(data, size, MADV_RANDOM);
+    bool parsed = gbx::parseMapHeader(
+        static_cast<const unsigned char*>(data), size, info);
+    ::munmap(data, size);
+    return parsed;
+}
+
+Library::Library(const std::string& indexPath)
+    : indexPath_(indexPath)
+{
+}
+
+bool Library::load()
+{
+    std::ifstream in(indexPath_, std::ios::binary);
+    if (!in.is_open())
+    {
+        return false;
+    }
+
+    std::error_code error;
+    std::uint64_t fileSize = std::filesystem::file_size(indexPath_, error);
+    char magic[4];
+    std::uint32_t version = 0;
+    std::uint32_t count = 0;
+    if (error || !in.read(magic, sizeof(magic)) ||
+        std::memcmp(magic, kIndexMagic, sizeof(magic)) != 0 ||
+        !get(in, version) || version != kIndexVersion ||
+        !getCount(in, fileSize, kMinMapEntry, count))
+    {
+        cli_tools::printWarning(
+            "Ignoring invalid map index: " + cli_tools::bold(indexPath_));
+        return false;
+    }
+
+    std::vector<MapInfo> maps(count);
+    for (MapInfo& info : maps)
+    {
+        if (!getString(in, info.path) || !getString(in, info.uid) ||
+            !getString(in, info.name) || !getString(in, info.authorLogin) ||
+            !getString(in, info.authorNickname) ||
+            !getString(in, info.environment) || !get(in, info.authorTime) ||
+            !get(in, info.mtime) || !get(in, info.size))
+        {
+            cli_tools::printWarning(
+                "Ignoring truncated map index: " + cli_tools::bold(indexPath_));
+            return false;
+        }
+    }
+
+    std::vector<MapInfo> invalid;
+    if (getCount(in, fileSize, kMinInvalidEntry, count))
+    {
+        invalid.resize(count);
+    }
+    else
+    {
+        in.setstate(std::ios::failbit);
+    }
+    for (MapInfo& info : invalid)
+    {
+        if (!getString(in, info.path) || !get(in, info.mtime) ||
+            !get(in, info.size))
+        {
+            break;
+        }
+    }
+    if (!in)
+    {
+        cli_tools::printWarning(
+            "Ignoring truncated map index: " + cli_tools::bold(indexPath_));
+        return false;
+    }
+
+    maps_ = std::move(maps);
+    invalid_ = std::move(invalid);
+    rebuildUidIndex();
+    return true;
+}
+
+bool Library::save() const
+{
+    std::string tmpPath = indexPath_ + ".tmp";
+    {
+        std::ofstream out(tmpPath, std::ios::binary | std::ios::trunc);
+        if (!out.is_open())
+        {
+            cli_tools::printError(
+                "Failed to open file: " + cli_tools::bold(tmpPath));
+            return false;
+        }
+
+        out.write(kIndexMagic, sizeof(kIndexMagic));
+        put<std::uint32_t>(out, kIndexVersion);
+        put<std::uint32_t>(out, static_cast<std::uint32_t>(maps_.size()));
+        for (const MapInfo& info : maps_)
+        {
+            putString(out, info.path);
+            putString(out, info.uid);
+            putString(out, info.name);
+            putString(out, info.authorLogin);
+            putString(out, info.authorNickname);
+            putString(out, info.environment);
+            put(out, info.authorTime);
+            put(out, info.mtime);
+            put(out, info.size);
+        }
+        put<std::uint32_t>(out, static_cast<std::uint32_t>(invalid_.size()));
+        for (const MapInfo& info : invalid_)
+        {
+            putString(out, info.path);
+            put(out, info.mtime);
+            put(out, info.size);
+        }
+        if (!out)
+        {
+            return false;
+        }
+    }
+    return std::rename(tmpPath.c_str(), indexPath_.c_str()) == 0;
+}
+
+ScanStats Library::scan(const std::string& directory, unsigned threads)
+{
+    auto start = std::chrono::steady_clock::now();
+    ScanStats stats;
+
+    // Invalid files are known too, so they are not parsed again either
+    std::unordered_map<std::string, std::pair<const MapInfo*, char>> known;
+    known.reserve(maps_.size() + invalid_.size());
+    for (const MapInfo& info : maps_)
+    {
+        known.emplace(info.path, std::make_pair(&info, 1));
+    }
+    for (const MapInfo& info : invalid_)
+    {
+        known.emplace(info.path, std::make_pair(&info, 0));
+    }
+
+    // Walk the tree, reuse unchanged entries, queue the others
+    std::vector<MapInfo> found;
+    std::vector<char> valid;
+    std::vector<std::size_t> toParse;
+    std::error_code error;
+    for (auto it = std::filesystem::recursive_directory_iterator(directory,
+             std::filesystem::directory_options::skip_permission_denied, error);
+         it != std::filesystem::recursive_directory_iterator();
+         it.increment(error))
+    {
+        if (error)
+        {
+            break;
+        }
+        if (!it->is_regular_file(error) || !isMapFile(it->path()))
+        {
+            continue;
+        }
+
+        struct stat st;
+        std::string path = it->path().string();
+        if (::stat(path.c_str(), &st) != 0)
+        {
+            continue;
+        }
+
+        MapInfo info;
+        info.path = path;
+        info.size = static_cast<std::uint64_t>(st.st_size);
+        info.mtime = static_cast<std::int64_t>(st.st_mtim.tv_sec) * 1000000000 +
+            st.st_mtim.tv_nsec;
+
+        auto cached = known.find(path);
+        if (cached != known.end() &&
+            cached->second.first->mtime == info.mtime &&
+            cached->second.first->size == info.size)
+        {
+            found.push_back(*cached->second.first);
+            valid.push_back(cached->second.second);
+            ++stats.reused;
+        }
+        else
+        {
+            toParse.push_back(found.size());
+            found.push_back(std::move(info));
+            valid.push_back(1);
+        }
+    }
+    if (error)
+    {
+        cli_tools::printWarning("Map scan of " + cli_tools::bold(directory) +
+            " stopped early: " + error.message());
+    }
+    stats.files = found.size();
+
+    // Parse changed files on every core, each worker claims the next file
+    std::atomic<std::size_t> next {0};
+    auto worker = [&] {
+        std::size_t i;
+        while ((i = next.fetch_add(1, std::memory_order_relaxed)) <
+            toParse.size())
+        {
+            MapInfo& info = found[toParse[i]];
+            valid[toParse[i]] = readMapFile(info.path, info) ? 1 : 0;
+        }
+    };
+
+    if (threads == 0)
+    {
+        threads = std::max(1u, std::thread::hardware_concurrency());
+    }
+    threads = static_cast<unsigned>(
+        std::min<std::size_t>(threads, std::max<std::size_t>(toParse.size(), 1)));
+    std::vector<std::thread> pool;
+    for (unsigned t = 1; t < threads; ++t)
+    {
+        pool.emplace_back(worker);
+    }
+    worker();
+    for (std::thread& thread : pool)
+    {
+        thread.join();
+    }
+
+    maps_.clear();
+    maps_.reserve(found.size());
+    invalid_.clear();
+    for (std::size_t i = 0; i < found.size(); ++i)
+    {
+        if (valid[i])
+        {
+            maps_.push_back(std::move(found[i]));
+        }
+        else
+        {
+            // Only what tells whether the file changed
+            MapInfo info;
+            info.path = std::move(found[i].path);
+            info.mtime = found[i].mtime;
+            info.size = found[i].size;
+            invalid_.push_back(std::move(info));
+            ++stats.failed;
+        }
+    }
+    stats.parsed = toParse.size();
+    rebuildUidIndex();
+
+    stats.duration = std::chrono::duration_cast<std::chrono::milliseconds>(
+        std::chrono::steady_clock::now() - start);
+    return stats;
+}
+
+const std::vector<MapInfo>& Library::maps() const
+{
+    return maps_;
+}
+
+const MapInfo* Library::findByUid(const std::string& uid) const
+{
+    auto it = byUid_.find(uid);
+    return it == byUid_.end() ? nullptr : &maps_[it->second];
+}
+
+void Library::rebuildUidIndex()
+{
+    byUid_.clear();
+    byUid_.reserve(maps_.size());
+    for (std::size_t i = 0; i < maps_.size(); ++i)
+    {
+        byUid_.emplace(maps_[i].uid, i);
+    }
+}
+} // namespace maps
@@ -0,0 +1,85 @@
+#ifndef LIBRARY_H
+#define LIBRARY_H
+
+#include <chrono>
+#include <cstddef>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "maps/gbx.h"
+
+namespace maps
+{
+/**
+ * @brief Summary of a Library::scan() run.
+ */
+struct ScanStats
+{
+    std::size_t files {0};  // map files found
+    std::size_t parsed {0}; // new or changed files that had to be parsed
+    std::size_t reused {0}; // unchanged files taken from the index
+    std::size_t failed {0}; // files that are not valid maps, parsed or not
+    std::chrono::milliseconds duration {0};
+};
+
+/**
+ * @brief Every map on disk, indexed by uid.
+ *
+ * A scan memory-maps each .Map.Gbx file and parses only its header, spread
+ * over all cores. Results are persisted to a compact index file keyed by
+ * path, mtime and size, so later scans only parse files that changed.
+ * Files that are not valid maps are kept in the index too, with no header,
+ * and are not parsed again either until they change.
+ */
+class Library
+{
+  public:
+    /**
+     * @param indexPath Where the index is persisted, e.g.
+     *                  ~/.local/share/planetplus/database/maps.idx
+     */
+    explicit Library(const std::string& indexPath);
+
+    /**
+     * @brief Loads the index file, if any.
+     *
+     * @return false if the file is missing or unreadable.
+     */
+    bool load();
+
+    /**
+     * @brief Writes the index file (atomically, through a temporary file).
+     *
+     * @return false if the file could not be written.
+     */
+    bool save() const;
+
+    /**
+     * @brief Scans directory recursively for .Map.Gbx files.
+     *
+     * @param threads Number of parsing threads, 0 for one per core.
+     */
+    ScanStats scan(const std::string& directory, unsigned threads = 0);
+
+    const std::vector<MapInfo>& maps() const;
+    const MapInfo* findByUid(const std::string& uid) const;
+
+  private:
+    std::string indexPath_;
+    std::vector<MapInfo> maps_;
+    std::vector<MapInfo> invalid_; // path, mtime and size only
+    std::unordered_map<std::string, std::size_t> byUid_;
+
+    void rebuildUidIndex();
+};
+
+/**
+ * @brief Parses the header of one map file through a read-only mapping.
+ *
+ * @return false if the file cannot be mapped or is not a valid map.
+ */
+bool readMapFile(const std::string& path, MapInfo& info);
+} // namespace maps
+
+#endif
@@ -0,0 +1,191 @@
+#include "exporter.h"
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <cerrno>
+#include <cstring>
+
+#include "cli/tools.h"
+
+namespace metrics
+{
+Exporter::Exporter(Registry& registry, core::EventLoop& loop)
+    : registry_(registry)
+    , loop_(loop)
+    , scrapes_(registry.counter(
+          "planetplus_metrics_scrapes_total", "Scrapes of the endpoint"))
+{
+}
+
+Exporter::~Exporter()
+{
+    close();
+}
+
+bool Exporter::listen(const std::string& address, std::uint16_t port)
+{
+    close();
+
+    sockaddr_in endpoint {};
+    endpoint.sin_family = AF_INET;
+    endpoint.sin_port = htons(port);
+    if (::inet_pton(AF_INET, address.c_str(), &endpoint.sin_addr) != 1)
+    {
+        cli_tools::printError(
+            "Invalid metrics address: " + cli_tools::bold(address));
+        return false;
+    }
+
+    listener_ =
+        ::socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    int reuse = 1;
+    ::setsockopt(listener_, SOL_SOCKET, SO_REUSEADDR, &reuse, sizeof(reuse));
+    socklen_t length = sizeof(endpoint);
+    if (listener_ < 0 ||
+        ::bind(listener_, reinterpret_cast<sockaddr*>(&endpoint),
+            sizeof(endpoint)) != 0 ||
+        ::listen(listener_, 16) != 0 ||
+        ::getsockname(listener_, reinterpret_cast<sockaddr*>(&endpoint),
+            &length) != 0)
+    {
+        cli_tools::printError("Failed to listen for metrics on " +
+            cli_tools::bold(address + ":" + std::to_string(port)) + ": " +
+            std::strerror(errno));
+        close();
+        return false;
+    }
+
+    port_ = ntohs(endpoint.sin_port);
+    loop_.watch(listener_, POLLIN, [this](short) { accept(); });
+    return true;
+}
+
+std::uint16_t Exporter::port() const
+{
+    return port_;
+}
+
+void Exporter::close()
+{
+    while (!connections_.empty())
+    {
+        drop(connections_.begin()->first);
+    }
+    if (listener_ >= 0)
+    {
+        loop_.unwatch(listener_);
+        ::close(listener_);
+        listener_ = -1;
+    }
+}
+
+void Exporter::accept()
+{
+    while (true)
+    {
+        int fd = ::accept4(listener_, nullptr, nullptr,
+            SOCK_NONBLOCK | SOCK_CLOEXEC);
+        if (fd < 0)
+        {
+            return;
+        }
+        connections_.emplace(fd, Connection());
+        loop_.watch(fd, POLLIN,
+            [this, fd](short revents) { onReady(fd, revents); });
+    }
+}
+
+void Exporter::onReady(int fd, short revents)
+{
+    auto it = connections_.find(fd);
+    if (it == connections_.end())
+    {
+        return;
+    }
+    Connection& connection = it->second;
+
+    if ((revents & (POLLERR | POLLHUP)) != 0 && (revents & POLLIN) == 0)
+    {
+        drop(fd);
+        return;
+    }
+
+    if (connection.output.empty())
+    {
+        char buffer[2048];
+        ssize_t received = ::recv(fd, buffer, sizeof(buffer), 0);
+        if (received <= 0)
+        {
+            if (received == 0 || (errno != EAGAIN && errno != EINTR))
+            {
+                drop(fd);
+            }
+            return;
+        }
+        connection.input.append(buffer, static_cast<std::size_t>(received));
+        if (connection.input.find("\r\n\r\n") == std::string::npos)
+        {
+            if (connection.input.size() > kMaxRequest)
+            {
+                drop(fd);
+            }
+            return;
+        }
+        respond(connection);
+        loop_.modify(fd, POLLOUT);
+    }
+
+    while (connection.written < connection.output.size())
+    {
+        ssize_t sent = ::send(fd,
+            connection.output.data() + connection.written,
+            connection.output.size() - connection.written, MSG_NOSIGNAL);
+        if (sent < 0)
+        {
+            if (errno == EAGAIN || errno == EINTR)
+            {
+                return;
+            }
+            break;
+        }
+        connection.written += static_cast<std::size_t>(sent);
+    }
+    drop(fd);
+}
+
+void Exporter::respond(Connection& connection)
+{
+    std::string body;
+    std::string status = "200 OK";
+    std::string type = "text/plain; version=0.0.4; charset=utf-8";
+
+    const std::string& request = connection.input;
+    if (request.compare(0, 13, "GET /metrics ") == 0 ||
+        request.compare(0, 13, "GET /metrics?") == 0)
+    {
+        scrapes_.add();
+        registry_.render(body);
+    }
+    else
+    {
+        status = "404 Not Found";
+        type = "text/plain";
+        body = "Metrics are served on /metrics\n";
+    }
+
+    connection.output = "HTTP/1.1 " + status + "\r\nContent-Type: " + type +
+        "\r\nContent-Length: " + std::to_string(body.size()) +
+        "\r\nConnection: close\r\n\r\n";
+    connection.output += body;
+}
+
+void Exporter::drop(int fd)
+{
+    loop_.unwatch(fd);
+    ::close(fd);
+    connections_.erase(fd);
+}
+} // namespace metrics
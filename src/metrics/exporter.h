@@ -0,0 +1,62 @@
+#ifndef METRICS_EXPORTER_H
+#define METRICS_EXPORTER_H
+
+#include <cstdint>
+#include <map>
+#include <string>
+
+#include "core/eventloop.h"
+#include "metrics/registry.h"
+
+namespace metrics
+{
+/**
+ * @brief Minimal HTTP endpoint answering GET /metrics with the registry, for
+ *        Prometheus to scrape. Runs on an event loop, one short lived
+ *        connection per scrape.
+ */
+class Exporter
+{
+  public:
+    Exporter(Registry& registry, core::EventLoop& loop);
+    ~Exporter();
+
+    Exporter(const Exporter&) = delete;
+    Exporter& operator=(const Exporter&) = delete;
+
+    /**
+     * @brief Starts listening, e.g. on 127.0.0.1:9180.
+     *
+     * @param port 0 to let the system pick one, see port().
+     */
+    bool listen(const std::string& address, std::uint16_t port);
+
+    std::uint16_t port() const;
+
+    void close();
+
+  private:
+    static constexpr std::size_t kMaxRequest = 8192;
+
+    struct Connection
+    {
+        std::string input;
+        std::string output;
+        std::size_t written {0};
+    };
+
+    Registry& registry_;
+    core::EventLoop& loop_;
+    Counter& scrapes_;
+    int listener_ {-1};
+    std::uint16_t port_ {0};
+    std::map<int, Connection> connections_;
+
+    void accept();
+    void onReady(int fd, short revents);
+    void respond(Connection& connection);
+    void drop(int fd);
+};
+} // namespace metrics
+
+#endif
@@ -0,0 +1,314 @@
+#include "registry.h"
+
+#include <bit>
+#include <cstdio>
+
+#include "cli/tools.h"
+
+namespace metrics
+{
+namespace
+{
+constexpr std::size_t kLinear = 16;     // values below are their own bucket
+constexpr std::size_t kSubBuckets = 8;  // per power of two above
+constexpr unsigned kFirstExponent = 4;  // log2(kLinear)
+constexpr double kQuantiles[] = {0.5, 0.9, 0.99, 0.999};
+
+void appendNumber(std::string& out, double value)
+{
+    char buffer[32];
+    int length = std::snprintf(buffer, sizeof(buffer), "%.9g", value);
+    out.append(buffer, static_cast<std::size_t>(length));
+}
+
+void appendEscaped(std::string& out, const std::string& text)
+{
+    for (char c : text)
+    {
+        if (c == '\\' || c == '"')
+        {
+            out += '\\';
+            out += c;
+        }
+        else if (c == '\n')
+        {
+            out += "\\n";
+        }
+        else
+        {
+            out += c;
+        }
+    }
+}
+
+std::string renderLabels(const Labels& labels)
+{
+    std::string out;
+    for (const auto& [name, value] : labels)
+    {
+        if (!out.empty())
+        {
+            out += ',';
+        }
+        out += name;
+        out += "=\"";
+        appendEscaped(out, value);
+        out += '"';
+    }
+    return out;
+}
+
+/// name{labels,extra} value
+void appendSample(std::string& out, const std::string& name,
+    const std::string& labels, const std::string& extra, double value)
+{
+    out += name;
+    if (!labels.empty() || !extra.empty())
+    {
+        out += '{';
+        out += labels;
+        if (!labels.empty() && !extra.empty())
+        {
+            out += ',';
+        }
+        out += extra;
+        out += '}';
+    }
+    out += ' ';
+    appendNumber(out, value);
+    out += '\n';
+}
+} // namespace
+
+namespace detail
+{
+std::size_t threadShard()
+{
+    static std::atomic<std::size_t> nextThread {0};
+    thread_local std::size_t shard =
+        nextThread.fetch_add(1, std::memory_order_relaxed) % kShards;
+    return shard;
+}
+} // namespace detail
+
+std::uint64_t Counter::value() const
+{
+    std::uint64_t total = 0;
+    for (const Shard& shard : shards_)
+    {
+        total += shard.value.load(std::memory_order_relaxed);
+    }
+    return total;
+}
+
+std::uint64_t HistogramSnapshot::quantile(double q) const
+{
+    if (count == 0)
+    {
+        return 0;
+    }
+    auto rank = static_cast<std::uint64_t>(q * static_cast<double>(count));
+    rank = rank >= count ? count - 1 : rank;
+
+    std::uint64_t seen = 0;
+    for (std::size_t i = 0; i < buckets.size(); ++i)
+    {
+        seen += buckets[i];
+        if (seen > rank)
+        {
+            std::uint64_t low = Histogram::lowerBound(i);
+            return low + (Histogram::upperBound(i) - low) / 2;
+        }
+    }
+    return Histogram::upperBound(buckets.size() - 1);
+}
+
+std::size_t Histogram::bucketOf(std::uint64_t value)
+{
+    if (value < kLinear)
+    {
+        return static_cast<std::size_t>(value);
+    }
+    unsigned exponent = static_cast<unsigned>(std::bit_width(value)) - 1;
+    std::size_t sub = (value >> (exponent - 3)) & (kSubBuckets - 1);
+    return kLinear + (exponent - kFirstExponent) * kSubBuckets + sub;
+}
+
+std::uint64_t Histogram::lowerBound(std::size_t bucket)
+{
+    if (bucket < kLinear)
+    {
+        return bucket;
+    }
+    std::size_t exponent = (bucket - kLinear) / kSubBuckets + kFirstExponent;
+    std::uint64_t sub = (bucket - kLinear) % kSubBuckets;
+    return (kSubBuckets + sub) << (exponent - 3);
+}
+
+std::uint64_t Histogram::upperBound(std::size_t bucket)
+{
+    if (bucket < kLinear)
+    {
+        return bucket;
+    }
+    std::size_t exponent = (bucket - kLinear) / kSubBuckets + kFirstExponent;
+    return lowerBound(bucket) + ((std::uint64_t(1) << (exponent - 3)) - 1);
+}
+
+void Histogram::record(std::uint64_t value)
+{
+    Shard& shard = shards_[detail::threadShard()];
+    shard.buckets[bucketOf(value)].fetch_add(1, std::memory_order_relaxed);
+    shard.sum.fetch_add(value, std::memory_order_relaxed);
+}
+
+HistogramSnapshot Histogram::snapshot() const
+{
+    HistogramSnapshot snapshot;
+    snapshot.buckets.assign(kBuckets, 0);
+    for (const Shard& shard : shards_)
+    {
+        snapshot.sum += shard.sum.load(std::memory_order_relaxed);
+        for (std::size_t i = 0; i < kBuckets; ++i)
+        {
+            std::uint64_t count =
+                shard.buckets[i].load(std::memory_order_relaxed);
+            snapshot.buckets[i] += count;
+            snapshot.count += count;
+        }
+    }
+    return snapshot;
+}
+
+Counter& Registry::counter(
+    const std::string& name, const std::string& help, const Labels& labels)
+{
+    return *find(name, help, labels, Type::COUNTER, 1.0).counter;
+}
+
+Gauge& Registry::gauge(
+    const std::string& name, const std::string& help, const Labels& labels)
+{
+    return *find(name, help, labels, Type::GAUGE, 1.0).gauge;
+}
+
+Histogram& Registry::histogram(const std::string& name,
+    const std::string& help, const Labels& labels, double scale)
+{
+    return *find(name, help, labels, Type::SUMMARY, scale).histogram;
+}
+
+Registry::Series& Registry::find(const std::string& name,
+    const std::string& help, const Labels& labels, Type type, double scale)
+{
+    std::string rendered = renderLabels(labels);
+    std::lock_guard<std::mutex> lock(mutex_);
+
+    auto [it, created] = families_.try_emplace(name);
+    Family& family = it->second;
+    if (created)
+    {
+        family.help = help;
+        family.type = type;
+        family.scale = scale;
+    }
+
+    std::vector<Series>* series = &family.series;
+    if (family.type != type)
+    {
+        cli_tools::printWarning("Metric " + cli_tools::bold(name) +
+            " registered twice with different types, the second one is not "
+            "exported.");
+        series = &orphans_;
+    }
+    else
+    {
+        for (Series& existing : family.series)
+        {
+            if (existing.labels == rendered)
+            {
+                return existing;
+            }
+        }
+    }
+
+    Series& added = series->emplace_back();
+    added.labels = std::move(rendered);
+    switch (type)
+    {
+        case Type::COUNTER:
+            added.counter = std::make_unique<Counter>();
+            break;
+        case Type::GAUGE:
+            added.gauge = std::make_unique<Gauge>();
+            break;
+        case Type::SUMMARY:
+            added.histogram = std::make_unique<Histogram>();
+            break;
+    }
+    return added;
+}
+
+void Registry::render(std::string& out) const
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    for (const auto& [name, family] : families_)
+    {
+        out += "# HELP ";
+        out += name;
+        out += ' ';
+        out += family.help;
+        out += "\n# TYPE ";
+        out += name;
+        switch (family.type)
+        {
+            case Type::COUNTER:
+                out += " counter\n";
+                break;
+            case Type::GAUGE:
+                out += " gauge\n";
+                break;
+            case Type::SUMMARY:
+                out += " summary\n";
+                break;
+        }
+
+        for (const Series& series : family.series)
+        {
+            if (series.counter)
+            {
+                appendSample(out, name, series.labels, "",
+                    static_cast<double>(series.counter->value()));
+            }
+            else if (series.gauge)
+            {
+                appendSample(out, name, series.labels, "",
+                    static_cast<double>(series.gauge->value()));
+            }
+            else if (series.histogram)
+            {
+                HistogramSnapshot snapshot = series.histogram->snapshot();
+                for (double q : kQuantiles)
+                {
+                    std::string quantile = "quantile=\"";
+                    appendNumber(quantile, q);
+                    quantile += '"';
+                    appendSample(out, name, series.labels, quantile,
+                        static_cast<double>(snapshot.quantile(q)) *
+                            family.scale);
+                }
+                appendSample(out, name + "_sum", series.labels, "",
+                    static_cast<double>(snapshot.sum) * family.scale);
+                appendSample(out, name + "_count", series.labels, "",
+                    static_cast<double>(snapshot.count));
+            }
+        }
+    }
+}
+
+Registry& global()
+{
+    static Registry registry;
+    return registry;
+}
+} // namespace metrics
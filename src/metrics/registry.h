@@ -0,0 +1,209 @@
+#ifndef METRICS_REGISTRY_H
+#define METRICS_REGISTRY_H
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace metrics
+{
+using Labels = std::vector<std::pair<std::string, std::string>>;
+
+namespace detail
+{
+constexpr std::size_t kShards = 8;
+
+/**
+ * @brief Shard of the calling thread. Threads are spread round robin, so
+ *        as long as there are fewer busy threads than shards no two of them
+ *        write the same cache line.
+ */
+std::size_t threadShard();
+} // namespace detail
+
+/**
+ * @brief Monotonic counter, cheap to increment from any thread.
+ */
+class Counter
+{
+  public:
+    void add(std::uint64_t amount = 1)
+    {
+        shards_[detail::threadShard()].value.fetch_add(
+            amount, std::memory_order_relaxed);
+    }
+
+    std::uint64_t value() const;
+
+  private:
+    struct alignas(64) Shard
+    {
+        std::atomic<std::uint64_t> value {0};
+    };
+
+    std::array<Shard, detail::kShards> shards_;
+};
+
+/**
+ * @brief Value that goes up and down, e.g. a queue depth.
+ */
+class Gauge
+{
+  public:
+    void set(std::int64_t value)
+    {
+        value_.store(value, std::memory_order_relaxed);
+    }
+
+    void add(std::int64_t amount)
+    {
+        value_.fetch_add(amount, std::memory_order_relaxed);
+    }
+
+    std::int64_t value() const
+    {
+        return value_.load(std::memory_order_relaxed);
+    }
+
+  private:
+    std::atomic<std::int64_t> value_ {0};
+};
+
+/**
+ * @brief Merged view of a Histogram.
+ */
+struct HistogramSnapshot
+{
+    std::uint64_t count {0};
+    std::uint64_t sum {0};
+    std::vector<std::uint64_t> buckets;
+
+    /**
+     * @brief Value below which a fraction q of the samples fall, within the
+     *        12.5% precision of the buckets.
+     */
+    std::uint64_t quantile(double q) const;
+};
+
+/**
+ * @brief Distribution of integer samples, e.g. latencies in microseconds.
+ *
+ * HDR style buckets: exact below 16, then every power of two is split in 8
+ * linear sub-buckets, so any value is known within 12.5% with a fixed 496
+ * buckets up to 2^64. Recording is one relaxed increment on the shard of
+ * the calling thread.
+ */
+class Histogram
+{
+  public:
+    static constexpr std::size_t kBuckets = 496;
+
+    void record(std::uint64_t value);
+
+    /**
+     * @brief Records the time elapsed since start, in microseconds.
+     */
+    void recordSince(std::chrono::steady_clock::time_point start)
+    {
+        auto elapsed = std::chrono::steady_clock::now() - start;
+        record(static_cast<std::uint64_t>(
+            std::chrono::duration_cast<std::chrono::microseconds>(elapsed)
+                .count()));
+    }
+
+    HistogramSnapshot snapshot() const;
+
+    static std::size_t bucketOf(std::uint64_t value);
+    static std::uint64_t lowerBound(std::size_t bucket);
+    static std::uint64_t upperBound(std::size_t bucket);
+
+  private:
+    struct alignas(64) Shard
+    {
+        std::atomic<std::uint64_t> sum {0};
+        std::array<std::atomic<std::uint64_t>, kBuckets> buckets {};
+    };
+
+    std::array<Shard, detail::kShards> shards_;
+};
+
+/**
+ * @brief Every metric of the process, rendered in the Prometheus text
+ *        exposition format.
+ *
+ * Registering is done once, under a lock; the returned reference stays
+ * valid as long as the registry and is what hot paths keep. Asking twice
+ * for the same name and labels gives the same metric.
+ *
+ *     static metrics::Counter& queries = metrics::global().counter(
+ *         "planetplus_db_queries_total", "Queries sent to the database");
+ *     queries.add();
+ */
+class Registry
+{
+  public:
+    Counter& counter(const std::string& name, const std::string& help,
+        const Labels& labels = {});
+    Gauge& gauge(const std::string& name, const std::string& help,
+        const Labels& labels = {});
+
+    /**
+     * @param scale Factor applied to the samples on export, e.g. 1e-6 for
+     *              microseconds exported as seconds.
+     */
+    Histogram& histogram(const std::string& name, const std::string& help,
+        const Labels& labels = {}, double scale = 1.0);
+
+    /**
+     * @brief Appends every metric in the Prometheus text format, histograms
+     *        as summaries (quantiles, sum and count).
+     */
+    void render(std::string& out) const;
+
+  private:
+    enum class Type
+    {
+        COUNTER,
+        GAUGE,
+        SUMMARY
+    };
+
+    struct Series
+    {
+        std::string labels; // rendered, e.g. shard="lobby"
+        std::unique_ptr<Counter> counter;
+        std::unique_ptr<Gauge> gauge;
+        std::unique_ptr<Histogram> histogram;
+    };
+
+    struct Family
+    {
+        std::string help;
+        Type type;
+        double scale {1.0};
+        std::vector<Series> series;
+    };
+
+    mutable std::mutex mutex_;
+    std::map<std::string, Family> families_;
+    std::vector<Series> orphans_; // registered with a conflicting type
+
+    Series& find(const std::string& name, const std::string& help,
+        const Labels& labels, Type type, double scale);
+};
+
+/**
+ * @brief The registry of the process, served by --run.
+ */
+Registry& global();
+} // namespace metrics
+
+#endif
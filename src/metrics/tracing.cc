@@ -0,0 +1,237 @@
+#include "tracing.h"
+
+#include <unistd.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <fstream>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+#include "cli/tools.h"
+
+namespace tracing
+{
+namespace
+{
+constexpr std::size_t kMaxSpans = 1 << 16; // per thread and capture
+
+struct Event
+{
+    const char* name;
+    std::string detail;
+    std::uint64_t start;
+    std::uint64_t end;
+};
+
+struct ThreadBuffer
+{
+    std::mutex mutex; // only contended by start() and stop()
+    std::string name;
+    std::uint32_t id {0};
+    std::vector<Event> events;
+    std::size_t dropped {0};
+};
+
+struct Threads
+{
+    std::mutex mutex;
+    std::vector<std::shared_ptr<ThreadBuffer>> buffers;
+    std::uint32_t nextId {1};
+    std::uint64_t since {0}; // start of the running capture
+};
+
+Threads& threads()
+{
+    static Threads instance;
+    return instance;
+}
+
+ThreadBuffer& localBuffer()
+{
+    // Shared with the list so the spans of a thread outlive it until stop()
+    thread_local std::shared_ptr<ThreadBuffer> buffer = [] {
+        auto created = std::make_shared<ThreadBuffer>();
+        Threads& all = threads();
+        std::lock_guard<std::mutex> lock(all.mutex);
+        created->id = all.nextId++;
+        created->name = "thread " + std::to_string(created->id);
+        all.buffers.push_back(created);
+        return created;
+    }();
+    return *buffer;
+}
+
+void appendEscaped(std::string& out, std::string_view text)
+{
+    for (char c : text)
+    {
+        if (c == '"' || c == '\\')
+        {
+            out += '\\';
+            out += c;
+        }
+        else if (static_cast<unsigned char>(c) < 0x20)
+        {
+            char escaped[8];
+            std::snprintf(escaped, sizeof(escaped), "\\u%04x", c);
+            out += escaped;
+        }
+        else
+        {
+            out += c;
+        }
+    }
+}
+
+/// Nanoseconds as the microseconds of the trace format.
+void appendMicroseconds(std::string& out, std::uint64_t nanoseconds)
+{
+    char buffer[32];
+    int length = std::snprintf(buffer, sizeof(buffer), "%llu.%03llu",
+        static_cast<unsigned long long>(nanoseconds / 1000),
+        static_cast<unsigned long long>(nanoseconds % 1000));
+    out.append(buffer, static_cast<std::size_t>(length));
+}
+} // namespace
+
+namespace detail
+{
+std::atomic<bool> capturing {false};
+
+std::uint64_t now()
+{
+    auto elapsed = std::chrono::steady_clock::now().time_since_epoch();
+    return static_cast<std::uint64_t>(
+               std::chrono::duration_cast<std::chrono::nanoseconds>(elapsed)
+                   .count()) |
+        1;
+}
+
+void record(const char* name, std::string_view detail, std::uint64_t start,
+    std::uint64_t end)
+{
+    if (!enabled())
+    {
+        return; // stopped while the span was open
+    }
+    ThreadBuffer& buffer = localBuffer();
+    std::lock_guard<std::mutex> lock(buffer.mutex);
+    if (buffer.events.size() >= kMaxSpans)
+    {
+        ++buffer.dropped;
+        return;
+    }
+    buffer.events.push_back({name, std::string(detail), start, end});
+}
+} // namespace detail
+
+void setThreadName(const std::string& name)
+{
+    ThreadBuffer& buffer = localBuffer();
+    std::lock_guard<std::mutex> lock(buffer.mutex);
+    buffer.name = name;
+}
+
+bool start()
+{
+    Threads& all = threads();
+    std::lock_guard<std::mutex> lock(all.mutex);
+    if (enabled())
+    {
+        return false;
+    }
+
+    // Threads that exited since the last capture are only held here
+    std::erase_if(all.buffers,
+        [](const std::shared_ptr<ThreadBuffer>& buffer) {
+            return buffer.use_count() == 1;
+        });
+    for (const auto& buffer : all.buffers)
+    {
+        std::lock_guard<std::mutex> bufferLock(buffer->mutex);
+        buffer->events.clear();
+        buffer->dropped = 0;
+    }
+    all.since = detail::now();
+    detail::capturing.store(true, std::memory_order_relaxed);
+    return true;
+}
+
+std::optional<Summary> stop(const std::string& path)
+{
+    Threads& all = threads();
+    std::unique_lock<std::mutex> lock(all.mutex);
+    if (!enabled())
+    {
+        return std::nullopt;
+    }
+    detail::capturing.store(false, std::memory_order_relaxed);
+
+    struct Collected
+    {
+        std::uint32_t id;
+        std::string name;
+        std::vector<Event> events;
+    };
+    std::vector<Collected> collected;
+    Summary summary;
+    for (const auto& buffer : all.buffers)
+    {
+        std::lock_guard<std::mutex> bufferLock(buffer->mutex);
+        summary.spans += buffer->events.size();
+        summary.dropped += buffer->dropped;
+        collected.push_back(
+            {buffer->id, buffer->name, std::move(buffer->events)});
+        buffer->events.clear();
+    }
+    std::uint64_t since = all.since;
+    lock.unlock();
+
+    std::string pid = std::to_string(::getpid());
+    std::string out = "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[";
+    out += "{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":" + pid +
+        ",\"args\":{\"name\":\"planetplus\"}}";
+    for (const Collected& thread : collected)
+    {
+        std::string tid = std::to_string(thread.id);
+        out += ",\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":" + pid +
+            ",\"tid\":" + tid + ",\"args\":{\"name\":\"";
+        appendEscaped(out, thread.name);
+        out += "\"}}";
+
+        for (const Event& event : thread.events)
+        {
+            // Spans opened before the capture are cut at its start
+            std::uint64_t begin = std::max(event.start, since);
+            out += ",\n{\"name\":\"";
+            appendEscaped(out, event.name);
+            out += "\",\"cat\":\"planetplus\",\"ph\":\"X\",\"ts\":";
+            appendMicroseconds(out, begin - since);
+            out += ",\"dur\":";
+            appendMicroseconds(out, event.end - std::min(event.end, begin));
+            out += ",\"pid\":" + pid + ",\"tid\":" + tid;
+            if (!event.detail.empty())
+            {
+                out += ",\"args\":{\"detail\":\"";
+                appendEscaped(out, event.detail);
+                out += "\"}";
+            }
+            out += '}';
+        }
+    }
+    out += "]}\n";
+
+    std::ofstream file(path, std::ios::binary | std::ios::trunc);
+    if (!file || !file.write(out.data(), static_cast<std::streamsize>(
+                                               out.size())))
+    {
+        cli_tools::printError(
+            "Failed to write the trace to " + cli_tools::bold(path));
+        return std::nullopt;
+    }
+    return summary;
+}
+} // namespace tracing
@@ -0,0 +1,95 @@
+#ifndef METRICS_TRACING_H
+#define METRICS_TRACING_H
+
+#include <atomic>
+#include <cstdint>
+#include <optional>
+#include <string>
+#include <string_view>
+
+namespace tracing
+{
+namespace detail
+{
+extern std::atomic<bool> capturing;
+
+/// Nanoseconds on the steady clock, never 0.
+std::uint64_t now();
+
+void record(const char* name, std::string_view detail, std::uint64_t start,
+    std::uint64_t end);
+} // namespace detail
+
+/**
+ * @brief Whether a capture is running. One relaxed load, the whole cost of
+ *        a Span outside of captures.
+ */
+inline bool enabled()
+{
+    return detail::capturing.load(std::memory_order_relaxed);
+}
+
+/**
+ * @brief Times the enclosing scope while a capture runs.
+ *
+ * Spans go to a buffer of the calling thread, nothing is shared until the
+ * capture stops. The name must be a string literal; the detail, e.g. the
+ * callback method, is only copied when captured.
+ *
+ *     tracing::Span span("callback", method);
+ */
+class Span
+{
+  public:
+    explicit Span(const char* name, std::string_view detail = {})
+        : name_(name)
+        , detail_(detail)
+        , start_(enabled() ? detail::now() : 0)
+    {
+    }
+
+    ~Span()
+    {
+        if (start_ != 0)
+        {
+            detail::record(name_, detail_, start_, detail::now());
+        }
+    }
+
+    Span(const Span&) = delete;
+    Span& operator=(const Span&) = delete;
+
+  private:
+    const char* name_;
+    std::string_view detail_;
+    std::uint64_t start_;
+};
+
+/**
+ * @brief Names the calling thread in the exported traces.
+ */
+void setThreadName(const std::string& name);
+
+/**
+ * @brief Starts a capture, dropping whatever a previous one left.
+ *
+ * @return false if a capture is already running.
+ */
+bool start();
+
+struct Summary
+{
+    std::size_t spans {0};
+    std::size_t dropped {0}; // past the per thread limit
+};
+
+/**
+ * @brief Stops the capture and writes its spans in the Chrome trace event
+ *        format, to open in Perfetto or chrome://tracing.
+ *
+ * @return Nothing if no capture was running or the file cannot be written.
+ */
+std::optional<Summary> stop(const std::string& path);
+} // namespace tracing
+
+#endif
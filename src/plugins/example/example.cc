@@ -0,0 +1,65 @@
+// Example plugin: greets players and counts chat lines.
+//
+// Build with `cmake --build . --target planetplus-example-plugin` and copy
+// example.so to ~/.local/share/planetplus/plugins/
+
+#include <cstdint>
+#include <string>
+
+#include "plugins/plugin.h"
+
+namespace
+{
+struct State
+{
+    const pp_host* host;
+    std::uint64_t chatLines {0};
+};
+
+void* load(const pp_host* host)
+{
+    host->log(host->context, PP_LOG_INFO, "example plugin ready");
+    return new State {host};
+}
+
+void unload(void* state)
+{
+    auto* example = static_cast<State*>(state);
+    std::string message =
+        "saw " + std::to_string(example->chatLines) + " chat lines";
+    example->host->log(example->host->context, PP_LOG_INFO, message.c_str());
+    delete example;
+}
+
+void onEvent(void* state, const pp_event* event)
+{
+    auto* example = static_cast<State*>(state);
+    switch (event->type)
+    {
+        case PP_EVENT_PLAYER_CONNECT:
+        {
+            std::string message = std::string("Welcome ") + event->login + "!";
+            example->host->send_chat(
+                example->host->context, event->login, message.c_str());
+            break;
+        }
+        case PP_EVENT_CHAT:
+            ++example->chatLines;
+            break;
+        default:
+            break;
+    }
+}
+
+const pp_plugin kPlugin = {PLANETPLUS_PLUGIN_ABI_VERSION, "example", "1.0.0",
+    &load, &unload, &onEvent};
+} // namespace
+
+extern "C" const pp_plugin* planetplus_plugin()
+{
+    return &kPlugin;
+}
+
+// Read by --plugins without loading the library
+extern "C" const pp_plugin_info planetplus_plugin_info = {
+    PLANETPLUS_PLUGIN_ABI_VERSION, "example", "1.0.0"};
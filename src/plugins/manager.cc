@@ -0,0 +1,449 @@
+#include "manager.h"
+
+#include <dlfcn.h>
+#include <elf.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <charconv>
+#include <cstring>
+#include <filesystem>
+
+#include "cli/tools.h"
+
+namespace plugins
+{
+namespace
+{
+void readSetting(config::Config& config, const std::string& key,
+    std::int64_t& value)
+{
+    if (!config.has("plugins", key))
+    {
+        return;
+    }
+
+    std::string text = config.get("plugins", key);
+    std::int64_t parsed = 0;
+    auto [ptr, error] =
+        std::from_chars(text.data(), text.data() + text.size(), parsed);
+    if (error != std::errc() || ptr != text.data() + text.size() || parsed <= 0)
+    {
+        cli_tools::printWarning("Invalid plugin setting " +
+            cli_tools::bold(key) + ", using the default.");
+        return;
+    }
+    value = parsed;
+}
+} // namespace
+
+std::vector<std::string> pluginFiles(const std::string& directory)
+{
+    std::error_code error;
+    std::vector<std::string> paths;
+    for (const auto& entry :
+        std::filesystem::directory_iterator(directory, error))
+    {
+        if (entry.is_regular_file(error) && entry.path().extension() == ".so")
+        {
+            paths.push_back(entry.path().string());
+        }
+    }
+    std::sort(paths.begin(), paths.end());
+    return paths;
+}
+
+std::optional<Info> inspect(const std::string& path)
+{
+    int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0)
+    {
+        return std::nullopt;
+    }
+    struct stat status;
+    if (::fstat(fd, &status) != 0 ||
+        static_cast<std::size_t>(status.st_size) < sizeof(Elf64_Ehdr))
+    {
+        ::close(fd);
+        return std::nullopt;
+    }
+    auto size = static_cast<std::size_t>(status.st_size);
+    void* mapped = ::mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+    ::close(fd);
+    if (mapped == MAP_FAILED)
+    {
+        return std::nullopt;
+    }
+    const auto* data = static_cast<const unsigned char*>(mapped);
+
+    // Every offset and count comes from the file: checked before use
+    auto fits = [size](std::uint64_t offset, std::uint64_t length) {
+        return offset <= size && length <= size - offset;
+    };
+    auto section = [data](const Elf64_Ehdr& header, std::size_t index) {
+        Elf64_Shdr entry;
+        std::memcpy(&entry, data + header.e_shoff + index * sizeof(entry),
+            sizeof(entry));
+        return entry;
+    };
+
+    std::optional<Info> info;
+    Elf64_Ehdr header;
+    std::memcpy(&header, data, sizeof(header));
+    bool valid = std::memcmp(header.e_ident, ELFMAG, SELFMAG) == 0 &&
+        header.e_ident[EI_CLASS] == ELFCLASS64 &&
+        header.e_shentsize == sizeof(Elf64_Shdr) &&
+        fits(header.e_shoff,
+            static_cast<std::uint64_t>(header.e_shnum) * sizeof(Elf64_Shdr));
+    for (std::size_t i = 0; valid && !info && i < header.e_shnum; ++i)
+    {
+        Elf64_Shdr symbols = section(header, i);
+        if (symbols.sh_type != SHT_DYNSYM ||
+            symbols.sh_entsize != sizeof(Elf64_Sym) ||
+            !fits(symbols.sh_offset, symbols.sh_size) ||
+            symbols.sh_link >= header.e_shnum)
+        {
+            continue;
+        }
+        Elf64_Shdr names = section(header, symbols.sh_link);
+        if (!fits(names.sh_offset, names.sh_size))
+        {
+            continue;
+        }
+
+        std::string_view table(
+            reinterpret_cast<const char*>(data + names.sh_offset),
+            names.sh_size);
+        for (std::uint64_t offset = 0;
+             offset + sizeof(Elf64_Sym) <= symbols.sh_size;
+             offset += sizeof(Elf64_Sym))
+        {
+            Elf64_Sym symbol;
+            std::memcpy(&symbol, data + symbols.sh_offset + offset,
+                sizeof(symbol));
+            if (symbol.st_name >= table.size())
+            {
+                continue;
+            }
+            std::string_view name = table.substr(symbol.st_name);
+            name = name.substr(0, name.find('\0'));
+            if (name != PLANETPLUS_PLUGIN_INFO)
+            {
+                continue;
+            }
+
+            // From its address in its section to its place in the file
+            Elf64_Shdr holder = symbol.st_shndx < header.e_shnum
+                ? section(header, symbol.st_shndx)
+                : Elf64_Shdr {};
+            std::uint64_t inSection = symbol.st_value - holder.sh_addr;
+            if (symbol.st_shndx == SHN_UNDEF ||
+                symbol.st_shndx >= header.e_shnum ||
+                holder.sh_type == SHT_NOBITS ||
+                symbol.st_size < sizeof(pp_plugin_info) ||
+                symbol.st_value < holder.sh_addr ||
+                !fits(holder.sh_offset, holder.sh_size) ||
+                !fits(inSection, sizeof(pp_plugin_info)) ||
+                inSection + sizeof(pp_plugin_info) > holder.sh_size)
+            {
+                break;
+            }
+            pp_plugin_info raw;
+            std::memcpy(
+                &raw, data + holder.sh_offset + inSection, sizeof(raw));
+            if (raw.abi_version == PLANETPLUS_PLUGIN_ABI_VERSION)
+            {
+                // Not trusted to be terminated
+                std::size_t nameLength = ::strnlen(raw.name, sizeof(raw.name));
+                std::size_t versionLength =
+                    ::strnlen(raw.version, sizeof(raw.version));
+                info = Info {std::string(raw.name, nameLength),
+                    std::string(raw.version, versionLength), path};
+            }
+            break;
+        }
+    }
+
+    ::munmap(mapped, size);
+    return info;
+}
+
+Limits Limits::fromConfig(config::Config& config)
+{
+    Limits limits;
+    auto maxQueued = static_cast<std::int64_t>(limits.maxQueued);
+    std::int64_t cpuBudget = limits.cpuBudget.count();
+    readSetting(config, "queue_depth", maxQueued);
+    readSetting(config, "cpu_budget", cpuBudget);
+    limits.maxQueued = static_cast<std::size_t>(maxQueued);
+    limits.cpuBudget = std::chrono::milliseconds(cpuBudget);
+    return limits;
+}
+
+Manager::Manager(const std::string& directory, core::ThreadPool& pool,
+    const Limits& limits)
+    : directory_(directory)
+    , pool_(pool)
+    , limits_(limits)
+{
+}
+
+Manager::~Manager()
+{
+    for (std::unique_ptr<Plugin>& plugin : plugins_)
+    {
+        close(*plugin);
+    }
+}
+
+std::size_t Manager::loadAll()
+{
+    std::size_t loaded = 0;
+    for (const std::string& path : pluginFiles(directory_))
+    {
+        loaded += load(path) ? 1 : 0;
+    }
+    return loaded;
+}
+
+bool Manager::load(const std::string& path)
+{
+    void* handle = ::dlopen(path.c_str(), RTLD_NOW | RTLD_LOCAL);
+    if (handle == nullptr)
+    {
+        cli_tools::printError(
+            "Failed to load plugin " + cli_tools::bold(path) + ": " + ::dlerror());
+        return false;
+    }
+
+    auto entry = reinterpret_cast<pp_plugin_entry>(
+        ::dlsym(handle, PLANETPLUS_PLUGIN_ENTRY));
+    const pp_plugin* api = entry != nullptr ? entry() : nullptr;
+    if (api == nullptr || api->abi_version != PLANETPLUS_PLUGIN_ABI_VERSION ||
+        api->name == nullptr || api->load == nullptr)
+    {
+        cli_tools::printError("Not a planetplus plugin, or built for another "
+                              "version: " +
+            cli_tools::bold(path));
+        ::dlclose(handle);
+        return false;
+    }
+
+    std::string name = api->name;
+    bool duplicate = std::any_of(plugins_.begin(), plugins_.end(),
+        [&name](const std::unique_ptr<Plugin>& plugin) {
+            return plugin->name == name;
+        });
+    if (duplicate)
+    {
+        cli_tools::printError(
+            "A plugin named " + cli_tools::bold(name) + " is already loaded");
+        ::dlclose(handle);
+        return false;
+    }
+
+    auto plugin = std::make_unique<Plugin>();
+    plugin->manager = this;
+    plugin->path = path;
+    plugin->name = name;
+    plugin->handle = handle;
+    plugin->api = api;
+    plugin->host = {PLANETPLUS_PLUGIN_ABI_VERSION, plugin.get(), &hostLog,
+        &hostSendChat};
+    plugin->strand = core::Strand::create(pool_, limits_.maxQueued);
+    plugin->windowStart = std::chrono::steady_clock::now();
+
+    // Loading runs on the strand too: events dispatched meanwhile are queued
+    // behind it
+    Plugin* raw = plugin.get();
+    plugin->strand->post([raw] {
+        void* state = raw->api->load(&raw->host);
+        if (state == nullptr)
+        {
+            cli_tools::printError(
+                "Plugin " + cli_tools::bold(raw->name) + " failed to load");
+        }
+        raw->state.store(state, std::memory_order_release);
+    });
+
+    cli_tools::printSuccess("Loaded plugin " + cli_tools::bold(name) + " " +
+        (api->version != nullptr ? api->version : ""));
+    plugins_.push_back(std::move(plugin));
+    return true;
+}
+
+bool Manager::unload(const std::string& name)
+{
+    auto it = std::find_if(plugins_.begin(), plugins_.end(),
+        [&name](const std::unique_ptr<Plugin>& plugin) {
+            return plugin->name == name;
+        });
+    if (it == plugins_.end())
+    {
+        cli_tools::printError("No plugin named " + cli_tools::bold(name));
+        return false;
+    }
+
+    close(**it);
+    plugins_.erase(it);
+    cli_tools::printInfo("Unloaded plugin " + cli_tools::bold(name));
+    return true;
+}
+
+bool Manager::reload(const std::string& name)
+{
+    auto it = std::find_if(plugins_.begin(), plugins_.end(),
+        [&name](const std::unique_ptr<Plugin>& plugin) {
+            return plugin->name == name;
+        });
+    if (it == plugins_.end())
+    {
+        cli_tools::printError("No plugin named " + cli_tools::bold(name));
+        return false;
+    }
+
+    std::string path = (*it)->path;
+    return unload(name) && load(path);
+}
+
+void Manager::dispatch(const Event& event)
+{
+    auto shared = std::make_shared<const Event>(event);
+    for (std::unique_ptr<Plugin>& plugin : plugins_)
+    {
+        if (plugin->api->on_event == nullptr || overBudget(*plugin))
+        {
+            continue;
+        }
+
+        Plugin* raw = plugin.get();
+        plugin->strand->post([raw, shared] {
+            void* state = raw->state.load(std::memory_order_acquire);
+            if (state == nullptr)
+            {
+                return;
+            }
+            pp_event converted = {static_cast<std::uint32_t>(shared->type),
+                shared->login.c_str(), shared->text.c_str(), shared->value,
+                shared->index};
+            raw->api->on_event(state, &converted);
+        });
+    }
+}
+
+void Manager::setChatSink(ChatSink sink)
+{
+    chatSink_ = std::move(sink);
+}
+
+bool Manager::empty() const
+{
+    return plugins_.empty();
+}
+
+std::string Manager::path(const std::string& name) const
+{
+    auto it = std::find_if(plugins_.begin(), plugins_.end(),
+        [&name](const std::unique_ptr<Plugin>& plugin) {
+            return plugin->name == name;
+        });
+    return it != plugins_.end() ? (*it)->path : std::string();
+}
+
+std::vector<PluginStats> Manager::stats() const
+{
+    std::vector<PluginStats> stats;
+    for (const std::unique_ptr<Plugin>& plugin : plugins_)
+    {
+        PluginStats entry;
+        entry.name = plugin->name;
+        entry.version = plugin->api->version != nullptr ? plugin->api->version
+                                                        : "";
+        entry.path = plugin->path;
+        entry.loaded =
+            plugin->state.load(std::memory_order_acquire) != nullptr;
+        entry.throttled = plugin->throttled;
+        entry.strand = plugin->strand->stats();
+        stats.push_back(std::move(entry));
+    }
+    return stats;
+}
+
+bool Manager::overBudget(Plugin& plugin)
+{
+    auto now = std::chrono::steady_clock::now();
+    std::chrono::nanoseconds cpu = plugin.strand->cpuTime();
+    if (now - plugin.windowStart >= std::chrono::seconds(1))
+    {
+        plugin.windowStart = now;
+        plugin.windowCpu = cpu;
+        plugin.warned = false;
+    }
+
+    if (cpu - plugin.windowCpu <= limits_.cpuBudget)
+    {
+        return false;
+    }
+    ++plugin.throttled;
+    if (!plugin.warned)
+    {
+        cli_tools::printWarning("Plugin " + cli_tools::bold(plugin.name) +
+            " is over its CPU budget, dropping its events");
+        plugin.warned = true;
+    }
+    return true;
+}
+
+void Manager::close(Plugin& plugin)
+{
+    Plugin* raw = &plugin;
+    plugin.strand->post([raw] {
+        void* state = raw->state.exchange(nullptr, std::memory_order_acq_rel);
+        if (state != nullptr && raw->api->unload != nullptr)
+        {
+            raw->api->unload(state);
+        }
+    });
+    plugin.strand->close();
+
+    // The queue may have been full: make sure unload ran
+    void* state = plugin.state.exchange(nullptr, std::memory_order_acq_rel);
+    if (state != nullptr && plugin.api->unload != nullptr)
+    {
+        plugin.api->unload(state);
+    }
+    ::dlclose(plugin.handle);
+}
+
+void Manager::hostLog(void* context, int level, const char* message)
+{
+    auto* plugin = static_cast<Plugin*>(context);
+    std::string text = "[" + plugin->name + "] " + message;
+    switch (level)
+    {
+        case PP_LOG_ERROR:
+            cli_tools::printError(text);
+            break;
+        case PP_LOG_WARNING:
+            cli_tools::printWarning(text);
+            break;
+        default:
+            cli_tools::printInfo(text);
+            break;
+    }
+}
+
+void Manager::hostSendChat(
+    void* context, const char* login, const char* message)
+{
+    auto* plugin = static_cast<Plugin*>(context);
+    if (plugin->manager->chatSink_)
+    {
+        plugin->manager->chatSink_(
+            login != nullptr ? login : "", message != nullptr ? message : "");
+    }
+}
+} // namespace plugins
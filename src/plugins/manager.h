@@ -0,0 +1,182 @@
+#ifndef PLUGINS_MANAGER_H
+#define PLUGINS_MANAGER_H
+
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <optional>
+#include <string>
+#include <vector>
+
+#include "core/threadpool.h"
+#include "plugins/plugin.h"
+#include "utils/config.h"
+
+namespace plugins
+{
+/**
+ * @brief A controller event, forwarded to every plugin.
+ */
+struct Event
+{
+    pp_event_type type {PP_EVENT_CHAT};
+    std::string login;
+    std::string text;
+    std::int64_t value {0};
+    std::int32_t index {0};
+};
+
+/**
+ * @brief The [plugins] section of the configuration.
+ */
+struct Limits
+{
+    std::size_t maxQueued {1024}; // events waiting per plugin
+    std::chrono::milliseconds cpuBudget {100}; // CPU time per second
+
+    /**
+     * @brief Reads the [plugins] section, missing keys keep their default.
+     */
+    static Limits fromConfig(config::Config& config);
+};
+
+struct PluginStats
+{
+    std::string name;
+    std::string version;
+    std::string path;
+    bool loaded {false}; // false until load() returned, or if it failed
+    std::uint64_t throttled {0}; // events dropped over the CPU budget
+    core::StrandStats strand;
+};
+
+/**
+ * @brief What a plugin file says about itself, see pp_plugin_info.
+ */
+struct Info
+{
+    std::string name;
+    std::string version;
+    std::string path;
+};
+
+/**
+ * @brief The .so files of a plugin directory, sorted so that plugins load
+ *        in the same order on every start.
+ */
+std::vector<std::string> pluginFiles(const std::string& directory);
+
+/**
+ * @brief Reads the pp_plugin_info of a plugin from its ELF symbol table,
+ *        without loading the library: no code of the plugin runs.
+ *
+ * @return Nothing if the file is not a 64-bit ELF library exporting
+ *         PLANETPLUS_PLUGIN_INFO for this ABI.
+ */
+std::optional<Info> inspect(const std::string& path);
+
+/**
+ * @brief Loads plugins (see plugins/plugin.h) and feeds them events.
+ *
+ * Each plugin gets its own Strand on the shared pool: its calls are
+ * serialized, and dispatch() only queues, so the server loop never waits
+ * for a plugin. A plugin whose queue is full, or that used more CPU than
+ * its budget during the last second, misses events instead of delaying
+ * the others. Plugins can be unloaded or reloaded while running.
+ *
+ * Used from the server loop thread only.
+ */
+class Manager
+{
+  public:
+    /// Receives send_chat calls from plugins, from pool threads.
+    using ChatSink =
+        std::function<void(const std::string& logins, const std::string&)>;
+
+    Manager(const std::string& directory, core::ThreadPool& pool,
+        const Limits& limits = Limits());
+
+    /**
+     * @brief Unloads every plugin.
+     */
+    ~Manager();
+
+    Manager(const Manager&) = delete;
+    Manager& operator=(const Manager&) = delete;
+
+    /**
+     * @brief Loads every .so file of the plugin directory.
+     *
+     * @return The number of plugins loaded.
+     */
+    std::size_t loadAll();
+
+    bool load(const std::string& path);
+
+    /**
+     * @brief Waits for the queued events of the plugin, unloads it and
+     *        closes its library.
+     */
+    bool unload(const std::string& name);
+
+    /**
+     * @brief Unloads the plugin then loads its file again, e.g. after it was
+     *        replaced by a new build.
+     */
+    bool reload(const std::string& name);
+
+    void dispatch(const Event& event);
+
+    void setChatSink(ChatSink sink);
+
+    /**
+     * @brief true without plugins, dispatch() can then be skipped.
+     */
+    bool empty() const;
+
+    /**
+     * @brief The file the plugin was loaded from, empty if none has that
+     *        name.
+     */
+    std::string path(const std::string& name) const;
+
+    std::vector<PluginStats> stats() const;
+
+  private:
+    struct Plugin
+    {
+        Manager* manager;
+        std::string path;
+        std::string name;
+        void* handle {nullptr};
+        const pp_plugin* api {nullptr};
+        pp_host host {};
+        std::atomic<void*> state {nullptr}; // set by load() on the strand
+        std::shared_ptr<core::Strand> strand;
+
+        // CPU budget accounting, see dispatch()
+        std::chrono::steady_clock::time_point windowStart {};
+        std::chrono::nanoseconds windowCpu {0};
+        bool warned {false};
+        std::uint64_t throttled {0};
+    };
+
+    std::string directory_;
+    core::ThreadPool& pool_;
+    Limits limits_;
+    ChatSink chatSink_;
+    std::vector<std::unique_ptr<Plugin>> plugins_;
+
+    bool overBudget(Plugin& plugin);
+    void close(Plugin& plugin);
+
+    static void hostLog(void* context, int level, const char* message);
+    static void hostSendChat(
+        void* context, const char* login, const char* message);
+};
+} // namespace plugins
+
+#endif
@@ -0,0 +1,94 @@
+#ifndef PLUGIN_H
+#define PLUGIN_H
+
+/*
+ * Plugin ABI of planetplus.
+ *
+ * A plugin is a shared library placed in ~/.local/share/planetplus/plugins/
+ * exporting PLANETPLUS_PLUGIN_ENTRY. Only C types cross the boundary, so a
+ * plugin can be built with any compiler, or in C. Everything a plugin
+ * receives (strings, events) is only valid for the duration of the call.
+ *
+ * Calls into a plugin are serialized: load, every on_event and unload run
+ * one at a time, from pool threads, never from the server loop.
+ */
+
+#include <stdint.h>
+
+#define PLANETPLUS_PLUGIN_ABI_VERSION 1
+#define PLANETPLUS_PLUGIN_ENTRY "planetplus_plugin"
+#define PLANETPLUS_PLUGIN_INFO "planetplus_plugin_info"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+enum pp_log_level
+{
+    PP_LOG_INFO = 0,
+    PP_LOG_WARNING = 1,
+    PP_LOG_ERROR = 2
+};
+
+enum pp_event_type
+{
+    PP_EVENT_PLAYER_CONNECT = 1,
+    PP_EVENT_PLAYER_DISCONNECT = 2,
+    PP_EVENT_CHAT = 3,        /* text: the chat line */
+    PP_EVENT_BEGIN_MAP = 4,   /* text: map uid */
+    PP_EVENT_END_MAP = 5,     /* text: map uid */
+    PP_EVENT_CHECKPOINT = 6,  /* value: race time, index: checkpoint */
+    PP_EVENT_FINISH = 7,      /* value: race time */
+    PP_EVENT_COMMAND = 8      /* text: command line without the '/' */
+};
+
+struct pp_event
+{
+    uint32_t type;     /* pp_event_type */
+    const char* login; /* empty for server events */
+    const char* text;
+    int64_t value;
+    int32_t index;
+};
+
+/* Services of the controller, the context must be passed back as is. */
+struct pp_host
+{
+    uint32_t abi_version;
+    void* context;
+    void (*log)(void* context, int level, const char* message);
+    /* login: comma separated logins, empty for everyone */
+    void (*send_chat)(void* context, const char* login, const char* message);
+};
+
+struct pp_plugin
+{
+    uint32_t abi_version; /* PLANETPLUS_PLUGIN_ABI_VERSION */
+    const char* name;
+    const char* version;
+
+    /* Returns the plugin state handed to the other calls, NULL on error. */
+    void* (*load)(const struct pp_host* host);
+    void (*unload)(void* state);
+    void (*on_event)(void* state, const struct pp_event* event);
+};
+
+typedef const struct pp_plugin* (*pp_plugin_entry)(void);
+
+/*
+ * Optional constant exported as PLANETPLUS_PLUGIN_INFO, with the name and
+ * version of pp_plugin. It is read from the file without loading it, so
+ * that listing plugins runs none of their code.
+ */
+struct pp_plugin_info
+{
+    uint32_t abi_version; /* PLANETPLUS_PLUGIN_ABI_VERSION */
+    char name[64];
+    char version[32];
+};
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,378 @@
+#include "live.h"
+
+#include <algorithm>
+
+namespace ranking
+{
+LiveRanking::LiveRanking(std::size_t checkpointCount)
+    : checkpointCount_(checkpointCount)
+    , recordSplits_(checkpointCount, kNoTime)
+    , roundBestSplits_(checkpointCount, kNoTime)
+{
+}
+
+void LiveRanking::newMap(
+    std::size_t checkpointCount, const std::vector<utils::LoginId>& players)
+{
+    newRound();
+
+    // Every row is reset anyway, renumber those still on the server so that
+    // the columns do not grow with everyone who ever joined
+    logins_.clear();
+    ids_.clear();
+    for (utils::LoginId login : players)
+    {
+        if (ids_.emplace(login, static_cast<std::uint32_t>(logins_.size()))
+                .second)
+        {
+            logins_.push_back(login);
+        }
+    }
+    checkpoints_.assign(logins_.size(), 0);
+    times_.assign(logins_.size(), 0);
+    positions_.assign(logins_.size(), kUnranked);
+    lastChange_.assign(logins_.size(), 0);
+
+    checkpointCount_ = checkpointCount;
+    splits_.assign(logins_.size() * checkpointCount_, kNoTime);
+    personalBests_.assign(logins_.size() * checkpointCount_, kNoTime);
+    recordSplits_.assign(checkpointCount_, kNoTime);
+    roundBestSplits_.assign(checkpointCount_, kNoTime);
+}
+
+void LiveRanking::newRound()
+{
+    // Ticks keep increasing so consumers notice the reset
+    ++tick_;
+    journalBase_ = tick_;
+    journal_.clear();
+
+    order_.clear();
+    std::fill(positions_.begin(), positions_.end(), kUnranked);
+    std::fill(checkpoints_.begin(), checkpoints_.end(), 0);
+    std::fill(times_.begin(), times_.end(), 0);
+    std::fill(splits_.begin(), splits_.end(), kNoTime);
+    std::fill(roundBestSplits_.begin(), roundBestSplits_.end(), kNoTime);
+}
+
+void LiveRanking::setRecordSplits(const std::vector<std::int32_t>& splits)
+{
+    if (splits.size() > checkpointCount_)
+    {
+        resizeCheckpoints(splits.size());
+    }
+    std::fill(recordSplits_.begin(), recordSplits_.end(), kNoTime);
+    std::transform(splits.begin(), splits.end(), recordSplits_.begin(),
+        [](std::int32_t time) { return time < 0 ? kNoTime : time; });
+}
+
+void LiveRanking::setPersonalBest(
+    const std::string& login, const std::vector<std::int32_t>& splits)
+{
+    if (splits.size() > checkpointCount_)
+    {
+        resizeCheckpoints(splits.size());
+    }
+    std::int32_t* best =
+        row(personalBests_, idOf(utils::logins().intern(login)));
+    std::fill(best, best + checkpointCount_, kNoTime);
+    std::transform(splits.begin(), splits.end(), best,
+        [](std::int32_t time) { return time < 0 ? kNoTime : time; });
+}
+
+std::vector<std::int32_t> LiveRanking::splitsOf(utils::LoginId login) const
+{
+    auto it = ids_.find(login);
+    if (it == ids_.end())
+    {
+        return {};
+    }
+    auto first = splits_.begin() +
+        static_cast<std::ptrdiff_t>(it->second * checkpointCount_);
+    return std::vector<std::int32_t>(
+        first, first + static_cast<std::ptrdiff_t>(checkpointCount_));
+}
+
+std::size_t LiveRanking::checkpointCount() const
+{
+    return checkpointCount_;
+}
+
+Update LiveRanking::onCheckpoint(
+    const std::string& login, std::size_t checkpoint, std::int32_t time)
+{
+    return onCheckpoint(utils::logins().intern(login), checkpoint, time);
+}
+
+Update LiveRanking::onCheckpoint(
+    utils::LoginId login, std::size_t checkpoint, std::int32_t time)
+{
+    if (checkpoint >= checkpointCount_)
+    {
+        resizeCheckpoints(checkpoint + 1);
+    }
+
+    Update update;
+    std::uint32_t id = idOf(login);
+    ++tick_;
+
+    row(splits_, id)[checkpoint] = time;
+
+    std::int32_t best = row(personalBests_, id)[checkpoint];
+    if (best != kNoTime)
+    {
+        update.deltaToPersonalBest = time - best;
+    }
+    if (recordSplits_[checkpoint] != kNoTime)
+    {
+        update.deltaToRecord = time - recordSplits_[checkpoint];
+    }
+    std::int32_t& roundBest = roundBestSplits_[checkpoint];
+    if (roundBest != kNoTime)
+    {
+        update.deltaToRoundBest = time - roundBest;
+    }
+    if (roundBest == kNoTime || time < roundBest)
+    {
+        roundBest = time;
+    }
+
+    checkpoints_[id] = static_cast<std::int32_t>(checkpoint + 1);
+    times_[id] = time;
+
+    std::size_t index;
+    if (positions_[id] == kUnranked)
+    {
+        order_.push_back(id);
+        index = order_.size() - 1;
+    }
+    else
+    {
+        index = positions_[id];
+        update.previousPosition = index + 1;
+    }
+
+    // Bubble towards the new position, shifting the players passed by one
+    std::size_t start = index;
+    while (index > 0 && ahead(id, order_[index - 1]))
+    {
+        place(index, order_[index - 1]);
+        --index;
+    }
+    while (index + 1 < order_.size() && ahead(order_[index + 1], id))
+    {
+        place(index, order_[index + 1]);
+        ++index;
+    }
+    order_[index] = id;
+    positions_[id] = static_cast<std::uint32_t>(index);
+    if (index != start || update.previousPosition == 0)
+    {
+        record(id);
+    }
+
+    update.position = index + 1;
+    return update;
+}
+
+void LiveRanking::remove(const std::string& login)
+{
+    remove(utils::logins().find(login));
+}
+
+void LiveRanking::remove(utils::LoginId login)
+{
+    auto it = ids_.find(login);
+    if (it == ids_.end() || positions_[it->second] == kUnranked)
+    {
+        return;
+    }
+
+    std::uint32_t id = it->second;
+    ++tick_;
+    for (std::size_t index = positions_[id]; index + 1 < order_.size(); ++index)
+    {
+        place(index, order_[index + 1]);
+    }
+    order_.pop_back();
+
+    positions_[id] = kUnranked;
+    checkpoints_[id] = 0;
+    times_[id] = 0;
+    std::int32_t* splits = row(splits_, id);
+    std::fill(splits, splits + checkpointCount_, kNoTime);
+    record(id);
+}
+
+std::size_t LiveRanking::positionOf(const std::string& login) const
+{
+    return positionOf(utils::logins().find(login));
+}
+
+std::size_t LiveRanking::positionOf(utils::LoginId login) const
+{
+    auto it = ids_.find(login);
+    if (it == ids_.end() || positions_[it->second] == kUnranked)
+    {
+        return 0;
+    }
+    return positions_[it->second] + 1;
+}
+
+std::size_t LiveRanking::size() const
+{
+    return order_.size();
+}
+
+std::size_t LiveRanking::players() const
+{
+    return logins_.size();
+}
+
+Standing LiveRanking::at(std::size_t position) const
+{
+    if (position == 0 || position > order_.size())
+    {
+        return Standing();
+    }
+    std::uint32_t id = order_[position - 1];
+    return Standing {nameOf(id), checkpoints_[id], times_[id]};
+}
+
+std::vector<Standing> LiveRanking::standings() const
+{
+    std::vector<Standing> result;
+    result.reserve(order_.size());
+    for (std::uint32_t id : order_)
+    {
+        result.push_back(Standing {nameOf(id), checkpoints_[id], times_[id]});
+    }
+    return result;
+}
+
+std::uint64_t LiveRanking::tick() const
+{
+    return tick_;
+}
+
+Diff LiveRanking::changesSince(std::uint64_t tick) const
+{
+    Diff diff;
+    diff.tick = tick_;
+
+    if (tick < journalBase_)
+    {
+        diff.full = true;
+        diff.changes.reserve(order_.size());
+        for (std::size_t index = 0; index < order_.size(); ++index)
+        {
+            std::uint32_t id = order_[index];
+            diff.changes.push_back(Change {lastChange_[id], nameOf(id), index + 1});
+        }
+        return diff;
+    }
+
+    auto first = std::upper_bound(journal_.begin(), journal_.end(),
+        std::make_pair(tick, static_cast<std::uint32_t>(-1)));
+    for (auto it = first; it != journal_.end(); ++it)
+    {
+        std::uint32_t id = it->second;
+        if (it->first != lastChange_[id])
+        {
+            continue; // superseded by a later entry
+        }
+        std::size_t position =
+            positions_[id] == kUnranked ? 0 : positions_[id] + 1;
+        diff.changes.push_back(Change {it->first, nameOf(id), position});
+    }
+    return diff;
+}
+
+std::uint32_t LiveRanking::idOf(utils::LoginId login)
+{
+    auto it = ids_.find(login);
+    if (it != ids_.end())
+    {
+        return it->second;
+    }
+
+    auto id = static_cast<std::uint32_t>(logins_.size());
+    ids_.emplace(login, id);
+    logins_.push_back(login);
+    checkpoints_.push_back(0);
+    times_.push_back(0);
+    positions_.push_back(kUnranked);
+    lastChange_.push_back(0);
+    splits_.resize(splits_.size() + checkpointCount_, kNoTime);
+    personalBests_.resize(personalBests_.size() + checkpointCount_, kNoTime);
+    return id;
+}
+
+std::string_view LiveRanking::nameOf(std::uint32_t id) const
+{
+    return utils::logins().name(logins_[id]);
+}
+
+bool LiveRanking::ahead(std::uint32_t a, std::uint32_t b) const
+{
+    if (checkpoints_[a] != checkpoints_[b])
+    {
+        return checkpoints_[a] > checkpoints_[b];
+    }
+    return times_[a] < times_[b];
+}
+
+void LiveRanking::place(std::size_t index, std::uint32_t id)
+{
+    order_[index] = id;
+    positions_[id] = static_cast<std::uint32_t>(index);
+    record(id);
+}
+
+void LiveRanking::record(std::uint32_t id)
+{
+    lastChange_[id] = tick_;
+    journal_.emplace_back(tick_, id);
+    if (journal_.size() > 1024 + 4 * logins_.size())
+    {
+        compactJournal();
+    }
+}
+
+void LiveRanking::compactJournal()
+{
+    // Only the latest entry of a player is ever reported, dropping older
+    // ones loses nothing.
+    journal_.erase(std::remove_if(journal_.begin(), journal_.end(),
+                       [this](const std::pair<std::uint64_t, std::uint32_t>& e) {
+                           return e.first != lastChange_[e.second];
+                       }),
+        journal_.end());
+}
+
+void LiveRanking::resizeCheckpoints(std::size_t checkpointCount)
+{
+    auto relayout = [&](std::vector<std::int32_t>& table) {
+        std::vector<std::int32_t> resized(
+            logins_.size() * checkpointCount, kNoTime);
+        std::size_t kept = std::min(checkpointCount, checkpointCount_);
+        for (std::size_t id = 0; id < logins_.size(); ++id)
+        {
+            std::copy_n(table.begin() + id * checkpointCount_, kept,
+                resized.begin() + id * checkpointCount);
+        }
+        table.swap(resized);
+    };
+
+    relayout(splits_);
+    relayout(personalBests_);
+    checkpointCount_ = checkpointCount;
+    recordSplits_.resize(checkpointCount_, kNoTime);
+    roundBestSplits_.resize(checkpointCount_, kNoTime);
+}
+
+std::int32_t* LiveRanking::row(std::vector<std::int32_t>& table, std::uint32_t id)
+{
+    return table.data() + static_cast<std::size_t>(id) * checkpointCount_;
+}
+} // namespace ranking
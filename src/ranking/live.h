@@ -0,0 +1,193 @@
+#ifndef LIVE_H
+#define LIVE_H
+
+#include <cstdint>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "utils/logins.h"
+
+namespace ranking
+{
+/**
+ * @brief Live position of a player during the current round.
+ */
+struct Standing
+{
+    std::string_view login; // the copy of utils::logins(), never dangles
+    std::int32_t checkpoints {0}; // checkpoints passed, finish included
+    std::int32_t time {0};        // race time at the last checkpoint
+};
+
+/**
+ * @brief What changed for a player after a checkpoint.
+ *
+ * Deltas are negative when the player is ahead.
+ */
+struct Update
+{
+    std::size_t position {0}; // 1-based
+    std::size_t previousPosition {0}; // 0 if the player was not ranked yet
+    std::optional<std::int32_t> deltaToPersonalBest;
+    std::optional<std::int32_t> deltaToRecord;
+    std::optional<std::int32_t> deltaToRoundBest;
+};
+
+/**
+ * @brief Position change of a player, see LiveRanking::changesSince().
+ */
+struct Change
+{
+    std::uint64_t tick {0};
+    std::string_view login; // the copy of utils::logins(), never dangles
+    std::size_t position {0};
+};
+
+/**
+ * @brief Changes since a tick. When full is set the journal no longer goes
+ *        back that far and changes holds every ranked player.
+ */
+struct Diff
+{
+    std::uint64_t tick {0}; // pass it to the next changesSince() call
+    bool full {false};
+    std::vector<Change> changes;
+};
+
+/**
+ * @brief Live standings of the current round, maintained incrementally.
+ *
+ * Players are kept in a sorted array (more checkpoints first, then lower
+ * time). A checkpoint only bubbles the player to its new position, so an
+ * update costs the distance moved instead of a full sort. Splits are kept in
+ * flat arrays (one row of checkpoints per player) for deltas against the
+ * personal best, the server record and the best split of the round.
+ */
+class LiveRanking
+{
+  public:
+    explicit LiveRanking(std::size_t checkpointCount = 0);
+
+    /**
+     * @brief Starts a new map: standings, personal bests and record splits
+     *        are all cleared.
+     *
+     * @param players Logins on the server. Only they keep a row, those of
+     *                players who left are dropped.
+     */
+    void newMap(std::size_t checkpointCount,
+        const std::vector<utils::LoginId>& players = {});
+
+    /**
+     * @brief Starts a new round. Personal bests and record splits are kept.
+     */
+    void newRound();
+
+    /**
+     * @brief Splits of the server record, one time per checkpoint. Negative
+     *        times are checkpoints not known, e.g. all but the finish of a
+     *        record read from the database.
+     */
+    void setRecordSplits(const std::vector<std::int32_t>& splits);
+
+    /**
+     * @brief Splits of the personal best of login, as for
+     *        setRecordSplits().
+     */
+    void setPersonalBest(
+        const std::string& login, const std::vector<std::int32_t>& splits);
+
+    /**
+     * @brief Splits of the current run of login, -1 for the checkpoints it
+     *        did not pass. Empty if login never passed one.
+     */
+    std::vector<std::int32_t> splitsOf(utils::LoginId login) const;
+
+    std::size_t checkpointCount() const;
+
+    /**
+     * @brief Handles a checkpoint crossing.
+     *
+     * @param checkpoint 0-based index of the checkpoint, the finish being the
+     *                   last one.
+     * @param time       Race time in milliseconds.
+     */
+    Update onCheckpoint(
+        const std::string& login, std::size_t checkpoint, std::int32_t time);
+    Update onCheckpoint(
+        utils::LoginId login, std::size_t checkpoint, std::int32_t time);
+
+    /**
+     * @brief Removes login from the standings, e.g. on give up or disconnect.
+     */
+    void remove(const std::string& login);
+    void remove(utils::LoginId login);
+
+    /**
+     * @brief 1-based position of login, 0 if not ranked.
+     */
+    std::size_t positionOf(const std::string& login) const;
+    std::size_t positionOf(utils::LoginId login) const;
+
+    std::size_t size() const;
+
+    /**
+     * @brief Number of players with a row, ranked or not.
+     */
+    std::size_t players() const;
+
+    Standing at(std::size_t position) const;
+    std::vector<Standing> standings() const;
+
+    /**
+     * @brief Current tick, incremented on every checkpoint.
+     */
+    std::uint64_t tick() const;
+
+    /**
+     * @brief Players whose position changed after tick, one entry per
+     *        player with its latest position.
+     */
+    Diff changesSince(std::uint64_t tick) const;
+
+  private:
+    static constexpr std::int32_t kNoTime = -1;
+    static constexpr std::uint32_t kUnranked = static_cast<std::uint32_t>(-1);
+
+    // Per player columns, indexed by player id
+    std::vector<utils::LoginId> logins_;
+    std::vector<std::int32_t> checkpoints_;
+    std::vector<std::int32_t> times_;
+    std::vector<std::uint32_t> positions_; // 0-based index in order_
+    std::vector<std::uint64_t> lastChange_;
+    std::unordered_map<utils::LoginId, std::uint32_t> ids_;
+
+    // Flat split rows: player * checkpointCount_ + checkpoint
+    std::size_t checkpointCount_;
+    std::vector<std::int32_t> splits_;
+    std::vector<std::int32_t> personalBests_;
+    std::vector<std::int32_t> recordSplits_;
+    std::vector<std::int32_t> roundBestSplits_;
+
+    std::vector<std::uint32_t> order_; // player ids, best first
+
+    std::uint64_t tick_ {0};
+    std::uint64_t journalBase_ {0}; // changes at or before it were dropped
+    std::vector<std::pair<std::uint64_t, std::uint32_t>> journal_;
+
+    std::uint32_t idOf(utils::LoginId login);
+    std::string_view nameOf(std::uint32_t id) const;
+    bool ahead(std::uint32_t a, std::uint32_t b) const;
+    void place(std::size_t index, std::uint32_t id);
+    void record(std::uint32_t id);
+    void compactJournal();
+    void resizeCheckpoints(std::size_t checkpointCount);
+    std::int32_t* row(std::vector<std::int32_t>& table, std::uint32_t id);
+};
+} // namespace ranking
+
+#endif
@@ -0,0 +1,254 @@
+#include "archive.h"
+
+#include <algorithm>
+
+namespace records
+{
+namespace
+{
+// Signed values as varints, small magnitudes in few bytes either way
+std::uint64_t zigzag(std::int64_t value)
+{
+    return (static_cast<std::uint64_t>(value) << 1) ^
+        static_cast<std::uint64_t>(value >> 63);
+}
+
+std::int64_t unzigzag(std::uint64_t value)
+{
+    return static_cast<std::int64_t>(value >> 1) ^
+        -static_cast<std::int64_t>(value & 1);
+}
+
+// Counts come from the file: reserve no more than it can hold
+constexpr std::uint64_t kMaxReserve = 1 << 20;
+} // namespace
+
+void ArchiveWriter::add(std::string_view map, std::vector<Record> records)
+{
+    std::sort(records.begin(), records.end(),
+        [](const Record& a, const Record& b) {
+            return a.time != b.time ? a.time < b.time
+                                    : a.timestamp < b.timestamp;
+        });
+
+    maps_.push_back(Map {std::string(map), records.size(),
+        loginColumn_.size(), timeColumn_.size(), timestampColumn_.size()});
+    records_ += records.size();
+
+    std::int32_t previousTime = 0;
+    std::int64_t previousTimestamp = 0;
+    for (std::size_t i = 0; i < records.size(); ++i)
+    {
+        const Record& record = records[i];
+        auto [it, inserted] = loginIds_.try_emplace(
+            record.login, static_cast<std::uint32_t>(logins_.size()));
+        if (inserted)
+        {
+            logins_.push_back(it->first);
+        }
+        snapshot::appendVarint(loginColumn_, it->second);
+
+        // Sorted: only the first time of a map can be below the previous
+        if (i == 0)
+        {
+            snapshot::appendVarint(timeColumn_, zigzag(record.time));
+        }
+        else
+        {
+            snapshot::appendVarint(timeColumn_,
+                static_cast<std::uint64_t>(
+                    static_cast<std::int64_t>(record.time) - previousTime));
+        }
+        snapshot::appendVarint(
+            timestampColumn_, zigzag(record.timestamp - previousTimestamp));
+        previousTime = record.time;
+        previousTimestamp = record.timestamp;
+    }
+}
+
+std::size_t ArchiveWriter::maps() const
+{
+    return maps_.size();
+}
+
+std::uint64_t ArchiveWriter::records() const
+{
+    return records_;
+}
+
+bool ArchiveWriter::save(const std::string& path)
+{
+    snapshot::Writer writer;
+    writer.begin(snapshot::Section::RECORDS_LOGINS);
+    writer.putVarint(logins_.size());
+    for (std::string_view login : logins_)
+    {
+        writer.putString(login);
+    }
+
+    writer.begin(snapshot::Section::RECORDS_MAPS);
+    writer.putVarint(maps_.size());
+    for (const Map& map : maps_)
+    {
+        writer.putString(map.uid);
+        writer.putVarint(map.records);
+        writer.putVarint(map.logins);
+        writer.putVarint(map.times);
+        writer.putVarint(map.timestamps);
+    }
+
+    writer.begin(snapshot::Section::RECORDS_LOGIN_IDS);
+    writer.putBytes(loginColumn_);
+    writer.begin(snapshot::Section::RECORDS_TIMES);
+    writer.putBytes(timeColumn_);
+    writer.begin(snapshot::Section::RECORDS_TIMESTAMPS);
+    writer.putBytes(timestampColumn_);
+    return writer.save(path);
+}
+
+bool Archive::open(const std::string& path)
+{
+    logins_.clear();
+    maps_.clear();
+    records_ = 0;
+    if (!reader_.open(path))
+    {
+        return false;
+    }
+
+    loginColumn_ = reader_.section(snapshot::Section::RECORDS_LOGIN_IDS);
+    timeColumn_ = reader_.section(snapshot::Section::RECORDS_TIMES);
+    timestampColumn_ = reader_.section(snapshot::Section::RECORDS_TIMESTAMPS);
+    auto logins = reader_.section(snapshot::Section::RECORDS_LOGINS);
+    auto maps = reader_.section(snapshot::Section::RECORDS_MAPS);
+    if (!loginColumn_ || !timeColumn_ || !timestampColumn_ || !logins ||
+        !maps)
+    {
+        return false;
+    }
+
+    std::uint64_t count = 0;
+    if (!logins->getVarint(count))
+    {
+        return false;
+    }
+    logins_.reserve(std::min(count, kMaxReserve));
+    for (std::uint64_t i = 0; i < count; ++i)
+    {
+        std::string_view login;
+        if (!logins->getString(login))
+        {
+            return false;
+        }
+        logins_.push_back(login);
+    }
+
+    if (!maps->getVarint(count))
+    {
+        return false;
+    }
+    maps_.reserve(std::min(count, kMaxReserve));
+    for (std::uint64_t i = 0; i < count; ++i)
+    {
+        Map map;
+        if (!maps->getString(map.uid) || !maps->getVarint(map.records) ||
+            !maps->getVarint(map.logins) || !maps->getVarint(map.times) ||
+            !maps->getVarint(map.timestamps))
+        {
+            return false;
+        }
+        maps_.push_back(map);
+        records_ += map.records;
+    }
+    return true;
+}
+
+std::size_t Archive::maps() const
+{
+    return maps_.size();
+}
+
+std::uint64_t Archive::records() const
+{
+    return records_;
+}
+
+std::size_t Archive::logins() const
+{
+    return logins_.size();
+}
+
+std::string_view Archive::uid(std::size_t map) const
+{
+    return maps_[map].uid;
+}
+
+std::uint64_t Archive::recordsOf(std::size_t map) const
+{
+    return maps_[map].records;
+}
+
+std::string_view Archive::login(std::uint32_t id) const
+{
+    return logins_[id];
+}
+
+bool Archive::read(
+    std::size_t map, std::vector<ArchivedRecord>& records) const
+{
+    records.clear();
+    if (map >= maps_.size())
+    {
+        return false;
+    }
+    // Copies: each read moves its own cursors
+    const Map& entry = maps_[map];
+    snapshot::Cursor logins = *loginColumn_;
+    snapshot::Cursor times = *timeColumn_;
+    snapshot::Cursor timestamps = *timestampColumn_;
+    if (!logins.seek(entry.logins) || !times.seek(entry.times) ||
+        !timestamps.seek(entry.timestamps))
+    {
+        return false;
+    }
+
+    records.reserve(std::min(entry.records, kMaxReserve));
+    std::int64_t time = 0;
+    std::int64_t timestamp = 0;
+    for (std::uint64_t i = 0; i < entry.records; ++i)
+    {
+        std::uint64_t login = 0;
+        std::uint64_t timeDelta = 0;
+        std::uint64_t timestampDelta = 0;
+        if (!logins.getVarint(login) || login >= logins_.size() ||
+            !times.getVarint(timeDelta) ||
+            !timestamps.getVarint(timestampDelta))
+        {
+            return false;
+        }
+        time = i == 0 ? unzigzag(timeDelta)
+                      : time + static_cast<std::int64_t>(timeDelta);
+        timestamp += unzigzag(timestampDelta);
+        records.push_back(ArchivedRecord {static_cast<std::uint32_t>(login),
+            static_cast<std::int32_t>(time), timestamp});
+    }
+    return true;
+}
+
+bool Archive::read(std::size_t map, std::vector<Record>& records) const
+{
+    std::vector<ArchivedRecord> archived;
+    records.clear();
+    if (!read(map, archived))
+    {
+        return false;
+    }
+    records.reserve(archived.size());
+    for (const ArchivedRecord& record : archived)
+    {
+        records.push_back(Record {std::string(logins_[record.login]),
+            record.time, record.timestamp});
+    }
+    return true;
+}
+} // namespace records
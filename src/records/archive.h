@@ -0,0 +1,138 @@
+#ifndef RECORDS_ARCHIVE_H
+#define RECORDS_ARCHIVE_H
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+#include "records/records.h"
+#include "utils/snapshot.h"
+
+namespace records
+{
+/**
+ * @brief A record of an Archive, the login as an index of its dictionary.
+ */
+struct ArchivedRecord
+{
+    std::uint32_t login;
+    std::int32_t time;
+    std::int64_t timestamp;
+};
+
+/**
+ * @brief Builds an Archive, see --export-records.
+ *
+ * Records are encoded as they are added, so memory holds the encoded
+ * columns only, a few bytes per record.
+ */
+class ArchiveWriter
+{
+  public:
+    /**
+     * @brief The records of map, in any order. Each map is added once.
+     */
+    void add(std::string_view map, std::vector<Record> records);
+
+    std::size_t maps() const;
+    std::uint64_t records() const;
+
+    bool save(const std::string& path);
+
+  private:
+    struct Hash
+    {
+        using is_transparent = void;
+        std::size_t operator()(std::string_view value) const
+        {
+            return std::hash<std::string_view>()(value);
+        }
+    };
+
+    struct Map
+    {
+        std::string uid;
+        std::uint64_t records;
+        std::uint64_t logins; // offsets of its first record in the columns
+        std::uint64_t times;
+        std::uint64_t timestamps;
+    };
+
+    std::unordered_map<std::string, std::uint32_t, Hash, std::equal_to<>>
+        loginIds_;
+    std::vector<std::string_view> logins_; // by id, keys of loginIds_
+    std::vector<Map> maps_;
+    std::uint64_t records_ {0};
+    std::string loginColumn_;
+    std::string timeColumn_;
+    std::string timestampColumn_;
+};
+
+/**
+ * @brief Records of many maps in a compact columnar file, read in place.
+ *
+ * The file is a snapshot with one section per column. Logins are stored
+ * once in a dictionary and records refer to them by index. Records of a map
+ * are sorted by time, stored as the difference to the previous one, and
+ * timestamps the same way, all as varints: about 5 bytes per record where
+ * the table takes over 40.
+ *
+ * The file is mapped, nothing is decoded before a map is read, and maps
+ * can be read from several threads at once.
+ *
+ *     records::Archive archive;
+ *     archive.open(path);
+ *     std::vector<records::ArchivedRecord> best;
+ *     archive.read(0, best);
+ *     std::string_view first = archive.login(best[0].login);
+ */
+class Archive
+{
+  public:
+    /**
+     * @return false if the file is missing, damaged or not an archive.
+     */
+    bool open(const std::string& path);
+
+    std::size_t maps() const;
+    std::uint64_t records() const;
+    std::size_t logins() const;
+
+    std::string_view uid(std::size_t map) const;
+    std::uint64_t recordsOf(std::size_t map) const;
+    std::string_view login(std::uint32_t id) const;
+
+    /**
+     * @brief Decodes the records of map, best first. Thread safe.
+     *
+     * @return false if the columns are damaged.
+     */
+    bool read(std::size_t map, std::vector<ArchivedRecord>& records) const;
+    bool read(std::size_t map, std::vector<Record>& records) const;
+
+  private:
+    struct Map
+    {
+        std::string_view uid;
+        std::uint64_t records;
+        std::uint64_t logins;
+        std::uint64_t times;
+        std::uint64_t timestamps;
+    };
+
+    snapshot::Reader reader_;
+    std::vector<std::string_view> logins_; // into the mapping
+    std::vector<Map> maps_;
+    std::uint64_t records_ {0};
+    std::optional<snapshot::Cursor> loginColumn_;
+    std::optional<snapshot::Cursor> timeColumn_;
+    std::optional<snapshot::Cursor> timestampColumn_;
+};
+} // namespace records
+
+#endif
@@ -0,0 +1,247 @@
+#include "records.h"
+
+#include <algorithm>
+#include <utility>
+
+#include "cli/tools.h"
+
+namespace records
+{
+MapRecords::MapRecords(const std::string& uid)
+    : uid_(uid)
+{
+}
+
+const std::string& MapRecords::uid() const
+{
+    return uid_;
+}
+
+std::size_t MapRecords::size() const
+{
+    return index_.size();
+}
+
+void MapRecords::load(std::vector<Record> records)
+{
+    // Oldest first so equal times keep the order in which they were driven
+    std::sort(records.begin(), records.end(),
+        [](const Record& a, const Record& b) {
+            return a.time != b.time ? a.time < b.time
+                                    : a.timestamp < b.timestamp;
+        });
+
+    logins_.clear();
+    logins_.reserve(records.size());
+    nextOrder_ = 0;
+
+    std::vector<Index::Item> items;
+    items.reserve(records.size());
+    for (Record& record : records)
+    {
+        Key key {record.time, nextOrder_};
+        auto [it, inserted] = logins_.emplace(
+            std::move(record.login), Slot {key, record.timestamp});
+        if (!inserted)
+        {
+            continue; // duplicate row, the best one was kept already
+        }
+        ++nextOrder_;
+        items.emplace_back(key, &*it);
+    }
+    index_.assign(items);
+}
+
+SubmitResult MapRecords::submit(
+    const std::string& login, std::int32_t time, std::int64_t timestamp)
+{
+    SubmitResult result;
+    Key key {time, nextOrder_};
+
+    auto [it, inserted] = logins_.try_emplace(login, Slot {key, timestamp});
+    if (!inserted)
+    {
+        Slot& slot = it->second;
+        result.previousTime = slot.key.time;
+        result.previousRank = index_.rank(slot.key);
+        if (time >= slot.key.time)
+        {
+            result.rank = result.previousRank;
+            return result;
+        }
+        index_.erase(slot.key);
+        slot = Slot {key, timestamp};
+    }
+    index_.insert(key, &*it);
+
+    ++nextOrder_;
+    result.improved = true;
+    result.rank = index_.rank(key);
+    return result;
+}
+
+std::size_t MapRecords::rankOf(const std::string& login) const
+{
+    auto it = logins_.find(login);
+    if (it == logins_.end())
+    {
+        return 0;
+    }
+    return index_.rank(it->second.key);
+}
+
+std::optional<Record> MapRecords::find(const std::string& login) const
+{
+    auto it = logins_.find(login);
+    if (it == logins_.end())
+    {
+        return std::nullopt;
+    }
+    return recordOf(&*it);
+}
+
+std::optional<Record> MapRecords::at(std::size_t rank) const
+{
+    Index::Item item;
+    if (!index_.select(rank, item))
+    {
+        return std::nullopt;
+    }
+    return recordOf(item.second);
+}
+
+std::vector<Record> MapRecords::top(std::size_t count) const
+{
+    return range(1, count);
+}
+
+std::vector<Record> MapRecords::around(
+    const std::string& login, std::size_t radius) const
+{
+    std::size_t rank = rankOf(login);
+    if (rank == 0)
+    {
+        return {};
+    }
+    std::size_t first = rank > radius ? rank - radius : 1;
+    return range(first, rank + radius - first + 1);
+}
+
+Record MapRecords::recordOf(Entry entry)
+{
+    return Record {
+        entry->first, entry->second.key.time, entry->second.timestamp};
+}
+
+std::vector<Record> MapRecords::range(std::size_t first, std::size_t count) const
+{
+    std::vector<Record> result;
+    result.reserve(std::min(count, size()));
+    index_.forEach(first, count,
+        [&](const Key&, Entry entry) { result.push_back(recordOf(entry)); });
+    return result;
+}
+
+//-----------------------------------------------------------------------------
+
+Engine::Engine(Loader loader, Writer writer, std::size_t maxMaps)
+    : loader_(std::move(loader))
+    , writer_(std::move(writer))
+    , maxMaps_(std::max<std::size_t>(maxMaps, 1))
+{
+}
+
+MapRecords& Engine::setCurrentMap(const std::string& uid)
+{
+    auto it = maps_.find(uid);
+    if (it == maps_.end())
+    {
+        auto map = std::make_unique<MapRecords>(uid);
+        if (loader_)
+        {
+            map->load(loader_(uid));
+        }
+        it = maps_.emplace(uid, std::move(map)).first;
+    }
+
+    current_ = it->second.get();
+    touch(uid);
+    return *current_;
+}
+
+MapRecords& Engine::setCurrentMap(
+    const std::string& uid, std::vector<Record> records)
+{
+    auto it = maps_.find(uid);
+    if (it == maps_.end())
+    {
+        auto map = std::make_unique<MapRecords>(uid);
+        map->load(std::move(records));
+        it = maps_.emplace(uid, std::move(map)).first;
+    }
+
+    current_ = it->second.get();
+    touch(uid);
+    return *current_;
+}
+
+bool Engine::contains(const std::string& uid) const
+{
+    return maps_.find(uid) != maps_.end();
+}
+
+const MapRecords& Engine::current() const
+{
+    return current_ != nullptr ? *current_ : none_;
+}
+
+SubmitResult Engine::submit(
+    const std::string& login, std::int32_t time, std::int64_t timestamp)
+{
+    if (current_ == nullptr)
+    {
+        cli_tools::printError("!! No current map, call "
+                              "records::Engine::setCurrentMap() first.");
+        return SubmitResult();
+    }
+
+    SubmitResult result = current_->submit(login, time, timestamp);
+    if (result.improved && writer_)
+    {
+        pending_[current_->uid()][utils::logins().intern(login)] =
+            Record {login, time, timestamp};
+    }
+    return result;
+}
+
+void Engine::flush()
+{
+    std::map<std::string, std::unordered_map<utils::LoginId, Record>> batch;
+    batch.swap(pending_); // the Writer may submit again
+    for (auto& [uid, byLogin] : batch)
+    {
+        std::vector<Record> rows;
+        rows.reserve(byLogin.size());
+        for (auto& [login, record] : byLogin)
+        {
+            rows.push_back(std::move(record));
+        }
+        writer_(uid, std::move(rows));
+    }
+}
+
+void Engine::touch(const std::string& uid)
+{
+    recentlyUsed_.erase(
+        std::remove(recentlyUsed_.begin(), recentlyUsed_.end(), uid),
+        recentlyUsed_.end());
+    recentlyUsed_.push_back(uid);
+
+    while (recentlyUsed_.size() > maxMaps_)
+    {
+        // Pending writes are copies, dropping the map does not lose them
+        maps_.erase(recentlyUsed_.front());
+        recentlyUsed_.erase(recentlyUsed_.begin());
+    }
+}
+} // namespace records
@@ -0,0 +1,208 @@
+#ifndef RECORDS_H
+#define RECORDS_H
+
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <memory>
+#include <optional>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "utils/logins.h"
+#include "utils/rankindex.h"
+
+namespace records
+{
+/**
+ * @brief A single local record: the best time of a login on a map.
+ */
+struct Record
+{
+    std::string login;
+    std::int32_t time {0};      // race time in milliseconds
+    std::int64_t timestamp {0}; // unix time when the record was driven
+};
+
+/**
+ * @brief Outcome of a finish submitted to MapRecords::submit().
+ */
+struct SubmitResult
+{
+    bool improved {false};
+    std::size_t previousRank {0}; // 0 if the login had no record yet
+    std::size_t rank {0};         // rank after the submission
+    std::int32_t previousTime {0};
+};
+
+/**
+ * @brief Records of one map, ordered by time.
+ *
+ * Backed by an order-statistic index so that submissions, rank lookups, top-N
+ * and range-around-player queries are O(log n) even with millions of records,
+ * amortized for submissions (see utils::RankIndex). Equal times are ranked
+ * by who drove them first.
+ */
+class MapRecords
+{
+  public:
+    explicit MapRecords(const std::string& uid);
+
+    const std::string& uid() const;
+    std::size_t size() const;
+
+    /**
+     * @brief Replaces the content with records, e.g. rows read from the
+     *        database. Records do not need to be sorted.
+     */
+    void load(std::vector<Record> records);
+
+    /**
+     * @brief Submits a finish. Only kept if it improves the login's record.
+     */
+    SubmitResult submit(
+        const std::string& login, std::int32_t time, std::int64_t timestamp);
+
+    /**
+     * @brief 1-based rank of login, 0 if login has no record on this map.
+     */
+    std::size_t rankOf(const std::string& login) const;
+
+    std::optional<Record> find(const std::string& login) const;
+
+    /**
+     * @brief Record at the 1-based rank.
+     */
+    std::optional<Record> at(std::size_t rank) const;
+
+    /**
+     * @brief The count best records.
+     */
+    std::vector<Record> top(std::size_t count) const;
+
+    /**
+     * @brief Records ranked within radius of login (login included).
+     *        Empty if login has no record.
+     */
+    std::vector<Record> around(const std::string& login, std::size_t radius) const;
+
+  private:
+    struct Key
+    {
+        std::int32_t time;
+        std::uint32_t order; // tie-break, lower was driven first
+
+        bool operator<(const Key& other) const
+        {
+            return time != other.time ? time < other.time : order < other.order;
+        }
+    };
+
+    struct Slot
+    {
+        Key key;
+        std::int64_t timestamp {0};
+    };
+
+    // Node based, so the index can point at entries: a rank lookup is one
+    // hash lookup followed by a search over keys only.
+    using Logins = std::unordered_map<std::string, Slot>;
+    using Entry = const Logins::value_type*;
+    using Index = utils::RankIndex<Key, Entry>;
+
+    std::string uid_;
+    Logins logins_;
+    Index index_;
+    std::uint32_t nextOrder_ {0};
+
+    static Record recordOf(Entry entry);
+    std::vector<Record> range(std::size_t first, std::size_t count) const;
+};
+
+/**
+ * @brief Local records of every map the server played, lazily loaded.
+ *
+ * Maps are loaded through the Loader on first use (usually on map change),
+ * or handed in by the caller once read asynchronously. Improved records are
+ * queued and given to the Writer in one batch per map on flush(), which the
+ * owner calls now and then: a login improving several times meanwhile is
+ * written once. Used from one thread, the Writer is expected to start the
+ * write rather than wait for it, so the callback loop never waits on the
+ * database.
+ */
+class Engine
+{
+  public:
+    using Loader = std::function<std::vector<Record>(const std::string& uid)>;
+    using Writer = std::function<void(
+        const std::string& uid, std::vector<Record> records)>;
+
+    /**
+     * @param loader  Reads every record of a map, e.g.
+     *                database::Manager::loadRecords().
+     * @param writer  Persists improved records, e.g. by starting
+     *                database::Async::saveRecords().
+     * @param maxMaps Number of maps kept in memory, least recently used
+     *                maps are dropped first.
+     */
+    Engine(Loader loader, Writer writer, std::size_t maxMaps = 16);
+
+    Engine(const Engine&) = delete;
+    Engine& operator=(const Engine&) = delete;
+
+    /**
+     * @brief Switches the current map, loading its records if needed.
+     */
+    MapRecords& setCurrentMap(const std::string& uid);
+
+    /**
+     * @brief Switches the current map to records read by the caller, e.g.
+     *        asynchronously. They are ignored if the map is in memory.
+     */
+    MapRecords& setCurrentMap(
+        const std::string& uid, std::vector<Record> records);
+
+    /**
+     * @return true if the records of uid are in memory.
+     */
+    bool contains(const std::string& uid) const;
+
+    /**
+     * @brief Records of the current map, empty until setCurrentMap().
+     */
+    const MapRecords& current() const;
+
+    /**
+     * @brief Submits a finish on the current map and queues it for
+     *        persistence when it improves the login's record. Ignored
+     *        before setCurrentMap().
+     */
+    SubmitResult submit(
+        const std::string& login, std::int32_t time, std::int64_t timestamp);
+
+    /**
+     * @brief Hands every queued record to the Writer, one call per map.
+     */
+    void flush();
+
+  private:
+    Loader loader_;
+    Writer writer_;
+    std::size_t maxMaps_;
+
+    std::map<std::string, std::unique_ptr<MapRecords>> maps_;
+    std::vector<std::string> recentlyUsed_; // most recent last
+    MapRecords* current_ {nullptr};
+    const MapRecords none_ {""}; // current() before any map
+
+    // Pending writes, keyed by map uid then login so that a login improving
+    // several times before the next flush() is only written once.
+    std::map<std::string, std::unordered_map<utils::LoginId, Record>>
+        pending_;
+
+    void touch(const std::string& uid);
+};
+} // namespace records
+
+#endif
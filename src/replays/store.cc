@@ -0,0 +1,480 @@
+#include "store.h"
+
+#include <algorithm>
+#include <ctime>
+#include <filesystem>
+
+#ifdef PLANETPLUS_HAS_ZLIB
+#include <zlib.h>
+#endif
+
+#include "utils/utils.h"
+
+namespace replays
+{
+namespace
+{
+constexpr char kIndexMagic[4] = {'P', 'P', 'R', 'I'};
+constexpr std::uint32_t kIndexVersion = 1;
+constexpr char kObjectMagic[4] = {'P', 'P', 'R', 'O'};
+constexpr std::size_t kObjectHeader = 4 + 1 + 8; // magic, codec, size
+
+// Payload of an object
+constexpr std::uint8_t kRaw = 0;
+constexpr std::uint8_t kDeflate = 1;
+
+// Index file primitives, little endian as written by the host
+template <typename T>
+void put(std::ostream& out, T value)
+{
+    out.write(reinterpret_cast<const char*>(&value), sizeof(value));
+}
+
+void putString(std::ostream& out, std::string_view value)
+{
+    put<std::uint16_t>(out, static_cast<std::uint16_t>(value.size()));
+    out.write(value.data(), static_cast<std::streamsize>(value.size()));
+}
+
+template <typename T>
+bool get(std::istream& in, T& value)
+{
+    return static_cast<bool>(
+        in.read(reinterpret_cast<char*>(&value), sizeof(value)));
+}
+
+bool getString(std::istream& in, std::string& value)
+{
+    std::uint16_t length = 0;
+    if (!get(in, length))
+    {
+        return false;
+    }
+    value.resize(length);
+    return static_cast<bool>(in.read(value.data(), length));
+}
+
+void putEntry(std::ostream& out, std::string_view map, std::string_view login,
+    const Entry& entry, std::uint64_t stored)
+{
+    putString(out, map);
+    putString(out, login);
+    out.write(reinterpret_cast<const char*>(entry.digest.data()),
+        static_cast<std::streamsize>(entry.digest.size()));
+    put(out, entry.time);
+    put(out, entry.timestamp);
+    put(out, entry.size);
+    put(out, stored);
+}
+
+std::uint64_t keyOf(std::uint32_t map, utils::LoginId login)
+{
+    return std::uint64_t {map} << 32 | login;
+}
+} // namespace
+
+Store::Store(std::string directory)
+    : directory_(std::move(directory))
+{
+}
+
+Store::~Store()
+{
+    if (thread_.joinable())
+    {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            stopping_ = true;
+        }
+        wakeUp_.notify_one();
+        thread_.join();
+    }
+}
+
+bool Store::open()
+{
+    std::error_code error;
+    std::filesystem::create_directories(directory_ + "objects", error);
+    if (error)
+    {
+        return false;
+    }
+
+    std::vector<Digest> unused;
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (opened_ || !readIndex(unused))
+    {
+        return opened_;
+    }
+
+    // Most of the index superseded: rewrite it with the live entries only
+    if (indexRecords_ > entries_.size() * 2 + 1024 && !writeIndex())
+    {
+        return false;
+    }
+    bool exists = std::filesystem::exists(directory_ + "index", error);
+    index_.open(directory_ + "index", std::ios::binary | std::ios::app);
+    if (!index_.is_open())
+    {
+        return false;
+    }
+    if (!exists)
+    {
+        index_.write(kIndexMagic, sizeof(kIndexMagic));
+        put(index_, kIndexVersion);
+        index_.flush();
+    }
+
+    // Replaced before a crash could remove them
+    for (const Digest& digest : unused)
+    {
+        if (objects_.find(digest) == objects_.end())
+        {
+            std::filesystem::remove(objectPath(digest), error);
+        }
+    }
+
+    opened_ = true;
+    thread_ = std::thread(&Store::run, this);
+    return true;
+}
+
+void Store::add(std::string_view map, std::string_view login,
+    std::int32_t time, std::string data, Encoding encoding)
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (!opened_ || map.empty() || login.empty())
+    {
+        return;
+    }
+    jobs_.push_back(Job {std::string(map), std::string(login), time,
+        std::move(data), encoding});
+    wakeUp_.notify_one();
+}
+
+std::optional<Entry> Store::find(
+    std::string_view map, std::string_view login) const
+{
+    utils::LoginId id = utils::logins().find(login);
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto mapId = mapIds_.find(map);
+    if (mapId == mapIds_.end() || id == utils::Logins::kNone)
+    {
+        return std::nullopt;
+    }
+    auto it = entries_.find(keyOf(mapId->second, id));
+    if (it == entries_.end())
+    {
+        return std::nullopt;
+    }
+    return it->second;
+}
+
+bool Store::read(const Entry& entry, std::string& data) const
+{
+    std::ifstream in(objectPath(entry.digest), std::ios::binary);
+    char magic[4];
+    std::uint8_t codec = 0;
+    std::uint64_t size = 0;
+    if (!in.read(magic, sizeof(magic)) ||
+        std::memcmp(magic, kObjectMagic, sizeof(magic)) != 0 ||
+        !get(in, codec) || !get(in, size) || size != entry.size)
+    {
+        return false;
+    }
+
+    std::string payload;
+    in.seekg(0, std::ios::end);
+    auto end = static_cast<std::size_t>(in.tellg());
+    in.seekg(kObjectHeader);
+    payload.resize(end - std::min(end, kObjectHeader));
+    auto bytes = static_cast<std::streamsize>(payload.size());
+    if (!in.read(payload.data(), bytes))
+    {
+        return false;
+    }
+
+    if (codec == kRaw)
+    {
+        data = std::move(payload);
+        return data.size() == size;
+    }
+#ifdef PLANETPLUS_HAS_ZLIB
+    if (codec == kDeflate)
+    {
+        data.resize(size);
+        uLongf length = static_cast<uLongf>(size);
+        return ::uncompress(reinterpret_cast<Bytef*>(data.data()), &length,
+                   reinterpret_cast<const Bytef*>(payload.data()),
+                   static_cast<uLong>(payload.size())) == Z_OK &&
+            length == size;
+    }
+#endif
+    return false;
+}
+
+void Store::flush()
+{
+    std::unique_lock<std::mutex> lock(mutex_);
+    done_.wait(lock, [this] { return jobs_.empty() && !busy_; });
+}
+
+StoreStats Store::stats() const
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    StoreStats stats = counters_;
+    stats.entries = entries_.size();
+    stats.objects = objects_.size();
+    return stats;
+}
+
+std::string Store::objectPath(const Digest& digest) const
+{
+    std::string hex = utils::Sha256::toHex(digest);
+    return directory_ + "objects/" + hex.substr(0, 2) + "/" + hex.substr(2);
+}
+
+std::uint32_t Store::mapIdLocked(std::string_view map)
+{
+    auto it = mapIds_.find(map);
+    if (it == mapIds_.end())
+    {
+        auto id = static_cast<std::uint32_t>(mapUids_.size());
+        mapUids_.emplace_back(map);
+        it = mapIds_.emplace(mapUids_.back(), id).first;
+    }
+    return it->second;
+}
+
+std::optional<Digest> Store::applyLocked(std::string_view map,
+    std::string_view login, const Entry& entry, std::uint64_t stored)
+{
+    Object& object = objects_[entry.digest];
+    if (object.refs++ == 0)
+    {
+        object.size = entry.size;
+        object.stored = stored;
+        counters_.storedBytes += stored;
+    }
+    counters_.bytes += entry.size;
+
+    auto [it, inserted] = entries_.try_emplace(
+        keyOf(mapIdLocked(map), utils::logins().intern(login)), entry);
+    if (inserted)
+    {
+        return std::nullopt;
+    }
+    Entry previous = it->second;
+    it->second = entry;
+    counters_.bytes -= previous.size;
+
+    auto old = objects_.find(previous.digest);
+    if (--old->second.refs != 0)
+    {
+        return std::nullopt;
+    }
+    counters_.storedBytes -= old->second.stored;
+    objects_.erase(old);
+    return previous.digest;
+}
+
+bool Store::readIndex(std::vector<Digest>& unused)
+{
+    std::ifstream in(directory_ + "index", std::ios::binary);
+    if (!in.is_open())
+    {
+        return true; // nothing stored yet
+    }
+
+    char magic[4];
+    std::uint32_t version = 0;
+    if (!in.read(magic, sizeof(magic)) ||
+        std::memcmp(magic, kIndexMagic, sizeof(magic)) != 0 ||
+        !get(in, version) || version != kIndexVersion)
+    {
+        return false;
+    }
+
+    // A record cut short by a crash ends the index
+    std::string map;
+    std::string login;
+    Entry entry;
+    std::uint64_t stored = 0;
+    while (getString(in, map) && getString(in, login) &&
+        in.read(reinterpret_cast<char*>(entry.digest.data()),
+            static_cast<std::streamsize>(entry.digest.size())) &&
+        get(in, entry.time) && get(in, entry.timestamp) &&
+        get(in, entry.size) && get(in, stored))
+    {
+        if (std::optional<Digest> removed =
+                applyLocked(map, login, entry, stored))
+        {
+            unused.push_back(*removed);
+        }
+        ++indexRecords_;
+    }
+    return true;
+}
+
+bool Store::writeIndex()
+{
+    std::string path = directory_ + "index";
+    std::string tmpPath = path + ".tmp";
+    {
+        std::ofstream out(tmpPath, std::ios::binary | std::ios::trunc);
+        out.write(kIndexMagic, sizeof(kIndexMagic));
+        put(out, kIndexVersion);
+        for (const auto& [key, entry] : entries_)
+        {
+            putEntry(out, mapUids_[key >> 32],
+                utils::logins().name(static_cast<utils::LoginId>(key)), entry,
+                objects_.at(entry.digest).stored);
+        }
+        if (!out)
+        {
+            return false;
+        }
+    }
+    indexRecords_ = entries_.size();
+    return std::rename(tmpPath.c_str(), path.c_str()) == 0;
+}
+
+bool Store::writeObject(
+    const Digest& digest, const std::string& data, std::uint64_t& stored)
+{
+    std::string path = objectPath(digest);
+    std::error_code error;
+    std::filesystem::create_directories(
+        std::filesystem::path(path).parent_path(), error);
+
+    std::uint8_t codec = kRaw;
+    std::string compressed;
+#ifdef PLANETPLUS_HAS_ZLIB
+    // Replays are partly compressed already: keep whichever is smaller
+    uLongf length = ::compressBound(static_cast<uLong>(data.size()));
+    compressed.resize(length);
+    if (::compress2(reinterpret_cast<Bytef*>(compressed.data()), &length,
+            reinterpret_cast<const Bytef*>(data.data()),
+            static_cast<uLong>(data.size()), Z_DEFAULT_COMPRESSION) == Z_OK &&
+        length < data.size())
+    {
+        compressed.resize(length);
+        codec = kDeflate;
+    }
+#endif
+    const std::string& payload = codec == kRaw ? data : compressed;
+
+    std::string tmpPath = path + ".tmp";
+    {
+        std::ofstream out(tmpPath, std::ios::binary | std::ios::trunc);
+        out.write(kObjectMagic, sizeof(kObjectMagic));
+        put(out, codec);
+        put<std::uint64_t>(out, data.size());
+        out.write(
+            payload.data(), static_cast<std::streamsize>(payload.size()));
+        if (!out)
+        {
+            std::filesystem::remove(tmpPath, error);
+            return false;
+        }
+    }
+    stored = kObjectHeader + payload.size();
+    return std::rename(tmpPath.c_str(), path.c_str()) == 0;
+}
+
+void Store::store(Job& job)
+{
+    if (job.encoding == Encoding::BASE64)
+    {
+        std::string raw;
+        if (!utils::decodeBase64(job.data, raw))
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            ++counters_.failures;
+            return;
+        }
+        job.data = std::move(raw);
+    }
+    if (job.data.empty())
+    {
+        return;
+    }
+
+    Entry entry;
+    entry.digest = utils::Sha256::of(job.data);
+    entry.time = job.time;
+    entry.timestamp = static_cast<std::int64_t>(std::time(nullptr));
+    entry.size = job.data.size();
+
+    std::uint64_t stored = 0;
+    bool exists = false;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        auto mapId = mapIds_.find(job.map);
+        utils::LoginId login = utils::logins().find(job.login);
+        auto best = mapId != mapIds_.end() && login != utils::Logins::kNone
+            ? entries_.find(keyOf(mapId->second, login))
+            : entries_.end();
+        if (best != entries_.end() && best->second.time <= job.time)
+        {
+            return; // a better run was stored meanwhile
+        }
+        auto object = objects_.find(entry.digest);
+        if (object != objects_.end())
+        {
+            exists = true;
+            stored = object->second.stored;
+            ++counters_.duplicates;
+        }
+    }
+
+    if (!exists && !writeObject(entry.digest, job.data, stored))
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        ++counters_.failures;
+        return;
+    }
+    putEntry(index_, job.map, job.login, entry, stored);
+    index_.flush();
+
+    std::optional<Digest> removed;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (!index_)
+        {
+            ++counters_.failures; // kept in memory until the next start
+            index_.clear();
+        }
+        removed = applyLocked(job.map, job.login, entry, stored);
+        ++indexRecords_;
+    }
+    if (removed)
+    {
+        std::error_code error;
+        std::filesystem::remove(objectPath(*removed), error);
+    }
+}
+
+void Store::run()
+{
+    std::unique_lock<std::mutex> lock(mutex_);
+    while (true)
+    {
+        wakeUp_.wait(lock, [this] { return stopping_ || !jobs_.empty(); });
+        if (jobs_.empty())
+        {
+            break; // stopping, and everything queued is done
+        }
+        Job job = std::move(jobs_.front());
+        jobs_.pop_front();
+        busy_ = true;
+        lock.unlock();
+
+        store(job);
+
+        lock.lock();
+        busy_ = false;
+        done_.notify_all();
+    }
+}
+} // namespace replays
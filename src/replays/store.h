@@ -0,0 +1,193 @@
+#ifndef REPLAYS_STORE_H
+#define REPLAYS_STORE_H
+
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <deque>
+#include <fstream>
+#include <functional>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#include "utils/logins.h"
+#include "utils/sha256.h"
+
+namespace replays
+{
+using Digest = utils::Sha256::Digest;
+
+/**
+ * @brief The replay kept for a login on a map.
+ */
+struct Entry
+{
+    Digest digest {};            // names the replay in the objects
+    std::int32_t time {0};       // race time in milliseconds
+    std::int64_t timestamp {0};  // unix time when it was added
+    std::uint64_t size {0};      // bytes of the replay
+};
+
+enum class Encoding
+{
+    RAW,
+    BASE64 // as returned by GetValidationReplay
+};
+
+struct StoreStats
+{
+    std::size_t entries {0};
+    std::size_t objects {0};         // distinct replays on disk
+    std::uint64_t bytes {0};         // of every entry, one file each
+    std::uint64_t storedBytes {0};   // of the objects on disk
+    std::uint64_t duplicates {0};    // replays added that were stored already
+    std::uint64_t failures {0};      // replays that could not be written
+};
+
+/**
+ * @brief Replays of the best run of every login on every map, stored by
+ *        content.
+ *
+ * A replay is named by its SHA-256: the same file added twice, for another
+ * map or login, is stored once and only gains a reference. Objects are
+ * compressed with zlib when planetplus is built with it, and removed with
+ * their last reference. Hashing, compressing and writing happen on a thread
+ * of the store, add() only queues.
+ *
+ * The index, (map uid, login) to digest, is an append-only file read back
+ * into a hash table on open() and compacted there when most of it is
+ * superseded, so finding the replay of a record is one lookup in memory.
+ *
+ *     directory/index
+ *     directory/objects/ab/cdef...  (the rest of the hexadecimal digest)
+ */
+class Store
+{
+  public:
+    /**
+     * @param directory E.g. ~/.local/share/planetplus/replays/
+     */
+    explicit Store(std::string directory);
+
+    /**
+     * @brief Writes what is still queued.
+     */
+    ~Store();
+
+    Store(const Store&) = delete;
+    Store& operator=(const Store&) = delete;
+
+    /**
+     * @brief Creates the directories if needed and reads the index.
+     *
+     * @return false if they cannot be created or the index is invalid,
+     *         add() then does nothing.
+     */
+    bool open();
+
+    /**
+     * @brief Queues the replay of a run of login on map. It only replaces
+     *        the stored one if its time is better.
+     */
+    void add(std::string_view map, std::string_view login, std::int32_t time,
+        std::string data, Encoding encoding = Encoding::RAW);
+
+    /**
+     * @brief Thread safe.
+     */
+    std::optional<Entry> find(
+        std::string_view map, std::string_view login) const;
+
+    /**
+     * @brief Reads and uncompresses the replay of entry.
+     *
+     * @return false if the object is missing or unreadable.
+     */
+    bool read(const Entry& entry, std::string& data) const;
+
+    /**
+     * @brief Waits until what is queued is stored.
+     */
+    void flush();
+
+    StoreStats stats() const;
+
+  private:
+    struct DigestHash
+    {
+        std::size_t operator()(const Digest& digest) const
+        {
+            std::size_t hash;
+            std::memcpy(&hash, digest.data(), sizeof(hash));
+            return hash;
+        }
+    };
+
+    struct Hash
+    {
+        using is_transparent = void;
+        std::size_t operator()(std::string_view value) const
+        {
+            return std::hash<std::string_view>()(value);
+        }
+    };
+
+    struct Object
+    {
+        std::uint32_t refs {0};
+        std::uint64_t size {0};
+        std::uint64_t stored {0}; // bytes of the file
+    };
+
+    struct Job
+    {
+        std::string map;
+        std::string login;
+        std::int32_t time;
+        std::string data;
+        Encoding encoding;
+    };
+
+    std::string directory_;
+
+    mutable std::mutex mutex_;
+    std::unordered_map<std::string, std::uint32_t, Hash, std::equal_to<>>
+        mapIds_;
+    std::vector<std::string> mapUids_; // by id
+    std::unordered_map<std::uint64_t, Entry> entries_; // map id, login id
+    std::unordered_map<Digest, Object, DigestHash> objects_;
+    StoreStats counters_;
+    bool opened_ {false};
+
+    std::deque<Job> jobs_;
+    std::condition_variable wakeUp_;
+    std::condition_variable done_;
+    bool busy_ {false};
+    bool stopping_ {false};
+    std::thread thread_;
+
+    // Only written by the thread once open() returned
+    std::ofstream index_;
+    std::size_t indexRecords_ {0};
+
+    std::string objectPath(const Digest& digest) const;
+    std::uint32_t mapIdLocked(std::string_view map);
+    /// Returns the digest that lost its last reference, if any.
+    std::optional<Digest> applyLocked(std::string_view map,
+        std::string_view login, const Entry& entry, std::uint64_t stored);
+    bool readIndex(std::vector<Digest>& unused);
+    bool writeIndex();
+    bool writeObject(const Digest& digest, const std::string& data,
+        std::uint64_t& stored);
+    void store(Job& job);
+    void run();
+};
+} // namespace replays
+
+#endif
@@ -0,0 +1,660 @@
+#include "gbxremote.h"
+
+#include <fcntl.h>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <cerrno>
+#include <cstring>
+#include <string_view>
+
+#include "cli/tools.h"
+#include "metrics/tracing.h"
+
+namespace server
+{
+namespace
+{
+constexpr std::string_view kProtocol = "GBXRemote 2";
+
+std::uint32_t readU32(const char* data)
+{
+    const auto* bytes = reinterpret_cast<const unsigned char*>(data);
+    return static_cast<std::uint32_t>(bytes[0]) |
+        static_cast<std::uint32_t>(bytes[1]) << 8 |
+        static_cast<std::uint32_t>(bytes[2]) << 16 |
+        static_cast<std::uint32_t>(bytes[3]) << 24;
+}
+
+void writeU32(char* data, std::uint32_t value)
+{
+    data[0] = static_cast<char>(value & 0xFF);
+    data[1] = static_cast<char>((value >> 8) & 0xFF);
+    data[2] = static_cast<char>((value >> 16) & 0xFF);
+    data[3] = static_cast<char>((value >> 24) & 0xFF);
+}
+
+void resumeAll(const std::vector<std::coroutine_handle<>>& handles)
+{
+    for (std::coroutine_handle<> handle : handles)
+    {
+        handle.resume();
+    }
+}
+
+struct AddrInfoDeleter
+{
+    void operator()(addrinfo* info) const
+    {
+        ::freeaddrinfo(info);
+    }
+};
+} // namespace
+
+GbxRemote::CallAwaiter::CallAwaiter(GbxRemote& remote, std::string method,
+    std::vector<xmlrpc::Value> params, Priority priority, std::string key)
+    : remote_(remote)
+    , method_(std::move(method))
+    , params_(std::move(params))
+    , priority_(priority)
+    , key_(std::move(key))
+{
+}
+
+bool GbxRemote::CallAwaiter::await_suspend(std::coroutine_handle<> handle)
+{
+    if (remote_.fd_ < 0)
+    {
+        response_.fault = true;
+        response_.faultCode = -1;
+        response_.faultString = "Not connected";
+        return false;
+    }
+
+    std::uint32_t id = remote_.nextHandle_++;
+    if (remote_.nextHandle_ == 0)
+    {
+        remote_.nextHandle_ = kFirstHandle;
+    }
+    remote_.pending_.emplace(id, Pending {handle, &response_});
+    remote_.send(id, method_, params_, priority_, std::move(key_));
+    return true;
+}
+
+GbxRemote::GbxRemote(core::EventLoop& loop)
+    : loop_(loop)
+    , alive_(std::make_shared<bool>(true))
+{
+}
+
+GbxRemote::~GbxRemote()
+{
+    alive_.reset();
+    close();
+}
+
+core::Task<bool> GbxRemote::connect(std::string host, std::uint16_t port)
+{
+    close();
+
+    addrinfo hints {};
+    hints.ai_family = AF_UNSPEC;
+    hints.ai_socktype = SOCK_STREAM;
+
+    addrinfo* found = nullptr;
+    std::string service = std::to_string(port);
+    int error = ::getaddrinfo(host.c_str(), service.c_str(), &hints, &found);
+    if (error != 0)
+    {
+        cli_tools::printError("Failed to resolve " + cli_tools::bold(host) +
+            ": " + ::gai_strerror(error));
+        co_return false;
+    }
+    std::unique_ptr<addrinfo, AddrInfoDeleter> addresses(found);
+
+    int fd = -1;
+    for (addrinfo* address = addresses.get(); address != nullptr;
+         address = address->ai_next)
+    {
+        fd = ::socket(address->ai_family,
+            address->ai_socktype | SOCK_NONBLOCK | SOCK_CLOEXEC,
+            address->ai_protocol);
+        if (fd < 0)
+        {
+            continue;
+        }
+        if (::connect(fd, address->ai_addr, address->ai_addrlen) == 0)
+        {
+            break;
+        }
+        if (errno == EINPROGRESS)
+        {
+            co_await core::waitFor(loop_, fd, POLLOUT);
+            int status = 0;
+            socklen_t length = sizeof(status);
+            if (::getsockopt(fd, SOL_SOCKET, SO_ERROR, &status, &length) == 0 &&
+                status == 0)
+            {
+                break;
+            }
+        }
+        ::close(fd);
+        fd = -1;
+    }
+
+    if (fd < 0)
+    {
+        cli_tools::printError("Failed to connect to " +
+            cli_tools::bold(host + ":" + service));
+        co_return false;
+    }
+    if (!attach(fd))
+    {
+        co_return false;
+    }
+
+    struct HandshakeAwaiter
+    {
+        GbxRemote& remote;
+
+        bool await_ready() const noexcept
+        {
+            return remote.handshake_ || remote.fd_ < 0;
+        }
+
+        void await_suspend(std::coroutine_handle<> handle) const noexcept
+        {
+            remote.handshakeWaiter_ = handle;
+        }
+
+        void await_resume() const noexcept {}
+    };
+    co_await HandshakeAwaiter {*this};
+    co_return handshake_;
+}
+
+bool GbxRemote::attach(int fd)
+{
+    close();
+
+    int flags = ::fcntl(fd, F_GETFL);
+    if (flags < 0 || ::fcntl(fd, F_SETFL, flags | O_NONBLOCK) < 0)
+    {
+        cli_tools::printError(
+            "Failed to make the server socket non blocking: " +
+            std::string(std::strerror(errno)));
+        ::close(fd);
+        return false;
+    }
+    int noDelay = 1;
+    ::setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &noDelay, sizeof(noDelay));
+
+    fd_ = fd;
+    loop_.watch(fd_, POLLIN, [this](short revents) { onReady(revents); });
+    return true;
+}
+
+GbxRemote::CallAwaiter GbxRemote::call(std::string method,
+    std::vector<xmlrpc::Value> params, Priority priority, std::string key)
+{
+    return CallAwaiter(*this, std::move(method), std::move(params), priority,
+        std::move(key));
+}
+
+void GbxRemote::onCallback(CallbackHandler handler)
+{
+    callbackHandler_ = std::move(handler);
+}
+
+void GbxRemote::onBackpressure(BackpressureHandler handler)
+{
+    backpressureHandler_ = std::move(handler);
+}
+
+void GbxRemote::measure(Priority priority, metrics::Histogram& latency)
+{
+    lanes_[static_cast<std::size_t>(priority)].latency = &latency;
+}
+
+void GbxRemote::close()
+{
+    std::vector<std::coroutine_handle<>> resume;
+    fail(resume, "Connection closed");
+    resumeAll(resume);
+}
+
+bool GbxRemote::connected() const
+{
+    return fd_ >= 0 && handshake_;
+}
+
+std::size_t GbxRemote::pending() const
+{
+    return pending_.size();
+}
+
+std::size_t GbxRemote::queued() const
+{
+    std::size_t bytes = output_.size() - outputOffset_;
+    for (const Lane& lane : lanes_)
+    {
+        bytes += lane.bytes;
+    }
+    return bytes;
+}
+
+LaneStats GbxRemote::lane(Priority priority) const
+{
+    const Lane& lane = lanes_[static_cast<std::size_t>(priority)];
+    return LaneStats {lane.calls, lane.bytes, lane.sent, lane.merged};
+}
+
+bool GbxRemote::congested() const
+{
+    return wantWrite_ || output_.size() - outputOffset_ >= kHighWater;
+}
+
+std::chrono::steady_clock::time_point GbxRemote::receivedAt() const
+{
+    return receivedAt_;
+}
+
+void GbxRemote::send(std::uint32_t handle, const std::string& method,
+    const std::vector<xmlrpc::Value>& params, Priority priority,
+    std::string key)
+{
+    // Encode in place behind a header patched once the size is known
+    tracing::Span span("xmlrpc.encode", method);
+    Lane& lane = lanes_[static_cast<std::size_t>(priority)];
+    std::size_t header = lane.buffer.size();
+    lane.buffer.append(8, '\0');
+    xmlrpc::encodeCall(lane.buffer, method, params);
+    std::size_t size = lane.buffer.size() - header;
+    writeU32(&lane.buffer[header], static_cast<std::uint32_t>(size - 8));
+    writeU32(&lane.buffer[header + 4], handle);
+
+    if (!key.empty())
+    {
+        std::uint64_t seq = lane.firstSeq + lane.frames.size();
+        auto [it, inserted] = lane.keyed.try_emplace(key, seq);
+        if (!inserted)
+        {
+            // Superseded before it went out: its callers wait for this one
+            Frame& old = lane.frames[it->second - lane.firstSeq];
+            old.dropped = true;
+            lane.bytes -= old.size;
+            --lane.calls;
+            ++lane.merged;
+            auto waiting = pending_.find(old.handle);
+            if (waiting != pending_.end())
+            {
+                merged_.emplace(handle, waiting->second);
+                pending_.erase(waiting);
+            }
+            while (auto node = merged_.extract(old.handle))
+            {
+                node.key() = handle;
+                merged_.insert(std::move(node));
+            }
+            it->second = seq;
+        }
+    }
+    lane.frames.push_back(Frame {lane.base + header, size, handle,
+        lane.latency != nullptr ? std::chrono::steady_clock::now()
+                                : std::chrono::steady_clock::time_point(),
+        std::move(key)});
+    lane.bytes += size;
+    ++lane.calls;
+    scheduleFlush();
+}
+
+void GbxRemote::dispatch()
+{
+    auto now = std::chrono::steady_clock::now();
+    for (std::size_t priority = 0; priority < kPriorities; ++priority)
+    {
+        Lane& lane = lanes_[priority];
+        std::size_t spent = 0;
+        while (!lane.frames.empty() &&
+            output_.size() - outputOffset_ < kHighWater)
+        {
+            Frame& frame = lane.frames.front();
+            if (!frame.dropped)
+            {
+                // One frame per round always goes, however large
+                if (spent != 0 && spent + frame.size > kBudgets[priority])
+                {
+                    break;
+                }
+                output_.append(lane.buffer, frame.offset - lane.base,
+                    frame.size);
+                spent += frame.size;
+                lane.bytes -= frame.size;
+                --lane.calls;
+                ++lane.sent;
+                if (lane.latency != nullptr)
+                {
+                    lane.latency->record(static_cast<std::uint64_t>(
+                        std::chrono::duration_cast<std::chrono::microseconds>(
+                            now - frame.queuedAt)
+                            .count()));
+                }
+                auto keyed = frame.key.empty() ? lane.keyed.end()
+                                               : lane.keyed.find(frame.key);
+                if (keyed != lane.keyed.end() && keyed->second == lane.firstSeq)
+                {
+                    lane.keyed.erase(keyed);
+                }
+            }
+            lane.frames.pop_front();
+            ++lane.firstSeq;
+        }
+
+        if (lane.frames.empty())
+        {
+            lane.buffer.clear();
+            lane.base = 0;
+        }
+        else if (lane.frames.front().offset - lane.base >
+            lane.buffer.size() / 2)
+        {
+            std::size_t consumed = lane.frames.front().offset - lane.base;
+            lane.buffer.erase(0, consumed);
+            lane.base += consumed;
+        }
+    }
+}
+
+void GbxRemote::setWantWrite(bool wanted)
+{
+    if (wantWrite_ == wanted || fd_ < 0)
+    {
+        return;
+    }
+    wantWrite_ = wanted;
+    loop_.modify(fd_, wanted ? POLLIN | POLLOUT : POLLIN);
+    if (backpressureHandler_)
+    {
+        backpressureHandler_(wanted);
+    }
+}
+
+void GbxRemote::scheduleFlush()
+{
+    if (flushPosted_ || wantWrite_)
+    {
+        return;
+    }
+    flushPosted_ = true;
+    loop_.post([this, alive = std::weak_ptr<bool>(alive_)] {
+        if (alive.expired())
+        {
+            return;
+        }
+        flushPosted_ = false;
+        flush();
+    });
+}
+
+void GbxRemote::flush()
+{
+    dispatch();
+    while (fd_ >= 0 && outputOffset_ < output_.size())
+    {
+        ssize_t written = ::send(fd_, output_.data() + outputOffset_,
+            output_.size() - outputOffset_, MSG_NOSIGNAL);
+        if (written < 0)
+        {
+            if (errno == EINTR)
+            {
+                continue;
+            }
+            if (errno == EAGAIN || errno == EWOULDBLOCK)
+            {
+                setWantWrite(true);
+                return;
+            }
+
+            std::vector<std::coroutine_handle<>> resume;
+            fail(resume, "Write failed: " + std::string(std::strerror(errno)));
+            resumeAll(resume);
+            return;
+        }
+        outputOffset_ += static_cast<std::size_t>(written);
+    }
+
+    output_.clear();
+    outputOffset_ = 0;
+    setWantWrite(false);
+
+    // Left over by the budgets, for the next round
+    for (const Lane& lane : lanes_)
+    {
+        if (!lane.frames.empty() && fd_ >= 0)
+        {
+            scheduleFlush();
+            break;
+        }
+    }
+}
+
+void GbxRemote::onReady(short revents)
+{
+    if ((revents & POLLOUT) != 0)
+    {
+        flush();
+        if (fd_ < 0)
+        {
+            return;
+        }
+    }
+    if ((revents & (POLLIN | POLLHUP | POLLERR)) == 0)
+    {
+        return;
+    }
+
+    receivedAt_ = std::chrono::steady_clock::now();
+    std::string reason;
+    char buffer[64 * 1024];
+    while (true)
+    {
+        ssize_t received = ::recv(fd_, buffer, sizeof(buffer), 0);
+        if (received > 0)
+        {
+            input_.append(buffer, static_cast<std::size_t>(received));
+            continue;
+        }
+        if (received == 0)
+        {
+            reason = "Connection closed by the server";
+        }
+        else if (errno == EINTR)
+        {
+            continue;
+        }
+        else if (errno != EAGAIN && errno != EWOULDBLOCK)
+        {
+            reason = "Read failed: " + std::string(std::strerror(errno));
+        }
+        break;
+    }
+
+    // Coroutines are resumed last: one of them may well close the client
+    std::vector<std::coroutine_handle<>> resume;
+    if (!readFrames(resume))
+    {
+        reason = "Protocol error";
+    }
+    if (!reason.empty())
+    {
+        fail(resume, reason);
+    }
+    resumeAll(resume);
+}
+
+bool GbxRemote::readFrames(std::vector<std::coroutine_handle<>>& resume)
+{
+    while (fd_ >= 0)
+    {
+        std::size_t available = input_.size() - inputOffset_;
+        const char* data = input_.data() + inputOffset_;
+
+        if (!handshake_)
+        {
+            if (available < 4)
+            {
+                break;
+            }
+            std::uint32_t size = readU32(data);
+            if (size > 64)
+            {
+                return false;
+            }
+            if (available < 4 + size)
+            {
+                break;
+            }
+            if (std::string_view(data + 4, size) != kProtocol)
+            {
+                cli_tools::printError("Unexpected protocol " +
+                    cli_tools::bold(std::string(data + 4, size)) +
+                    ", expected " + std::string(kProtocol));
+                return false;
+            }
+            handshake_ = true;
+            inputOffset_ += 4 + size;
+            if (handshakeWaiter_)
+            {
+                resume.push_back(std::exchange(handshakeWaiter_, nullptr));
+            }
+            continue;
+        }
+
+        if (available < 8)
+        {
+            break;
+        }
+        std::uint32_t size = readU32(data);
+        std::uint32_t handle = readU32(data + 4);
+        if (size > kMaxFrame)
+        {
+            return false;
+        }
+        if (available < 8 + static_cast<std::size_t>(size))
+        {
+            break;
+        }
+        std::string_view xml(data + 8, size);
+        inputOffset_ += 8 + static_cast<std::size_t>(size);
+
+        if ((handle & kFirstHandle) != 0)
+        {
+            auto it = pending_.find(handle);
+            if (it == pending_.end())
+            {
+                continue; // late response of a call made before a reconnect
+            }
+            xmlrpc::Response& response = *it->second.response;
+            tracing::Span span("xmlrpc.decode_response");
+            if (!xmlrpc::decodeResponse(xml, response))
+            {
+                response.fault = true;
+                response.faultCode = -1;
+                response.faultString = "Malformed response";
+            }
+            resume.push_back(it->second.handle);
+            pending_.erase(it);
+            if (!merged_.empty())
+            {
+                auto [first, last] = merged_.equal_range(handle);
+                for (auto waiting = first; waiting != last; ++waiting)
+                {
+                    *waiting->second.response = response;
+                    resume.push_back(waiting->second.handle);
+                }
+                merged_.erase(first, last);
+            }
+        }
+        else if (callbackHandler_)
+        {
+            bool decoded = false;
+            {
+                tracing::Span span("xmlrpc.decode_callback");
+                decoded =
+                    xmlrpc::decodeCall(xml, callbackMethod_, callbackParams_);
+            }
+            if (decoded)
+            {
+                callbackHandler_(callbackMethod_, callbackParams_);
+            }
+        }
+    }
+
+    if (inputOffset_ == input_.size())
+    {
+        input_.clear();
+        inputOffset_ = 0;
+    }
+    else if (inputOffset_ > input_.size() / 2)
+    {
+        input_.erase(0, inputOffset_);
+        inputOffset_ = 0;
+    }
+    return true;
+}
+
+void GbxRemote::fail(
+    std::vector<std::coroutine_handle<>>& resume, const std::string& reason)
+{
+    if (fd_ >= 0)
+    {
+        loop_.unwatch(fd_);
+        ::close(fd_);
+        fd_ = -1;
+    }
+    handshake_ = false;
+    bool congested = std::exchange(wantWrite_, false);
+    input_.clear();
+    inputOffset_ = 0;
+    output_.clear();
+    outputOffset_ = 0;
+    for (Lane& lane : lanes_)
+    {
+        lane.buffer.clear();
+        lane.base = 0;
+        lane.firstSeq += lane.frames.size();
+        lane.frames.clear();
+        lane.keyed.clear();
+        lane.bytes = 0;
+        lane.calls = 0;
+    }
+
+    for (auto& [handle, pending] : pending_)
+    {
+        pending.response->fault = true;
+        pending.response->faultCode = -1;
+        pending.response->faultString = reason;
+        resume.push_back(pending.handle);
+    }
+    pending_.clear();
+    for (auto& [handle, pending] : merged_)
+    {
+        pending.response->fault = true;
+        pending.response->faultCode = -1;
+        pending.response->faultString = reason;
+        resume.push_back(pending.handle);
+    }
+    merged_.clear();
+    if (handshakeWaiter_)
+    {
+        resume.push_back(std::exchange(handshakeWaiter_, nullptr));
+    }
+    if (congested && backpressureHandler_)
+    {
+        backpressureHandler_(false);
+    }
+}
+} // namespace server
@@ -0,0 +1,278 @@
+#ifndef GBXREMOTE_H
+#define GBXREMOTE_H
+
+#include <array>
+#include <chrono>
+#include <coroutine>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <limits>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+#include "core/eventloop.h"
+#include "core/task.h"
+#include "metrics/registry.h"
+#include "server/xmlrpc.h"
+
+namespace server
+{
+/**
+ * @brief Class of an outgoing call, the first one goes out first.
+ */
+enum class Priority : std::uint8_t
+{
+    ADMIN,    // authentication, kicks, bans, map changes
+    GAMEPLAY, // what the game needs to go on
+    CHAT,
+    UI // Manialink pages, superseded by the next update of the same page
+};
+
+constexpr std::size_t kPriorities = 4;
+
+/**
+ * @brief Calls of a priority not written to the socket yet.
+ */
+struct LaneStats
+{
+    std::size_t calls {0};
+    std::size_t bytes {0};
+    std::uint64_t sent {0};
+    std::uint64_t merged {0}; // replaced by a later call with the same key
+};
+
+/**
+ * @brief Client of the GbxRemote 2 protocol spoken by the dedicated server.
+ *
+ * Every frame is a little endian uint32 size, a uint32 handle and an
+ * XML-RPC document. Calls carry a handle with the high bit set and get a
+ * response with the same handle; frames from the server without the high
+ * bit are callbacks.
+ *
+ * Everything runs on the loop the client was created with: call() suspends
+ * the coroutine until the response arrives, so any number of calls can be in
+ * flight at once. Frames written during one round of the loop go out in a
+ * single write().
+ *
+ * Calls wait in one lane per Priority and are moved to the socket buffer
+ * once per round, each lane up to its byte budget, higher priorities
+ * first. While the socket does not take more than kHighWater bytes, calls
+ * stay in their lanes: an admin call made then still overtakes the widgets
+ * queued before it, and a UI update can still replace the one it
+ * supersedes. congested() tells producers to hold back meanwhile.
+ *
+ *     xmlrpc::Response version = co_await remote.call("GetVersion");
+ */
+class GbxRemote
+{
+  public:
+    using CallbackHandler = std::function<void(
+        const std::string& method, const std::vector<xmlrpc::Value>& params)>;
+
+    /**
+     * @brief Called with true when the socket stops taking calls, with
+     *        false once it drained.
+     */
+    using BackpressureHandler = std::function<void(bool congested)>;
+
+    /**
+     * @brief Bytes moved to the socket buffer per lane and round.
+     */
+    static constexpr std::array<std::size_t, kPriorities> kBudgets {
+        std::numeric_limits<std::size_t>::max(), 32 * 1024, 8 * 1024,
+        16 * 1024};
+
+    /**
+     * @brief Bytes in the socket buffer above which calls wait in their
+     *        lanes.
+     */
+    static constexpr std::size_t kHighWater = 64 * 1024;
+
+    class CallAwaiter
+    {
+      public:
+        CallAwaiter(GbxRemote& remote, std::string method,
+            std::vector<xmlrpc::Value> params, Priority priority,
+            std::string key);
+
+        bool await_ready() const noexcept
+        {
+            return false;
+        }
+
+        bool await_suspend(std::coroutine_handle<> handle);
+
+        xmlrpc::Response await_resume()
+        {
+            return std::move(response_);
+        }
+
+      private:
+        GbxRemote& remote_;
+        std::string method_;
+        std::vector<xmlrpc::Value> params_;
+        Priority priority_;
+        std::string key_;
+        xmlrpc::Response response_;
+    };
+
+    explicit GbxRemote(core::EventLoop& loop);
+    ~GbxRemote();
+
+    GbxRemote(const GbxRemote&) = delete;
+    GbxRemote& operator=(const GbxRemote&) = delete;
+
+    /**
+     * @brief Connects and waits for the protocol header.
+     *
+     * @return false if the server is unreachable or does not speak
+     *         GBXRemote 2
+     */
+    core::Task<bool> connect(std::string host, std::uint16_t port);
+
+    /**
+     * @brief Takes ownership of an already connected socket. The protocol
+     *        header is then expected from the other end.
+     */
+    bool attach(int fd);
+
+    /**
+     * @brief co_await call(...): sends the call and resumes with the
+     *        response, or a fault if the connection is lost.
+     *
+     * @param key Names what the call sets, e.g. a page and a login: a call
+     *            of the same priority and key still queued is dropped, and
+     *            its caller resumes with the response of this one.
+     */
+    CallAwaiter call(std::string method,
+        std::vector<xmlrpc::Value> params = {},
+        Priority priority = Priority::GAMEPLAY, std::string key = {});
+
+    void onCallback(CallbackHandler handler);
+    void onBackpressure(BackpressureHandler handler);
+
+    /**
+     * @brief Records how long calls of priority waited in their lane, in
+     *        microseconds.
+     */
+    void measure(Priority priority, metrics::Histogram& latency);
+
+    /**
+     * @brief Closes the connection. Pending calls resume with a fault.
+     */
+    void close();
+
+    bool connected() const;
+
+    /**
+     * @brief Number of calls waiting for their response.
+     */
+    std::size_t pending() const;
+
+    /**
+     * @brief Bytes of calls not written to the socket yet.
+     */
+    std::size_t queued() const;
+
+    LaneStats lane(Priority priority) const;
+
+    /**
+     * @brief True while the socket does not take what is written, calls
+     *        of low priority should wait or be dropped.
+     */
+    bool congested() const;
+
+    /**
+     * @brief When the frames being handled were read off the socket.
+     */
+    std::chrono::steady_clock::time_point receivedAt() const;
+
+  private:
+    struct Pending
+    {
+        std::coroutine_handle<> handle;
+        xmlrpc::Response* response;
+    };
+
+    struct Frame
+    {
+        std::size_t offset; // in the buffer of the lane, see Lane::base
+        std::size_t size;
+        std::uint32_t handle;
+        std::chrono::steady_clock::time_point queuedAt;
+        std::string key;
+        bool dropped {false};
+    };
+
+    struct Hash
+    {
+        using is_transparent = void;
+        std::size_t operator()(std::string_view value) const
+        {
+            return std::hash<std::string_view>()(value);
+        }
+    };
+
+    struct Lane
+    {
+        std::string buffer; // encoded frames, in call order
+        std::size_t base {0}; // offset of buffer[0] since the last clear
+        std::deque<Frame> frames;
+        std::uint64_t firstSeq {0}; // of frames.front()
+        std::unordered_map<std::string, std::uint64_t, Hash, std::equal_to<>>
+            keyed; // key -> seq of the queued frame
+        std::size_t calls {0}; // frames not dropped
+        std::size_t bytes {0}; // of those
+        std::uint64_t sent {0};
+        std::uint64_t merged {0};
+        metrics::Histogram* latency {nullptr};
+    };
+
+    static constexpr std::uint32_t kFirstHandle = 0x80000000;
+    static constexpr std::uint32_t kMaxFrame = 64 * 1024 * 1024;
+
+    core::EventLoop& loop_;
+    int fd_ {-1};
+    bool handshake_ {false};
+    std::coroutine_handle<> handshakeWaiter_;
+    std::uint32_t nextHandle_ {kFirstHandle};
+    std::unordered_map<std::uint32_t, Pending> pending_;
+    // Callers of dropped calls, by the handle of the call replacing them
+    std::unordered_multimap<std::uint32_t, Pending> merged_;
+    std::array<Lane, kPriorities> lanes_;
+    CallbackHandler callbackHandler_;
+    BackpressureHandler backpressureHandler_;
+    std::string callbackMethod_; // reused by every callback, see decodeCall
+    std::vector<xmlrpc::Value> callbackParams_;
+
+    std::string input_;
+    std::size_t inputOffset_ {0};
+    std::chrono::steady_clock::time_point receivedAt_;
+    std::string output_;
+    std::size_t outputOffset_ {0};
+    bool flushPosted_ {false};
+    bool wantWrite_ {false};
+
+    // Expires with the client, guards the flushes posted to the loop
+    std::shared_ptr<bool> alive_;
+
+    void send(std::uint32_t handle, const std::string& method,
+        const std::vector<xmlrpc::Value>& params, Priority priority,
+        std::string key);
+    void dispatch();
+    void setWantWrite(bool wanted);
+    void scheduleFlush();
+    void flush();
+    void onReady(short revents);
+    bool readFrames(std::vector<std::coroutine_handle<>>& resume);
+    void fail(std::vector<std::coroutine_handle<>>& resume,
+        const std::string& reason);
+};
+} // namespace server
+
+#endif
@@ -0,0 +1,989 @@
+#include "shard.h"
+
+#include <pthread.h>
+#include <sched.h>
+
+#include <algorithm>
+#include <array>
+#include <charconv>
+#include <ctime>
+#include <limits>
+#include <memory_resource>
+#include <optional>
+
+#include "cli/tools.h"
+#include "metrics/tracing.h"
+#include "ui/widgets.h"
+
+namespace server
+{
+namespace
+{
+constexpr std::string_view kShardPrefix = "server.";
+constexpr std::string_view kApiVersion = "2013-04-16";
+
+// Mode script events the shard reads, the others are not parsed
+constexpr std::string_view kWayPoint = "Trackmania.Event.WayPoint";
+constexpr std::string_view kGiveUp = "Trackmania.Event.GiveUp";
+constexpr std::string_view kStartRound = "Maniaplanet.StartRound_Start";
+constexpr std::string_view kScores = "Trackmania.Scores";
+
+// Above any real map, the ranking keeps a split row that wide per player
+constexpr std::int64_t kMaxCheckpoints = 1024;
+
+// Label of each Priority in the outbound metrics
+constexpr std::array<const char*, kPriorities> kPriorityNames {
+    "admin", "gameplay", "chat", "ui"};
+
+bool readShard(config::Config& config, const std::string& name,
+    ShardSettings& settings)
+{
+    auto read = [&config, &name](const std::string& key) {
+        std::string section = config.sectionFor("server", key, name);
+        return config.has(section, key) ? config.get(section, key)
+                                        : std::string();
+    };
+
+    settings.name = name;
+    settings.host = read("host");
+    settings.login = read("login");
+    settings.password = read("password");
+
+    std::string port = read("port");
+    if (settings.host.empty())
+    {
+        return false;
+    }
+    if (!port.empty())
+    {
+        auto [ptr, error] = std::from_chars(
+            port.data(), port.data() + port.size(), settings.port);
+        if (error != std::errc() || ptr != port.data() + port.size())
+        {
+            cli_tools::printWarning("Invalid port " + cli_tools::bold(port) +
+                " for server " + cli_tools::bold(name) + ", skipping it.");
+            return false;
+        }
+    }
+    return true;
+}
+
+// Built outside of the coroutines, GCC 12 cannot keep an initializer list
+// alive across a co_await
+std::vector<xmlrpc::Value> single(xmlrpc::Value value)
+{
+    std::vector<xmlrpc::Value> params;
+    params.push_back(std::move(value));
+    return params;
+}
+
+// TriggerModeScriptEventArray("XmlRpc.EnableCallbacks", ["true"])
+std::vector<xmlrpc::Value> modeScriptCallbacks()
+{
+    std::vector<xmlrpc::Value> params;
+    params.emplace_back(std::string("XmlRpc.EnableCallbacks"));
+    params.emplace_back(xmlrpc::Value::Array {xmlrpc::Value("true")});
+    return params;
+}
+
+std::vector<xmlrpc::Value> credentials(
+    const std::string& login, const std::string& password)
+{
+    std::vector<xmlrpc::Value> params;
+    params.emplace_back(login);
+    params.emplace_back(password);
+    return params;
+}
+
+// Only the time of a stored record is known, it goes to the finish
+std::vector<std::int32_t> finishSplits(
+    std::size_t checkpointCount, std::int32_t time)
+{
+    std::vector<std::int32_t> splits(checkpointCount, -1);
+    if (!splits.empty())
+    {
+        splits.back() = time;
+    }
+    return splits;
+}
+} // namespace
+
+std::vector<ShardSettings> ShardSettings::fromConfig(config::Config& config)
+{
+    std::vector<ShardSettings> shards;
+    for (const std::string& section : config.sections())
+    {
+        if (section.size() > kShardPrefix.size() &&
+            section.compare(0, kShardPrefix.size(), kShardPrefix) == 0)
+        {
+            ShardSettings settings;
+            std::string name = section.substr(kShardPrefix.size());
+            if (readShard(config, name, settings))
+            {
+                shards.push_back(std::move(settings));
+            }
+        }
+    }
+
+    if (shards.empty())
+    {
+        ShardSettings settings;
+        if (readShard(config, "default", settings))
+        {
+            shards.push_back(std::move(settings));
+        }
+    }
+    return shards;
+}
+
+Shard::Shard(ShardSettings settings, config::Config& config, Shared shared)
+    : settings_(std::move(settings))
+    , shared_(shared)
+    , remote_(loop_)
+    , rateLimiter_(chat::RateLimitSettings::fromConfig(config, settings_.name))
+    , plugins_(shared_.pluginDirectory, shared_.pool,
+          plugins::Limits::fromConfig(config))
+    , records_({}, recordsWriter())
+    , connects_(metrics::global().counter("planetplus_server_connects_total",
+          "Connections to the dedicated server", {{"shard", settings_.name}}))
+    , disconnects_(metrics::global().counter(
+          "planetplus_server_disconnects_total",
+          "Connections to the dedicated server lost or closed",
+          {{"shard", settings_.name}}))
+    , callbacks_(metrics::global().counter("planetplus_callbacks_total",
+          "Callbacks received from the dedicated server",
+          {{"shard", settings_.name}}))
+    , calls_(metrics::global().counter("planetplus_calls_total",
+          "Calls made to the dedicated server", {{"shard", settings_.name}}))
+    , faults_(metrics::global().counter("planetplus_call_faults_total",
+          "Calls answered with a fault", {{"shard", settings_.name}}))
+    , chatLines_(metrics::global().counter("planetplus_chat_lines_total",
+          "Chat lines and commands accepted", {{"shard", settings_.name}}))
+    , chatRejected_(metrics::global().counter(
+          "planetplus_chat_rejected_total",
+          "Chat lines and commands dropped by the rate limiter",
+          {{"shard", settings_.name}}))
+    , messagesDropped_(metrics::global().counter(
+          "planetplus_messages_dropped_total",
+          "Chat messages to players not sent while congested",
+          {{"shard", settings_.name}}))
+    , connected_(metrics::global().gauge("planetplus_server_connected",
+          "1 while the dedicated server is connected",
+          {{"shard", settings_.name}}))
+    , outboundBytes_(metrics::global().gauge("planetplus_outbound_queue_bytes",
+          "Bytes waiting to be written to the dedicated server",
+          {{"shard", settings_.name}}))
+    , pendingCalls_(metrics::global().gauge("planetplus_pending_calls",
+          "Calls waiting for their response", {{"shard", settings_.name}}))
+    , callbackLag_(metrics::global().histogram(
+          "planetplus_callback_lag_seconds",
+          "Time from reading a callback off the socket to handling it",
+          {{"shard", settings_.name}}, 1e-6))
+    , callbackTime_(metrics::global().histogram(
+          "planetplus_callback_seconds", "Time spent handling a callback",
+          {{"shard", settings_.name}}, 1e-6))
+    , arenaPeak_(metrics::global().gauge("planetplus_arena_peak_bytes",
+          "Most scratch memory one loop tick used",
+          {{"shard", settings_.name}}))
+    , arenaOverflows_(metrics::global().gauge("planetplus_arena_overflows",
+          "Loop ticks whose scratch memory did not fit the arena",
+          {{"shard", settings_.name}}))
+    , congested_(metrics::global().gauge("planetplus_outbound_congested",
+          "1 while the dedicated server does not take what is written",
+          {{"shard", settings_.name}}))
+{
+    for (std::size_t i = 0; i < kPriorities; ++i)
+    {
+        remote_.measure(static_cast<Priority>(i),
+            metrics::global().histogram("planetplus_outbound_wait_seconds",
+                "Time calls waited in their priority lane",
+                {{"shard", settings_.name}, {"class", kPriorityNames[i]}},
+                1e-6));
+    }
+    // Producers of chat and widgets check remote_.congested() themselves
+    remote_.onBackpressure([this](bool congested) {
+        congested_.set(congested ? 1 : 0);
+        if (!congested)
+        {
+            // What changed meanwhile, once the remote is done writing
+            loop_.post([this] { updateUi(); });
+        }
+    });
+    remote_.onCallback(
+        [this](const std::string& method,
+            const std::vector<xmlrpc::Value>& params) {
+            onCallback(method, params);
+        });
+    permissions_.load(config);
+    addCommands();
+    // Plugins chat from pool threads, the call is made from the loop
+    plugins_.setChatSink(
+        [this](const std::string& logins, const std::string& message) {
+            loop_.post([this, logins, message] {
+                core::spawn(tell(logins, message));
+            });
+        });
+    plugins_.loadAll();
+    rateLimiter_.setMuteHook(
+        [this](std::string_view login, std::uint32_t rejected) {
+            log("Muting " + std::string(login) + " after " +
+                std::to_string(rejected) + " rejected messages");
+            core::spawn(ignore(std::string(login)));
+            if (rateLimiter_.muteFor().count() > 0)
+            {
+                loop_.timers().after(rateLimiter_.muteFor(),
+                    [this, login = std::string(login)] {
+                        rateLimiter_.forget(login);
+                        core::spawn(unignore(login));
+                    });
+            }
+        });
+}
+
+Shard::~Shard()
+{
+    stop();
+}
+
+void Shard::start(int cpu)
+{
+    if (!thread_.joinable())
+    {
+        thread_ = std::thread([this, cpu] { run(cpu); });
+    }
+}
+
+void Shard::stop()
+{
+    if (!thread_.joinable())
+    {
+        return;
+    }
+    loop_.post([this] {
+        stopping_ = true;
+        // Its queries are queued now, they run until the database closes
+        records_.flush();
+        remote_.close();
+        loop_.stop();
+    });
+    thread_.join();
+}
+
+const ShardSettings& Shard::settings() const
+{
+    return settings_;
+}
+
+std::future<std::string> Shard::unloadPlugin(std::string name)
+{
+    auto done = std::make_shared<std::promise<std::string>>();
+    std::future<std::string> path = done->get_future();
+    loop_.post([this, done, name = std::move(name)] {
+        std::string file = plugins_.path(name);
+        done->set_value(!file.empty() && plugins_.unload(name) ? file : "");
+    });
+    return path;
+}
+
+std::future<bool> Shard::loadPlugin(std::string path)
+{
+    auto done = std::make_shared<std::promise<bool>>();
+    std::future<bool> loaded = done->get_future();
+    loop_.post([this, done, path = std::move(path)] {
+        done->set_value(plugins_.load(path));
+    });
+    return loaded;
+}
+
+ShardMetrics Shard::metrics() const
+{
+    ShardMetrics metrics;
+    metrics.connects = connects_.value();
+    metrics.disconnects = disconnects_.value();
+    metrics.callbacks = callbacks_.value();
+    metrics.calls = calls_.value();
+    metrics.faults = faults_.value();
+    metrics.chatLines = chatLines_.value();
+    metrics.chatRejected = chatRejected_.value();
+    metrics.connected = connected_.value() != 0;
+    return metrics;
+}
+
+void Shard::run(int cpu)
+{
+#ifdef __linux__
+    if (cpu >= 0)
+    {
+        cpu_set_t set;
+        CPU_ZERO(&set);
+        CPU_SET(cpu, &set);
+        pthread_setaffinity_np(pthread_self(), sizeof(set), &set);
+    }
+#else
+    (void)cpu;
+#endif
+
+    tracing::setThreadName("server " + settings_.name);
+
+    loop_.post([this] {
+        session_ = session().release();
+        session_.resume();
+    });
+    loop_.timers().every(kUiTick, [this] { updateUi(); });
+    loop_.run();
+
+    // Whatever the session was waiting on will not happen anymore
+    if (session_)
+    {
+        session_.destroy();
+        session_ = nullptr;
+    }
+    shared_.karma.close(karma_);
+    karma_ = nullptr;
+}
+
+core::Task<> Shard::session()
+{
+    std::string address =
+        settings_.host + ":" + std::to_string(settings_.port);
+    while (!stopping_)
+    {
+        if (co_await remote_.connect(settings_.host, settings_.port))
+        {
+            bool ready = co_await call("Authenticate",
+                credentials(settings_.login, settings_.password),
+                Priority::ADMIN);
+            ready = ready &&
+                co_await call("SetApiVersion",
+                    single(std::string(kApiVersion)), Priority::ADMIN);
+            ready = ready &&
+                co_await call(
+                    "EnableCallbacks", single(true), Priority::ADMIN);
+            if (ready)
+            {
+                // Fails in legacy modes, which have no script callbacks
+                co_await call("TriggerModeScriptEventArray",
+                    modeScriptCallbacks(), Priority::ADMIN);
+                connected_.set(1);
+                connects_.add();
+                log("Connected to " + address);
+
+                while (remote_.connected() && !stopping_)
+                {
+                    co_await core::sleepFor(loop_, std::chrono::seconds(1));
+                    records_.flush(); // what improved in that second
+                }
+
+                countPlaytime(std::chrono::steady_clock::now());
+                for (const auto& [login, since] : present_)
+                {
+                    ui_.disconnect(utils::logins().name(login));
+                }
+                present_.clear();
+                connected_.set(0);
+                disconnects_.add();
+                if (!stopping_)
+                {
+                    log("Lost the connection to " + address);
+                }
+            }
+            remote_.close();
+        }
+
+        if (!stopping_)
+        {
+            co_await core::sleepFor(loop_, kReconnectDelay);
+        }
+    }
+}
+
+core::Task<bool> Shard::call(std::string method,
+    std::vector<xmlrpc::Value> params, Priority priority, std::string key)
+{
+    calls_.add();
+    xmlrpc::Response response = co_await remote_.call(
+        method, std::move(params), priority, std::move(key));
+    updateGauges();
+    if (response.fault)
+    {
+        faults_.add();
+        if (!stopping_)
+        {
+            log(method + " failed: " + response.faultString);
+        }
+        co_return false;
+    }
+    co_return true;
+}
+
+core::Task<> Shard::changeMap(std::string method)
+{
+    co_await call(std::move(method), {}, Priority::ADMIN);
+}
+
+core::Task<> Shard::ignore(std::string login)
+{
+    co_await call("Ignore", single(xmlrpc::Value(login)), Priority::ADMIN);
+}
+
+core::Task<> Shard::unignore(std::string login)
+{
+    log("Unmuting " + login);
+    co_await call("UnIgnore", single(xmlrpc::Value(login)), Priority::ADMIN);
+}
+
+#ifdef PLANETPLUS_HAS_DATABASE
+core::Task<> Shard::loadRecords(std::string uid)
+{
+    std::vector<records::Record> rows =
+        co_await shared_.database->next().loadRecords(uid);
+    if (!recordsLoading_ || uid != mapUid_)
+    {
+        co_return; // the map changed meanwhile
+    }
+    records_.setCurrentMap(uid, std::move(rows));
+    recordsLoading_ = false;
+    rankRecords();
+    for (records::Record& record : unsubmitted_)
+    {
+        submitRecord(std::move(record));
+    }
+    unsubmitted_.clear();
+}
+
+core::Task<> Shard::saveRecords(
+    std::string uid, std::vector<records::Record> rows)
+{
+    std::size_t count = rows.size();
+    if (co_await shared_.database->next().saveRecords(
+            std::move(uid), std::move(rows)) != 0)
+    {
+        log("Could not save " + std::to_string(count) + " records");
+    }
+}
+#endif
+
+void Shard::submitRecord(records::Record record)
+{
+    records::SubmitResult result =
+        records_.submit(record.login, record.time, record.timestamp);
+    if (!result.improved)
+    {
+        return;
+    }
+
+    // Splits of the run, unless the player started another one meanwhile
+    std::vector<std::int32_t> splits =
+        ranking_.splitsOf(utils::logins().intern(record.login));
+    if (splits.empty() || splits.back() != record.time)
+    {
+        splits = finishSplits(ranking_.checkpointCount(), record.time);
+    }
+    ranking_.setPersonalBest(record.login, splits);
+    if (result.rank == 1)
+    {
+        ranking_.setRecordSplits(splits);
+    }
+    if (result.rank <= ui::kWidgetRows)
+    {
+        recordsChanged_ = true;
+    }
+    log(record.login + " drove the local record " +
+        std::to_string(result.rank) + " in " + std::to_string(record.time) +
+        " ms");
+}
+
+records::Engine::Writer Shard::recordsWriter()
+{
+#ifdef PLANETPLUS_HAS_DATABASE
+    if (shared_.database != nullptr)
+    {
+        // Each batch is one query on the pool, the loop does not wait
+        return [this](const std::string& uid,
+                   std::vector<records::Record> rows) {
+            core::spawn(saveRecords(uid, std::move(rows)));
+        };
+    }
+#endif
+    return {}; // kept in memory only
+}
+
+core::Task<> Shard::tell(std::string login, std::string message)
+{
+    if (remote_.congested())
+    {
+        // Stale by the time it would go out, and it would delay the rest
+        messagesDropped_.add();
+        co_return;
+    }
+    std::vector<xmlrpc::Value> params;
+    params.emplace_back(std::move(message));
+    if (login.empty())
+    {
+        co_await call("ChatSendServerMessage", std::move(params),
+            Priority::CHAT);
+        co_return;
+    }
+    params.emplace_back(std::move(login));
+    co_await call(
+        "ChatSendServerMessageToLogin", std::move(params), Priority::CHAT);
+}
+
+core::Task<> Shard::showPages(ui::Outgoing pages)
+{
+    // Replaces the same pages for the same players if those still wait
+    std::string key = pages.pages + "@" + pages.logins;
+    std::vector<xmlrpc::Value> params;
+    params.emplace_back(std::move(pages.logins));
+    params.emplace_back(std::move(pages.xml));
+    params.emplace_back(0);
+    params.emplace_back(false);
+    co_await call("SendDisplayManialinkPageToLogin", std::move(params),
+        Priority::UI, std::move(key));
+}
+
+core::Task<> Shard::saveReplay(
+    std::string login, std::string map, std::int32_t time)
+{
+    calls_.add();
+    xmlrpc::Response response = co_await remote_.call(
+        "GetValidationReplay", single(xmlrpc::Value(login)));
+    updateGauges();
+    if (response.fault)
+    {
+        faults_.add(); // no replay in every mode, nothing to log
+        co_return;
+    }
+    // Decoded on the thread of the store, with the hashing
+    shared_.replays.add(map, login, time,
+        std::string(response.value.asString()), replays::Encoding::BASE64);
+}
+
+void Shard::onCallback(
+    const std::string& method, const std::vector<xmlrpc::Value>& params)
+{
+    tracing::Span span("callback", method);
+    auto start = std::chrono::steady_clock::now();
+    callbacks_.add();
+    callbackLag_.record(static_cast<std::uint64_t>(
+        std::chrono::duration_cast<std::chrono::microseconds>(
+            start - remote_.receivedAt())
+            .count()));
+    handleCallback(method, params);
+    callbackTime_.recordSince(start);
+    updateGauges();
+}
+
+void Shard::handleCallback(
+    const std::string& method, const std::vector<xmlrpc::Value>& params)
+{
+    if (method == "ManiaPlanet.PlayerChat" && params.size() >= 4)
+    {
+        const std::string& login = params[1].asString();
+        if (params[0].asInt() == 0 || login.empty())
+        {
+            return; // written by the server itself
+        }
+
+        chat::Event event =
+            params[3].asBool() ? chat::Event::COMMAND : chat::Event::CHAT;
+        chat::Verdict verdict = rateLimiter_.check(login, event);
+        if (verdict.decision == chat::Decision::REJECT)
+        {
+            chatRejected_.add();
+            return;
+        }
+        if (verdict.decision == chat::Decision::DELAY)
+        {
+            // Handled once the bucket has refilled for it
+            loop_.timers().after(verdict.delay,
+                [this, login, text = params[2].asString(), event] {
+                    handleChat(login, text, event);
+                });
+            return;
+        }
+        handleChat(login, params[2].asString(), event);
+    }
+    else if (method == "ManiaPlanet.PlayerConnect" && !params.empty())
+    {
+        utils::LoginId login = utils::logins().intern(params[0].asString());
+        join(login);
+        notify(PP_EVENT_PLAYER_CONNECT, params[0].asString());
+        if (!mapUid_.empty() && !recordsLoading_)
+        {
+            rankPersonalBest(login);
+        }
+    }
+    else if (method == "ManiaPlanet.PlayerDisconnect" && !params.empty())
+    {
+        notify(PP_EVENT_PLAYER_DISCONNECT, params[0].asString());
+        ui_.disconnect(params[0].asString());
+        auto it = present_.find(utils::logins().find(params[0].asString()));
+        if (it != present_.end())
+        {
+            auto seconds = std::chrono::duration_cast<std::chrono::seconds>(
+                std::chrono::steady_clock::now() - it->second);
+            shared_.stats.addPlaytime(it->first, mapUid_, seconds.count());
+            present_.erase(it);
+        }
+    }
+    else if (method == "ManiaPlanet.BeginMap" && !params.empty())
+    {
+        // What was played until now goes to the previous map
+        countPlaytime(std::chrono::steady_clock::now());
+        mapUid_.clear();
+        recordsLoading_ = false;
+        unsubmitted_.clear();
+        // Writes the votes of the previous map in one batch
+        shared_.karma.close(karma_);
+        karma_ = nullptr;
+        const xmlrpc::Value* checkpoints = params[0].find("NbCheckpoints");
+        std::vector<utils::LoginId> players;
+        players.reserve(present_.size());
+        for (const auto& [login, since] : present_)
+        {
+            players.push_back(login);
+        }
+        ranking_.newMap(checkpoints != nullptr
+                ? static_cast<std::size_t>(
+                      std::max<std::int64_t>(0, checkpoints->asInt()))
+                : 0,
+            players);
+        rankingChanged_ = true;
+        if (const xmlrpc::Value* uid = params[0].find("UId"))
+        {
+            const maps::MapInfo* map = shared_.maps.findByUid(uid->asString());
+            log("Playing " + (map != nullptr ? map->name : uid->asString()));
+            mapUid_ = uid->asString();
+            karma_ = shared_.karma.open(mapUid_);
+            notify(PP_EVENT_BEGIN_MAP, "", mapUid_);
+#ifdef PLANETPLUS_HAS_DATABASE
+            if (shared_.database != nullptr && !records_.contains(mapUid_))
+            {
+                recordsLoading_ = true;
+                core::spawn(loadRecords(mapUid_));
+            }
+            else
+#endif
+            {
+                records_.setCurrentMap(mapUid_);
+                rankRecords();
+            }
+        }
+    }
+    else if (method == "ManiaPlanet.EndMap" && !params.empty())
+    {
+        if (const xmlrpc::Value* uid = params[0].find("UId"))
+        {
+            notify(PP_EVENT_END_MAP, "", uid->asString());
+        }
+    }
+    else if (method == "ManiaPlanet.ModeScriptCallbackArray" &&
+        params.size() >= 2 && !params[1].asArray().empty())
+    {
+        handleModeScript(
+            params[0].asString(), params[1].asArray()[0].asString());
+    }
+}
+
+void Shard::rankRecords()
+{
+    recordsChanged_ = true;
+    std::vector<records::Record> best = records_.current().top(1);
+    if (!best.empty())
+    {
+        ranking_.setRecordSplits(
+            finishSplits(ranking_.checkpointCount(), best.front().time));
+    }
+    for (const auto& [login, since] : present_)
+    {
+        rankPersonalBest(login);
+    }
+}
+
+void Shard::rankPersonalBest(utils::LoginId login)
+{
+    std::string name(utils::logins().name(login));
+    if (std::optional<records::Record> best = records_.current().find(name))
+    {
+        ranking_.setPersonalBest(
+            name, finishSplits(ranking_.checkpointCount(), best->time));
+    }
+}
+
+void Shard::addCommands()
+{
+    commands_.add({"karma", {}, chat::Permission::PLAYER, 0,
+        "/karma [++|--]",
+        [this](const chat::Context& context, const chat::Arguments& args) {
+            if (karma_ == nullptr)
+            {
+                return;
+            }
+            std::string_view vote = args.empty() ? "" : args[0];
+            if (vote == "++" || vote == "--")
+            {
+                karma_->vote(utils::logins().intern(context.login),
+                    vote == "++" ? karma::Vote::PLUS : karma::Vote::MINUS);
+                return;
+            }
+            karma::Score score = karma_->score();
+            core::spawn(tell(std::string(context.login),
+                "Karma: " + std::to_string(score.percent()) + "% of " +
+                    std::to_string(score.votes()) + " votes"));
+        }});
+    commands_.add({"admin skip", {"skip"}, chat::Permission::ADMIN, 0, "",
+        [this](const chat::Context&, const chat::Arguments&) {
+            core::spawn(changeMap("NextMap"));
+        }});
+    commands_.add({"admin restart", {"restart"}, chat::Permission::ADMIN, 0,
+        "", [this](const chat::Context&, const chat::Arguments&) {
+            core::spawn(changeMap("RestartMap"));
+        }});
+    commands_.add({"admin mute", {"mute"}, chat::Permission::ADMIN, 1,
+        "/admin mute LOGIN",
+        [this](const chat::Context&, const chat::Arguments& args) {
+            core::spawn(ignore(std::string(args[0])));
+        }});
+    commands_.add({"admin unmute", {"unmute"}, chat::Permission::ADMIN, 1,
+        "/admin unmute LOGIN",
+        [this](const chat::Context&, const chat::Arguments& args) {
+            rateLimiter_.forget(args[0]);
+            core::spawn(unignore(std::string(args[0])));
+        }});
+    commands_.add({"help", {}, chat::Permission::PLAYER, 0, "",
+        [this](const chat::Context& context, const chat::Arguments&) {
+            std::string message = "Commands:";
+            for (const chat::Command& command : commands_.commands())
+            {
+                if (command.permission <= context.permission)
+                {
+                    message += " /" + command.name;
+                }
+            }
+            core::spawn(tell(std::string(context.login), message));
+        }});
+    commands_.compile();
+}
+
+void Shard::handleChat(
+    const std::string& login, const std::string& text, chat::Event event)
+{
+    chatLines_.add();
+    std::pmr::string line(core::scratch());
+    line += login;
+    line += ": ";
+    line += text;
+    log(line);
+
+    // A bare "++" or "--" is the usual way to vote, short for "/karma ++"
+    std::string_view command = text;
+    std::pmr::string karma(core::scratch());
+    if (event == chat::Event::CHAT && (text == "++" || text == "--"))
+    {
+        karma = "/karma ";
+        karma += text;
+        command = karma;
+    }
+
+    chat::Context context {
+        login, permissions_.levelOf(std::string_view(login))};
+    chat::Result result = commands_.dispatch(command, context);
+    if (result.status == chat::Status::NOT_A_COMMAND)
+    {
+        notify(PP_EVENT_CHAT, login, text);
+    }
+    else
+    {
+        notify(PP_EVENT_COMMAND, login, command.substr(1));
+    }
+    switch (result.status)
+    {
+        case chat::Status::OK:
+        case chat::Status::NOT_A_COMMAND:
+            break;
+        case chat::Status::UNKNOWN:
+            // Maybe one of a plugin, they see every command
+            if (plugins_.empty())
+            {
+                core::spawn(tell(login, "Unknown command, see /help"));
+            }
+            break;
+        case chat::Status::AMBIGUOUS:
+            core::spawn(tell(login, "Ambiguous command, see /help"));
+            break;
+        case chat::Status::DENIED:
+            core::spawn(tell(login, "You may not use /" +
+                result.command->name));
+            break;
+        case chat::Status::BAD_ARGUMENTS:
+            core::spawn(tell(login, "Usage: " + result.command->usage));
+            break;
+    }
+}
+
+void Shard::handleModeScript(std::string_view name, std::string_view data)
+{
+    if (name != kWayPoint && name != kGiveUp && name != kStartRound &&
+        name != kScores)
+    {
+        return;
+    }
+    if (!json_.parse(data))
+    {
+        log("Invalid JSON in " + std::string(name));
+        return;
+    }
+
+    json::Value event = json_.root();
+    if (name == kWayPoint)
+    {
+        std::string_view login = event.find("login").asString();
+        std::int64_t checkpoint = event.find("checkpointinrace").asInt();
+        std::int64_t time = event.find("racetime").asInt();
+        if (!login.empty() && checkpoint >= 0 &&
+            checkpoint < kMaxCheckpoints && time >= 0 &&
+            time <= std::numeric_limits<std::int32_t>::max())
+        {
+            utils::LoginId id = utils::logins().intern(login);
+            ranking::Update update = ranking_.onCheckpoint(id,
+                static_cast<std::size_t>(checkpoint),
+                static_cast<std::int32_t>(time));
+            if (update.position <= ui::kWidgetRows ||
+                (update.previousPosition != 0 &&
+                    update.previousPosition <= ui::kWidgetRows))
+            {
+                rankingChanged_ = true;
+            }
+            bool finished = event.find("isendrace").asBool();
+            notify(finished ? PP_EVENT_FINISH : PP_EVENT_CHECKPOINT, login, {},
+                time, static_cast<std::int32_t>(checkpoint));
+
+            // Was already there when the shard connected
+            join(id);
+            if (finished && !mapUid_.empty())
+            {
+                shared_.stats.onFinish(id, mapUid_);
+
+                auto time32 = static_cast<std::int32_t>(time);
+                records::Record record {
+                    std::string(login), time32, std::time(nullptr)};
+                if (recordsLoading_)
+                {
+                    unsubmitted_.push_back(std::move(record));
+                }
+                else
+                {
+                    submitRecord(std::move(record));
+                }
+
+                // Only a run better than the stored one is fetched
+                std::optional<replays::Entry> best =
+                    shared_.replays.find(mapUid_, login);
+                if (!best || time32 < best->time)
+                {
+                    core::spawn(
+                        saveReplay(std::string(login), mapUid_, time32));
+                }
+            }
+        }
+    }
+    else if (name == kScores)
+    {
+        std::string_view winner = event.find("winnerplayer").asString();
+        if (event.find("section").asString() == "EndMap" && !winner.empty())
+        {
+            shared_.stats.onWin(utils::logins().intern(winner));
+        }
+    }
+    else if (name == kGiveUp)
+    {
+        utils::LoginId login =
+            utils::logins().find(event.find("login").asString());
+        if (login != utils::Logins::kNone)
+        {
+            ranking_.remove(login);
+            rankingChanged_ = true;
+        }
+    }
+    else
+    {
+        ranking_.newRound();
+        rankingChanged_ = true;
+    }
+}
+
+void Shard::notify(pp_event_type type, std::string_view login,
+    std::string_view text, std::int64_t value, std::int32_t index)
+{
+    if (plugins_.empty())
+    {
+        return; // nothing built for nobody
+    }
+    plugins_.dispatch(plugins::Event {
+        type, std::string(login), std::string(text), value, index});
+}
+
+void Shard::join(utils::LoginId login)
+{
+    if (present_.try_emplace(login, std::chrono::steady_clock::now()).second)
+    {
+        ui_.connect(utils::logins().name(login));
+        // Pages equal to what the others have are only sent to login
+        recordsChanged_ = true;
+        rankingChanged_ = true;
+    }
+}
+
+void Shard::updateUi()
+{
+    // While congested nothing is rendered: the changes add up in the flags
+    // and the pending pages of the engine, and go out as one update
+    if (!remote_.connected() || remote_.congested())
+    {
+        return;
+    }
+    if (recordsChanged_ && !recordsLoading_)
+    {
+        ui_.showAll("records",
+            ui::recordsWidget(records_.current().top(ui::kWidgetRows)));
+        recordsChanged_ = false;
+    }
+    if (rankingChanged_)
+    {
+        ui_.showAll("ranking", ui::rankingWidget(ranking_.standings()));
+        rankingChanged_ = false;
+    }
+    for (ui::Outgoing& pages : ui_.tick(std::chrono::steady_clock::now()))
+    {
+        core::spawn(showPages(std::move(pages)));
+    }
+}
+
+void Shard::countPlaytime(std::chrono::steady_clock::time_point now)
+{
+    for (auto& [login, since] : present_)
+    {
+        // Whole seconds, the rest is counted next time
+        auto seconds =
+            std::chrono::duration_cast<std::chrono::seconds>(now - since);
+        shared_.stats.addPlaytime(login, mapUid_, seconds.count());
+        since += seconds;
+    }
+}
+
+void Shard::log(std::string_view message)
+{
+    shared_.log.write(settings_.name, message);
+}
+
+void Shard::updateGauges()
+{
+    outboundBytes_.set(static_cast<std::int64_t>(remote_.queued()));
+    pendingCalls_.set(static_cast<std::int64_t>(remote_.pending()));
+
+    const core::Arena::Stats& arena = loop_.arena().stats();
+    arenaPeak_.set(static_cast<std::int64_t>(arena.peak));
+    arenaOverflows_.set(static_cast<std::int64_t>(arena.overflows));
+}
+} // namespace server
@@ -0,0 +1,227 @@
+#ifndef SHARD_H
+#define SHARD_H
+
+#include <chrono>
+#include <coroutine>
+#include <cstdint>
+#include <future>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#include "chat/commands.h"
+#include "chat/ratelimit.h"
+#include "core/eventloop.h"
+#include "core/task.h"
+#include "core/threadpool.h"
+#include "karma/karma.h"
+#include "maps/library.h"
+#include "metrics/registry.h"
+#include "plugins/manager.h"
+#include "ranking/live.h"
+#include "records/records.h"
+#include "replays/store.h"
+#include "server/gbxremote.h"
+#include "stats/stats.h"
+#include "ui/manialink.h"
+#include "utils/config.h"
+#include "utils/json.h"
+#include "utils/log.h"
+
+#ifdef PLANETPLUS_HAS_DATABASE
+#include "utils/database.h"
+#endif
+
+namespace server
+{
+/**
+ * @brief Where one dedicated server listens and how to log in.
+ */
+struct ShardSettings
+{
+    std::string name;
+    std::string host;
+    std::uint16_t port {5000};
+    std::string login;
+    std::string password;
+
+    /**
+     * @brief One shard per [server.NAME] section, keys it does not set are
+     *        taken from [server]. Without any, [server] alone is the shard
+     *        "default".
+     */
+    static std::vector<ShardSettings> fromConfig(config::Config& config);
+};
+
+/**
+ * @brief What one shard did since it started, also exported by the metrics
+ *        endpoint with a shard label.
+ */
+struct ShardMetrics
+{
+    std::uint64_t connects {0};
+    std::uint64_t disconnects {0};
+    std::uint64_t callbacks {0};
+    std::uint64_t calls {0};
+    std::uint64_t faults {0};
+    std::uint64_t chatLines {0};
+    std::uint64_t chatRejected {0};
+    bool connected {false};
+};
+
+/**
+ * @brief Process wide resources every shard uses.
+ */
+struct Shared
+{
+    core::ThreadPool& pool;
+    const maps::Library& maps;
+    logging::Writer& log;
+    stats::Aggregator& stats;
+    karma::Tally& karma;
+    replays::Store& replays;
+    std::string pluginDirectory; // every shard loads its plugins from it
+#ifdef PLANETPLUS_HAS_DATABASE
+    database::Pool* database {nullptr};
+#endif
+};
+
+/**
+ * @brief One dedicated server, driven by its own event loop thread.
+ *
+ * Everything about the server (connection, callbacks, rate limits) lives
+ * on that thread and needs no locking; only what is in Shared crosses
+ * shards. The connection is retried until stop().
+ */
+class Shard
+{
+  public:
+    Shard(ShardSettings settings, config::Config& config, Shared shared);
+    ~Shard();
+
+    Shard(const Shard&) = delete;
+    Shard& operator=(const Shard&) = delete;
+
+    /**
+     * @param cpu Core to pin the loop thread to, -1 to let it float.
+     */
+    void start(int cpu = -1);
+
+    /**
+     * @brief Closes the connection and joins the loop thread.
+     */
+    void stop();
+
+    const ShardSettings& settings() const;
+
+    /**
+     * @brief Thread safe.
+     */
+    ShardMetrics metrics() const;
+
+    /**
+     * @brief Thread safe, done on the loop thread. To reload a plugin, it is
+     *        unloaded from every shard first: its library is only closed,
+     *        and a new build of it read, once no shard uses it.
+     *
+     * @return The file of the plugin, empty if the shard has none by that
+     *         name.
+     */
+    std::future<std::string> unloadPlugin(std::string name);
+
+    /**
+     * @brief Thread safe, see unloadPlugin().
+     */
+    std::future<bool> loadPlugin(std::string path);
+
+  private:
+    static constexpr std::chrono::seconds kReconnectDelay {5};
+    static constexpr std::chrono::milliseconds kUiTick {50};
+
+    ShardSettings settings_;
+    Shared shared_;
+    core::EventLoop loop_;
+    GbxRemote remote_;
+    chat::RateLimiter rateLimiter_;
+    chat::Router commands_;
+    chat::Permissions permissions_;
+    plugins::Manager plugins_;
+    ranking::LiveRanking ranking_;
+    records::Engine records_;
+    ui::ManialinkEngine ui_;
+    bool recordsChanged_ {false}; // the widgets are rendered on the UI tick
+    bool rankingChanged_ {false};
+    bool recordsLoading_ {false}; // those of mapUid_, from the database
+    std::vector<records::Record> unsubmitted_; // finished meanwhile
+    json::Parser json_; // mode script payloads, reused for all of them
+    std::string mapUid_;
+    karma::MapVotes* karma_ {nullptr}; // of mapUid_, opened in the tally
+
+    // Players on the server and since when their playtime is not counted
+    std::unordered_map<utils::LoginId, std::chrono::steady_clock::time_point>
+        present_;
+    std::thread thread_;
+    std::coroutine_handle<> session_;
+    bool stopping_ {false};
+
+    // In metrics::global(), labelled with the name of the shard
+    metrics::Counter& connects_;
+    metrics::Counter& disconnects_;
+    metrics::Counter& callbacks_;
+    metrics::Counter& calls_;
+    metrics::Counter& faults_;
+    metrics::Counter& chatLines_;
+    metrics::Counter& chatRejected_;
+    metrics::Counter& messagesDropped_;
+    metrics::Gauge& connected_;
+    metrics::Gauge& outboundBytes_;
+    metrics::Gauge& pendingCalls_;
+    metrics::Histogram& callbackLag_;
+    metrics::Histogram& callbackTime_;
+    metrics::Gauge& arenaPeak_;
+    metrics::Gauge& arenaOverflows_;
+    metrics::Gauge& congested_;
+
+    void run(int cpu);
+    core::Task<> session();
+    core::Task<bool> call(std::string method,
+        std::vector<xmlrpc::Value> params = {},
+        Priority priority = Priority::GAMEPLAY, std::string key = {});
+    core::Task<> changeMap(std::string method);
+    core::Task<> ignore(std::string login);
+    core::Task<> unignore(std::string login);
+    core::Task<> tell(std::string login, std::string message);
+    core::Task<> showPages(ui::Outgoing pages);
+    core::Task<> saveReplay(
+        std::string login, std::string map, std::int32_t time);
+    void onCallback(
+        const std::string& method, const std::vector<xmlrpc::Value>& params);
+    void handleCallback(
+        const std::string& method, const std::vector<xmlrpc::Value>& params);
+#ifdef PLANETPLUS_HAS_DATABASE
+    core::Task<> loadRecords(std::string uid);
+    core::Task<> saveRecords(
+        std::string uid, std::vector<records::Record> rows);
+#endif
+    records::Engine::Writer recordsWriter();
+    void submitRecord(records::Record record);
+    void rankRecords();
+    void rankPersonalBest(utils::LoginId login);
+    void addCommands();
+    void handleChat(
+        const std::string& login, const std::string& text, chat::Event event);
+    void handleModeScript(std::string_view name, std::string_view data);
+    void notify(pp_event_type type, std::string_view login,
+        std::string_view text = {}, std::int64_t value = 0,
+        std::int32_t index = 0);
+    void join(utils::LoginId login);
+    void updateUi();
+    void countPlaytime(std::chrono::steady_clock::time_point now);
+    void log(std::string_view message);
+    void updateGauges();
+};
+} // namespace server
+
+#endif
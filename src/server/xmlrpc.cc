@@ -0,0 +1,750 @@
+#include "xmlrpc.h"
+
+#include <charconv>
+#include <cstdio>
+#include <cstdlib>
+#include <memory_resource>
+
+#include "core/eventloop.h"
+
+namespace xmlrpc
+{
+namespace
+{
+const std::string kEmptyString;
+const Value::Array kEmptyArray;
+const Value::Struct kEmptyStruct;
+
+void appendEscaped(std::string& out, std::string_view text)
+{
+    for (char c : text)
+    {
+        switch (c)
+        {
+            case '&':
+                out += "&amp;";
+                break;
+            case '<':
+                out += "&lt;";
+                break;
+            case '>':
+                out += "&gt;";
+                break;
+            default:
+                out += c;
+        }
+    }
+}
+
+template <typename String>
+void appendUtf8(String& out, unsigned long code)
+{
+    if (code < 0x80)
+    {
+        out += static_cast<char>(code);
+    }
+    else if (code < 0x800)
+    {
+        out += static_cast<char>(0xC0 | (code >> 6));
+        out += static_cast<char>(0x80 | (code & 0x3F));
+    }
+    else if (code < 0x10000)
+    {
+        out += static_cast<char>(0xE0 | (code >> 12));
+        out += static_cast<char>(0x80 | ((code >> 6) & 0x3F));
+        out += static_cast<char>(0x80 | (code & 0x3F));
+    }
+    else
+    {
+        out += static_cast<char>(0xF0 | (code >> 18));
+        out += static_cast<char>(0x80 | ((code >> 12) & 0x3F));
+        out += static_cast<char>(0x80 | ((code >> 6) & 0x3F));
+        out += static_cast<char>(0x80 | (code & 0x3F));
+    }
+}
+
+void encodeValue(std::string& out, const Value& value)
+{
+    out += "<value>";
+    switch (value.type())
+    {
+        case Value::Type::NIL:
+            out += "<nil/>";
+            break;
+        case Value::Type::BOOLEAN:
+            out += value.asBool() ? "<boolean>1</boolean>"
+                                  : "<boolean>0</boolean>";
+            break;
+        case Value::Type::INTEGER:
+        {
+            char buffer[24];
+            auto result = std::to_chars(buffer, buffer + sizeof(buffer),
+                value.asInt());
+            out += "<i4>";
+            out.append(buffer, result.ptr);
+            out += "</i4>";
+            break;
+        }
+        case Value::Type::DOUBLE:
+        {
+            char buffer[32];
+            int length = std::snprintf(buffer, sizeof(buffer), "%.17g",
+                value.asDouble());
+            out += "<double>";
+            out.append(buffer, static_cast<std::size_t>(length));
+            out += "</double>";
+            break;
+        }
+        case Value::Type::STRING:
+            out += "<string>";
+            appendEscaped(out, value.asString());
+            out += "</string>";
+            break;
+        case Value::Type::BASE64:
+            out += "<base64>";
+            out += value.asString();
+            out += "</base64>";
+            break;
+        case Value::Type::ARRAY:
+            out += "<array><data>";
+            for (const Value& element : value.asArray())
+            {
+                encodeValue(out, element);
+            }
+            out += "</data></array>";
+            break;
+        case Value::Type::STRUCT:
+            out += "<struct>";
+            for (const auto& [name, member] : value.asStruct())
+            {
+                out += "<member><name>";
+                appendEscaped(out, name);
+                out += "</name>";
+                encodeValue(out, member);
+                out += "</member>";
+            }
+            out += "</struct>";
+            break;
+    }
+    out += "</value>";
+}
+
+} // namespace
+
+namespace detail
+{
+/**
+ * @brief Just enough XML for XML-RPC: elements, text and entities. No
+ *        attributes are needed, they are skipped.
+ */
+class Parser
+{
+  public:
+    explicit Parser(std::string_view xml)
+        : xml_(xml)
+        , scratch_(core::scratch())
+    {
+    }
+
+    struct Tag
+    {
+        std::string_view name;
+        bool closing {false};
+        bool selfClosing {false};
+    };
+
+    bool failed() const
+    {
+        return failed_;
+    }
+
+    bool next(Tag& tag)
+    {
+        while (true)
+        {
+            skipSpace();
+            if (pos_ >= xml_.size() || xml_[pos_] != '<')
+            {
+                return fail();
+            }
+            if (xml_.compare(pos_, 2, "<?") == 0)
+            {
+                if (!skipPast("?>"))
+                {
+                    return false;
+                }
+                continue;
+            }
+            if (xml_.compare(pos_, 4, "<!--") == 0)
+            {
+                if (!skipPast("-->"))
+                {
+                    return false;
+                }
+                continue;
+            }
+            break;
+        }
+
+        ++pos_;
+        tag.closing = pos_ < xml_.size() && xml_[pos_] == '/';
+        if (tag.closing)
+        {
+            ++pos_;
+        }
+        std::size_t start = pos_;
+        while (pos_ < xml_.size() && xml_[pos_] != '>' && xml_[pos_] != '/' &&
+            xml_[pos_] != ' ' && xml_[pos_] != '\t' && xml_[pos_] != '\r' &&
+            xml_[pos_] != '\n')
+        {
+            ++pos_;
+        }
+        tag.name = xml_.substr(start, pos_ - start);
+
+        std::size_t end = xml_.find('>', pos_);
+        if (end == std::string_view::npos || tag.name.empty())
+        {
+            return fail();
+        }
+        tag.selfClosing = xml_[end - 1] == '/';
+        pos_ = end + 1;
+        return true;
+    }
+
+    bool open(std::string_view name, bool* selfClosing = nullptr)
+    {
+        Tag tag;
+        if (!next(tag) || tag.closing || tag.name != name ||
+            (tag.selfClosing && selfClosing == nullptr))
+        {
+            return fail();
+        }
+        if (selfClosing != nullptr)
+        {
+            *selfClosing = tag.selfClosing;
+        }
+        return true;
+    }
+
+    bool close(std::string_view name)
+    {
+        Tag tag;
+        if (!next(tag) || !tag.closing || tag.name != name)
+        {
+            return fail();
+        }
+        return true;
+    }
+
+    /// Peeks at the next tag without consuming it.
+    bool peek(Tag& tag)
+    {
+        std::size_t saved = pos_;
+        bool found = next(tag);
+        pos_ = saved;
+        failed_ = false;
+        return found;
+    }
+
+    /// Appends the text up to the next element to out, entities decoded.
+    template <typename String>
+    void text(String& out)
+    {
+        while (pos_ < xml_.size() && xml_[pos_] != '<')
+        {
+            if (xml_[pos_] != '&')
+            {
+                std::size_t end = xml_.find_first_of("<&", pos_);
+                end = end == std::string_view::npos ? xml_.size() : end;
+                out.append(xml_.substr(pos_, end - pos_));
+                pos_ = end;
+                continue;
+            }
+
+            std::size_t end = xml_.find_first_of(";<", pos_ + 1);
+            if (end == std::string_view::npos || xml_[end] != ';')
+            {
+                fail();
+                return;
+            }
+            std::string_view entity = xml_.substr(pos_ + 1, end - pos_ - 1);
+            if (entity == "lt")
+                out += '<';
+            else if (entity == "gt")
+                out += '>';
+            else if (entity == "amp")
+                out += '&';
+            else if (entity == "quot")
+                out += '"';
+            else if (entity == "apos")
+                out += '\'';
+            else if (entity.size() > 1 && entity[0] == '#')
+            {
+                bool hex = entity[1] == 'x' || entity[1] == 'X';
+                const char* first = entity.data() + (hex ? 2 : 1);
+                const char* last = entity.data() + entity.size();
+                unsigned long code = 0;
+                auto result = std::from_chars(first, last, code, hex ? 16 : 10);
+                // A character XML allows, whole: no NUL, no surrogate
+                if (first == last || result.ec != std::errc() ||
+                    result.ptr != last || code == 0 || code > 0x10FFFF ||
+                    (code >= 0xD800 && code <= 0xDFFF))
+                {
+                    fail();
+                    return;
+                }
+                appendUtf8(out, code);
+            }
+            else
+            {
+                fail(); // no DTD, so no other entity
+                return;
+            }
+            pos_ = end + 1;
+        }
+    }
+
+    std::size_t position() const
+    {
+        return pos_;
+    }
+
+    void rewind(std::size_t position)
+    {
+        pos_ = position;
+    }
+
+    /// Decodes into out, reusing the memory it has from a previous value.
+    bool value(Value& out, int depth = 0)
+    {
+        if (depth > 64)
+        {
+            return fail();
+        }
+
+        bool empty = false;
+        if (!open("value", &empty))
+        {
+            return false;
+        }
+        out.reset(Value::Type::STRING);
+        if (empty)
+        {
+            return true;
+        }
+
+        // <value>text</value> is a string
+        std::size_t start = pos_;
+        text(out.string_);
+        Tag tag;
+        if (!peek(tag))
+        {
+            return fail();
+        }
+        if (tag.closing && tag.name == "value")
+        {
+            return close("value");
+        }
+        rewind(start);
+        out.string_.clear();
+
+        if (!next(tag) || tag.closing)
+        {
+            return fail();
+        }
+        std::string_view type = tag.name;
+        if (tag.selfClosing)
+        {
+            if (type == "nil")
+                out.reset(Value::Type::NIL);
+            else if (type == "array")
+            {
+                out.reset(Value::Type::ARRAY);
+                out.array_.clear();
+            }
+            else if (type == "struct")
+            {
+                out.reset(Value::Type::STRUCT);
+                out.struct_.clear();
+            }
+            else if (type != "string")
+                return fail();
+            return close("value");
+        }
+
+        if (type == "i4" || type == "int" || type == "i8")
+        {
+            scratch_.clear();
+            text(scratch_);
+            out.reset(Value::Type::INTEGER);
+            const char* last = scratch_.data() + scratch_.size();
+            auto result =
+                std::from_chars(scratch_.data(), last, out.integer_);
+            if (result.ec != std::errc() || result.ptr != last)
+            {
+                return fail();
+            }
+        }
+        else if (type == "boolean")
+        {
+            scratch_.clear();
+            text(scratch_);
+            out.reset(Value::Type::BOOLEAN);
+            out.boolean_ = scratch_ == "1";
+        }
+        else if (type == "double")
+        {
+            scratch_.clear();
+            text(scratch_);
+            out.reset(Value::Type::DOUBLE);
+            out.double_ = std::strtod(scratch_.c_str(), nullptr);
+        }
+        else if (type == "string" || type == "base64")
+        {
+            out.reset(type == "string" ? Value::Type::STRING
+                                       : Value::Type::BASE64);
+            text(out.string_);
+        }
+        else if (type == "array")
+        {
+            out.reset(Value::Type::ARRAY);
+            bool emptyData = false;
+            if (!open("data", &emptyData))
+            {
+                return false;
+            }
+            std::size_t count = 0;
+            while (!emptyData && peek(tag) && !tag.closing)
+            {
+                if (count == out.array_.size())
+                {
+                    out.array_.emplace_back();
+                }
+                if (!value(out.array_[count++], depth + 1))
+                {
+                    return false;
+                }
+            }
+            out.array_.resize(count);
+            if (!emptyData && !close("data"))
+            {
+                return false;
+            }
+        }
+        else if (type == "struct")
+        {
+            out.reset(Value::Type::STRUCT);
+            std::size_t count = 0;
+            while (peek(tag) && !tag.closing)
+            {
+                if (count == out.struct_.size())
+                {
+                    out.struct_.emplace_back();
+                }
+                auto& [name, member] = out.struct_[count++];
+                if (!open("member") || !open("name"))
+                {
+                    return false;
+                }
+                name.clear();
+                text(name);
+                if (!close("name") || !value(member, depth + 1) ||
+                    !close("member"))
+                {
+                    return false;
+                }
+            }
+            out.struct_.resize(count);
+        }
+        else
+        {
+            return fail();
+        }
+
+        return close(type) && close("value");
+    }
+
+  private:
+    std::string_view xml_;
+    std::size_t pos_ {0};
+    bool failed_ {false};
+    std::pmr::string scratch_; // numbers and booleans, before conversion
+
+    bool fail()
+    {
+        failed_ = true;
+        return false;
+    }
+
+    void skipSpace()
+    {
+        while (pos_ < xml_.size() &&
+            (xml_[pos_] == ' ' || xml_[pos_] == '\t' || xml_[pos_] == '\r' ||
+                xml_[pos_] == '\n'))
+        {
+            ++pos_;
+        }
+    }
+
+    bool skipPast(std::string_view marker)
+    {
+        std::size_t end = xml_.find(marker, pos_);
+        if (end == std::string_view::npos)
+        {
+            return fail();
+        }
+        pos_ = end + marker.size();
+        return true;
+    }
+};
+
+} // namespace detail
+
+namespace
+{
+using detail::Parser;
+
+/// Decodes into params, reusing the values it already holds.
+bool decodeParams(Parser& parser, std::vector<Value>& params)
+{
+    bool empty = false;
+    if (!parser.open("params", &empty))
+    {
+        return false;
+    }
+    std::size_t count = 0;
+    Parser::Tag tag;
+    while (!empty && parser.peek(tag) && !tag.closing)
+    {
+        if (count == params.size())
+        {
+            params.emplace_back();
+        }
+        if (!parser.open("param") || !parser.value(params[count++]) ||
+            !parser.close("param"))
+        {
+            return false;
+        }
+    }
+    params.resize(count);
+    return empty || parser.close("params");
+}
+} // namespace
+
+Value::Value(bool value)
+    : type_(Type::BOOLEAN)
+    , boolean_(value)
+{
+}
+
+Value::Value(int value)
+    : type_(Type::INTEGER)
+    , integer_(value)
+{
+}
+
+Value::Value(std::int64_t value)
+    : type_(Type::INTEGER)
+    , integer_(value)
+{
+}
+
+Value::Value(double value)
+    : type_(Type::DOUBLE)
+    , double_(value)
+{
+}
+
+Value::Value(std::string value)
+    : type_(Type::STRING)
+    , string_(std::move(value))
+{
+}
+
+Value::Value(const char* value)
+    : type_(Type::STRING)
+    , string_(value)
+{
+}
+
+Value::Value(Array values)
+    : type_(Type::ARRAY)
+    , array_(std::move(values))
+{
+}
+
+Value::Value(Struct members)
+    : type_(Type::STRUCT)
+    , struct_(std::move(members))
+{
+}
+
+void Value::reset(Type type)
+{
+    type_ = type;
+    boolean_ = false;
+    integer_ = 0;
+    double_ = 0.0;
+    string_.clear();
+}
+
+Value Value::base64(std::string encoded)
+{
+    Value value(std::move(encoded));
+    value.type_ = Type::BASE64;
+    return value;
+}
+
+Value::Type Value::type() const
+{
+    return type_;
+}
+
+bool Value::isNil() const
+{
+    return type_ == Type::NIL;
+}
+
+bool Value::asBool() const
+{
+    return type_ == Type::BOOLEAN ? boolean_ : false;
+}
+
+std::int64_t Value::asInt() const
+{
+    return type_ == Type::INTEGER ? integer_ : 0;
+}
+
+double Value::asDouble() const
+{
+    if (type_ == Type::INTEGER)
+    {
+        return static_cast<double>(integer_);
+    }
+    return type_ == Type::DOUBLE ? double_ : 0.0;
+}
+
+const std::string& Value::asString() const
+{
+    return (type_ == Type::STRING || type_ == Type::BASE64) ? string_
+                                                            : kEmptyString;
+}
+
+const Value::Array& Value::asArray() const
+{
+    return type_ == Type::ARRAY ? array_ : kEmptyArray;
+}
+
+const Value::Struct& Value::asStruct() const
+{
+    return type_ == Type::STRUCT ? struct_ : kEmptyStruct;
+}
+
+const Value* Value::find(std::string_view name) const
+{
+    for (const auto& [key, member] : asStruct())
+    {
+        if (key == name)
+        {
+            return &member;
+        }
+    }
+    return nullptr;
+}
+
+void encodeCall(std::string& out, std::string_view method,
+    const std::vector<Value>& params)
+{
+    out += "<?xml version=\"1.0\" encoding=\"UTF-8\"?><methodCall><methodName>";
+    appendEscaped(out, method);
+    out += "</methodName><params>";
+    for (const Value& param : params)
+    {
+        out += "<param>";
+        encodeValue(out, param);
+        out += "</param>";
+    }
+    out += "</params></methodCall>";
+}
+
+void encodeResponse(std::string& out, const Value& value)
+{
+    out += "<?xml version=\"1.0\" encoding=\"UTF-8\"?><methodResponse><params>"
+           "<param>";
+    encodeValue(out, value);
+    out += "</param></params></methodResponse>";
+}
+
+bool decodeResponse(std::string_view xml, Response& response)
+{
+    Parser parser(xml);
+    if (!parser.open("methodResponse"))
+    {
+        return false;
+    }
+
+    Parser::Tag tag;
+    if (!parser.peek(tag))
+    {
+        return false;
+    }
+    if (tag.name == "fault")
+    {
+        Value fault;
+        if (!parser.open("fault") || !parser.value(fault) ||
+            !parser.close("fault"))
+        {
+            return false;
+        }
+        response.fault = true;
+        response.faultCode = 0; // not left from a previous fault
+        response.faultString.clear();
+        if (const Value* code = fault.find("faultCode"))
+        {
+            response.faultCode = static_cast<std::int32_t>(code->asInt());
+        }
+        if (const Value* text = fault.find("faultString"))
+        {
+            response.faultString = text->asString();
+        }
+    }
+    else
+    {
+        std::vector<Value> params;
+        if (!decodeParams(parser, params))
+        {
+            return false;
+        }
+        response.fault = false;
+        response.value = params.empty() ? Value() : std::move(params[0]);
+    }
+    return parser.close("methodResponse");
+}
+
+bool decodeCall(
+    std::string_view xml, std::string& method, std::vector<Value>& params)
+{
+    Parser parser(xml);
+    if (!parser.open("methodCall") || !parser.open("methodName"))
+    {
+        return false;
+    }
+    method.clear();
+    parser.text(method);
+    if (!parser.close("methodName"))
+    {
+        return false;
+    }
+
+    Parser::Tag tag;
+    if (!parser.peek(tag) || tag.closing)
+    {
+        params.clear();
+    }
+    else if (!decodeParams(parser, params))
+    {
+        return false;
+    }
+    return parser.close("methodCall");
+}
+} // namespace xmlrpc
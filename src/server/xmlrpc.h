@@ -0,0 +1,118 @@
+#ifndef XMLRPC_H
+#define XMLRPC_H
+
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+namespace xmlrpc
+{
+namespace detail
+{
+class Parser;
+}
+
+/**
+ * @brief An XML-RPC value, as used by the dedicated server.
+ *
+ * The decoder fills values in place: decoding into the params of the
+ * previous callback reuses their strings and arrays, so a steady stream
+ * of callbacks of the same shape does not allocate.
+ */
+class Value
+{
+  public:
+    enum class Type
+    {
+        NIL,
+        BOOLEAN,
+        INTEGER,
+        DOUBLE,
+        STRING,
+        BASE64,
+        ARRAY,
+        STRUCT
+    };
+
+    using Array = std::vector<Value>;
+    using Struct = std::vector<std::pair<std::string, Value>>;
+
+    Value() = default;
+    Value(bool value);
+    Value(int value);
+    Value(std::int64_t value);
+    Value(double value);
+    Value(std::string value);
+    Value(const char* value);
+    Value(Array values);
+    Value(Struct members);
+
+    static Value base64(std::string encoded);
+
+    Type type() const;
+    bool isNil() const;
+
+    // Conversions return a default value on a type mismatch
+    bool asBool() const;
+    std::int64_t asInt() const;
+    double asDouble() const;
+    const std::string& asString() const;
+    const Array& asArray() const;
+    const Struct& asStruct() const;
+
+    /**
+     * @brief Member of a struct, nullptr if missing.
+     */
+    const Value* find(std::string_view name) const;
+
+  private:
+    friend class detail::Parser;
+
+    Type type_ {Type::NIL};
+    bool boolean_ {false};
+    std::int64_t integer_ {0};
+    double double_ {0.0};
+    // Not cleared when the type changes, the decoder reuses their memory
+    std::string string_;
+    Array array_;
+    Struct struct_;
+
+    /// Becomes an empty value of type, keeping the memory of the members.
+    void reset(Type type);
+};
+
+/**
+ * @brief A methodResponse: a value, or a fault.
+ */
+struct Response
+{
+    bool fault {false};
+    std::int32_t faultCode {0};
+    std::string faultString;
+    Value value;
+};
+
+/**
+ * @brief Appends a methodCall document to out.
+ */
+void encodeCall(std::string& out, std::string_view method,
+    const std::vector<Value>& params);
+
+/**
+ * @brief Appends a methodResponse document to out.
+ */
+void encodeResponse(std::string& out, const Value& value);
+
+bool decodeResponse(std::string_view xml, Response& response);
+
+/**
+ * @brief Parses a methodCall, e.g. a server callback. method and params are
+ *        overwritten, reusing their memory.
+ */
+bool decodeCall(
+    std::string_view xml, std::string& method, std::vector<Value>& params);
+} // namespace xmlrpc
+
+#endif
@@ -0,0 +1,577 @@
+#include "stats.h"
+
+#include <algorithm>
+#include <unordered_set>
+
+#include "utils/snapshot.h"
+
+namespace stats
+{
+bool Rows::empty() const
+{
+    return players.empty() && maps.empty() && finishers.empty();
+}
+
+bool Aggregator::Key::operator<(const Key& other) const
+{
+    if (wins != other.wins)
+    {
+        return wins > other.wins;
+    }
+    if (mapsFinished != other.mapsFinished)
+    {
+        return mapsFinished > other.mapsFinished;
+    }
+    if (finishes != other.finishes)
+    {
+        return finishes > other.finishes;
+    }
+    return login < other.login;
+}
+
+Aggregator::Aggregator(
+    Writer writer, std::chrono::seconds interval, Writer snapshot)
+    : writer_(std::move(writer))
+    , interval_(interval)
+    , snapshot_(std::move(snapshot))
+{
+    if (writer_ || snapshot_)
+    {
+        thread_ = std::thread(&Aggregator::writerLoop, this);
+    }
+}
+
+Aggregator::~Aggregator()
+{
+    if (thread_.joinable())
+    {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            stopping_ = true;
+        }
+        wakeUp_.notify_one();
+        thread_.join();
+    }
+}
+
+void Aggregator::load(const Rows& rows, bool validated)
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    validated_ = validated;
+    players_.clear();
+    maps_.clear();
+    changedPlayers_.clear();
+    changedMaps_.clear();
+    newFinishers_.clear();
+
+    std::vector<Index::Item> items;
+    players_.reserve(rows.players.size());
+    items.reserve(rows.players.size());
+    for (const auto& [login, stats] : rows.players)
+    {
+        utils::LoginId id = utils::logins().intern(login);
+        auto [it, inserted] = players_.try_emplace(id, Player {stats, false});
+        if (inserted && stats.finishes != 0)
+        {
+            items.emplace_back(keyOf(id, stats), id);
+        }
+    }
+    std::sort(items.begin(), items.end(),
+        [](const Index::Item& a, const Index::Item& b) {
+            return a.first < b.first;
+        });
+    rank_.assign(items);
+
+    for (const auto& [uid, stats] : rows.maps)
+    {
+        maps_[uid].stats = stats;
+    }
+    for (const auto& [uid, login] : rows.finishers)
+    {
+        maps_[uid].finishers.insert(utils::logins().intern(login));
+    }
+}
+
+void Aggregator::reconcile(const Rows& snapshot, const Rows& database)
+{
+    std::unordered_map<std::string_view, const PlayerStats*> players;
+    players.reserve(snapshot.players.size());
+    for (const auto& [login, stats] : snapshot.players)
+    {
+        players.emplace(login, &stats);
+    }
+    std::unordered_map<std::string_view, const MapStats*> maps;
+    maps.reserve(snapshot.maps.size());
+    for (const auto& [uid, stats] : snapshot.maps)
+    {
+        maps.emplace(uid, &stats);
+    }
+    auto grow = [](auto& value, auto saved, auto read) {
+        if (read > saved)
+        {
+            value += read - saved;
+        }
+    };
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    validated_ = true;
+    for (const auto& [name, read] : database.players)
+    {
+        auto it = players.find(name);
+        PlayerStats saved = it != players.end() ? *it->second : PlayerStats();
+        if (it != players.end())
+        {
+            players.erase(it);
+        }
+        if (saved.playtime == read.playtime &&
+            saved.finishes == read.finishes && saved.wins == read.wins &&
+            saved.mapsFinished == read.mapsFinished)
+        {
+            continue;
+        }
+        utils::LoginId login = utils::logins().intern(name);
+        Player& player = playerOf(login);
+        PlayerStats before = player.stats;
+        grow(player.stats.playtime, saved.playtime, read.playtime);
+        grow(player.stats.finishes, saved.finishes, read.finishes);
+        grow(player.stats.wins, saved.wins, read.wins);
+        grow(player.stats.mapsFinished, saved.mapsFinished,
+            read.mapsFinished);
+        update(login, player, before);
+    }
+    for (const auto& [uid, read] : database.maps)
+    {
+        auto it = maps.find(uid);
+        MapStats saved = it != maps.end() ? *it->second : MapStats();
+        if (it != maps.end())
+        {
+            maps.erase(it);
+        }
+        if (saved.playtime == read.playtime &&
+            saved.finishes == read.finishes && saved.players == read.players)
+        {
+            continue;
+        }
+        auto& [key, map] = mapOf(uid);
+        grow(map.stats.playtime, saved.playtime, read.playtime);
+        grow(map.stats.finishes, saved.finishes, read.finishes);
+        grow(map.stats.players, saved.players, read.players);
+        markChanged(key, map);
+    }
+
+    // Only in the snapshot: never written, or lost from the tables
+    for (const auto& [name, stats] : players)
+    {
+        utils::LoginId login = utils::logins().intern(name);
+        markChanged(login, playerOf(login));
+    }
+    for (const auto& [uid, stats] : maps)
+    {
+        auto& [key, map] = mapOf(uid);
+        markChanged(key, map);
+    }
+
+    std::unordered_set<std::string> written;
+    written.reserve(database.finishers.size());
+    for (const auto& [uid, name] : database.finishers)
+    {
+        written.insert(uid + '\0' + name);
+        mapOf(uid).second.finishers.insert(utils::logins().intern(name));
+    }
+    for (const auto& [uid, name] : snapshot.finishers)
+    {
+        if (!written.contains(uid + '\0' + name))
+        {
+            newFinishers_.emplace_back(uid, utils::logins().intern(name));
+        }
+    }
+}
+
+void Aggregator::onFinish(utils::LoginId login, std::string_view map)
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    Player& player = playerOf(login);
+    PlayerStats before = player.stats;
+    auto& [uid, entry] = mapOf(map);
+
+    ++player.stats.finishes;
+    ++entry.stats.finishes;
+    if (entry.finishers.insert(login).second)
+    {
+        ++player.stats.mapsFinished;
+        ++entry.stats.players;
+        newFinishers_.emplace_back(std::string(map), login);
+    }
+    update(login, player, before);
+    markChanged(uid, entry);
+}
+
+void Aggregator::onWin(utils::LoginId login)
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    Player& player = playerOf(login);
+    PlayerStats before = player.stats;
+    ++player.stats.wins;
+    update(login, player, before);
+}
+
+void Aggregator::addPlaytime(
+    utils::LoginId login, std::string_view map, std::int64_t seconds)
+{
+    if (seconds <= 0)
+    {
+        return;
+    }
+    std::lock_guard<std::mutex> lock(mutex_);
+    Player& player = playerOf(login);
+    player.stats.playtime += seconds;
+    markChanged(login, player); // not part of the rank
+    if (!map.empty())
+    {
+        auto& [uid, entry] = mapOf(map);
+        entry.stats.playtime += seconds;
+        markChanged(uid, entry);
+    }
+}
+
+PlayerStats Aggregator::player(utils::LoginId login) const
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto it = players_.find(login);
+    return it != players_.end() ? it->second.stats : PlayerStats();
+}
+
+MapStats Aggregator::map(std::string_view uid) const
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto it = maps_.find(uid);
+    return it != maps_.end() ? it->second.stats : MapStats();
+}
+
+std::size_t Aggregator::rankOf(utils::LoginId login) const
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto it = players_.find(login);
+    if (it == players_.end() || it->second.stats.finishes == 0)
+    {
+        return 0;
+    }
+    return rank_.rank(keyOf(login, it->second.stats));
+}
+
+std::size_t Aggregator::ranked() const
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    return rank_.size();
+}
+
+std::vector<Ranked> Aggregator::top(std::size_t count) const
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    std::vector<Ranked> result;
+    result.reserve(std::min(count, rank_.size()));
+    rank_.forEach(1, count, [&](const Key&, utils::LoginId login) {
+        result.push_back(
+            Ranked {utils::logins().name(login), players_.at(login).stats});
+    });
+    return result;
+}
+
+Rows Aggregator::rows() const
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    return rowsLocked();
+}
+
+Rows Aggregator::takeChanges()
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    return takeChangesLocked();
+}
+
+void Aggregator::restore(const Rows& rows)
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    restoreLocked(rows);
+}
+
+void Aggregator::flush()
+{
+    if (!thread_.joinable())
+    {
+        return;
+    }
+    std::unique_lock<std::mutex> lock(mutex_);
+    std::uint64_t wanted = ++flushes_;
+    wakeUp_.notify_one();
+    written_.wait(lock, [this, wanted] { return writes_ >= wanted; });
+}
+
+Aggregator::Key Aggregator::keyOf(
+    utils::LoginId login, const PlayerStats& stats)
+{
+    return Key {stats.wins, stats.mapsFinished, stats.finishes, login};
+}
+
+Aggregator::Player& Aggregator::playerOf(utils::LoginId login)
+{
+    return players_[login];
+}
+
+Aggregator::Maps::value_type& Aggregator::mapOf(std::string_view uid)
+{
+    auto it = maps_.find(uid);
+    if (it == maps_.end())
+    {
+        it = maps_.emplace(std::string(uid), Map()).first;
+    }
+    return *it;
+}
+
+void Aggregator::update(
+    utils::LoginId login, Player& player, const PlayerStats& before)
+{
+    // Only this player moves: out at its old key, in at its new one
+    if (before.finishes != 0)
+    {
+        rank_.erase(keyOf(login, before));
+    }
+    if (player.stats.finishes != 0)
+    {
+        rank_.insert(keyOf(login, player.stats), login);
+    }
+    markChanged(login, player);
+}
+
+void Aggregator::markChanged(utils::LoginId login, Player& player)
+{
+    if (!player.changed)
+    {
+        player.changed = true;
+        changedPlayers_.push_back(login);
+    }
+}
+
+void Aggregator::markChanged(const std::string& uid, Map& map)
+{
+    if (!map.changed)
+    {
+        map.changed = true;
+        changedMaps_.push_back(uid);
+    }
+}
+
+Rows Aggregator::rowsLocked() const
+{
+    Rows rows;
+    rows.players.reserve(players_.size());
+    for (const auto& [login, player] : players_)
+    {
+        rows.players.emplace_back(
+            std::string(utils::logins().name(login)), player.stats);
+    }
+    rows.maps.reserve(maps_.size());
+    for (const auto& [uid, map] : maps_)
+    {
+        rows.maps.emplace_back(uid, map.stats);
+        for (utils::LoginId login : map.finishers)
+        {
+            rows.finishers.emplace_back(
+                uid, std::string(utils::logins().name(login)));
+        }
+    }
+    return rows;
+}
+
+Rows Aggregator::takeChangesLocked()
+{
+    Rows rows;
+    rows.players.reserve(changedPlayers_.size());
+    for (utils::LoginId login : changedPlayers_)
+    {
+        Player& player = players_.at(login);
+        player.changed = false;
+        rows.players.emplace_back(
+            std::string(utils::logins().name(login)), player.stats);
+    }
+    rows.maps.reserve(changedMaps_.size());
+    for (const std::string& uid : changedMaps_)
+    {
+        Map& map = maps_.at(uid);
+        map.changed = false;
+        rows.maps.emplace_back(uid, map.stats);
+    }
+    rows.finishers.reserve(newFinishers_.size());
+    for (const auto& [uid, login] : newFinishers_)
+    {
+        rows.finishers.emplace_back(
+            uid, std::string(utils::logins().name(login)));
+    }
+
+    changedPlayers_.clear();
+    changedMaps_.clear();
+    newFinishers_.clear();
+    return rows;
+}
+
+void Aggregator::restoreLocked(const Rows& rows)
+{
+    // The values written next are the current ones, only the rows matter
+    for (const auto& row : rows.players)
+    {
+        utils::LoginId login = utils::logins().intern(row.first);
+        markChanged(login, playerOf(login));
+    }
+    for (const auto& row : rows.maps)
+    {
+        auto& [uid, map] = mapOf(row.first);
+        markChanged(uid, map);
+    }
+    for (const auto& [uid, login] : rows.finishers)
+    {
+        newFinishers_.emplace_back(uid, utils::logins().intern(login));
+    }
+}
+
+void Aggregator::writerLoop()
+{
+    std::unique_lock<std::mutex> lock(mutex_);
+    while (true)
+    {
+        wakeUp_.wait_for(lock, interval_,
+            [this] { return stopping_ || flushes_ > writes_; });
+        std::uint64_t wanted = flushes_;
+
+        // Rows written before reconcile() would overwrite newer tables
+        Rows rows = validated_ ? takeChangesLocked() : Rows();
+        if (!rows.empty())
+        {
+            // Taken with the changes, so it never misses one of them
+            Rows all = snapshot_ ? rowsLocked() : Rows();
+            lock.unlock();
+            bool written = !writer_ || writer_(rows);
+            if (written && snapshot_)
+            {
+                snapshot_(all);
+            }
+            lock.lock();
+            if (!written)
+            {
+                restoreLocked(rows);
+            }
+        }
+
+        writes_ = std::max(writes_, wanted);
+        written_.notify_all();
+        if (stopping_)
+        {
+            break;
+        }
+    }
+}
+
+bool saveSnapshot(const std::string& path, const Rows& rows)
+{
+    snapshot::Writer writer;
+    writer.begin(snapshot::Section::STATS_PLAYERS);
+    writer.put<std::uint64_t>(rows.players.size());
+    for (const auto& [login, stats] : rows.players)
+    {
+        writer.putString(login);
+        writer.put(stats.playtime);
+        writer.put(stats.finishes);
+        writer.put(stats.wins);
+        writer.put(stats.mapsFinished);
+    }
+    writer.begin(snapshot::Section::STATS_MAPS);
+    writer.put<std::uint64_t>(rows.maps.size());
+    for (const auto& [uid, stats] : rows.maps)
+    {
+        writer.putString(uid);
+        writer.put(stats.playtime);
+        writer.put(stats.finishes);
+        writer.put(stats.players);
+    }
+    writer.begin(snapshot::Section::STATS_FINISHERS);
+    writer.put<std::uint64_t>(rows.finishers.size());
+    for (const auto& [uid, login] : rows.finishers)
+    {
+        writer.putString(uid);
+        writer.putString(login);
+    }
+    return writer.save(path);
+}
+
+bool loadSnapshot(const std::string& path, Rows& rows)
+{
+    snapshot::Reader reader;
+    if (!reader.open(path))
+    {
+        return false;
+    }
+    auto players = reader.section(snapshot::Section::STATS_PLAYERS);
+    auto maps = reader.section(snapshot::Section::STATS_MAPS);
+    auto finishers = reader.section(snapshot::Section::STATS_FINISHERS);
+    if (!players || !maps || !finishers)
+    {
+        return false;
+    }
+
+    // Counts come from the file: reserve no more than it can hold
+    std::uint64_t count = 0;
+    if (!players->get(count))
+    {
+        return false;
+    }
+    rows.players.clear();
+    rows.players.reserve(std::min<std::uint64_t>(count, 1 << 20));
+    for (std::uint64_t i = 0; i < count; ++i)
+    {
+        std::string_view login;
+        PlayerStats stats;
+        if (!players->getString(login) || !players->get(stats.playtime) ||
+            !players->get(stats.finishes) || !players->get(stats.wins) ||
+            !players->get(stats.mapsFinished))
+        {
+            return false;
+        }
+        rows.players.emplace_back(std::string(login), stats);
+    }
+
+    if (!maps->get(count))
+    {
+        return false;
+    }
+    rows.maps.clear();
+    rows.maps.reserve(std::min<std::uint64_t>(count, 1 << 20));
+    for (std::uint64_t i = 0; i < count; ++i)
+    {
+        std::string_view uid;
+        MapStats stats;
+        if (!maps->getString(uid) || !maps->get(stats.playtime) ||
+            !maps->get(stats.finishes) || !maps->get(stats.players))
+        {
+            return false;
+        }
+        rows.maps.emplace_back(std::string(uid), stats);
+    }
+
+    if (!finishers->get(count))
+    {
+        return false;
+    }
+    rows.finishers.clear();
+    rows.finishers.reserve(std::min<std::uint64_t>(count, 1 << 20));
+    for (std::uint64_t i = 0; i < count; ++i)
+    {
+        std::string_view uid;
+        std::string_view login;
+        if (!finishers->getString(uid) || !finishers->getString(login))
+        {
+            return false;
+        }
+        rows.finishers.emplace_back(std::string(uid), std::string(login));
+    }
+    return true;
+}
+} // namespace stats
@@ -0,0 +1,254 @@
+#ifndef STATS_H
+#define STATS_H
+
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <unordered_map>
+#include <unordered_set>
+#include <utility>
+#include <vector>
+
+#include "utils/logins.h"
+#include "utils/rankindex.h"
+
+namespace stats
+{
+/**
+ * @brief Totals of a login over every map and server.
+ */
+struct PlayerStats
+{
+    std::int64_t playtime {0};    // seconds
+    std::uint32_t finishes {0};
+    std::uint32_t wins {0};       // maps won
+    std::uint32_t mapsFinished {0};
+};
+
+/**
+ * @brief Totals of a map over every player.
+ */
+struct MapStats
+{
+    std::int64_t playtime {0}; // seconds, all players together
+    std::uint32_t finishes {0};
+    std::uint32_t players {0}; // logins who finished it
+};
+
+/**
+ * @brief Rows as they are stored, see Aggregator::load() and
+ *        Aggregator::takeChanges().
+ */
+struct Rows
+{
+    std::vector<std::pair<std::string, PlayerStats>> players;
+    std::vector<std::pair<std::string, MapStats>> maps;
+    std::vector<std::pair<std::string, std::string>> finishers; // map, login
+
+    bool empty() const;
+};
+
+/**
+ * @brief A line of the server ranking, see Aggregator::top().
+ */
+struct Ranked
+{
+    std::string_view login; // the copy of utils::logins(), never dangles
+    PlayerStats stats;
+};
+
+/**
+ * @brief Player and map statistics maintained from events instead of
+ *        aggregate queries.
+ *
+ * Counters are updated as finishes, wins and playtime come in. Changed rows
+ * are remembered and written every interval by the Writer, on a thread of
+ * the aggregator; the tables are only read back on a cold start, see load().
+ *
+ * The server rank orders players with a finish by wins, then maps
+ * finished, then finishes. It is kept in a RankIndex updated for the
+ * changed player only, so an event costs O(log n) whatever the number of
+ * players. Thread safe.
+ */
+class Aggregator
+{
+  public:
+    /**
+     * @brief Persists rows, false to keep them for the next attempt.
+     */
+    using Writer = std::function<bool(const Rows& rows)>;
+
+    static constexpr std::chrono::seconds kDefaultInterval {60};
+
+    /**
+     * @param writer   E.g. database::Manager::saveStats(), none to keep
+     *                 the statistics in memory only.
+     * @param interval Time between two writes.
+     * @param snapshot Given every row after each write, e.g. saveSnapshot(),
+     *                 to start again from it instead of the tables.
+     */
+    explicit Aggregator(Writer writer = {},
+        std::chrono::seconds interval = kDefaultInterval,
+        Writer snapshot = {});
+    ~Aggregator();
+
+    Aggregator(const Aggregator&) = delete;
+    Aggregator& operator=(const Aggregator&) = delete;
+
+    /**
+     * @brief Replaces the content with rows read from the tables. Nothing
+     *        loaded is considered changed.
+     *
+     * @param validated false for rows of a snapshot, which may be behind
+     *                  the tables: nothing is written until reconcile().
+     */
+    void load(const Rows& rows, bool validated = true);
+
+    /**
+     * @brief Brings what was loaded from a snapshot up to the tables, read
+     *        after the start.
+     *
+     * Counters only grow, so what the tables have more than the snapshot,
+     * written by another server since, is added to the current values.
+     * Rows that differ are written again, the tables then agree with
+     * memory whichever was ahead.
+     *
+     * @param snapshot The rows given to load().
+     * @param database The rows read from the tables.
+     */
+    void reconcile(const Rows& snapshot, const Rows& database);
+
+    /**
+     * @brief A finish of login on map.
+     */
+    void onFinish(utils::LoginId login, std::string_view map);
+
+    /**
+     * @brief login won a map.
+     */
+    void onWin(utils::LoginId login);
+
+    void addPlaytime(
+        utils::LoginId login, std::string_view map, std::int64_t seconds);
+
+    /**
+     * @brief Zeros for a login or map never seen.
+     */
+    PlayerStats player(utils::LoginId login) const;
+    MapStats map(std::string_view uid) const;
+
+    /**
+     * @brief 1-based server rank of login, 0 without any finish.
+     */
+    std::size_t rankOf(utils::LoginId login) const;
+
+    /**
+     * @brief Players with a server rank.
+     */
+    std::size_t ranked() const;
+
+    /**
+     * @brief The count first players of the server ranking.
+     */
+    std::vector<Ranked> top(std::size_t count) const;
+
+    /**
+     * @brief Every row, with its current value.
+     */
+    Rows rows() const;
+
+    /**
+     * @brief Rows changed since the last call, with their current values.
+     */
+    Rows takeChanges();
+
+    /**
+     * @brief Marks rows as changed again, after a write that failed.
+     */
+    void restore(const Rows& rows);
+
+    /**
+     * @brief Writes the changes now, then waits until they are written.
+     */
+    void flush();
+
+  private:
+    struct Player
+    {
+        PlayerStats stats;
+        bool changed {false};
+    };
+
+    struct Map
+    {
+        MapStats stats;
+        std::unordered_set<utils::LoginId> finishers;
+        bool changed {false};
+    };
+
+    /// Best first: more wins, then more maps finished, then more finishes
+    struct Key
+    {
+        std::uint32_t wins;
+        std::uint32_t mapsFinished;
+        std::uint32_t finishes;
+        utils::LoginId login; // tie-break, keys must be unique
+
+        bool operator<(const Key& other) const;
+    };
+
+    using Index = utils::RankIndex<Key, utils::LoginId>;
+    using Maps = std::map<std::string, Map, std::less<>>;
+
+    mutable std::mutex mutex_;
+    std::unordered_map<utils::LoginId, Player> players_;
+    Maps maps_;
+    Index rank_;
+    std::vector<utils::LoginId> changedPlayers_;
+    std::vector<std::string> changedMaps_;
+    std::vector<std::pair<std::string, utils::LoginId>> newFinishers_;
+
+    Writer writer_;
+    std::chrono::seconds interval_;
+    Writer snapshot_;
+    std::condition_variable wakeUp_;
+    std::condition_variable written_;
+    std::uint64_t flushes_ {0}; // requested
+    std::uint64_t writes_ {0};  // done
+    bool stopping_ {false};
+    bool validated_ {true};
+    std::thread thread_;
+
+    static Key keyOf(utils::LoginId login, const PlayerStats& stats);
+    Player& playerOf(utils::LoginId login);
+    Maps::value_type& mapOf(std::string_view uid);
+    void update(utils::LoginId login, Player& player,
+        const PlayerStats& before);
+    void markChanged(utils::LoginId login, Player& player);
+    void markChanged(const std::string& uid, Map& map);
+    Rows rowsLocked() const;
+    Rows takeChangesLocked();
+    void restoreLocked(const Rows& rows);
+    void writerLoop();
+};
+
+/**
+ * @brief Writes rows to a snapshot file, see snapshot::Writer.
+ */
+bool saveSnapshot(const std::string& path, const Rows& rows);
+
+/**
+ * @brief Reads rows from a snapshot file.
+ *
+ * @return false if it is missing, damaged or from another version.
+ */
+bool loadSnapshot(const std::string& path, Rows& rows);
+} // namespace stats
+
+#endif
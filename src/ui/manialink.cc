@@ -0,0 +1,206 @@
+#include "manialink.h"
+
+#include <memory_resource>
+#include <utility>
+
+#include "core/eventloop.h"
+
+#include "metrics/tracing.h"
+
+namespace ui
+{
+namespace
+{
+std::uint64_t hashOf(std::string_view xml)
+{
+    return std::hash<std::string_view>()(xml);
+}
+
+void appendPage(
+    std::pmr::string& out, std::string_view id, const std::string& xml)
+{
+    out += "<manialink id=\"";
+    out += id;
+    out += "\" version=\"3\">";
+    out += xml;
+    out += "</manialink>";
+}
+} // namespace
+
+ManialinkEngine::ManialinkEngine(std::chrono::milliseconds interval)
+    : interval_(interval)
+    , empty_ {std::make_shared<const std::string>(), hashOf("")}
+{
+}
+
+void ManialinkEngine::connect(std::string_view login)
+{
+    if (players_.find(login) == players_.end())
+    {
+        players_.emplace(std::string(login), Player());
+    }
+}
+
+void ManialinkEngine::disconnect(std::string_view login)
+{
+    auto it = players_.find(login);
+    if (it != players_.end())
+    {
+        players_.erase(it);
+    }
+}
+
+void ManialinkEngine::show(
+    std::string_view login, std::string_view id, std::string xml)
+{
+    auto it = players_.find(login);
+    if (it == players_.end())
+    {
+        return;
+    }
+    std::uint64_t hash = hashOf(xml);
+    queue(it->second, id,
+        Page {std::make_shared<const std::string>(std::move(xml)), hash});
+}
+
+void ManialinkEngine::showAll(std::string_view id, std::string xml)
+{
+    std::uint64_t hash = hashOf(xml);
+    Page page {std::make_shared<const std::string>(std::move(xml)), hash};
+    for (auto& [login, player] : players_)
+    {
+        queue(player, id, page);
+    }
+}
+
+void ManialinkEngine::hide(std::string_view login, std::string_view id)
+{
+    auto it = players_.find(login);
+    if (it != players_.end())
+    {
+        queue(it->second, id, empty_);
+    }
+}
+
+void ManialinkEngine::hideAll(std::string_view id)
+{
+    for (auto& [login, player] : players_)
+    {
+        queue(player, id, empty_);
+    }
+}
+
+std::vector<Outgoing> ManialinkEngine::tick(Clock::time_point now)
+{
+    tracing::Span span("ui.tick");
+    std::vector<Outgoing> outgoing;
+    std::pmr::unordered_map<std::uint64_t, std::pmr::vector<std::size_t>>
+        byPayload(core::scratch());
+    std::pmr::string xml(core::scratch());
+    std::pmr::string pages(core::scratch());
+
+    for (auto& [login, player] : players_)
+    {
+        if (player.pending.empty() || now - player.lastSent < interval_)
+        {
+            continue; // throttled pages wait, newer updates replace them
+        }
+
+        xml.clear();
+        pages.clear();
+        xml += "<manialinks>";
+        for (auto& [id, page] : player.pending)
+        {
+            appendPage(xml, id, *page.xml);
+            pages += pages.empty() ? "" : ",";
+            pages += id;
+            if (page.xml->empty())
+            {
+                player.sent.erase(id); // hidden, same as never shown
+            }
+            else
+            {
+                player.sent.insert_or_assign(id, page);
+            }
+        }
+        xml += "</manialinks>";
+        counters_.pagesSent += player.pending.size();
+        player.pending.clear();
+        player.lastSent = now;
+
+        // Players with the same pages share one call
+        std::pmr::vector<std::size_t>& candidates = byPayload[hashOf(xml)];
+        bool merged = false;
+        for (std::size_t index : candidates)
+        {
+            if (std::string_view(outgoing[index].xml) == xml)
+            {
+                outgoing[index].logins += ',';
+                outgoing[index].logins += login;
+                counters_.bytesSaved += xml.size();
+                merged = true;
+                break;
+            }
+        }
+        if (!merged)
+        {
+            candidates.push_back(outgoing.size());
+            outgoing.push_back(
+                {login, std::string(pages), std::string(xml)});
+        }
+    }
+
+    counters_.calls += outgoing.size();
+    for (const Outgoing& call : outgoing)
+    {
+        counters_.bytesSent += call.xml.size();
+    }
+    return outgoing;
+}
+
+std::size_t ManialinkEngine::players() const
+{
+    return players_.size();
+}
+
+const UiCounters& ManialinkEngine::counters() const
+{
+    return counters_;
+}
+
+void ManialinkEngine::queue(
+    Player& player, std::string_view id, const Page& page)
+{
+    // Content is compared once the hashes match, a collision is not taken
+    // for an unchanged page
+    auto sent = player.sent.find(id);
+    const Page& current = sent == player.sent.end() ? empty_ : sent->second;
+
+    auto pending = player.pending.find(id);
+    if (pending != player.pending.end())
+    {
+        ++counters_.pagesSuperseded;
+        counters_.bytesSaved += pending->second.xml->size();
+        if (page == current)
+        {
+            // Back to what the player already has
+            ++counters_.pagesSuppressed;
+            counters_.bytesSaved += page.xml->size();
+            player.pending.erase(pending);
+        }
+        else
+        {
+            pending->second = page;
+        }
+        return;
+    }
+
+    if (page == current)
+    {
+        ++counters_.pagesSuppressed;
+        counters_.bytesSaved += page.xml->size();
+        return;
+    }
+    player.pending.emplace(std::string(id), page);
+}
+} // namespace ui
@@ -0,0 +1,134 @@
+#ifndef MANIALINK_H
+#define MANIALINK_H
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+namespace ui
+{
+/**
+ * @brief One SendDisplayManialinkPageToLogin call.
+ */
+struct Outgoing
+{
+    std::string logins; // comma separated
+    std::string pages;  // ids of the pages in xml, comma separated
+    std::string xml;    // <manialinks> holding every changed page
+};
+
+/**
+ * @brief What the engine did since it was created.
+ */
+struct UiCounters
+{
+    std::uint64_t pagesSent {0};
+    std::uint64_t pagesSuppressed {0}; // identical to what the player has
+    std::uint64_t pagesSuperseded {0}; // replaced before they were sent
+    std::uint64_t calls {0};           // Outgoing returned by tick()
+    std::uint64_t bytesSent {0};
+    std::uint64_t bytesSaved {0}; // compared to sending every page update
+};
+
+/**
+ * @brief Sends Manialink pages to players, only when they changed.
+ *
+ * For every player the engine retains each page as last sent, with its
+ * hash. show() and hide() only queue the new state; a page equal to what
+ * the player already has is dropped (the hash only spares comparing
+ * content that differs), a page replaced before it went out is
+ * never sent. tick() then builds at most one payload per player, no more
+ * often than the update interval, and players getting the same payload
+ * (broadcast widgets) share a single call.
+ *
+ * Driven from the server loop, not thread safe.
+ */
+class ManialinkEngine
+{
+  public:
+    using Clock = std::chrono::steady_clock;
+
+    /**
+     * @param interval Minimum time between two payloads to a player.
+     */
+    explicit ManialinkEngine(
+        std::chrono::milliseconds interval = std::chrono::milliseconds(250));
+
+    void connect(std::string_view login);
+
+    /**
+     * @brief Forgets everything about login, pages are gone with the player.
+     */
+    void disconnect(std::string_view login);
+
+    /**
+     * @brief Queues page id for login.
+     *
+     * @param xml Content of the <manialink> element.
+     */
+    void show(std::string_view login, std::string_view id, std::string xml);
+
+    /**
+     * @brief Queues page id for every connected player.
+     */
+    void showAll(std::string_view id, std::string xml);
+
+    void hide(std::string_view login, std::string_view id);
+    void hideAll(std::string_view id);
+
+    /**
+     * @brief Builds the calls to send now, once per loop tick.
+     */
+    std::vector<Outgoing> tick(Clock::time_point now);
+
+    std::size_t players() const;
+    const UiCounters& counters() const;
+
+  private:
+    using Content = std::shared_ptr<const std::string>;
+
+    struct Page
+    {
+        Content xml; // shared by every player of a showAll()
+        std::uint64_t hash;
+
+        bool operator==(const Page& other) const
+        {
+            return hash == other.hash &&
+                (xml == other.xml || *xml == *other.xml);
+        }
+    };
+
+    struct Hash
+    {
+        using is_transparent = void;
+        std::size_t operator()(std::string_view value) const
+        {
+            return std::hash<std::string_view>()(value);
+        }
+    };
+
+    struct Player
+    {
+        // Page id -> what the player has, hidden pages are not in it
+        std::unordered_map<std::string, Page, Hash, std::equal_to<>> sent;
+        std::map<std::string, Page, std::less<>> pending;
+        Clock::time_point lastSent {};
+    };
+
+    std::chrono::milliseconds interval_;
+    std::unordered_map<std::string, Player, Hash, std::equal_to<>> players_;
+    Page empty_;
+    UiCounters counters_;
+
+    void queue(Player& player, std::string_view id, const Page& page);
+};
+} // namespace ui
+
+#endif
@@ -0,0 +1,65 @@
+#include "template.h"
+
+#include <cstring>
+
+namespace ui
+{
+void appendEscaped(std::string& out, std::string_view text)
+{
+    // Nicknames rarely need escaping, copy runs of plain characters at once
+    std::size_t start = 0;
+    for (std::size_t i = 0; i < text.size(); ++i)
+    {
+        const char* entity;
+        switch (text[i])
+        {
+            case '&':
+                entity = "&amp;";
+                break;
+            case '<':
+                entity = "&lt;";
+                break;
+            case '>':
+                entity = "&gt;";
+                break;
+            case '"':
+                entity = "&quot;";
+                break;
+            case '\'':
+                entity = "&apos;";
+                break;
+            default:
+                continue;
+        }
+        out.append(text.data() + start, i - start);
+        out.append(entity, std::strlen(entity));
+        start = i + 1;
+    }
+    out.append(text.data() + start, text.size() - start);
+}
+
+void appendTime(std::string& out, std::int32_t time)
+{
+    std::uint32_t value;
+    if (time < 0)
+    {
+        out += '-';
+        value = static_cast<std::uint32_t>(-static_cast<std::int64_t>(time));
+    }
+    else
+    {
+        value = static_cast<std::uint32_t>(time);
+    }
+
+    std::uint32_t minutes = value / 60000;
+    std::uint32_t seconds = value / 1000 % 60;
+    std::uint32_t millis = value % 1000;
+    appendInteger(out, minutes);
+    char tail[7] = {':', static_cast<char>('0' + seconds / 10),
+        static_cast<char>('0' + seconds % 10), '.',
+        static_cast<char>('0' + millis / 100),
+        static_cast<char>('0' + millis / 10 % 10),
+        static_cast<char>('0' + millis % 10)};
+    out.append(tail, sizeof(tail));
+}
+} // namespace ui
@@ -0,0 +1,220 @@
+#ifndef TEMPLATE_H
+#define TEMPLATE_H
+
+#include <array>
+#include <charconv>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+
+namespace ui
+{
+/**
+ * @brief A string literal usable as a template argument.
+ */
+template <std::size_t N>
+struct FixedString
+{
+    char data[N] {};
+
+    constexpr FixedString(const char (&text)[N])
+    {
+        for (std::size_t i = 0; i < N; ++i)
+        {
+            data[i] = text[i];
+        }
+    }
+
+    constexpr std::size_t size() const
+    {
+        return N - 1;
+    }
+
+    constexpr std::string_view view() const
+    {
+        return std::string_view(data, N - 1);
+    }
+};
+
+/**
+ * @brief Appends text with the XML special characters escaped.
+ */
+void appendEscaped(std::string& out, std::string_view text);
+
+/**
+ * @brief Appends a race time in milliseconds as m:ss.mmm.
+ */
+void appendTime(std::string& out, std::int32_t time);
+
+template <typename T>
+void appendInteger(std::string& out, T value)
+{
+    char buffer[24];
+    auto result = std::to_chars(buffer, buffer + sizeof(buffer), value);
+    out.append(buffer, result.ptr);
+}
+
+namespace detail
+{
+struct Chunk
+{
+    std::size_t offset {0};
+    std::size_t length {0};
+};
+
+constexpr bool isHoleKind(char kind)
+{
+    return kind == 's' || kind == 'r' || kind == 'i' || kind == 't';
+}
+
+/// Number of holes, fails to compile on a malformed one.
+constexpr std::size_t countHoles(std::string_view source)
+{
+    std::size_t holes = 0;
+    for (std::size_t i = 0; i + 1 < source.size(); ++i)
+    {
+        if (source[i] == '{' && source[i + 1] == '{')
+        {
+            if (i + 4 >= source.size() || !isHoleKind(source[i + 2]) ||
+                source[i + 3] != '}' || source[i + 4] != '}')
+            {
+                throw "malformed hole, expected {{s}}, {{r}}, {{i}} or {{t}}";
+            }
+            ++holes;
+            i += 4;
+        }
+    }
+    return holes;
+}
+
+template <std::size_t Holes>
+struct Layout
+{
+    std::array<Chunk, Holes + 1> chunks {};
+    std::array<char, Holes> kinds {};
+};
+
+template <std::size_t Holes>
+constexpr Layout<Holes> parse(std::string_view source)
+{
+    Layout<Holes> layout;
+    std::size_t hole = 0;
+    std::size_t start = 0;
+    for (std::size_t i = 0; i + 1 < source.size(); ++i)
+    {
+        if (source[i] == '{' && source[i + 1] == '{')
+        {
+            layout.chunks[hole] = {start, i - start};
+            layout.kinds[hole] = source[i + 2];
+            ++hole;
+            i += 4;
+            start = i + 1;
+        }
+    }
+    layout.chunks[Holes] = {start, source.size() - start};
+    return layout;
+}
+} // namespace detail
+
+/**
+ * @brief Manialink template compiled at build time.
+ *
+ * The source is split at compile time into literal chunks and typed holes:
+ *
+ *     {{s}}  text, XML escaped        {{i}}  integer
+ *     {{r}}  raw XML, e.g. rows       {{t}}  race time in ms, as m:ss.mmm
+ *
+ * render() is then a sequence of appends of the literal chunks and of the
+ * formatted arguments, into a buffer the caller reuses. The argument count
+ * and types are checked against the holes at compile time.
+ *
+ *     using Row = ui::Template<"<label text=\"{{i}}. {{s}}\"/>">;
+ *     Row::render(buffer, rank, nickname);
+ */
+template <FixedString Source>
+class Template
+{
+  public:
+    static constexpr std::size_t kHoles = detail::countHoles(Source.view());
+
+    /**
+     * @brief Appends the template, with its holes filled in order, to out.
+     */
+    template <typename... Args>
+    static void render(std::string& out, const Args&... args)
+    {
+        static_assert(sizeof...(Args) == kHoles,
+            "the number of arguments must match the number of holes");
+        renderHoles(out, std::forward_as_tuple(args...),
+            std::make_index_sequence<kHoles>());
+        appendChunk<kHoles>(out);
+    }
+
+    /**
+     * @brief Size of the literal parts, a lower bound of a rendering.
+     */
+    static constexpr std::size_t literalSize()
+    {
+        return Source.size() - kHoles * 5;
+    }
+
+  private:
+    static constexpr detail::Layout<kHoles> kLayout =
+        detail::parse<kHoles>(Source.view());
+
+    template <std::size_t I>
+    static void appendChunk(std::string& out)
+    {
+        constexpr detail::Chunk chunk = kLayout.chunks[I];
+        if constexpr (chunk.length != 0)
+        {
+            out.append(Source.data + chunk.offset, chunk.length);
+        }
+    }
+
+    template <std::size_t I, typename T>
+    static void appendHole(std::string& out, const T& value)
+    {
+        constexpr char kind = kLayout.kinds[I];
+        if constexpr (kind == 's' || kind == 'r')
+        {
+            static_assert(std::is_convertible_v<const T&, std::string_view>,
+                "{{s}} and {{r}} holes take strings");
+            if constexpr (kind == 's')
+            {
+                appendEscaped(out, std::string_view(value));
+            }
+            else
+            {
+                out.append(std::string_view(value));
+            }
+        }
+        else
+        {
+            static_assert(std::is_integral_v<T> && !std::is_same_v<T, bool>,
+                "{{i}} and {{t}} holes take integers");
+            if constexpr (kind == 'i')
+            {
+                appendInteger(out, value);
+            }
+            else
+            {
+                appendTime(out, static_cast<std::int32_t>(value));
+            }
+        }
+    }
+
+    template <typename Tuple, std::size_t... I>
+    static void renderHoles(
+        std::string& out, const Tuple& args, std::index_sequence<I...>)
+    {
+        ((appendChunk<I>(out), appendHole<I>(out, std::get<I>(args))), ...);
+    }
+};
+} // namespace ui
+
+#endif
@@ -0,0 +1,52 @@
+#include "widgets.h"
+
+#include <algorithm>
+#include <string_view>
+
+#include "template.h"
+
+namespace ui
+{
+namespace
+{
+// Shared by the widgets, filled by rows of records or of standings
+using Frame = Template<
+    "<frame pos=\"{{r}}\" z-index=\"1\"><quad size=\"50 50\" "
+    "bgcolor=\"0008\"/><label pos=\"25 -2\" halign=\"center\" "
+    "textsize=\"2\" text=\"{{s}}\"/>{{r}}</frame>">;
+using Row = Template<
+    "<frame pos=\"0 -{{i}}\"><label pos=\"2 0\" size=\"6 4\" "
+    "textsize=\"1\" text=\"{{i}}.\"/><label pos=\"9 0\" size=\"26 4\" "
+    "textsize=\"1\" text=\"{{s}}\"/><label pos=\"48 0\" halign=\"right\" "
+    "size=\"12 4\" textsize=\"1\" text=\"{{t}}\"/></frame>">;
+
+template <typename Entries>
+std::string render(std::string_view position, std::string_view title,
+    const Entries& entries)
+{
+    std::size_t count = std::min(entries.size(), kWidgetRows);
+    std::string rows;
+    rows.reserve(count * (Row::literalSize() + 32));
+    for (std::size_t i = 0; i < count; ++i)
+    {
+        Row::render(rows, 8 + i * 4, i + 1,
+            std::string_view(entries[i].login), entries[i].time);
+    }
+    std::string xml;
+    xml.reserve(Frame::literalSize() + position.size() + title.size() +
+        rows.size());
+    Frame::render(xml, position, title, rows);
+    return xml;
+}
+} // namespace
+
+std::string recordsWidget(const std::vector<records::Record>& records)
+{
+    return render("-160 80", "Local records", records);
+}
+
+std::string rankingWidget(const std::vector<ranking::Standing>& standings)
+{
+    return render("110 80", "Live", standings);
+}
+} // namespace ui
@@ -0,0 +1,29 @@
+#ifndef WIDGETS_H
+#define WIDGETS_H
+
+#include <cstddef>
+#include <string>
+#include <vector>
+
+#include "ranking/live.h"
+#include "records/records.h"
+
+namespace ui
+{
+/// Rows shown by the widgets of the shard.
+constexpr std::size_t kWidgetRows = 10;
+
+/**
+ * @brief Content of the "records" page: the best local records of the map,
+ *        best first.
+ */
+std::string recordsWidget(const std::vector<records::Record>& records);
+
+/**
+ * @brief Content of the "ranking" page: the live standings of the round,
+ *        first the leader.
+ */
+std::string rankingWidget(const std::vector<ranking::Standing>& standings);
+} // namespace ui
+
+#endif
@@ -0,0 +1,297 @@
+#include <catch2/catch.hpp>
+
+#include <chrono>
+#include <filesystem>
+#include <fstream>
+#include <string>
+#include <vector>
+
+#include "chat/commands.h"
+#include "chat/ratelimit.h"
+#include "utils/config.h"
+
+namespace
+{
+struct Ran
+{
+    std::string command;
+    std::vector<std::string> arguments;
+};
+
+chat::Handler record(Ran& ran, const std::string& name)
+{
+    return [&ran, name](const chat::Context&, const chat::Arguments& args) {
+        ran.command = name;
+        ran.arguments.clear();
+        for (std::size_t i = 0; i < args.size(); ++i)
+        {
+            ran.arguments.emplace_back(args[i]);
+        }
+    };
+}
+
+void addCommands(chat::Router& router, Ran& ran)
+{
+    router.add({"rec", {}, chat::Permission::PLAYER, 0, "",
+        record(ran, "rec")});
+    router.add({"records", {}, chat::Permission::PLAYER, 0, "",
+        record(ran, "records")});
+    router.add({"karma", {}, chat::Permission::PLAYER, 0, "",
+        record(ran, "karma")});
+    router.add({"admin skip", {"skip"}, chat::Permission::ADMIN, 0, "",
+        record(ran, "admin skip")});
+    router.add({"admin restart", {"restart", "res"},
+        chat::Permission::ADMIN, 0, "", record(ran, "admin restart")});
+    router.add({"admin remove", {}, chat::Permission::MASTERADMIN, 1,
+        "/admin remove MAP", record(ran, "admin remove")});
+    router.compile();
+}
+
+const chat::Context kPlayer {"player", chat::Permission::PLAYER};
+const chat::Context kAdmin {"admin", chat::Permission::ADMIN};
+const chat::Context kOwner {"owner", chat::Permission::OWNER};
+} // namespace
+
+TEST_CASE("Router matches command words and prefixes", "[chat][router]")
+{
+    chat::Router router;
+    Ran ran;
+    addCommands(router, ran);
+
+    SECTION("plain chat is not a command")
+    {
+        CHECK(router.dispatch("gg", kPlayer).status ==
+            chat::Status::NOT_A_COMMAND);
+        CHECK(ran.command.empty());
+    }
+
+    SECTION("a whole word wins over the longer ones it prefixes")
+    {
+        CHECK(router.dispatch("/rec", kPlayer).status == chat::Status::OK);
+        CHECK(ran.command == "rec");
+    }
+
+    SECTION("an unambiguous prefix runs its command")
+    {
+        CHECK(router.dispatch("/reco", kPlayer).status == chat::Status::OK);
+        CHECK(ran.command == "records");
+        CHECK(router.dispatch("/adm sk", kAdmin).status == chat::Status::OK);
+        CHECK(ran.command == "admin skip");
+    }
+
+    SECTION("words are matched without case")
+    {
+        CHECK(router.dispatch("/KARMA", kPlayer).status == chat::Status::OK);
+        CHECK(ran.command == "karma");
+    }
+
+    SECTION("arguments follow the command words")
+    {
+        CHECK(router.dispatch("/karma ++ \"great map\"", kPlayer).status ==
+            chat::Status::OK);
+        REQUIRE(ran.arguments.size() == 2);
+        CHECK(ran.arguments[0] == "++");
+        CHECK(ran.arguments[1] == "great map");
+    }
+
+    SECTION("unknown commands")
+    {
+        CHECK(router.dispatch("/nope", kPlayer).status ==
+            chat::Status::UNKNOWN);
+        CHECK(router.dispatch("/", kPlayer).status == chat::Status::UNKNOWN);
+        CHECK(ran.command.empty());
+    }
+}
+
+TEST_CASE("Router reports ambiguous prefixes", "[chat][router]")
+{
+    chat::Router router;
+    Ran ran;
+    addCommands(router, ran);
+
+    // restart and remove, but also the alias res of restart
+    chat::Result result = router.dispatch("/admin re", kOwner);
+    CHECK(result.status == chat::Status::AMBIGUOUS);
+    CHECK(result.command == nullptr);
+    CHECK(ran.command.empty());
+
+    CHECK(router.dispatch("/admin rest", kOwner).status == chat::Status::OK);
+    CHECK(ran.command == "admin restart");
+}
+
+TEST_CASE("Router runs aliases as their command", "[chat][router]")
+{
+    chat::Router router;
+    Ran ran;
+    addCommands(router, ran);
+
+    chat::Result result = router.dispatch("/skip", kAdmin);
+    CHECK(result.status == chat::Status::OK);
+    REQUIRE(result.command != nullptr);
+    CHECK(result.command->name == "admin skip");
+    CHECK(ran.command == "admin skip");
+
+    // Exact aliases even when they prefix another word
+    CHECK(router.dispatch("/res", kAdmin).status == chat::Status::OK);
+    CHECK(ran.command == "admin restart");
+}
+
+TEST_CASE("Router checks permissions and arguments", "[chat][router]")
+{
+    chat::Router router;
+    Ran ran;
+    addCommands(router, ran);
+
+    chat::Result denied = router.dispatch("/skip", kPlayer);
+    CHECK(denied.status == chat::Status::DENIED);
+    REQUIRE(denied.command != nullptr);
+    CHECK(denied.command->name == "admin skip");
+    CHECK(ran.command.empty());
+
+    CHECK(router.dispatch("/admin remove abc", kAdmin).status ==
+        chat::Status::DENIED);
+
+    chat::Result missing = router.dispatch("/admin remove", kOwner);
+    CHECK(missing.status == chat::Status::BAD_ARGUMENTS);
+    REQUIRE(missing.command != nullptr);
+    CHECK(missing.command->usage == "/admin remove MAP");
+    CHECK(ran.command.empty());
+
+    CHECK(router.dispatch("/admin remove abc", kOwner).status ==
+        chat::Status::OK);
+    CHECK(ran.arguments == std::vector<std::string> {"abc"});
+}
+
+TEST_CASE("RateLimiter allows a burst then delays then rejects",
+    "[chat][ratelimit]")
+{
+    using namespace std::chrono_literals;
+
+    // 1 line per second, 5 at once, waits of up to 2 s
+    chat::RateLimitSettings settings;
+    settings.muteAfter = 0;
+    chat::RateLimiter limiter(settings);
+    auto now = chat::RateLimiter::Clock::now() + 1s;
+
+    for (int i = 0; i < 5; ++i)
+    {
+        CHECK(limiter.check("alice", chat::Event::CHAT, now).decision ==
+            chat::Decision::ALLOW);
+    }
+
+    chat::Verdict first = limiter.check("alice", chat::Event::CHAT, now);
+    CHECK(first.decision == chat::Decision::DELAY);
+    CHECK(first.delay == 1000ms);
+    chat::Verdict second = limiter.check("alice", chat::Event::CHAT, now);
+    CHECK(second.decision == chat::Decision::DELAY);
+    CHECK(second.delay == 2000ms);
+    CHECK(limiter.check("alice", chat::Event::CHAT, now).decision ==
+        chat::Decision::REJECT);
+
+    // Other logins and the other event kind have buckets of their own
+    CHECK(limiter.check("bob", chat::Event::CHAT, now).decision ==
+        chat::Decision::ALLOW);
+    CHECK(limiter.check("alice", chat::Event::COMMAND, now).decision ==
+        chat::Decision::ALLOW);
+
+    // The debt is paid back before anything is allowed again
+    CHECK(limiter.check("alice", chat::Event::CHAT, now + 2s).decision ==
+        chat::Decision::DELAY);
+    CHECK(limiter.check("alice", chat::Event::CHAT, now + 10s).decision ==
+        chat::Decision::ALLOW);
+
+    chat::RateLimitCounters counters = limiter.counters();
+    CHECK(counters.allowed == 8);
+    CHECK(counters.delayed == 3);
+    CHECK(counters.rejected == 1);
+}
+
+TEST_CASE("RateLimiter mutes after rejections in a row", "[chat][ratelimit]")
+{
+    using namespace std::chrono_literals;
+
+    chat::RateLimitSettings settings;
+    settings.chat = {1.0, 1.0};
+    settings.maxDelay = 0ms;
+    settings.muteAfter = 3;
+    chat::RateLimiter limiter(settings);
+
+    std::vector<std::string> muted;
+    limiter.setMuteHook([&muted](std::string_view login, std::uint32_t) {
+        muted.emplace_back(login);
+    });
+    auto now = chat::RateLimiter::Clock::now() + 1s;
+
+    CHECK(limiter.check("alice", chat::Event::CHAT, now).decision ==
+        chat::Decision::ALLOW);
+    for (int i = 0; i < 2; ++i)
+    {
+        CHECK(limiter.check("alice", chat::Event::CHAT, now).decision ==
+            chat::Decision::REJECT);
+    }
+    CHECK(muted.empty());
+
+    SECTION("an allowed line resets the count")
+    {
+        CHECK(limiter.check("alice", chat::Event::CHAT, now + 1s).decision ==
+            chat::Decision::ALLOW);
+        for (int i = 0; i < 2; ++i)
+        {
+            limiter.check("alice", chat::Event::CHAT, now + 1s);
+        }
+        CHECK(muted.empty());
+    }
+
+    SECTION("the hook runs once at the threshold")
+    {
+        for (int i = 0; i < 3; ++i)
+        {
+            limiter.check("alice", chat::Event::CHAT, now);
+        }
+        CHECK(muted == std::vector<std::string> {"alice"});
+        CHECK(limiter.counters().muted == 1);
+    }
+
+    SECTION("forget refills the buckets and clears the count")
+    {
+        limiter.forget("alice");
+        CHECK(limiter.check("alice", chat::Event::CHAT, now).decision ==
+            chat::Decision::ALLOW);
+        CHECK(muted.empty());
+    }
+}
+
+TEST_CASE("RateLimiter reads its section", "[chat][ratelimit]")
+{
+    std::string path =
+        (std::filesystem::temp_directory_path() / "planetplus_ratelimit.conf")
+            .string();
+    {
+        std::ofstream file(path);
+        file << "[ratelimit]\n"
+                "chat_rate = \"2\"\n"
+                "max_delay = \"500\"\n"
+                "mute_seconds = \"60\"\n"
+                "slots = \"oops\"\n"
+                "[ratelimit.alpha]\n"
+                "mute_seconds = \"0\"\n";
+    }
+    config::Config config(path);
+    config.load();
+
+    chat::RateLimitSettings settings =
+        chat::RateLimitSettings::fromConfig(config);
+    CHECK(settings.chat.rate == 2.0);
+    CHECK(settings.chat.burst == 5.0);
+    CHECK(settings.maxDelay == std::chrono::milliseconds(500));
+    CHECK(settings.muteFor == std::chrono::seconds(60));
+    CHECK(settings.slots == 4096);
+
+    chat::RateLimitSettings alpha =
+        chat::RateLimitSettings::fromConfig(config, "alpha");
+    CHECK(alpha.chat.rate == 2.0);
+    CHECK(alpha.muteFor == std::chrono::seconds(0));
+
+    config.save();
+    std::filesystem::remove(path);
+}
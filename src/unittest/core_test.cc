@@ -0,0 +1,103 @@
+#include <catch2/catch.hpp>
+
+#include <chrono>
+#include <future>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "core/eventloop.h"
+#include "core/task.h"
+#include "core/threadpool.h"
+
+namespace
+{
+/**
+ * @brief Keeps a strand busy until released, so that the tests can fill
+ *        its queue.
+ */
+struct Gate
+{
+    std::promise<void> started;
+    std::promise<void> open;
+
+    core::Job job()
+    {
+        return [this] {
+            started.set_value();
+            open.get_future().wait();
+        };
+    }
+};
+
+core::Task<> offloadThreadId(
+    core::Strand& strand, std::thread::id& ranOn, bool& done)
+{
+    auto job = [] { return std::this_thread::get_id(); };
+    ranOn = co_await core::offload(strand, job);
+    done = true;
+}
+} // namespace
+
+TEST_CASE("Strand enqueue waits for room in the queue", "[core][strand]")
+{
+    core::ThreadPool pool(2);
+    std::shared_ptr<core::Strand> strand = core::Strand::create(pool, 2);
+
+    Gate gate;
+    REQUIRE(strand->post(gate.job()));
+    gate.started.get_future().wait();
+
+    std::mutex mutex;
+    std::vector<int> order;
+    auto append = [&](int value) {
+        return [&, value] {
+            std::lock_guard<std::mutex> lock(mutex);
+            order.push_back(value);
+        };
+    };
+    CHECK(strand->post(append(1)));
+    CHECK(strand->post(append(2)));
+    CHECK_FALSE(strand->post(append(-1)));
+    CHECK(strand->enqueue(append(3)));
+    CHECK(strand->enqueue(append(4)));
+
+    core::StrandStats stats = strand->stats();
+    CHECK(stats.queued == 2);
+    CHECK(stats.waiting == 2);
+    CHECK(stats.rejected == 1);
+
+    gate.open.set_value();
+    strand->close();
+    CHECK(order == std::vector<int> {1, 2, 3, 4});
+    CHECK(strand->stats().highWater == 2);
+    CHECK_FALSE(strand->enqueue(append(5)));
+}
+
+TEST_CASE("offload never runs a strand job on the loop", "[core][strand]")
+{
+    core::ThreadPool pool(2);
+    std::shared_ptr<core::Strand> strand = core::Strand::create(pool, 1);
+    core::EventLoop loop;
+
+    Gate gate;
+    REQUIRE(strand->post(gate.job()));
+    gate.started.get_future().wait();
+    REQUIRE(strand->post([] {}));
+
+    std::thread::id ranOn;
+    bool done = false;
+    loop.post([&] { core::spawn(offloadThreadId(*strand, ranOn, done)); });
+    loop.runOnce(std::chrono::milliseconds(0));
+    CHECK_FALSE(done);
+    CHECK(strand->stats().waiting == 1);
+
+    gate.open.set_value();
+    for (int i = 0; i < 50 && !done; ++i)
+    {
+        loop.runOnce(std::chrono::milliseconds(20));
+    }
+    REQUIRE(done);
+    CHECK(ranOn != std::this_thread::get_id());
+    strand->close();
+}
@@ -0,0 +1,223 @@
+#include <catch2/catch.hpp>
+
+#include <cstdint>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "maps/gbx.h"
+
+namespace
+{
+/// Little endian writer for hand made map headers.
+struct Bytes
+{
+    std::string data;
+
+    Bytes& u8(std::uint8_t value)
+    {
+        data += static_cast<char>(value);
+        return *this;
+    }
+
+    Bytes& u16(std::uint16_t value)
+    {
+        return u8(value & 0xFF).u8(value >> 8);
+    }
+
+    Bytes& u32(std::uint32_t value)
+    {
+        return u16(value & 0xFFFF).u16(value >> 16);
+    }
+
+    Bytes& string(const std::string& value)
+    {
+        u32(static_cast<std::uint32_t>(value.size()));
+        data += value;
+        return *this;
+    }
+
+    /// A new lookback string, or the first one of the chunk with version.
+    Bytes& lookback(const std::string& value, bool first = false)
+    {
+        if (first)
+        {
+            u32(3);
+        }
+        return u32(0x40000000).string(value);
+    }
+};
+
+Bytes commonChunk(std::uint32_t authorLookback = 0x40000000)
+{
+    Bytes chunk;
+    chunk.u8(11).lookback("uid-1234", true).u32(26); // Stadium by its id
+    chunk.u32(authorLookback);
+    if (authorLookback == 0x40000000)
+    {
+        chunk.string("author");
+    }
+    chunk.string("$fffMy map");
+    return chunk;
+}
+
+Bytes timesChunk()
+{
+    Bytes chunk;
+    return chunk.u8(13).u32(0).u32(60000).u32(50000).u32(45000).u32(42123);
+}
+
+Bytes authorChunk()
+{
+    Bytes chunk;
+    return chunk.u32(0).u32(0).string("author").string("$f00Author");
+}
+
+/// A .Map.Gbx header holding chunks, in that order.
+std::string mapHeader(
+    const std::vector<std::pair<std::uint32_t, Bytes>>& chunks)
+{
+    Bytes table;
+    Bytes content;
+    table.u32(static_cast<std::uint32_t>(chunks.size()));
+    for (const auto& [id, chunk] : chunks)
+    {
+        table.u32(id).u32(static_cast<std::uint32_t>(chunk.data.size()));
+        content.data += chunk.data;
+    }
+
+    Bytes file;
+    file.data = "GBX";
+    file.u16(6).u8('B').u8('U').u8('C').u8('R').u32(maps::gbx::kMapClassId);
+    file.u32(
+        static_cast<std::uint32_t>(table.data.size() + content.data.size()));
+    file.data += table.data + content.data;
+    return file.data;
+}
+
+bool parse(const std::string& file, maps::MapInfo& info)
+{
+    // A copy of the exact size, so that reading past it is caught by
+    // sanitizers
+    std::vector<unsigned char> bytes(file.begin(), file.end());
+    return maps::gbx::parseMapHeader(bytes.data(), bytes.size(), info);
+}
+} // namespace
+
+TEST_CASE("parseMapHeader reads the identity and times of a map",
+    "[maps][gbx]")
+{
+    std::string file = mapHeader({{maps::gbx::kChunkTimes, timesChunk()},
+        {maps::gbx::kChunkCommon, commonChunk()},
+        {maps::gbx::kChunkThumbnail, Bytes {std::string(5000, 'x')}},
+        {maps::gbx::kChunkAuthor, authorChunk()}});
+
+    maps::MapInfo info;
+    REQUIRE(parse(file, info));
+    CHECK(info.uid == "uid-1234");
+    CHECK(info.environment == "Stadium");
+    CHECK(info.authorLogin == "author");
+    CHECK(info.authorNickname == "$f00Author");
+    CHECK(info.name == "$fffMy map");
+    CHECK(info.authorTime == 42123);
+
+    // The body follows the header, it is not read
+    file += std::string(100, '\0');
+    maps::MapInfo again;
+    REQUIRE(parse(file, again));
+    CHECK(again.uid == "uid-1234");
+}
+
+TEST_CASE("parseMapHeader rejects truncated files", "[maps][gbx]")
+{
+    std::string file = mapHeader({{maps::gbx::kChunkTimes, timesChunk()},
+        {maps::gbx::kChunkCommon, commonChunk()},
+        {maps::gbx::kChunkAuthor, authorChunk()}});
+    for (std::size_t size = 0; size < file.size(); ++size)
+    {
+        INFO(size);
+        maps::MapInfo info;
+        CHECK_FALSE(parse(file.substr(0, size), info));
+    }
+
+    // A chunk cut short is not read, even when its size says it fits
+    Bytes cut = commonChunk();
+    cut.data.resize(cut.data.size() - 3);
+    maps::MapInfo info;
+    CHECK_FALSE(parse(mapHeader({{maps::gbx::kChunkCommon, cut}}), info));
+    CHECK(info.uid.empty());
+    CHECK(info.name.empty());
+}
+
+TEST_CASE("parseMapHeader rejects oversized chunk tables", "[maps][gbx]")
+{
+    std::string file = mapHeader({{maps::gbx::kChunkCommon, commonChunk()}});
+    const std::size_t kUserDataSize = 3 + 2 + 4 + 4;
+    const std::size_t kChunkCount = kUserDataSize + 4;
+    const std::size_t kFirstSize = kChunkCount + 4 + 4;
+    maps::MapInfo info;
+    REQUIRE(parse(file, info));
+
+    auto patched = [&file](std::size_t offset, std::uint32_t value) {
+        std::string copy = file;
+        for (int i = 0; i < 4; ++i)
+        {
+            copy[offset + i] = static_cast<char>((value >> (8 * i)) & 0xFF);
+        }
+        return copy;
+    };
+
+    SECTION("more chunks than a map has")
+    {
+        CHECK_FALSE(parse(patched(kChunkCount, 65), info));
+        CHECK_FALSE(parse(patched(kChunkCount, 0xFFFFFFFF), info));
+    }
+    SECTION("chunk past the user data")
+    {
+        CHECK_FALSE(parse(patched(kFirstSize, 0x7FFFFFFF), info));
+        CHECK_FALSE(parse(patched(kFirstSize, 0xFFFFFFFF), info));
+    }
+    SECTION("user data past the file")
+    {
+        CHECK_FALSE(parse(patched(kUserDataSize, 0xFFFFFFFF), info));
+    }
+    SECTION("64 chunks are read")
+    {
+        std::vector<std::pair<std::uint32_t, Bytes>> chunks(
+            63, {maps::gbx::kChunkThumbnail, Bytes {"x"}});
+        chunks.emplace_back(maps::gbx::kChunkCommon, commonChunk());
+        maps::MapInfo many;
+        CHECK(parse(mapHeader(chunks), many));
+        CHECK(many.uid == "uid-1234");
+    }
+}
+
+TEST_CASE("parseMapHeader rejects invalid lookback indices", "[maps][gbx]")
+{
+    maps::MapInfo info;
+    // Index 1 is the uid, read earlier in the chunk
+    REQUIRE(parse(
+        mapHeader({{maps::gbx::kChunkCommon, commonChunk(0x40000001)}}),
+        info));
+    CHECK(info.authorLogin == "uid-1234");
+
+    for (std::uint32_t lookback : {0x40000002u, 0x80000005u, 0x7FFFFFFFu})
+    {
+        INFO(lookback);
+        maps::MapInfo bad;
+        CHECK_FALSE(parse(
+            mapHeader({{maps::gbx::kChunkCommon, commonChunk(lookback)}}),
+            bad));
+        CHECK(bad.uid.empty());
+    }
+
+    // Lookback strings are per chunk: index 1 in the times chunk (version
+    // 2 still has the identity) is not the uid of the common chunk
+    Bytes times;
+    times.u8(2).u32(3).u32(0x40000001);
+    maps::MapInfo separate;
+    CHECK(parse(mapHeader({{maps::gbx::kChunkCommon, commonChunk()},
+                              {maps::gbx::kChunkTimes, times}}),
+        separate));
+    CHECK(separate.authorTime == -1);
+}
@@ -0,0 +1,44 @@
+#include <catch2/catch.hpp>
+
+#include <string>
+#include <vector>
+
+#include "ranking/live.h"
+#include "utils/logins.h"
+
+TEST_CASE("LiveRanking keeps only connected players on a new map",
+    "[ranking][live]")
+{
+    ranking::LiveRanking live(3);
+    for (int i = 0; i < 100; ++i)
+    {
+        live.onCheckpoint("ranking" + std::to_string(i), 0, 1000 + i);
+    }
+    live.setPersonalBest("ranking5", {900, 1900, 2900});
+    CHECK(live.players() == 100);
+
+    std::vector<utils::LoginId> connected {
+        utils::logins().intern("ranking5"),
+        utils::logins().intern("ranking7"),
+        utils::logins().intern("ranking5")};
+    live.newMap(2, connected);
+    CHECK(live.players() == 2);
+    CHECK(live.size() == 0);
+    CHECK(live.checkpointCount() == 2);
+    CHECK(live.positionOf("ranking5") == 0);
+    CHECK(live.splitsOf(utils::logins().intern("ranking5")) ==
+        std::vector<std::int32_t> {-1, -1});
+
+    // Personal bests are per map, the row starts empty
+    ranking::Update update = live.onCheckpoint("ranking5", 0, 1000);
+    CHECK_FALSE(update.deltaToPersonalBest);
+    CHECK(update.position == 1);
+    CHECK(live.onCheckpoint("ranking99", 0, 900).position == 1);
+    CHECK(live.players() == 3);
+    CHECK(live.positionOf("ranking5") == 2);
+    CHECK(live.at(1).login == "ranking99");
+
+    live.newMap(2);
+    CHECK(live.players() == 0);
+    CHECK(live.splitsOf(utils::logins().intern("ranking99")).empty());
+}
@@ -0,0 +1,56 @@
+#include <catch2/catch.hpp>
+
+#include <map>
+#include <string>
+#include <vector>
+
+#include "records/records.h"
+
+TEST_CASE("Engine is empty before a map is set", "[records][engine]")
+{
+    records::Engine engine({}, {});
+    CHECK(engine.current().size() == 0);
+    CHECK_FALSE(engine.submit("alice", 1000, 1).improved);
+    CHECK(engine.current().size() == 0);
+}
+
+TEST_CASE("Engine writes improved records in one batch per map",
+    "[records][engine]")
+{
+    std::map<std::string, std::vector<records::Record>> written;
+    int batches = 0;
+    records::Engine engine({},
+        [&](const std::string& uid, std::vector<records::Record> rows) {
+            ++batches;
+            written[uid] = std::move(rows);
+        });
+
+    engine.setCurrentMap("a");
+    CHECK(engine.submit("alice", 3000, 1).improved);
+    CHECK(engine.submit("alice", 2000, 2).improved);
+    CHECK_FALSE(engine.submit("alice", 2500, 3).improved);
+    CHECK(engine.submit("bob", 2500, 4).rank == 2);
+
+    engine.setCurrentMap("b", {{"carol", 1000, 5}});
+    CHECK(engine.current().size() == 1);
+    CHECK(engine.submit("carol", 900, 6).improved);
+    CHECK(batches == 0);
+
+    engine.flush();
+    CHECK(batches == 2);
+    REQUIRE(written["a"].size() == 2);
+    for (const records::Record& record : written["a"])
+    {
+        CHECK(record.time == (record.login == "alice" ? 2000 : 2500));
+    }
+    REQUIRE(written["b"].size() == 1);
+    CHECK(written["b"][0].time == 900);
+
+    engine.flush();
+    CHECK(batches == 2);
+
+    // Records handed in are not queued, the map was in memory already
+    engine.setCurrentMap("a", {{"dave", 1, 7}});
+    CHECK(engine.current().rankOf("dave") == 0);
+    CHECK(engine.current().rankOf("alice") == 1);
+}
@@ -0,0 +1,495 @@
+#include <catch2/catch.hpp>
+
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "core/eventloop.h"
+#include "core/task.h"
+#include "server/gbxremote.h"
+#include "server/xmlrpc.h"
+
+namespace
+{
+using server::GbxRemote;
+using server::Priority;
+
+void appendU32(std::string& out, std::uint32_t value)
+{
+    for (int shift = 0; shift < 32; shift += 8)
+    {
+        out += static_cast<char>((value >> shift) & 0xFF);
+    }
+}
+
+std::uint32_t readU32(const char* data)
+{
+    const auto* bytes = reinterpret_cast<const unsigned char*>(data);
+    return static_cast<std::uint32_t>(bytes[0]) |
+        static_cast<std::uint32_t>(bytes[1]) << 8 |
+        static_cast<std::uint32_t>(bytes[2]) << 16 |
+        static_cast<std::uint32_t>(bytes[3]) << 24;
+}
+
+struct Call
+{
+    std::uint32_t handle;
+    std::string method;
+    std::vector<xmlrpc::Value> params;
+};
+
+/**
+ * @brief The dedicated server end of a socket pair, read and answered by
+ *        the test itself.
+ */
+class Peer
+{
+  public:
+    explicit Peer(int fd)
+        : fd_(fd)
+    {
+        std::string header;
+        appendU32(header, 11);
+        header += "GBXRemote 2";
+        write(header);
+    }
+
+    ~Peer()
+    {
+        ::close(fd_);
+    }
+
+    /// Every call written by the client so far.
+    std::vector<Call> read()
+    {
+        char buffer[64 * 1024];
+        ssize_t received;
+        while ((received = ::recv(fd_, buffer, sizeof(buffer), MSG_DONTWAIT)) >
+            0)
+        {
+            input_.append(buffer, static_cast<std::size_t>(received));
+        }
+
+        std::vector<Call> calls;
+        std::size_t offset = 0;
+        while (input_.size() - offset >= 8)
+        {
+            std::uint32_t size = readU32(input_.data() + offset);
+            if (input_.size() - offset - 8 < size)
+            {
+                break;
+            }
+            Call call;
+            call.handle = readU32(input_.data() + offset + 4);
+            std::string_view xml(input_.data() + offset + 8, size);
+            xmlrpc::decodeCall(xml, call.method, call.params);
+            calls.push_back(std::move(call));
+            offset += 8 + size;
+        }
+        input_.erase(0, offset);
+        return calls;
+    }
+
+    void answer(std::uint32_t handle, const xmlrpc::Value& value)
+    {
+        std::string xml;
+        xmlrpc::encodeResponse(xml, value);
+        std::string frame;
+        appendU32(frame, static_cast<std::uint32_t>(xml.size()));
+        appendU32(frame, handle);
+        write(frame + xml);
+    }
+
+  private:
+    int fd_;
+    std::string input_;
+
+    void write(const std::string& data)
+    {
+        REQUIRE(::send(fd_, data.data(), data.size(), MSG_NOSIGNAL) ==
+            static_cast<ssize_t>(data.size()));
+    }
+};
+
+struct Fixture
+{
+    core::EventLoop loop;
+    GbxRemote remote {loop};
+    std::unique_ptr<Peer> peer;
+
+    Fixture()
+    {
+        int fds[2];
+        REQUIRE(::socketpair(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0, fds) ==
+            0);
+        peer = std::make_unique<Peer>(fds[1]);
+        REQUIRE(remote.attach(fds[0]));
+        for (int i = 0; i < 10 && !remote.connected(); ++i)
+        {
+            loop.runOnce(std::chrono::milliseconds(100));
+        }
+        REQUIRE(remote.connected());
+    }
+
+    /// One round of the loop, i.e. one pass over the lanes.
+    void round()
+    {
+        loop.runOnce(std::chrono::milliseconds(100));
+    }
+};
+
+core::Task<> makeCall(GbxRemote& remote, std::string method,
+    std::string payload, Priority priority, std::string key,
+    xmlrpc::Response& response)
+{
+    std::vector<xmlrpc::Value> params;
+    params.emplace_back(std::move(payload));
+    response = co_await remote.call(
+        std::move(method), std::move(params), priority, std::move(key));
+}
+} // namespace
+
+TEST_CASE("GbxRemote writes higher priorities first", "[server][gbxremote]")
+{
+    // Before the fixture: calls still pending resume when it closes
+    std::vector<xmlrpc::Response> responses(4);
+    Fixture fixture;
+    const char* methods[] = {"Ui", "Chat", "Gameplay", "Admin"};
+    const Priority priorities[] = {
+        Priority::UI, Priority::CHAT, Priority::GAMEPLAY, Priority::ADMIN};
+    for (int i = 0; i < 4; ++i)
+    {
+        core::spawn(makeCall(fixture.remote, methods[i], "", priorities[i],
+            "", responses[i]));
+    }
+    CHECK(fixture.remote.pending() == 4);
+
+    fixture.round();
+    std::vector<Call> calls = fixture.peer->read();
+    REQUIRE(calls.size() == 4);
+    CHECK(calls[0].method == "Admin");
+    CHECK(calls[1].method == "Gameplay");
+    CHECK(calls[2].method == "Chat");
+    CHECK(calls[3].method == "Ui");
+
+    for (const Call& call : calls)
+    {
+        fixture.peer->answer(call.handle, xmlrpc::Value(call.method));
+    }
+    fixture.round();
+    CHECK(fixture.remote.pending() == 0);
+    for (int i = 0; i < 4; ++i)
+    {
+        CHECK_FALSE(responses[i].fault);
+        CHECK(responses[i].value.asString() == methods[i]);
+    }
+}
+
+TEST_CASE("GbxRemote spreads a lane over rounds by its budget",
+    "[server][gbxremote]")
+{
+    constexpr std::size_t kCalls = 20;
+    std::vector<xmlrpc::Response> chat(kCalls);
+    std::vector<xmlrpc::Response> admin(kCalls);
+    Fixture fixture;
+    const std::string payload(1000, 'x');
+    for (std::size_t i = 0; i < kCalls; ++i)
+    {
+        core::spawn(makeCall(fixture.remote, "Chat", payload, Priority::CHAT,
+            "", chat[i]));
+        core::spawn(makeCall(fixture.remote, "Admin", payload,
+            Priority::ADMIN, "", admin[i]));
+    }
+
+    server::LaneStats queued = fixture.remote.lane(Priority::CHAT);
+    REQUIRE(queued.calls == kCalls);
+    std::size_t frame = queued.bytes / kCalls;
+    std::size_t budget =
+        GbxRemote::kBudgets[static_cast<std::size_t>(Priority::CHAT)];
+    REQUIRE(frame * kCalls > budget);
+
+    fixture.round();
+    // Admin calls have no budget, chat gets what fits in 8 KiB
+    CHECK(fixture.remote.lane(Priority::ADMIN).sent == kCalls);
+    CHECK(fixture.remote.lane(Priority::ADMIN).calls == 0);
+    server::LaneStats first = fixture.remote.lane(Priority::CHAT);
+    CHECK(first.sent == budget / frame);
+    CHECK(first.calls == kCalls - first.sent);
+    CHECK(first.bytes == first.calls * frame);
+
+    for (int i = 0; i < 10 && fixture.remote.lane(Priority::CHAT).calls != 0;
+         ++i)
+    {
+        fixture.round();
+    }
+    CHECK(fixture.remote.lane(Priority::CHAT).sent == kCalls);
+    CHECK(fixture.peer->read().size() == 2 * kCalls);
+}
+
+TEST_CASE("GbxRemote always sends one frame over the budget",
+    "[server][gbxremote]")
+{
+    xmlrpc::Response response;
+    Fixture fixture;
+    core::spawn(makeCall(fixture.remote, "Chat", std::string(20000, 'x'),
+        Priority::CHAT, "", response));
+    fixture.round();
+    CHECK(fixture.remote.lane(Priority::CHAT).sent == 1);
+    CHECK(fixture.peer->read().size() == 1);
+}
+
+TEST_CASE("GbxRemote merges queued calls with the same key",
+    "[server][gbxremote]")
+{
+    std::vector<xmlrpc::Response> responses(5);
+    Fixture fixture;
+    core::spawn(makeCall(fixture.remote, "Page", "first", Priority::UI,
+        "hud/alice", responses[0]));
+    core::spawn(makeCall(fixture.remote, "Page", "second", Priority::UI,
+        "hud/alice", responses[1]));
+    core::spawn(makeCall(fixture.remote, "Page", "third", Priority::UI,
+        "hud/alice", responses[2]));
+    // Another key, or the same key in another lane, are not merged
+    core::spawn(makeCall(fixture.remote, "Page", "bob", Priority::UI,
+        "hud/bob", responses[3]));
+    core::spawn(makeCall(fixture.remote, "Page", "chat", Priority::CHAT,
+        "hud/alice", responses[4]));
+
+    server::LaneStats ui = fixture.remote.lane(Priority::UI);
+    CHECK(ui.calls == 2);
+    CHECK(ui.merged == 2);
+    CHECK(fixture.remote.lane(Priority::CHAT).merged == 0);
+
+    fixture.round();
+    std::vector<Call> calls = fixture.peer->read();
+    REQUIRE(calls.size() == 3);
+    CHECK(calls[0].params[0].asString() == "chat");
+    CHECK(calls[1].params[0].asString() == "third");
+    CHECK(calls[2].params[0].asString() == "bob");
+
+    for (const Call& call : calls)
+    {
+        fixture.peer->answer(call.handle, call.params[0]);
+    }
+    fixture.round();
+    CHECK(fixture.remote.pending() == 0);
+
+    // Callers of the dropped calls resume with the response of the last
+    for (int i = 0; i < 3; ++i)
+    {
+        CHECK_FALSE(responses[i].fault);
+        CHECK(responses[i].value.asString() == "third");
+    }
+    CHECK(responses[3].value.asString() == "bob");
+    CHECK(responses[4].value.asString() == "chat");
+
+    // Once sent, the key is free again
+    core::spawn(makeCall(fixture.remote, "Page", "fourth", Priority::UI,
+        "hud/alice", responses[0]));
+    CHECK(fixture.remote.lane(Priority::UI).merged == 2);
+    CHECK(fixture.remote.lane(Priority::UI).calls == 1);
+}
+
+namespace
+{
+std::string response(const std::string& value)
+{
+    return "<?xml version=\"1.0\"?><methodResponse><params><param>" + value +
+        "</param></params></methodResponse>";
+}
+
+std::string nested(int depth)
+{
+    std::string value;
+    for (int i = 0; i < depth; ++i)
+    {
+        value += "<value><array><data>";
+    }
+    value += "<value><i4>1</i4></value>";
+    for (int i = 0; i < depth; ++i)
+    {
+        value += "</data></array></value>";
+    }
+    return value;
+}
+} // namespace
+
+TEST_CASE("XML-RPC decodes responses and calls", "[server][xmlrpc]")
+{
+    xmlrpc::Response decoded;
+    REQUIRE(xmlrpc::decodeResponse(
+        response("<value><struct><member><name>UId</name><value>abc</value>"
+                 "</member><member><name>Laps</name><value><array><data>"
+                 "<value><i4>-3</i4></value><value><boolean>1</boolean>"
+                 "</value><value><double>1.5</double></value></data>"
+                 "</array></value></member></struct></value>"),
+        decoded));
+    CHECK_FALSE(decoded.fault);
+    REQUIRE(decoded.value.find("UId") != nullptr);
+    CHECK(decoded.value.find("UId")->asString() == "abc");
+    const xmlrpc::Value::Array& laps = decoded.value.find("Laps")->asArray();
+    REQUIRE(laps.size() == 3);
+    CHECK(laps[0].asInt() == -3);
+    CHECK(laps[1].asBool());
+    CHECK(laps[2].asDouble() == 1.5);
+
+    std::string method;
+    std::vector<xmlrpc::Value> params;
+    REQUIRE(xmlrpc::decodeCall(
+        "<methodCall><methodName>ManiaPlanet.PlayerConnect</methodName>"
+        "<params><param><value><string>alice</string></value></param>"
+        "<param><value><boolean>0</boolean></value></param></params>"
+        "</methodCall>",
+        method, params));
+    CHECK(method == "ManiaPlanet.PlayerConnect");
+    REQUIRE(params.size() == 2);
+    CHECK(params[0].asString() == "alice");
+    CHECK_FALSE(params[1].asBool());
+
+    // What encodeCall() writes reads back the same
+    std::string xml;
+    xmlrpc::encodeCall(xml, "Echo", params);
+    std::vector<xmlrpc::Value> again;
+    REQUIRE(xmlrpc::decodeCall(xml, method, again));
+    CHECK(method == "Echo");
+    REQUIRE(again.size() == 2);
+    CHECK(again[0].asString() == "alice");
+}
+
+TEST_CASE("XML-RPC decodes faults", "[server][xmlrpc]")
+{
+    xmlrpc::Response decoded;
+    REQUIRE(xmlrpc::decodeResponse(
+        "<methodResponse><fault><value><struct><member><name>faultCode"
+        "</name><value><int>-1000</int></value></member><member><name>"
+        "faultString</name><value><string>Login &lt;unknown&gt;.</string>"
+        "</value></member></struct></value></fault></methodResponse>",
+        decoded));
+    CHECK(decoded.fault);
+    CHECK(decoded.faultCode == -1000);
+    CHECK(decoded.faultString == "Login <unknown>.");
+
+    // A response after a fault is not one any more
+    REQUIRE(xmlrpc::decodeResponse(response("<value>ok</value>"), decoded));
+    CHECK_FALSE(decoded.fault);
+    CHECK(decoded.value.asString() == "ok");
+
+    REQUIRE(xmlrpc::decodeResponse(
+        "<methodResponse><fault><value><struct/></value></fault>"
+        "</methodResponse>",
+        decoded));
+    CHECK(decoded.fault);
+    CHECK(decoded.faultCode == 0);
+
+    CHECK_FALSE(xmlrpc::decodeResponse(
+        "<methodResponse><fault></fault></methodResponse>", decoded));
+    CHECK_FALSE(xmlrpc::decodeResponse(
+        "<methodResponse><fault><value><struct/></value>"
+        "</methodResponse>",
+        decoded));
+}
+
+TEST_CASE("XML-RPC decodes character references", "[server][xmlrpc]")
+{
+    xmlrpc::Response decoded;
+    REQUIRE(xmlrpc::decodeResponse(
+        response("<value><string>&#x41;&#65;&#xe9;&#X20AC;&#x1F3C1;"
+                 "&amp;&quot;&apos;</string></value>"),
+        decoded));
+    CHECK(decoded.value.asString() ==
+        "AA\xC3\xA9\xE2\x82\xAC\xF0\x9F\x8F\x81&\"'");
+
+    for (const char* reference :
+        {"&#x;", "&#;", "&#x41", "&#xZZ;", "&#x41Z;", "&#0;", "&#x110000;",
+            "&#xD800;", "&#99999999999999999999;", "&nbsp;", "&;"})
+    {
+        INFO(reference);
+        CHECK_FALSE(xmlrpc::decodeResponse(
+            response(std::string("<value><string>a") + reference +
+                "b</string></value>"),
+            decoded));
+    }
+}
+
+TEST_CASE("XML-RPC rejects malformed and truncated documents",
+    "[server][xmlrpc]")
+{
+    xmlrpc::Response decoded;
+    for (const char* xml : {"", "<", "<>", "not xml",
+             "<methodResponse></methodResponse>",
+             "<methodResponse><params><param><value><i4>12abc</i4></value>"
+             "</param></params></methodResponse>",
+             "<methodResponse><params><param><value><i4></i4></value>"
+             "</param></params></methodResponse>",
+             "<methodResponse><params><param><value><date>1</date></value>"
+             "</param></params></methodResponse>",
+             "<methodResponse><params><param><value><string>a</int>"
+             "</value></param></params></methodResponse>",
+             "<methodResponse><params><param><value><array><value><i4>1"
+             "</i4></value></array></value></param></params>"
+             "</methodResponse>",
+             "<methodResponse><params><param><value><struct><member>"
+             "<value>1</value></member></struct></value></param></params>"
+             "</methodResponse>",
+             "<methodCall><methodName>x</methodName></methodCall>",
+             "<methodResponse><params><param><value>a</value></param>"
+             "</params></methodResponse",
+             "<!-- <methodResponse>"})
+    {
+        INFO(xml);
+        CHECK_FALSE(xmlrpc::decodeResponse(xml, decoded));
+    }
+
+    // Every prefix of a valid document is rejected, none reads past it
+    const std::string call =
+        "<?xml version=\"1.0\"?><methodCall><methodName>"
+        "ManiaPlanet.BeginMap</methodName><params><param><value><struct>"
+        "<member><name>UId</name><value><string>a&amp;b&#xe9;</string>"
+        "</value></member><member><name>NbCheckpoints</name><value><i4>3"
+        "</i4></value></member><member><name>Laps</name><value><array>"
+        "<data><value><double>2.5</double></value><value/></data></array>"
+        "</value></member></struct></value></param></params></methodCall>";
+    std::string method;
+    std::vector<xmlrpc::Value> params;
+    REQUIRE(xmlrpc::decodeCall(call, method, params));
+    for (std::size_t size = 0; size < call.size(); ++size)
+    {
+        INFO(size);
+        // Copied so that reading past the end is caught by sanitizers
+        std::string prefix = call.substr(0, size);
+        CHECK_FALSE(xmlrpc::decodeCall(prefix, method, params));
+    }
+}
+
+TEST_CASE("XML-RPC limits the depth of values", "[server][xmlrpc]")
+{
+    xmlrpc::Response decoded;
+    REQUIRE(xmlrpc::decodeResponse(response(nested(64)), decoded));
+    const xmlrpc::Value* value = &decoded.value;
+    for (int i = 0; i < 64; ++i)
+    {
+        REQUIRE(value->asArray().size() == 1);
+        value = &value->asArray()[0];
+    }
+    CHECK(value->asInt() == 1);
+
+    CHECK_FALSE(xmlrpc::decodeResponse(response(nested(65)), decoded));
+    CHECK_FALSE(xmlrpc::decodeResponse(response(nested(100000)), decoded));
+
+    std::string members;
+    for (int i = 0; i < 65; ++i)
+    {
+        members += "<value><struct><member><name>m</name>";
+    }
+    members += "<value><i4>1</i4></value>";
+    for (int i = 0; i < 65; ++i)
+    {
+        members += "</member></struct></value>";
+    }
+    CHECK_FALSE(xmlrpc::decodeResponse(response(members), decoded));
+}
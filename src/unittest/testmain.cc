@@ -1 +1,2 @@
-#define CATCH_CONFIG_MAIN
\ No newline at end of file
+#define CATCH_CONFIG_MAIN
+#include <catch2/catch.hpp>
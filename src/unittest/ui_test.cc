@@ -0,0 +1,84 @@
+#include <catch2/catch.hpp>
+
+#include <chrono>
+#include <string>
+#include <vector>
+
+#include "ui/manialink.h"
+#include "ui/widgets.h"
+
+TEST_CASE("ManialinkEngine sends a page only when it changed", "[ui]")
+{
+    using namespace std::chrono_literals;
+    ui::ManialinkEngine engine(100ms);
+    auto now = ui::ManialinkEngine::Clock::now();
+    engine.connect("alice");
+    engine.connect("bob");
+
+    engine.showAll("records", "<label text=\"1\"/>");
+    std::vector<ui::Outgoing> calls = engine.tick(now);
+    REQUIRE(calls.size() == 1); // same payload, one call for both
+    CHECK(calls[0].pages == "records");
+    CHECK((calls[0].logins == "alice,bob" || calls[0].logins == "bob,alice"));
+    CHECK(calls[0].xml ==
+        "<manialinks><manialink id=\"records\" version=\"3\">"
+        "<label text=\"1\"/></manialink></manialinks>");
+
+    // Equal to what both have, nothing to send
+    engine.showAll("records", "<label text=\"1\"/>");
+    CHECK(engine.tick(now + 1s).empty());
+    CHECK(engine.counters().pagesSuppressed == 2);
+
+    // Only the last update of a throttled player goes out
+    engine.show("alice", "checkpoint", "<label text=\"a\"/>");
+    engine.show("alice", "ranking", "<label text=\"b\"/>");
+    CHECK(engine.tick(now + 1s + 50ms).size() == 1);
+    engine.show("alice", "checkpoint", "<label text=\"c\"/>");
+    engine.show("alice", "checkpoint", "<label text=\"d\"/>");
+    CHECK(engine.tick(now + 1s + 100ms).empty());
+    calls = engine.tick(now + 1s + 150ms);
+    REQUIRE(calls.size() == 1);
+    CHECK(calls[0].logins == "alice");
+    CHECK(calls[0].pages == "checkpoint");
+    CHECK(calls[0].xml.find("text=\"d\"") != std::string::npos);
+    CHECK(calls[0].xml.find("text=\"c\"") == std::string::npos);
+
+    // Hidden pages are sent empty, then forgotten
+    engine.hide("alice", "checkpoint");
+    calls = engine.tick(now + 2s);
+    REQUIRE(calls.size() == 1);
+    CHECK(calls[0].xml.find("<manialink id=\"checkpoint\" version=\"3\">"
+                            "</manialink>") != std::string::npos);
+    engine.hide("alice", "checkpoint");
+    CHECK(engine.tick(now + 3s).empty());
+
+    engine.disconnect("bob");
+    engine.showAll("records", "<label text=\"2\"/>");
+    calls = engine.tick(now + 4s);
+    REQUIRE(calls.size() == 1);
+    CHECK(calls[0].logins == "alice");
+    CHECK(engine.players() == 1);
+}
+
+TEST_CASE("Widgets escape logins and format times", "[ui]")
+{
+    std::string records =
+        ui::recordsWidget({{"a<b", 61234, 0}, {"c&d", 61300, 0}});
+    CHECK(records.find("text=\"a&lt;b\"") != std::string::npos);
+    CHECK(records.find("text=\"c&amp;d\"") != std::string::npos);
+    CHECK(records.find("text=\"1:01.234\"") != std::string::npos);
+    CHECK(records.find("text=\"2.\"") != std::string::npos);
+
+    std::vector<records::Record> many;
+    for (int i = 0; i < 20; ++i)
+    {
+        many.push_back({"player" + std::to_string(i), 1000 + i, 0});
+    }
+    std::string top = ui::recordsWidget(many);
+    CHECK(top.find("player9") != std::string::npos);
+    CHECK(top.find("player10") == std::string::npos);
+
+    std::string live = ui::rankingWidget({{"alice", 3, 12345}});
+    CHECK(live.find("text=\"alice\"") != std::string::npos);
+    CHECK(live.find("text=\"0:12.345\"") != std::string::npos);
+}
@@ -0,0 +1,298 @@
+#include <catch2/catch.hpp>
+
+#include <cstdint>
+#include <random>
+#include <set>
+#include <string>
+#include <vector>
+
+#include "utils/json.h"
+#include "utils/rankindex.h"
+
+namespace
+{
+// Small blocks, so that a few hundred keys split and drop many of them
+using Index = utils::RankIndex<int, int, std::less<int>, 4>;
+
+void checkAgainst(const Index& index, const std::set<int>& expected)
+{
+    REQUIRE(index.size() == expected.size());
+    std::size_t position = 1;
+    for (int key : expected)
+    {
+        CHECK(index.rank(key) == position);
+        Index::Item item;
+        REQUIRE(index.select(position, item));
+        CHECK(item.first == key);
+        CHECK(item.second == key * 10);
+        ++position;
+    }
+    Index::Item item;
+    CHECK_FALSE(index.select(0, item));
+    CHECK_FALSE(index.select(expected.size() + 1, item));
+}
+} // namespace
+
+TEST_CASE("RankIndex keeps ranks through splits", "[utils][rankindex]")
+{
+    Index index;
+    std::set<int> expected;
+    CHECK(index.empty());
+    CHECK(index.rank(1) == 0);
+
+    // Descending inserts always land in the first block
+    for (int key = 200; key > 0; key -= 2)
+    {
+        index.insert(key, key * 10);
+        expected.insert(key);
+    }
+    checkAgainst(index, expected);
+
+    // Odd keys go between the existing ones, in every block
+    for (int key = 1; key < 200; key += 2)
+    {
+        index.insert(key, key * 10);
+        expected.insert(key);
+    }
+    checkAgainst(index, expected);
+
+    CHECK(index.countBelow(0) == 0);
+    CHECK(index.countBelow(50) == 49);
+    CHECK(index.countBelow(1000) == expected.size());
+    CHECK(index.rank(1000) == 0);
+}
+
+TEST_CASE("RankIndex keeps ranks through erases", "[utils][rankindex]")
+{
+    Index index;
+    std::set<int> expected;
+    for (int key = 0; key < 100; ++key)
+    {
+        index.insert(key, key * 10);
+        expected.insert(key);
+    }
+
+    SECTION("erasing whole blocks drops them")
+    {
+        for (int key = 20; key < 60; ++key)
+        {
+            CHECK(index.erase(key));
+            expected.erase(key);
+        }
+        checkAgainst(index, expected);
+        CHECK(index.rank(20) == 0);
+        CHECK(index.rank(60) == 21);
+    }
+
+    SECTION("erasing a missing key does nothing")
+    {
+        CHECK_FALSE(index.erase(-1));
+        CHECK_FALSE(index.erase(100));
+        checkAgainst(index, expected);
+    }
+
+    SECTION("everything can be erased and inserted again")
+    {
+        for (int key = 0; key < 100; ++key)
+        {
+            CHECK(index.erase(key));
+        }
+        CHECK(index.empty());
+        CHECK(index.rank(5) == 0);
+        index.insert(5, 50);
+        CHECK(index.rank(5) == 1);
+    }
+}
+
+TEST_CASE("RankIndex matches std::set on random updates",
+    "[utils][rankindex]")
+{
+    Index index;
+    std::set<int> expected;
+    std::mt19937 random(7);
+    std::uniform_int_distribution<int> keys(0, 499);
+    for (int i = 0; i < 5000; ++i)
+    {
+        int key = keys(random);
+        if (expected.count(key) != 0)
+        {
+            CHECK(index.erase(key));
+            expected.erase(key);
+        }
+        else
+        {
+            index.insert(key, key * 10);
+            expected.insert(key);
+        }
+    }
+    checkAgainst(index, expected);
+
+    std::vector<int> visited;
+    index.forEach(3, 5, [&visited](int key, int) { visited.push_back(key); });
+    std::vector<int> first(std::next(expected.begin(), 2),
+        std::next(expected.begin(), 7));
+    CHECK(visited == first);
+}
+
+TEST_CASE("RankIndex assign builds a sorted index", "[utils][rankindex]")
+{
+    std::vector<Index::Item> items;
+    for (int key = 0; key < 50; ++key)
+    {
+        items.emplace_back(key * 3, key * 30);
+    }
+    Index index;
+    index.insert(1000, 10000); // replaced
+    index.assign(items);
+    CHECK(index.size() == 50);
+    CHECK(index.rank(0) == 1);
+    CHECK(index.rank(147) == 50);
+    CHECK(index.rank(1000) == 0);
+
+    index.insert(4, 40);
+    CHECK(index.rank(4) == 3);
+    CHECK(index.rank(6) == 4);
+}
+
+TEST_CASE("json reads nested values through find and at chains",
+    "[utils][json]")
+{
+    json::Parser parser;
+    REQUIRE(parser.parse(R"( {"login": "alice", "time": 1000,
+        "players": [{"login": "bob", "cps": [1, 2, 3]}, {"login": "carol"}],
+        "map": {"uid": "x", "laps": null, "multilap": false},
+        "empty": {}, "none": [] } )"));
+    json::Value root = parser.root();
+    CHECK(root.type() == json::Value::Type::OBJECT);
+    CHECK(root.size() == 6);
+    CHECK(root.find("login").asString() == "alice");
+    CHECK(root.find("time").asInt() == 1000);
+
+    json::Value players = root.find("players");
+    CHECK(players.size() == 2);
+    CHECK(players.at(1).find("login").asString() == "carol");
+    CHECK(players.at(0).find("cps").at(2).asInt() == 3);
+    CHECK(players.at(0).find("cps").raw() == "[1, 2, 3]");
+    CHECK(root.find("map").find("uid").asString() == "x");
+    CHECK(root.find("map").find("laps").type() == json::Value::Type::NIL);
+    CHECK(root.find("map").find("multilap").type() ==
+        json::Value::Type::BOOLEAN);
+    CHECK_FALSE(root.find("map").find("multilap").asBool());
+    CHECK(root.find("empty").size() == 0);
+    CHECK_FALSE(root.find("none").first());
+
+    // Missing values chain to missing values
+    CHECK_FALSE(root.find("nope"));
+    CHECK_FALSE(root.find("nope").at(0).find("login"));
+    CHECK(root.find("nope").at(0).find("login").asString().empty());
+    CHECK_FALSE(players.at(2));
+    CHECK_FALSE(players.at(0).find("cps").at(3));
+    CHECK_FALSE(players.find("login")); // not an object
+    CHECK_FALSE(root.at(0));            // not an array
+    CHECK_FALSE(root.find("login").find("x"));
+    CHECK_FALSE(root.find("uid")); // only the fields of root itself
+
+    // Fields in order, with their keys
+    std::vector<std::string> keys;
+    for (json::Value field = root.first(); field; field = field.next())
+    {
+        keys.emplace_back(field.key());
+    }
+    CHECK(keys ==
+        std::vector<std::string> {
+            "login", "time", "players", "map", "empty", "none"});
+    CHECK(players.at(0).key().empty());
+    CHECK_FALSE(root.next());
+}
+
+TEST_CASE("json unescapes strings and keys", "[utils][json]")
+{
+    json::Parser parser;
+    REQUIRE(parser.parse(
+        R"({"a\"b": "q\"\\\/\b\f\n\r\t", "u": "é€🏁",
+        "plain": "no escape", "bad": "\x\u12", "lone": "𐀀\ud800x",
+        "low": "\udc00"})"));
+    json::Value root = parser.root();
+    CHECK(root.find("a\"b").asString() == "q\"\\/\b\f\n\r\t");
+    CHECK(root.find("u").asString() == "\xC3\xA9\xE2\x82\xAC\xF0\x9F\x8F\x81");
+    CHECK(root.find("plain").asString() == "no escape");
+    CHECK(root.find("plain").asString().data() ==
+        root.find("plain").raw().data() + 1); // a view of the document
+    // Invalid escapes are kept as they are, lone surrogates replaced
+    CHECK(root.find("bad").asString() == "\\x\\u12");
+    CHECK(root.find("lone").asString() == "\xF0\x90\x80\x80\xEF\xBF\xBDx");
+    CHECK(root.find("low").asString() == "\xEF\xBF\xBD");
+
+    // Escaped quotes and backslashes across the 64 byte blocks of the scan
+    for (std::size_t padding = 50; padding < 80; ++padding)
+    {
+        INFO(padding);
+        std::string text = std::string(padding, 'a') + "\\\"\\\\";
+        std::string document = "{\"k\":\"" + text + "\",\"n\":[" +
+            std::to_string(padding) + "]}";
+        REQUIRE(parser.parse(document));
+        CHECK(parser.root().find("k").asString() ==
+            std::string(padding, 'a') + "\"\\");
+        CHECK(parser.root().find("n").at(0).asInt() ==
+            static_cast<std::int64_t>(padding));
+    }
+}
+
+TEST_CASE("json reads numbers", "[utils][json]")
+{
+    json::Parser parser;
+    REQUIRE(parser.parse(R"([0, -0, 42, -17, 9223372036854775807,
+        -9223372036854775808, 1.5, -2.75, 1e3, 2.5E-1, 1e400,
+        99999999999999999999, "12", true])"));
+    json::Value root = parser.root();
+    CHECK(root.at(0).asInt() == 0);
+    CHECK(root.at(1).asInt() == 0);
+    CHECK(root.at(2).asInt() == 42);
+    CHECK(root.at(3).asInt() == -17);
+    CHECK(root.at(4).asInt() == INT64_MAX);
+    CHECK(root.at(5).asInt() == INT64_MIN);
+    CHECK(root.at(6).asInt() == 1); // truncated like a cast
+    CHECK(root.at(6).asDouble() == 1.5);
+    CHECK(root.at(7).asInt() == -2);
+    CHECK(root.at(8).asInt() == 1000);
+    CHECK(root.at(9).asDouble() == 0.25);
+    CHECK(root.at(10).asDouble() == 0.0); // out of range
+    CHECK(root.at(11).asInt() == 0);
+    CHECK(root.at(11).asDouble() == 1e20);
+    CHECK(root.at(12).asInt() == 0); // a string is not a number
+    CHECK(root.at(13).asInt() == 0);
+    CHECK(root.at(13).asBool());
+
+    REQUIRE(parser.parse(" 7 "));
+    CHECK(parser.root().asInt() == 7);
+    CHECK(parser.root().raw() == "7");
+}
+
+TEST_CASE("json rejects malformed documents", "[utils][json]")
+{
+    json::Parser parser;
+    for (const char* document : {"", "   ", "{", "}", "[1, 2", "[1, 2]]",
+             "{\"a\": [1}", "{\"a\": 1]", "\"abc", "{\"a\": \"b}",
+             "1 2", "{} {}", "[] x", "{\"a\\\": 1}"})
+    {
+        INFO(document);
+        CHECK_FALSE(parser.parse(document));
+        CHECK_FALSE(parser.root());
+    }
+
+    // Errors inside values are found when they are read, as missing values
+    REQUIRE(parser.parse(R"({"a" 1, "b": 2})"));
+    CHECK_FALSE(parser.root().find("a"));
+    REQUIRE(parser.parse("[1,,2]"));
+    CHECK(parser.root().at(0).asInt() == 1);
+    CHECK_FALSE(parser.root().at(1));
+    REQUIRE(parser.parse(R"({"a": })"));
+    CHECK_FALSE(parser.root().find("a"));
+    REQUIRE(parser.parse(R"({"a": tru})"));
+    CHECK_FALSE(parser.root().find("a").asBool());
+
+    // A parser is reused after a failure, and after a larger document
+    REQUIRE(parser.parse("[" + std::string(1000, ' ') + "[1], {}]"));
+    REQUIRE(parser.parse(R"({"x": [true]})"));
+    CHECK(parser.root().find("x").at(0).asBool());
+}
@@ -1,12 +1,14 @@
 #include "config.h"
 
 #include <algorithm>
+#include <chrono>
 #include <fstream>
 #include <map>
 #include <string>
 #include <vector>
 
 #include "cli/tools.h"
+#include "metrics/registry.h"
 #include "utils.h"
 
 namespace config
@@ -35,6 +37,13 @@ Config::~Config()
 
 void Config::load()
 {
+    static metrics::Counter& loads = metrics::global().counter(
+        "planetplus_config_loads_total", "Configuration files loaded");
+    static metrics::Histogram& loadTime = metrics::global().histogram(
+        "planetplus_config_load_seconds", "Time spent loading a configuration",
+        {}, 1e-6);
+    auto start = std::chrono::steady_clock::now();
+
     std::ifstream fileStream(path_);
 
     if (!fileStream.is_open())
@@ -81,7 +90,11 @@ void Config::load()
                             utils::split(value, ",");
                         for (std::string owner : owners)
                         {
-                            owners_.push_back(owner);
+                            utils::trim(owner);
+                            if (!owner.empty())
+                            {
+                                owners_.push_back(owner);
+                            }
                         }
                     }
                     else if (key == "masteradmins")
@@ -90,7 +103,11 @@ void Config::load()
                             utils::split(value, ",");
                         for (std::string masteradmin : masteradmins)
                         {
-                            masteradmins_.push_back(masteradmin);
+                            utils::trim(masteradmin);
+                            if (!masteradmin.empty())
+                            {
+                                masteradmins_.push_back(masteradmin);
+                            }
                         }
                     }
                     else if (key == "admins")
@@ -99,7 +116,11 @@ void Config::load()
                             utils::split(value, ",");
                         for (std::string admin : admins)
                         {
-                            admins_.push_back(admin);
+                            utils::trim(admin);
+                            if (!admin.empty())
+                            {
+                                admins_.push_back(admin);
+                            }
                         }
                     }
                     else
@@ -116,6 +137,8 @@ void Config::load()
         }
     }
     loaded_ = true;
+    loads.add();
+    loadTime.recordSince(start);
 }
 
 void Config::save()
@@ -199,8 +222,9 @@ std::string Config::get(const std::string& section, const std::string& key)
     return "";
 }
 
-std::vector<std::string> Config::get(ConfigType type)
+const std::vector<std::string>& Config::get(ConfigType type)
 {
+    static const std::vector<std::string> none;
     checkIfLoaded();
     switch (type)
     {
@@ -211,7 +235,59 @@ std::vector<std::string> Config::get(ConfigType type)
         case ConfigType::ADMIN:
             return admins_;
     }
-    return std::vector<std::string>();
+    return none;
+}
+
+bool Config::has(const std::string& section, const std::string& key) const
+{
+    auto it = data_.find(section);
+    if (it == data_.end())
+    {
+        return false;
+    }
+    return std::any_of(it->second.begin(), it->second.end(),
+        [&key](const std::pair<std::string, std::string>& pair) {
+            return pair.first == key;
+        });
+}
+
+std::vector<std::string> Config::sections() const
+{
+    std::vector<std::string> names;
+    names.reserve(data_.size());
+    for (const auto& section : data_)
+    {
+        names.push_back(section.first);
+    }
+    return names;
+}
+
+std::vector<std::string> Config::keys(const std::string& section) const
+{
+    std::vector<std::string> names;
+    auto it = data_.find(section);
+    if (it != data_.end())
+    {
+        for (const auto& pair : it->second)
+        {
+            names.push_back(pair.first);
+        }
+    }
+    return names;
+}
+
+std::string Config::sectionFor(const std::string& section,
+    const std::string& key, const std::string& shard) const
+{
+    if (!shard.empty())
+    {
+        std::string overridden = section + "." + shard;
+        if (has(overridden, key))
+        {
+            return overridden;
+        }
+    }
+    return section;
 }
 
 void Config::set(const std::string& section, const std::string& key,
@@ -230,6 +306,7 @@ void Config::set(const std::string& section, const std::string& key,
             if (pair.first == key)
             {
                 pair.second = value;
+                saved_ = false;
             }
         }
     }
@@ -238,6 +315,7 @@ void Config::set(const std::string& section, const std::string& key,
 void Config::set(const std::string& value, ConfigType type)
 {
     checkIfLoaded();
+    saved_ = false;
     switch (type)
     {
         case ConfigType::OWNER:
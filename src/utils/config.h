@@ -24,7 +24,28 @@ class Config
     void save();
 
     std::string get(const std::string& section, const std::string& key);
-    std::vector<std::string> get(ConfigType type);
+    /**
+     * @brief The list itself, valid until the next set() or load().
+     */
+    const std::vector<std::string>& get(ConfigType type);
+    bool has(const std::string& section, const std::string& key) const;
+
+    /**
+     * @brief Names of every section, e.g. to find the [server.NAME] ones.
+     */
+    std::vector<std::string> sections() const;
+
+    /**
+     * @brief Keys of a section in file order, without the admin lists.
+     */
+    std::vector<std::string> keys(const std::string& section) const;
+
+    /**
+     * @brief Section to read key from for one server: [section.shard] when
+     *        it sets key, [section] otherwise.
+     */
+    std::string sectionFor(const std::string& section, const std::string& key,
+        const std::string& shard) const;
 
     void set(const std::string& section, const std::string& key,
         const std::string& value);
@@ -37,8 +58,8 @@ class Config
     std::vector<std::string> owners_;
     std::vector<std::string> masteradmins_;
     std::vector<std::string> admins_;
-    bool saved_;
-    bool loaded_;
+    bool saved_ {true}; // false once set() changed something
+    bool loaded_ {false};
 
     void parseValue(std::string& value);
     void checkIfLoaded();
@@ -2,14 +2,112 @@
 
 #include <mysql/mysql.h>
 
+#include <algorithm>
+#include <chrono>
+#include <cstring>
 #include <string>
 #include <fstream>
+#include <sstream>
+#include <vector>
 
 #include "cli/tools.h"
+#include "metrics/registry.h"
+#include "metrics/tracing.h"
 #include "utils/config.h"
 
 namespace database
 {
+namespace
+{
+/// mysql_query(), timed. Failed queries are counted too.
+int timedQuery(MYSQL* conn, const std::string& query)
+{
+    static metrics::Histogram& latency = metrics::global().histogram(
+        "planetplus_db_query_seconds", "Database query latency", {}, 1e-6);
+    static metrics::Counter& failures = metrics::global().counter(
+        "planetplus_db_query_errors_total", "Database queries that failed");
+
+    tracing::Span span("db.query");
+    auto start = std::chrono::steady_clock::now();
+    int status = mysql_query(conn, query.c_str());
+    latency.recordSince(start);
+    if (status != 0)
+    {
+        failures.add();
+    }
+    return status;
+}
+
+// Rows larger batches are split in when LOAD DATA LOCAL is refused
+constexpr std::size_t kImportBatch = 5000;
+
+// Kept over the best time of the rows inserted, as saveRecords() does
+constexpr const char* kKeepBestTime =
+    " ON DUPLICATE KEY UPDATE timestamp = IF(VALUES(time) < time, "
+    "VALUES(timestamp), timestamp), time = LEAST(time, VALUES(time))";
+
+/**
+ * @brief Rows of a LOAD DATA LOCAL INFILE, written as tab separated lines
+ *        from memory as the client library asks for them: no file.
+ */
+struct InfileSource
+{
+    const std::vector<records::Record>* rows;
+    std::size_t next {0};
+    std::string buffer;
+    std::size_t offset {0};
+};
+
+int infileInit(void** source, const char*, void* userdata)
+{
+    *source = userdata;
+    return 0;
+}
+
+int infileRead(void* data, char* out, unsigned int length)
+{
+    auto* source = static_cast<InfileSource*>(data);
+    if (source->offset == source->buffer.size())
+    {
+        source->buffer.clear();
+        source->offset = 0;
+    }
+    while (source->buffer.size() - source->offset < length &&
+        source->next < source->rows->size())
+    {
+        const records::Record& row = (*source->rows)[source->next++];
+        // The default escaping of LOAD DATA
+        for (char c : row.login)
+        {
+            if (c == '\\' || c == '\t' || c == '\n')
+            {
+                source->buffer += '\\';
+                c = c == '\t' ? 't' : c == '\n' ? 'n' : c;
+            }
+            source->buffer += c;
+        }
+        source->buffer += '\t';
+        source->buffer += std::to_string(row.time);
+        source->buffer += '\t';
+        source->buffer += std::to_string(row.timestamp);
+        source->buffer += '\n';
+    }
+    std::size_t count =
+        std::min<std::size_t>(length, source->buffer.size() - source->offset);
+    std::memcpy(out, source->buffer.data() + source->offset, count);
+    source->offset += count;
+    return static_cast<int>(count);
+}
+
+void infileEnd(void*) {}
+
+int infileError(void*, char* message, unsigned int length)
+{
+    std::snprintf(message, length, "Failed to stream the records");
+    return 2000; // CR_UNKNOWN_ERROR, never returned by the callbacks above
+}
+} // namespace
+
 Manager::Manager(std::string config_path, config::Config* config)
 {
     this->host = config->get("database", "host");
@@ -58,6 +156,11 @@ bool Manager::connect()
         return false;
     }
 
+    if (this->localInfile)
+    {
+        unsigned int enabled = 1;
+        mysql_options(this->conn, MYSQL_OPT_LOCAL_INFILE, &enabled);
+    }
     if (mysql_real_connect(this->conn, this->host.c_str(), this->user.c_str(),
                            this->password.c_str(), this->name.c_str(),
                            std::stoi(this->port), nullptr, 0) == nullptr)
@@ -67,9 +170,66 @@ bool Manager::connect()
     }
 
     cli_tools::printSuccess("Connection to database established.");
+    this->disconnected_ = false;
     return true;
 }
 
+bool Manager::provision()
+{
+    this->conn = mysql_init(nullptr);
+    if (this->conn == nullptr)
+    {
+        cli_tools::printError("!! mysql_init() failed");
+        return false;
+    }
+
+    // No database yet: it is what this creates
+    if (mysql_real_connect(this->conn, this->host.c_str(), this->user.c_str(),
+                           this->password.c_str(), nullptr,
+                           std::stoi(this->port), nullptr, 0) == nullptr)
+    {
+        cli_tools::printError(
+            "!! mysql_real_connect() failed: " +
+            std::string(mysql_error(this->conn)));
+        mysql_close(this->conn);
+        this->conn = nullptr;
+        return false;
+    }
+    this->disconnected_ = false;
+
+    bool created =
+        timedQuery(this->conn,
+            "CREATE DATABASE IF NOT EXISTS `" + this->name + "`") == 0 &&
+        mysql_select_db(this->conn, this->name.c_str()) == 0;
+
+    // One statement at a time, comment lines dropped
+    std::string statement;
+    std::istringstream lines(schema());
+    std::string line;
+    while (created && std::getline(lines, line))
+    {
+        if (line.rfind("--", 0) == 0)
+        {
+            continue;
+        }
+        statement += line;
+        statement += '\n';
+        if (line.find(';') != std::string::npos)
+        {
+            created = timedQuery(this->conn, statement) == 0;
+            statement.clear();
+        }
+    }
+
+    if (!created)
+    {
+        cli_tools::printError("!! Failed to create the database: " +
+            std::string(mysql_error(this->conn)));
+    }
+    this->disconnect();
+    return created;
+}
+
 void Manager::disconnect()
 {
     mysql_close(this->conn);
@@ -91,13 +251,12 @@ int Manager::executeQuery(const std::string& query)
         return -1;
     }
 
-    if (mysql_query(this->conn, query.c_str()))
+    if (timedQuery(this->conn, query))
     {
         cli_tools::printError("!! mysql_query() failed");
         return -1;
     }
 
-    cli_tools::printSuccess("Query executed successfully.");
     return 0;
 }
 
@@ -132,13 +291,487 @@ int Manager::executeFromFile(const std::string& file_path)
         return -1;
     }
 
-    if (mysql_query(this->conn, query.c_str()))
+    if (timedQuery(this->conn, query))
+    {
+        cli_tools::printError("!! mysql_query() failed");
+        return -1;
+    }
+
+    return 0;
+}
+std::vector<records::Record> Manager::loadRecords(const std::string& map_uid)
+{
+    tracing::Span span("db.load_records", map_uid);
+    std::vector<records::Record> rows;
+
+    if (this->disconnected_ || this->conn == nullptr)
+    {
+        cli_tools::printError("!! Database is disconnected");
+        return rows;
+    }
+
+    std::string query = "SELECT login, time, timestamp FROM records WHERE "
+                        "map_uid = '" + this->escape(map_uid) + "'";
+    if (timedQuery(this->conn, query))
+    {
+        cli_tools::printError("!! mysql_query() failed");
+        return rows;
+    }
+
+    // Stream rows instead of buffering the whole result client side
+    MYSQL_RES* result = mysql_use_result(this->conn);
+    if (result == nullptr)
+    {
+        cli_tools::printError("!! mysql_use_result() failed");
+        return rows;
+    }
+
+    MYSQL_ROW row;
+    while ((row = mysql_fetch_row(result)) != nullptr)
+    {
+        records::Record record;
+        record.login = row[0];
+        record.time = std::stoi(row[1]);
+        record.timestamp = std::stoll(row[2]);
+        rows.push_back(std::move(record));
+    }
+    mysql_free_result(result);
+
+    return rows;
+}
+
+int Manager::saveRecords(
+    const std::string& map_uid, const std::vector<records::Record>& rows)
+{
+    if (rows.empty())
+    {
+        return 0;
+    }
+
+    tracing::Span span("db.save_records", map_uid);
+    return this->executeQuery(this->recordsUpsert(
+        this->escape(map_uid), rows.data(), rows.data() + rows.size()));
+}
+
+bool Manager::scanRecords(const RecordVisitor& visit)
+{
+    tracing::Span span("db.scan_records");
+    if (this->disconnected_ || this->conn == nullptr)
+    {
+        cli_tools::printError("!! Database is disconnected");
+        return false;
+    }
+
+    // In primary key order: grouped by map without sorting
+    if (timedQuery(this->conn, "SELECT map_uid, login, time, timestamp "
+                               "FROM records ORDER BY map_uid"))
     {
         cli_tools::printError("!! mysql_query() failed");
+        return false;
+    }
+    MYSQL_RES* result = mysql_use_result(this->conn);
+    if (result == nullptr)
+    {
+        cli_tools::printError("!! mysql_use_result() failed");
+        return false;
+    }
+
+    std::string map_uid;
+    MYSQL_ROW row;
+    while ((row = mysql_fetch_row(result)) != nullptr)
+    {
+        if (map_uid != row[0])
+        {
+            map_uid = row[0];
+        }
+        visit(map_uid,
+            records::Record {row[1], std::stoi(row[2]), std::stoll(row[3])});
+    }
+    mysql_free_result(result);
+    return true;
+}
+
+int Manager::importRecords(
+    const std::string& map_uid, const std::vector<records::Record>& rows)
+{
+    if (rows.empty())
+    {
+        return 0;
+    }
+    if (this->disconnected_ || this->conn == nullptr)
+    {
+        cli_tools::printError("!! Database is disconnected");
         return -1;
     }
 
-    cli_tools::printSuccess("Query executed successfully.");
+    tracing::Span span("db.import_records", map_uid);
+    std::string uid = this->escape(map_uid);
+    if (this->localInfile)
+    {
+        // Streamed to a table of this connection, then merged in one query
+        InfileSource source {&rows, 0, {}, 0};
+        mysql_set_local_infile_handler(this->conn, infileInit, infileRead,
+            infileEnd, infileError, &source);
+        bool loaded =
+            timedQuery(this->conn,
+                "CREATE TEMPORARY TABLE IF NOT EXISTS records_import ("
+                "import_login VARCHAR(64) NOT NULL, "
+                "import_time INT NOT NULL, "
+                "import_timestamp BIGINT NOT NULL)") == 0 &&
+            timedQuery(this->conn, "TRUNCATE TABLE records_import") == 0 &&
+            timedQuery(this->conn,
+                "LOAD DATA LOCAL INFILE 'records' INTO TABLE records_import "
+                "(import_login, import_time, import_timestamp)") == 0;
+        if (loaded)
+        {
+            std::string query =
+                "INSERT INTO records (map_uid, login, time, timestamp) "
+                "SELECT '" + uid + "', import_login, import_time, "
+                "import_timestamp FROM records_import";
+            query += kKeepBestTime;
+            if (timedQuery(this->conn, query) != 0)
+            {
+                cli_tools::printError("!! Failed to import the records of " +
+                    map_uid + ": " + mysql_error(this->conn));
+                return -1;
+            }
+            return 0;
+        }
+
+        cli_tools::printWarning("LOAD DATA LOCAL refused (" +
+            std::string(mysql_error(this->conn)) +
+            "), importing with batched inserts.");
+        this->localInfile = false;
+    }
+
+    for (std::size_t first = 0; first < rows.size(); first += kImportBatch)
+    {
+        std::size_t last = std::min(rows.size(), first + kImportBatch);
+        if (timedQuery(this->conn, this->recordsUpsert(uid,
+                rows.data() + first, rows.data() + last)) != 0)
+        {
+            cli_tools::printError("!! Failed to import the records of " +
+                map_uid + ": " + mysql_error(this->conn));
+            return -1;
+        }
+    }
+    return 0;
+}
+
+bool Manager::loadStats(stats::Rows& rows)
+{
+    tracing::Span span("db.load_stats");
+    if (this->disconnected_ || this->conn == nullptr)
+    {
+        cli_tools::printError("!! Database is disconnected");
+        return false;
+    }
+
+    // Streamed like loadRecords(), calls visit(row) for every row
+    auto select = [this](const std::string& query, auto visit) {
+        if (timedQuery(this->conn, query))
+        {
+            cli_tools::printError("!! mysql_query() failed: " +
+                std::string(mysql_error(this->conn)));
+            return false;
+        }
+        MYSQL_RES* result = mysql_use_result(this->conn);
+        if (result == nullptr)
+        {
+            cli_tools::printError("!! mysql_use_result() failed");
+            return false;
+        }
+        MYSQL_ROW row;
+        while ((row = mysql_fetch_row(result)) != nullptr)
+        {
+            visit(row);
+        }
+        mysql_free_result(result);
+        return true;
+    };
+
+    bool loaded = select("SELECT login, playtime, finishes, wins, "
+                         "maps_finished FROM player_stats",
+        [&rows](MYSQL_ROW row) {
+            stats::PlayerStats player;
+            player.playtime = std::stoll(row[1]);
+            player.finishes = static_cast<std::uint32_t>(std::stoul(row[2]));
+            player.wins = static_cast<std::uint32_t>(std::stoul(row[3]));
+            player.mapsFinished =
+                static_cast<std::uint32_t>(std::stoul(row[4]));
+            rows.players.emplace_back(row[0], player);
+        });
+    loaded = loaded &&
+        select("SELECT map_uid, playtime, finishes, players FROM map_stats",
+            [&rows](MYSQL_ROW row) {
+                stats::MapStats map;
+                map.playtime = std::stoll(row[1]);
+                map.finishes = static_cast<std::uint32_t>(std::stoul(row[2]));
+                map.players = static_cast<std::uint32_t>(std::stoul(row[3]));
+                rows.maps.emplace_back(row[0], map);
+            });
+    loaded = loaded &&
+        select("SELECT map_uid, login FROM map_finishers",
+            [&rows](MYSQL_ROW row) {
+                rows.finishers.emplace_back(row[0], row[1]);
+            });
+    return loaded;
+}
+
+int Manager::saveStats(const stats::Rows& rows)
+{
+    tracing::Span span("db.save_stats");
+    if (!rows.players.empty())
+    {
+        std::string query = "INSERT INTO player_stats (login, playtime, "
+                            "finishes, wins, maps_finished) VALUES ";
+        for (size_t i = 0; i < rows.players.size(); i++)
+        {
+            const auto& [login, player] = rows.players[i];
+            query += i != 0 ? ",('" : "('";
+            query += this->escape(login) + "'," +
+                std::to_string(player.playtime) + "," +
+                std::to_string(player.finishes) + "," +
+                std::to_string(player.wins) + "," +
+                std::to_string(player.mapsFinished) + ")";
+        }
+        query += " ON DUPLICATE KEY UPDATE playtime = VALUES(playtime), "
+                 "finishes = VALUES(finishes), wins = VALUES(wins), "
+                 "maps_finished = VALUES(maps_finished)";
+        if (this->executeQuery(query) != 0)
+        {
+            return -1;
+        }
+    }
+
+    if (!rows.maps.empty())
+    {
+        std::string query = "INSERT INTO map_stats (map_uid, playtime, "
+                            "finishes, players) VALUES ";
+        for (size_t i = 0; i < rows.maps.size(); i++)
+        {
+            const auto& [uid, map] = rows.maps[i];
+            query += i != 0 ? ",('" : "('";
+            query += this->escape(uid) + "'," +
+                std::to_string(map.playtime) + "," +
+                std::to_string(map.finishes) + "," +
+                std::to_string(map.players) + ")";
+        }
+        query += " ON DUPLICATE KEY UPDATE playtime = VALUES(playtime), "
+                 "finishes = VALUES(finishes), players = VALUES(players)";
+        if (this->executeQuery(query) != 0)
+        {
+            return -1;
+        }
+    }
+
+    if (!rows.finishers.empty())
+    {
+        std::string query =
+            "INSERT IGNORE INTO map_finishers (map_uid, login) VALUES ";
+        for (size_t i = 0; i < rows.finishers.size(); i++)
+        {
+            const auto& [uid, login] = rows.finishers[i];
+            query += i != 0 ? ",('" : "('";
+            query += this->escape(uid) + "','" +
+                this->escape(login) + "')";
+        }
+        if (this->executeQuery(query) != 0)
+        {
+            return -1;
+        }
+    }
     return 0;
 }
-} // namespace Database
\ No newline at end of file
+
+bool Manager::loadKarma(const std::string& map_uid, karma::Rows& rows)
+{
+    tracing::Span span("db.load_karma", map_uid);
+    if (this->disconnected_ || this->conn == nullptr)
+    {
+        cli_tools::printError("!! Database is disconnected");
+        return false;
+    }
+
+    std::string query = "SELECT login, vote FROM karma WHERE map_uid = '";
+    query += this->escape(map_uid);
+    query += "' AND vote <> 0";
+    if (timedQuery(this->conn, query))
+    {
+        cli_tools::printError("!! mysql_query() failed");
+        return false;
+    }
+
+    // Streamed like loadRecords()
+    MYSQL_RES* result = mysql_use_result(this->conn);
+    if (result == nullptr)
+    {
+        cli_tools::printError("!! mysql_use_result() failed");
+        return false;
+    }
+
+    MYSQL_ROW row;
+    while ((row = mysql_fetch_row(result)) != nullptr)
+    {
+        rows.emplace_back(
+            row[0], std::stoi(row[1]) > 0 ? karma::Vote::PLUS
+                                          : karma::Vote::MINUS);
+    }
+    mysql_free_result(result);
+    return true;
+}
+
+int Manager::saveKarma(const std::string& map_uid, const karma::Rows& rows)
+{
+    if (rows.empty())
+    {
+        return 0;
+    }
+
+    tracing::Span span("db.save_karma", map_uid);
+    std::string uid = this->escape(map_uid);
+    std::string query = "INSERT INTO karma (map_uid, login, vote) VALUES ";
+    for (size_t i = 0; i < rows.size(); i++)
+    {
+        const auto& [login, vote] = rows[i];
+        query += i != 0 ? ",('" : "('";
+        query += uid + "','" + this->escape(login) + "'," +
+            std::to_string(static_cast<int>(vote)) + ")";
+    }
+    // A vote taken back stays as a 0, never read back
+    query += " ON DUPLICATE KEY UPDATE vote = VALUES(vote)";
+
+    return this->executeQuery(query);
+}
+
+std::string Manager::recordsUpsert(const std::string& uid,
+    const records::Record* first, const records::Record* last)
+{
+    std::string query =
+        "INSERT INTO records (map_uid, login, time, timestamp) VALUES ";
+    for (const records::Record* row = first; row != last; ++row)
+    {
+        if (row != first)
+        {
+            query += ",";
+        }
+        query += "('" + uid + "','" + this->escape(row->login) + "'," +
+            std::to_string(row->time) + "," + std::to_string(row->timestamp) +
+            ")";
+    }
+    // timestamp first: assignments are applied left to right
+    query += kKeepBestTime;
+    return query;
+}
+
+std::string Manager::escape(const std::string& value)
+{
+    std::string escaped(value.size() * 2 + 1, '\0');
+    unsigned long length = mysql_real_escape_string(
+        this->conn, escaped.data(), value.c_str(), value.size());
+    escaped.resize(length);
+    return escaped;
+}
+
+Async::Async(Manager& manager, core::ThreadPool& pool)
+    : manager_(manager)
+    , strand_(core::Strand::create(pool))
+{
+}
+
+Async::~Async()
+{
+    strand_->close();
+}
+
+void Async::close()
+{
+    strand_->close();
+}
+
+// Arguments are moved into the jobs, which may outlive the frames, see
+// core::offload()
+core::Task<int> Async::executeQuery(std::string query)
+{
+    auto job = [this, query = std::move(query)] {
+        return manager_.executeQuery(query);
+    };
+    co_return co_await core::offload(*strand_, std::move(job));
+}
+
+core::Task<std::vector<records::Record>> Async::loadRecords(
+    std::string map_uid)
+{
+    auto job = [this, map_uid = std::move(map_uid)] {
+        return manager_.loadRecords(map_uid);
+    };
+    co_return co_await core::offload(*strand_, std::move(job));
+}
+
+core::Task<int> Async::saveRecords(
+    std::string map_uid, std::vector<records::Record> rows)
+{
+    auto job = [this, map_uid = std::move(map_uid), rows = std::move(rows)] {
+        return manager_.saveRecords(map_uid, rows);
+    };
+    co_return co_await core::offload(*strand_, std::move(job));
+}
+
+Pool::Pool(
+    config::Config& config, core::ThreadPool& pool, std::size_t connections)
+{
+    for (std::size_t i = 0; i < std::max<std::size_t>(connections, 1); ++i)
+    {
+        managers_.push_back(std::make_unique<Manager>("", &config));
+        connections_.push_back(
+            std::make_unique<Async>(*managers_.back(), pool));
+        connected_.push_back(false);
+    }
+}
+
+Pool::~Pool()
+{
+    // Strands first, queries still queued need their connection
+    connections_.clear();
+    for (std::size_t i = 0; i < managers_.size(); ++i)
+    {
+        if (connected_[i])
+        {
+            managers_[i]->disconnect();
+        }
+    }
+}
+
+bool Pool::connect()
+{
+    bool ok = true;
+    for (std::size_t i = 0; i < managers_.size(); ++i)
+    {
+        if (!connected_[i])
+        {
+            connected_[i] = managers_[i]->connect();
+            ok = ok && connected_[i];
+        }
+    }
+    return ok;
+}
+
+Async& Pool::next()
+{
+    std::size_t index = next_.fetch_add(1, std::memory_order_relaxed);
+    return *connections_[index % connections_.size()];
+}
+
+void Pool::close()
+{
+    for (const std::unique_ptr<Async>& connection : connections_)
+    {
+        connection->close();
+    }
+}
+
+std::size_t Pool::size() const
+{
+    return connections_.size();
+}
+} // namespace Database
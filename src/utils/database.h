@@ -3,12 +3,26 @@
 
 #include <mysql/mysql.h>
 
+#include <atomic>
+#include <functional>
+#include <memory>
 #include <string>
+#include <vector>
 
+#include "core/task.h"
+#include "core/threadpool.h"
+#include "karma/karma.h"
+#include "records/records.h"
+#include "stats/stats.h"
 #include "utils/config.h"
 
 namespace database
 {
+/**
+ * @brief data/schema.sql, built in.
+ */
+const char* schema();
+
 class Manager
 {
   public:
@@ -18,13 +32,30 @@ class Manager
     std::string password;
     std::string name;
 
-    MYSQL* conn;
+    MYSQL* conn {nullptr};
+
+    /**
+     * @brief Allow LOAD DATA LOCAL INFILE, see importRecords(). Set before
+     *        connect()
+     */
+    bool localInfile {false};
+
+    using RecordVisitor = std::function<void(
+        const std::string& map_uid, records::Record record)>;
 
     void init();
 
     bool connect();
     void disconnect();
 
+    /**
+     * @brief Create the database if needed and load the schema, in one
+     *        connection that is closed afterwards
+     *
+     * @return bool
+     */
+    bool provision();
+
     /**
      * @brief Execute a sql query
      *
@@ -41,11 +72,152 @@ class Manager
      */
     int executeFromFile(const std::string& file_path);
 
-    Manager::Manager(std::string config_path, config::Config* config);
+    /**
+     * @brief Read every local record of a map
+     *
+     * @param map_uid
+     * @return std::vector<records::Record>
+     */
+    std::vector<records::Record> loadRecords(const std::string& map_uid);
+
+    /**
+     * @brief Insert or update local records of a map in one query
+     *
+     * @param map_uid
+     * @param rows
+     * @return int
+     */
+    int saveRecords(
+        const std::string& map_uid, const std::vector<records::Record>& rows);
+
+    /**
+     * @brief Stream every local record, those of a map one after the other
+     *
+     * @param visit Called for every row, as it is read
+     * @return bool false if the query failed
+     */
+    bool scanRecords(const RecordVisitor& visit);
+
+    /**
+     * @brief Bulk insert or update local records of a map, through
+     *        LOAD DATA LOCAL INFILE when localInfile is set and the server
+     *        allows it, in batches of inserts otherwise
+     *
+     * @param map_uid
+     * @param rows Any number, a login once
+     * @return int
+     */
+    int importRecords(
+        const std::string& map_uid, const std::vector<records::Record>& rows);
+
+    /**
+     * @brief Read every row of the statistics tables, on a cold start
+     *
+     * @param rows
+     * @return bool false if a query failed, rows is then incomplete
+     */
+    bool loadStats(stats::Rows& rows);
+
+    /**
+     * @brief Insert or update statistics rows, one query per table
+     *
+     * @param rows Absolute values, so writing them twice is harmless
+     * @return int
+     */
+    int saveStats(const stats::Rows& rows);
+
+    /**
+     * @brief Read every karma vote of a map
+     *
+     * @param map_uid
+     * @param rows
+     * @return bool false if the query failed
+     */
+    bool loadKarma(const std::string& map_uid, karma::Rows& rows);
+
+    /**
+     * @brief Insert or update karma votes of a map in one query
+     *
+     * @param map_uid
+     * @param rows
+     * @return int
+     */
+    int saveKarma(const std::string& map_uid, const karma::Rows& rows);
+
+    Manager(std::string config_path, config::Config* config);
     ~Manager();
 
   private:
-    bool disconnected_;
+    bool disconnected_ {true};
+
+    std::string escape(const std::string& value);
+    std::string recordsUpsert(const std::string& uid,
+        const records::Record* first, const records::Record* last);
+};
+
+/**
+ * @brief Coroutine front of a Manager.
+ *
+ * Queries run one at a time on a strand of the pool, since a MySQL
+ * connection is not thread safe, and the awaiting coroutine resumes on its
+ * event loop. The Manager must not be used directly meanwhile.
+ *
+ *     auto rows = co_await async.loadRecords(uid);
+ */
+class Async
+{
+  public:
+    Async(Manager& manager, core::ThreadPool& pool);
+    ~Async();
+
+    /**
+     * @brief Waits for the queued queries and refuses new ones, those then
+     *        run on the calling thread
+     */
+    void close();
+
+    core::Task<int> executeQuery(std::string query);
+    core::Task<std::vector<records::Record>> loadRecords(std::string map_uid);
+    core::Task<int> saveRecords(
+        std::string map_uid, std::vector<records::Record> rows);
+
+  private:
+    Manager& manager_;
+    std::shared_ptr<core::Strand> strand_;
+};
+
+/**
+ * @brief A few connections shared by every server of the process, handed
+ *        out round robin.
+ */
+class Pool
+{
+  public:
+    Pool(config::Config& config, core::ThreadPool& pool,
+        std::size_t connections);
+    ~Pool();
+
+    /**
+     * @return false if any connection failed.
+     */
+    bool connect();
+
+    Async& next();
+
+    /**
+     * @brief Waits for the queued queries of every connection. A finished
+     *        query resumes on the loop it came from, so this must run once
+     *        the loops stopped and before they are destroyed
+     */
+    void close();
+
+    std::size_t size() const;
+
+  private:
+    std::vector<std::unique_ptr<Manager>> managers_;
+    std::vector<std::unique_ptr<Async>> connections_;
+    std::vector<bool> connected_;
+    std::atomic<std::size_t> next_ {0};
 };
 } // namespace Database
 
@@ -0,0 +1,641 @@
+#include "json.h"
+
+#include <bit>
+#include <charconv>
+#include <cstring>
+#include <limits>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+#ifdef __PCLMUL__
+#include <wmmintrin.h>
+#endif
+
+namespace json
+{
+namespace
+{
+constexpr std::size_t kBlockSize = 64; // one bit per byte in a mask
+
+/// Bits of one block, bit i for byte i
+struct Masks
+{
+    std::uint64_t quotes {0};
+    std::uint64_t backslashes {0};
+    std::uint64_t operators {0}; // { } [ ] : ,
+};
+
+#ifdef __SSE2__
+std::uint64_t equal(__m128i chunk, char c)
+{
+    return static_cast<std::uint32_t>(
+        _mm_movemask_epi8(_mm_cmpeq_epi8(chunk, _mm_set1_epi8(c))));
+}
+
+Masks classify(const char* block)
+{
+    Masks masks;
+    const __m128i lower = _mm_set1_epi8(0x20);
+    for (int i = 0; i < 4; ++i)
+    {
+        __m128i chunk = _mm_loadu_si128(
+            reinterpret_cast<const __m128i*>(block + 16 * i));
+        // [ and ] only differ from { and } by the 0x20 bit
+        __m128i folded = _mm_or_si128(chunk, lower);
+        int shift = 16 * i;
+        masks.quotes |= equal(chunk, '"') << shift;
+        masks.backslashes |= equal(chunk, '\\') << shift;
+        masks.operators |= (equal(folded, '{') | equal(folded, '}') |
+                               equal(chunk, ':') | equal(chunk, ','))
+            << shift;
+    }
+    return masks;
+}
+#else
+Masks classify(const char* block)
+{
+    Masks masks;
+    for (std::size_t i = 0; i < kBlockSize; ++i)
+    {
+        std::uint64_t bit = std::uint64_t {1} << i;
+        switch (block[i])
+        {
+        case '"':
+            masks.quotes |= bit;
+            break;
+        case '\\':
+            masks.backslashes |= bit;
+            break;
+        case '{':
+        case '}':
+        case '[':
+        case ']':
+        case ':':
+        case ',':
+            masks.operators |= bit;
+            break;
+        default:
+            break;
+        }
+    }
+    return masks;
+}
+#endif
+
+/**
+ * @brief Bits of the characters escaped by a backslash. carry is set when
+ *        the previous block ended on a backslash, and for the next one.
+ */
+std::uint64_t escapedBy(std::uint64_t backslashes, std::uint64_t& carry)
+{
+    std::uint64_t escaped = carry;
+    carry = 0;
+    backslashes &= ~escaped;
+    // Rare in callbacks, a loop over them is enough
+    while (backslashes != 0)
+    {
+        int bit = std::countr_zero(backslashes);
+        if (bit == 63)
+        {
+            carry = 1;
+            break;
+        }
+        escaped |= std::uint64_t {2} << bit;
+        backslashes &= ~(std::uint64_t {3} << bit);
+    }
+    return escaped;
+}
+
+/**
+ * @brief Bit i is the parity of the bits up to i: set from an opening
+ *        quote to the byte before the closing one.
+ */
+std::uint64_t prefixXor(std::uint64_t bits)
+{
+#ifdef __PCLMUL__
+    __m128i product = _mm_clmulepi64_si128(
+        _mm_set_epi64x(0, static_cast<long long>(bits)),
+        _mm_set1_epi8(static_cast<char>(0xFF)), 0);
+    return static_cast<std::uint64_t>(_mm_cvtsi128_si64(product));
+#else
+    bits ^= bits << 1;
+    bits ^= bits << 2;
+    bits ^= bits << 4;
+    bits ^= bits << 8;
+    bits ^= bits << 16;
+    bits ^= bits << 32;
+    return bits;
+#endif
+}
+
+bool isSpace(char c)
+{
+    return c == ' ' || c == '\n' || c == '\r' || c == '\t';
+}
+
+bool hex4(const char* text, std::uint32_t& value)
+{
+    auto [ptr, error] = std::from_chars(text, text + 4, value, 16);
+    return error == std::errc() && ptr == text + 4;
+}
+
+void appendUtf8(std::string& out, std::uint32_t code)
+{
+    if (code < 0x80)
+    {
+        out += static_cast<char>(code);
+    }
+    else if (code < 0x800)
+    {
+        out += static_cast<char>(0xC0 | (code >> 6));
+        out += static_cast<char>(0x80 | (code & 0x3F));
+    }
+    else if (code < 0x10000)
+    {
+        out += static_cast<char>(0xE0 | (code >> 12));
+        out += static_cast<char>(0x80 | ((code >> 6) & 0x3F));
+        out += static_cast<char>(0x80 | (code & 0x3F));
+    }
+    else
+    {
+        out += static_cast<char>(0xF0 | (code >> 18));
+        out += static_cast<char>(0x80 | ((code >> 12) & 0x3F));
+        out += static_cast<char>(0x80 | ((code >> 6) & 0x3F));
+        out += static_cast<char>(0x80 | (code & 0x3F));
+    }
+}
+
+/**
+ * @brief Appends raw, the text between the quotes of a string, unescaped.
+ *        An invalid escape is kept as it is.
+ */
+void unescape(std::string_view raw, std::string& out)
+{
+    out.reserve(raw.size());
+    for (std::size_t i = 0; i < raw.size(); ++i)
+    {
+        if (raw[i] != '\\' || i + 1 == raw.size())
+        {
+            out += raw[i];
+            continue;
+        }
+
+        char c = raw[++i];
+        switch (c)
+        {
+        case 'b':
+            out += '\b';
+            break;
+        case 'f':
+            out += '\f';
+            break;
+        case 'n':
+            out += '\n';
+            break;
+        case 'r':
+            out += '\r';
+            break;
+        case 't':
+            out += '\t';
+            break;
+        case 'u':
+        {
+            std::uint32_t code;
+            if (i + 4 >= raw.size() || !hex4(raw.data() + i + 1, code))
+            {
+                out += "\\u";
+                break;
+            }
+            i += 4;
+            // A pair of surrogates for what is past the 16 bit range
+            std::uint32_t low;
+            if (code >= 0xD800 && code < 0xDC00 && i + 6 < raw.size() &&
+                raw[i + 1] == '\\' && raw[i + 2] == 'u' &&
+                hex4(raw.data() + i + 3, low) && low >= 0xDC00 &&
+                low < 0xE000)
+            {
+                code = 0x10000 + ((code - 0xD800) << 10) + (low - 0xDC00);
+                i += 6;
+            }
+            else if (code >= 0xD800 && code < 0xE000)
+            {
+                code = 0xFFFD; // half a pair, not a character
+            }
+            appendUtf8(out, code);
+            break;
+        }
+        case '"':
+        case '\\':
+        case '/':
+            out += c;
+            break;
+        default:
+            out += '\\';
+            out += c;
+            break;
+        }
+    }
+}
+} // namespace
+
+Value::Type Value::type() const
+{
+    if (parser_ == nullptr)
+    {
+        return Type::NONE;
+    }
+    switch (parser_->input_[offset_])
+    {
+    case '{':
+        return Type::OBJECT;
+    case '[':
+        return Type::ARRAY;
+    case '"':
+        return Type::STRING;
+    case 't':
+    case 'f':
+        return Type::BOOLEAN;
+    case 'n':
+        return Type::NIL;
+    default:
+        return Type::NUMBER;
+    }
+}
+
+Value::operator bool() const
+{
+    return parser_ != nullptr;
+}
+
+Value Value::find(std::string_view key) const
+{
+    if (type() != Type::OBJECT)
+    {
+        return {};
+    }
+
+    std::uint32_t entry = entry_;
+    while (true)
+    {
+        Value value = parser_->member(entry);
+        if (!value)
+        {
+            return {};
+        }
+        // The key is the two entries before the colon
+        std::string_view raw = parser_->input_.substr(
+            parser_->positions_[value.entry_ - 3] + 1,
+            parser_->positions_[value.entry_ - 2] -
+                parser_->positions_[value.entry_ - 3] - 1);
+        if (raw == key ||
+            (parser_->escapes_ && raw.find('\\') != std::string_view::npos &&
+                parser_->string(value.entry_ - 3) == key))
+        {
+            return value;
+        }
+
+        entry = value.end();
+        if (parser_->charAt(entry) != ',')
+        {
+            return {};
+        }
+    }
+}
+
+Value Value::at(std::size_t index) const
+{
+    Value value = type() == Type::ARRAY ? first() : Value();
+    for (; value && index > 0; --index)
+    {
+        value = value.next();
+    }
+    return value;
+}
+
+std::size_t Value::size() const
+{
+    std::size_t count = 0;
+    for (Value value = first(); value; value = value.next())
+    {
+        ++count;
+    }
+    return count;
+}
+
+Value Value::first() const
+{
+    switch (type())
+    {
+    case Type::ARRAY:
+        return parser_->valueAfter(entry_);
+    case Type::OBJECT:
+        return parser_->member(entry_);
+    default:
+        return {};
+    }
+}
+
+Value Value::next() const
+{
+    if (parser_ == nullptr || entry_ == 0)
+    {
+        return {}; // the root has no siblings
+    }
+
+    std::uint32_t end = this->end();
+    if (parser_->charAt(end) != ',')
+    {
+        return {};
+    }
+    // Whatever the value is, the entry before it is what it follows
+    return parser_->charAt(entry_ - 1) == ':' ? parser_->member(end)
+                                              : parser_->valueAfter(end);
+}
+
+std::string_view Value::key() const
+{
+    if (parser_ == nullptr || entry_ == 0 || parser_->charAt(entry_ - 1) != ':')
+    {
+        return {};
+    }
+    return parser_->string(entry_ - 3);
+}
+
+std::string_view Value::asString() const
+{
+    return type() == Type::STRING ? parser_->string(entry_)
+                                  : std::string_view();
+}
+
+std::int64_t Value::asInt() const
+{
+    if (type() != Type::NUMBER)
+    {
+        return 0;
+    }
+    std::string_view text = scalar();
+    std::int64_t value = 0;
+    auto [ptr, error] =
+        std::from_chars(text.data(), text.data() + text.size(), value);
+    if (error == std::errc() && ptr == text.data() + text.size())
+    {
+        return value;
+    }
+    // 1.5 or 1e3, truncated like a cast
+    double real = asDouble();
+    return real >= -9.2e18 && real <= 9.2e18 ? static_cast<std::int64_t>(real)
+                                             : 0;
+}
+
+double Value::asDouble() const
+{
+    if (type() != Type::NUMBER)
+    {
+        return 0.0;
+    }
+    std::string_view text = scalar();
+    double value = 0.0;
+    auto [ptr, error] =
+        std::from_chars(text.data(), text.data() + text.size(), value);
+    return error == std::errc() && ptr == text.data() + text.size() ? value
+                                                                    : 0.0;
+}
+
+bool Value::asBool() const
+{
+    return type() == Type::BOOLEAN && scalar() == "true";
+}
+
+std::string_view Value::raw() const
+{
+    if (parser_ == nullptr)
+    {
+        return {};
+    }
+    switch (type())
+    {
+    case Type::OBJECT:
+    case Type::ARRAY:
+    case Type::STRING:
+        return parser_->input_.substr(
+            offset_, parser_->positions_[end() - 1] + 1 - offset_);
+    default:
+        return scalar();
+    }
+}
+
+std::uint32_t Value::end() const
+{
+    switch (type())
+    {
+    case Type::OBJECT:
+    case Type::ARRAY:
+        return parser_->closers_[entry_] + 1;
+    case Type::STRING:
+        return entry_ + 2; // both quotes are structural
+    default:
+        return entry_; // a scalar ends on the structural after it
+    }
+}
+
+std::string_view Value::scalar() const
+{
+    std::string_view text = parser_->input_.substr(
+        offset_, parser_->positions_[entry_] - offset_);
+    while (!text.empty() && isSpace(text.back()))
+    {
+        text.remove_suffix(1);
+    }
+    return text;
+}
+
+bool Parser::parse(std::string_view json)
+{
+    input_ = json;
+    count_ = 0;
+    decoded_.clear();
+    escapes_ = false;
+    valid_ = false;
+    if (json.size() >= std::numeric_limits<std::uint32_t>::max())
+    {
+        return false;
+    }
+
+    scan();
+    if (!valid_ || !match())
+    {
+        valid_ = false;
+        return false;
+    }
+
+    // Nothing but spaces after the document
+    Value document = valueAt(0, 0);
+    valid_ = document && document.end() + 1 == count_;
+    if (valid_)
+    {
+        std::string_view text = document.raw();
+        valid_ = skipSpace(static_cast<std::uint32_t>(
+                     text.data() + text.size() - input_.data())) ==
+            input_.size();
+        // A scalar runs to the end, a space in it separates two values
+        Value::Type type = document.type();
+        if (type != Value::Type::OBJECT && type != Value::Type::ARRAY &&
+            type != Value::Type::STRING &&
+            text.find_first_of(" \n\r\t") != std::string_view::npos)
+        {
+            valid_ = false;
+        }
+    }
+    return valid_;
+}
+
+Value Parser::root() const
+{
+    return valid_ ? valueAt(0, 0) : Value();
+}
+
+void Parser::scan()
+{
+    // At most one per byte, so a block never has to check for room
+    if (positions_.size() < input_.size() + kBlockSize + 1)
+    {
+        positions_.resize(input_.size() + kBlockSize + 1);
+    }
+    std::uint32_t* out = positions_.data();
+
+    std::uint64_t escapeCarry = 0;
+    std::uint64_t stringCarry = 0; // all ones inside a string
+
+    auto block = [&](const char* data, std::uint32_t base) {
+        Masks masks = classify(data);
+        if (masks.backslashes != 0 || escapeCarry != 0)
+        {
+            escapes_ = true;
+            std::uint64_t escaped = escapedBy(masks.backslashes, escapeCarry);
+            masks.quotes &= ~escaped;
+        }
+
+        std::uint64_t inside = prefixXor(masks.quotes) ^ stringCarry;
+        stringCarry =
+            static_cast<std::uint64_t>(static_cast<std::int64_t>(inside) >> 63);
+
+        // Opening quotes are inside, closing ones are not: keep both
+        std::uint64_t structural = (masks.operators & ~inside) | masks.quotes;
+        int count = std::popcount(structural);
+        for (int i = 0; i < count; ++i)
+        {
+            out[i] =
+                base + static_cast<std::uint32_t>(std::countr_zero(structural));
+            structural &= structural - 1;
+        }
+        out += count;
+    };
+
+    std::size_t offset = 0;
+    for (; offset + kBlockSize <= input_.size(); offset += kBlockSize)
+    {
+        block(input_.data() + offset, static_cast<std::uint32_t>(offset));
+    }
+    if (offset < input_.size())
+    {
+        char last[kBlockSize];
+        std::memset(last, ' ', sizeof(last));
+        std::memcpy(last, input_.data() + offset, input_.size() - offset);
+        block(last, static_cast<std::uint32_t>(offset));
+    }
+
+    *out++ = static_cast<std::uint32_t>(input_.size());
+    count_ = static_cast<std::uint32_t>(out - positions_.data());
+    valid_ = stringCarry == 0;
+}
+
+bool Parser::match()
+{
+    if (closers_.size() < count_)
+    {
+        closers_.resize(count_);
+    }
+    open_.clear();
+    for (std::uint32_t entry = 0; entry + 1 < count_; ++entry)
+    {
+        char c = input_[positions_[entry]];
+        if (c == '{' || c == '[')
+        {
+            open_.push_back(entry);
+        }
+        else if (c == '}' || c == ']')
+        {
+            // The closing character is the opening one plus 2
+            if (open_.empty() || input_[positions_[open_.back()]] + 2 != c)
+            {
+                return false;
+            }
+            closers_[open_.back()] = entry;
+            open_.pop_back();
+        }
+    }
+    return open_.empty();
+}
+
+char Parser::charAt(std::uint32_t entry) const
+{
+    return entry + 1 < count_ ? input_[positions_[entry]] : '\0';
+}
+
+std::uint32_t Parser::skipSpace(std::uint32_t offset) const
+{
+    while (offset < input_.size() && isSpace(input_[offset]))
+    {
+        ++offset;
+    }
+    return offset;
+}
+
+Value Parser::valueAt(std::uint32_t offset, std::uint32_t entry) const
+{
+    offset = skipSpace(offset);
+    if (offset >= input_.size())
+    {
+        return {};
+    }
+    char c = input_[offset];
+    if (std::strchr("{[\"tfn-", c) == nullptr && (c < '0' || c > '9'))
+    {
+        return {}; // nothing there, e.g. [1,,2]
+    }
+
+    Value value;
+    value.parser_ = this;
+    value.offset_ = offset;
+    value.entry_ = entry;
+    return value;
+}
+
+Value Parser::valueAfter(std::uint32_t entry) const
+{
+    return valueAt(positions_[entry] + 1, entry + 1);
+}
+
+Value Parser::member(std::uint32_t entry) const
+{
+    // entry is the { or the comma before "key": value
+    if (charAt(entry + 1) != '"' || charAt(entry + 3) != ':')
+    {
+        return {};
+    }
+    return valueAfter(entry + 3);
+}
+
+std::string_view Parser::string(std::uint32_t entry) const
+{
+    std::uint32_t begin = positions_[entry] + 1;
+    std::string_view raw = input_.substr(begin, positions_[entry + 1] - begin);
+    if (!escapes_ || raw.find('\\') == std::string_view::npos)
+    {
+        return raw;
+    }
+    unescape(raw, decoded_.emplace_back());
+    return decoded_.back();
+}
+} // namespace json
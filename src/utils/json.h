@@ -0,0 +1,156 @@
+#ifndef JSON_H
+#define JSON_H
+
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace json
+{
+class Parser;
+
+/**
+ * @brief A value of the document last indexed by a Parser, read on demand.
+ *
+ * Nothing is converted before it is asked for: find() walks the fields of
+ * an object comparing raw keys and skipping nested values in one step,
+ * strings are unescaped and numbers parsed only when read. A missing field
+ * or element is a Value of type NONE whose accessors return empty or zero,
+ * so lookups can be chained.
+ *
+ * A Value is a position in the document, valid until the next
+ * Parser::parse().
+ */
+class Value
+{
+  public:
+    enum class Type
+    {
+        NONE,
+        NIL,
+        BOOLEAN,
+        NUMBER,
+        STRING,
+        ARRAY,
+        OBJECT
+    };
+
+    Value() = default;
+
+    Type type() const;
+
+    /**
+     * @brief False for a missing value.
+     */
+    explicit operator bool() const;
+
+    /**
+     * @brief Field key of an object, missing if there is none.
+     */
+    Value find(std::string_view key) const;
+
+    /**
+     * @brief Element index of an array, missing if out of range.
+     */
+    Value at(std::size_t index) const;
+
+    /**
+     * @brief Elements of an array or fields of an object, counted by
+     *        walking them.
+     */
+    std::size_t size() const;
+
+    /**
+     * @brief First element or field value, to iterate with next().
+     */
+    Value first() const;
+    Value next() const;
+
+    /**
+     * @brief Key of a field value, empty outside of an object.
+     */
+    std::string_view key() const;
+
+    /**
+     * @brief Unescaped, a view of the document unless it had escapes.
+     */
+    std::string_view asString() const;
+    std::int64_t asInt() const;
+    double asDouble() const;
+    bool asBool() const;
+
+    /**
+     * @brief The JSON text of the value, as it is in the document.
+     */
+    std::string_view raw() const;
+
+  private:
+    const Parser* parser_ {nullptr};
+    std::uint32_t offset_ {0}; // first byte of the value
+    std::uint32_t entry_ {0};  // first structural character at or after it
+
+    std::uint32_t end() const;
+    std::string_view scalar() const;
+
+    friend class Parser;
+};
+
+/**
+ * @brief On-demand parser for the JSON payloads of mode script callbacks.
+ *
+ * parse() only finds the structural characters of the document (brackets,
+ * colons, commas and quotes outside of strings), 64 bytes at a time with
+ * SSE2 where available, and matches the brackets. Values are then read
+ * through that index without building a tree, see Value.
+ *
+ * Reused from one document to the next, the parser stops allocating once
+ * its index fits the largest document seen. Not thread safe.
+ */
+class Parser
+{
+  public:
+    /**
+     * @brief Indexes json, which must outlive the values read from it.
+     *
+     * @return False if the brackets do not match, a string is not closed
+     *         or there is more than one value. Other syntax errors are
+     *         found when the value is read, which then reads as missing.
+     */
+    bool parse(std::string_view json);
+
+    /**
+     * @brief The document, missing if the last parse() failed.
+     */
+    Value root() const;
+
+  private:
+    std::string_view input_;
+    // Offsets of the structural characters then input_.size(), in the
+    // first count_ entries: the vector is only ever grown
+    std::vector<std::uint32_t> positions_;
+    std::uint32_t count_ {0};
+    std::vector<std::uint32_t> closers_;   // entry of the } or ] of a { or [
+    std::vector<std::uint32_t> open_;
+    bool escapes_ {false}; // any backslash in the document
+    bool valid_ {false};
+
+    // Strings that had escapes, kept until the next parse()
+    mutable std::deque<std::string> decoded_;
+
+    void scan();
+    bool match();
+    char charAt(std::uint32_t entry) const;
+    std::uint32_t skipSpace(std::uint32_t offset) const;
+    Value valueAt(std::uint32_t offset, std::uint32_t entry) const;
+    Value valueAfter(std::uint32_t entry) const;
+    Value member(std::uint32_t entry) const;
+    std::string_view string(std::uint32_t entry) const;
+
+    friend class Value;
+};
+} // namespace json
+
+#endif
@@ -0,0 +1,110 @@
+#include "log.h"
+
+#include <chrono>
+#include <ctime>
+
+#include "cli/tools.h"
+
+namespace logging
+{
+Writer::Writer(const std::string& path)
+    : file_(path, std::ios::app)
+{
+    if (!file_.is_open())
+    {
+        cli_tools::printError(
+            "Failed to open log file: " + cli_tools::bold(path));
+        return;
+    }
+    thread_ = std::thread([this] { run(); });
+}
+
+Writer::~Writer()
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        stopping_ = true;
+    }
+    wake_.notify_one();
+    if (thread_.joinable())
+    {
+        thread_.join();
+    }
+}
+
+bool Writer::isOpen() const
+{
+    return file_.is_open();
+}
+
+void Writer::write(std::string_view source, std::string_view message)
+{
+    std::time_t now =
+        std::chrono::system_clock::to_time_t(std::chrono::system_clock::now());
+    std::tm local {};
+    localtime_r(&now, &local);
+    char stamp[24];
+    std::size_t length =
+        std::strftime(stamp, sizeof(stamp), "%Y-%m-%d %H:%M:%S", &local);
+
+    bool wake;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        wake = queued_.empty();
+        queued_.append(stamp, length);
+        queued_ += " [";
+        queued_ += source;
+        queued_ += "] ";
+        queued_ += message;
+        queued_ += '\n';
+        ++queuedLines_;
+    }
+    lines_.fetch_add(1, std::memory_order_relaxed);
+    if (wake)
+    {
+        wake_.notify_one();
+    }
+}
+
+void Writer::flush()
+{
+    std::unique_lock<std::mutex> lock(mutex_);
+    if (!thread_.joinable())
+    {
+        return;
+    }
+    std::uint64_t target = queuedLines_;
+    flushed_.wait(lock, [this, target] { return writtenLines_ >= target; });
+}
+
+std::uint64_t Writer::lines() const
+{
+    return lines_.load(std::memory_order_relaxed);
+}
+
+void Writer::run()
+{
+    std::string batch;
+    std::unique_lock<std::mutex> lock(mutex_);
+    while (true)
+    {
+        wake_.wait(lock, [this] { return stopping_ || !queued_.empty(); });
+        if (queued_.empty())
+        {
+            break; // stopping, and everything is written
+        }
+
+        batch.swap(queued_);
+        std::uint64_t count = queuedLines_;
+        lock.unlock();
+
+        file_.write(batch.data(), static_cast<std::streamsize>(batch.size()));
+        file_.flush();
+        batch.clear();
+
+        lock.lock();
+        writtenLines_ = count;
+        flushed_.notify_all();
+    }
+}
+} // namespace logging
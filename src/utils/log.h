@@ -0,0 +1,62 @@
+#ifndef LOG_H
+#define LOG_H
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <fstream>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+namespace logging
+{
+/**
+ * @brief Appends timestamped lines to one log file from any thread.
+ *
+ * Lines are formatted by the caller and queued under a short lock; a
+ * background thread writes whatever accumulated in one go, so event loops
+ * never wait on the disk. Used by every server of a multi-server process,
+ * each line tagged with where it comes from:
+ *
+ *     2024-05-01 21:03:44 [lobby] Connected to 127.0.0.1:5000
+ */
+class Writer
+{
+  public:
+    explicit Writer(const std::string& path);
+    ~Writer();
+
+    Writer(const Writer&) = delete;
+    Writer& operator=(const Writer&) = delete;
+
+    bool isOpen() const;
+
+    void write(std::string_view source, std::string_view message);
+
+    /**
+     * @brief Blocks until every line written so far is on disk.
+     */
+    void flush();
+
+    std::uint64_t lines() const;
+
+  private:
+    std::ofstream file_;
+    std::mutex mutex_;
+    std::condition_variable wake_;
+    std::condition_variable flushed_;
+    std::string queued_;
+    std::uint64_t queuedLines_ {0};
+    std::uint64_t writtenLines_ {0};
+    bool stopping_ {false};
+    std::atomic<std::uint64_t> lines_ {0};
+    std::thread thread_;
+
+    void run();
+};
+} // namespace logging
+
+#endif
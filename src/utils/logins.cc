@@ -0,0 +1,201 @@
+#include "logins.h"
+
+#include <cstring>
+#include <functional>
+
+namespace utils
+{
+Logins::~Logins()
+{
+    for (Shard& shard : shards_)
+    {
+        for (auto& block : shard.blocks)
+        {
+            delete[] block.load(std::memory_order_relaxed);
+        }
+    }
+}
+
+LoginId Logins::intern(std::string_view login)
+{
+    std::uint64_t hash = hashOf(login);
+    std::size_t index = hash >> 60; // the slots use the low bits
+    Shard& shard = shards_[index];
+
+    LoginId id = lookup(shard, login, hash);
+    if (id != kNone)
+    {
+        return id;
+    }
+
+    std::lock_guard<std::mutex> lock(shard.mutex);
+    id = lookup(shard, login, hash);
+    if (id != kNone)
+    {
+        return id; // interned by another thread meanwhile
+    }
+
+    std::size_t slot = shard.count;
+    if (slot == kMaxBlocks * kBlockSize)
+    {
+        return kNone;
+    }
+    std::string_view* block =
+        shard.blocks[slot / kBlockSize].load(std::memory_order_relaxed);
+    if (block == nullptr)
+    {
+        block = new std::string_view[kBlockSize];
+        shard.blocks[slot / kBlockSize].store(block, std::memory_order_release);
+    }
+    block[slot % kBlockSize] = copy(shard, login);
+
+    // At most half full, so probes stay short and always end on a free word
+    if (shard.tables.empty() ||
+        2 * (shard.count + 1) > shard.tables.back()->mask + 1)
+    {
+        grow(shard);
+    }
+    ++shard.count;
+
+    id = static_cast<LoginId>(slot * kShards + index);
+    insert(*shard.tables.back(), hash, id);
+    return id;
+}
+
+LoginId Logins::find(std::string_view login) const
+{
+    std::uint64_t hash = hashOf(login);
+    return lookup(shards_[hash >> 60], login, hash);
+}
+
+std::string_view Logins::name(LoginId id) const
+{
+    if (id == kNone)
+    {
+        return {};
+    }
+    // The id was handed out after its name was written, whoever holds it
+    // synchronized with that
+    const Shard& shard = shards_[id % kShards];
+    std::size_t slot = id / kShards;
+    return shard.blocks[slot / kBlockSize].load(
+        std::memory_order_acquire)[slot % kBlockSize];
+}
+
+std::size_t Logins::size() const
+{
+    std::size_t total = 0;
+    for (const Shard& shard : shards_)
+    {
+        std::lock_guard<std::mutex> lock(shard.mutex);
+        total += shard.count;
+    }
+    return total;
+}
+
+std::uint64_t Logins::hashOf(std::string_view login)
+{
+    return std::hash<std::string_view>()(login);
+}
+
+LoginId Logins::lookup(
+    const Shard& shard, std::string_view login, std::uint64_t hash) const
+{
+    const Slots* slots = shard.slots.load(std::memory_order_acquire);
+    if (slots == nullptr)
+    {
+        return kNone;
+    }
+
+    auto tag = static_cast<std::uint32_t>(hash >> 32);
+    for (std::size_t i = hash & slots->mask;; i = (i + 1) & slots->mask)
+    {
+        std::uint64_t word = slots->words[i].load(std::memory_order_acquire);
+        if (word == 0)
+        {
+            return kNone;
+        }
+        if (static_cast<std::uint32_t>(word >> 32) == tag)
+        {
+            auto id = static_cast<LoginId>(word) - 1;
+            if (name(id) == login)
+            {
+                return id;
+            }
+        }
+    }
+}
+
+void Logins::insert(Slots& slots, std::uint64_t hash, LoginId id)
+{
+    std::uint64_t word = (hash >> 32 << 32) | (std::uint64_t {id} + 1);
+    std::size_t i = hash & slots.mask;
+    while (slots.words[i].load(std::memory_order_relaxed) != 0)
+    {
+        i = (i + 1) & slots.mask;
+    }
+    // Release: a reader seeing the word sees the name it points to
+    slots.words[i].store(word, std::memory_order_release);
+}
+
+void Logins::grow(Shard& shard)
+{
+    auto slots = std::make_unique<Slots>();
+    std::size_t size =
+        shard.tables.empty() ? kMinSlots : 2 * (shard.tables.back()->mask + 1);
+    slots->mask = size - 1;
+    slots->words = std::make_unique<std::atomic<std::uint64_t>[]>(size);
+
+    if (!shard.tables.empty())
+    {
+        const Slots& old = *shard.tables.back();
+        for (std::size_t i = 0; i <= old.mask; ++i)
+        {
+            std::uint64_t word = old.words[i].load(std::memory_order_relaxed);
+            if (word != 0)
+            {
+                // The word only keeps half the hash, the home slot needs
+                // the low bits
+                std::size_t slot = (static_cast<LoginId>(word) - 1) / kShards;
+                insert(*slots,
+                    hashOf(shard.blocks[slot / kBlockSize].load(
+                        std::memory_order_relaxed)[slot % kBlockSize]),
+                    static_cast<LoginId>(word) - 1);
+            }
+        }
+    }
+
+    // Readers still on the old array find what it had; what they miss is
+    // looked up again under the lock
+    shard.slots.store(slots.get(), std::memory_order_release);
+    shard.tables.push_back(std::move(slots));
+}
+
+std::string_view Logins::copy(Shard& shard, std::string_view login)
+{
+    if (login.size() > kChunkSize / 4)
+    {
+        // Not a real login, kept apart so it does not waste a chunk
+        shard.chunks.emplace_back(new char[login.size()]);
+        std::memcpy(shard.chunks.back().get(), login.data(), login.size());
+        return std::string_view(shard.chunks.back().get(), login.size());
+    }
+
+    if (shard.chunk == nullptr || kChunkSize - shard.chunkUsed < login.size())
+    {
+        shard.chunks.emplace_back(new char[kChunkSize]);
+        shard.chunk = shard.chunks.back().get();
+        shard.chunkUsed = 0;
+    }
+    char* out = shard.chunk + shard.chunkUsed;
+    std::memcpy(out, login.data(), login.size());
+    shard.chunkUsed += login.size();
+    return std::string_view(out, login.size());
+}
+
+Logins& logins()
+{
+    static Logins table;
+    return table;
+}
+} // namespace utils
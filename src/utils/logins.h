@@ -0,0 +1,108 @@
+#ifndef LOGINS_H
+#define LOGINS_H
+
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string_view>
+#include <vector>
+
+namespace utils
+{
+/**
+ * @brief Stable number of a login, see Logins.
+ */
+using LoginId = std::uint32_t;
+
+/**
+ * @brief Interning table of the logins seen by the process: each login gets
+ *        one id and one canonical copy, both kept until exit.
+ *
+ * Permission lists, caches and write queues key on the id, so a lookup is an
+ * integer compare and a login is not copied once per subsystem. The table is
+ * split in shards by hash, each an open addressing array of (hash, id)
+ * words. Looking up a known login takes no lock: words are only ever
+ * filled, and a full array is copied to a larger one that replaces it, the
+ * old one staying readable. Adding a login locks its shard.
+ */
+class Logins
+{
+  public:
+    static constexpr LoginId kNone = static_cast<LoginId>(-1);
+
+    Logins() = default;
+    ~Logins();
+
+    Logins(const Logins&) = delete;
+    Logins& operator=(const Logins&) = delete;
+
+    /**
+     * @brief Id of login, added on first sight.
+     *
+     * @return kNone only if the table is full (2^28 logins).
+     */
+    LoginId intern(std::string_view login);
+
+    /**
+     * @brief Id of login, kNone if it was never interned.
+     */
+    LoginId find(std::string_view login) const;
+
+    /**
+     * @brief The canonical copy of an id returned by intern(), valid until
+     *        exit. Empty for kNone.
+     */
+    std::string_view name(LoginId id) const;
+
+    std::size_t size() const;
+
+  private:
+    static constexpr std::size_t kShards = 16;
+    static constexpr std::size_t kBlockSize = 4096;  // names per block
+    static constexpr std::size_t kMaxBlocks = 4096;  // per shard
+    static constexpr std::size_t kChunkSize = 65536; // bytes of names
+    static constexpr std::size_t kMinSlots = 1024;
+
+    /// Slot words: high half the hash, low half the id plus one, 0 if free
+    struct Slots
+    {
+        std::size_t mask {0};
+        std::unique_ptr<std::atomic<std::uint64_t>[]> words;
+    };
+
+    struct alignas(64) Shard
+    {
+        std::atomic<const Slots*> slots {nullptr};
+
+        // Only touched by intern(), under the lock
+        mutable std::mutex mutex;
+        std::vector<std::unique_ptr<Slots>> tables; // the current one last
+        std::vector<std::unique_ptr<char[]>> chunks;
+        char* chunk {nullptr}; // the one names are appended to
+        std::size_t chunkUsed {kChunkSize};
+        std::uint32_t count {0};
+
+        // Written under the lock, read without it by name()
+        std::array<std::atomic<std::string_view*>, kMaxBlocks> blocks {};
+    };
+
+    std::array<Shard, kShards> shards_;
+
+    static std::uint64_t hashOf(std::string_view login);
+    LoginId lookup(
+        const Shard& shard, std::string_view login, std::uint64_t hash) const;
+    static void insert(Slots& slots, std::uint64_t hash, LoginId id);
+    static void grow(Shard& shard);
+    static std::string_view copy(Shard& shard, std::string_view login);
+};
+
+/**
+ * @brief The table of the process, shared by every subsystem.
+ */
+Logins& logins();
+} // namespace utils
+
+#endif
@@ -0,0 +1,392 @@
+#ifndef RANKINDEX_H
+#define RANKINDEX_H
+
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <utility>
+#include <vector>
+
+namespace utils
+{
+/**
+ * @brief Ordered set with rank and select, for leaderboards.
+ *
+ * Items live in sorted fixed-size blocks, keys and values stored apart so a
+ * search only reads keys. A Fenwick tree over the block sizes gives the number
+ * of items before any block, so rank and select cost O(log n), and so do
+ * insert/erase plus a short memmove inside one block. A lookup touches a
+ * handful of cache lines instead of one per tree level. Keys must be unique
+ * under Compare.
+ *
+ * Update costs are amortized: when a block fills up and splits, or empties
+ * and is dropped, the block list and the Fenwick tree are rebuilt in
+ * O(n / BlockSize). A block splits at most once every BlockSize inserts into
+ * it and is dropped only once all its items are erased.
+ */
+template <typename Key, typename Value, typename Compare = std::less<Key>,
+    std::size_t BlockSize = 64>
+class RankIndex
+{
+  public:
+    using Item = std::pair<Key, Value>;
+
+    explicit RankIndex(Compare compare = Compare())
+        : compare_(compare)
+    {
+    }
+
+    std::size_t size() const
+    {
+        return size_;
+    }
+
+    bool empty() const
+    {
+        return size_ == 0;
+    }
+
+    void clear()
+    {
+        pool_.clear();
+        freeBlocks_.clear();
+        order_.clear();
+        firstKeys_.clear();
+        fenwick_.clear();
+        size_ = 0;
+    }
+
+    /**
+     * @brief Replaces the content with items, which must be sorted and
+     *        unique. O(n).
+     */
+    void assign(const std::vector<Item>& items)
+    {
+        clear();
+        size_ = items.size();
+        pool_.reserve(items.size() / BlockSize + 1);
+        for (std::size_t i = 0; i < items.size(); i += BlockSize)
+        {
+            std::uint32_t id = allocate();
+            Block& block = pool_[id];
+            std::size_t end = std::min(items.size(), i + BlockSize);
+            for (std::size_t j = i; j < end; ++j)
+            {
+                block.keys[block.count] = items[j].first;
+                block.values[block.count] = items[j].second;
+                ++block.count;
+            }
+            order_.push_back(id);
+            firstKeys_.push_back(block.keys[0]);
+        }
+        rebuild();
+    }
+
+    /**
+     * @brief Inserts key, which must not be present yet. Amortized
+     *        O(log n), see above.
+     */
+    void insert(const Key& key, const Value& value)
+    {
+        if (order_.empty())
+        {
+            order_.push_back(allocate());
+            firstKeys_.push_back(key);
+            rebuild();
+        }
+
+        std::size_t b = blockOf(key);
+        Block& block = pool_[order_[b]];
+        std::size_t at = lowerBound(block, key);
+        std::move_backward(block.keys.begin() + at,
+            block.keys.begin() + block.count,
+            block.keys.begin() + block.count + 1);
+        std::move_backward(block.values.begin() + at,
+            block.values.begin() + block.count,
+            block.values.begin() + block.count + 1);
+        block.keys[at] = key;
+        block.values[at] = value;
+        ++block.count;
+        firstKeys_[b] = block.keys[0];
+        ++size_;
+
+        if (block.count == Capacity)
+        {
+            splitBlock(b);
+        }
+        else
+        {
+            add(b, 1);
+        }
+    }
+
+    /**
+     * @brief Removes key. Amortized O(log n), see above.
+     *
+     * @return false if key was not present.
+     */
+    bool erase(const Key& key)
+    {
+        if (order_.empty())
+        {
+            return false;
+        }
+
+        std::size_t b = blockOf(key);
+        Block& block = pool_[order_[b]];
+        std::size_t at = lowerBound(block, key);
+        if (at == block.count || compare_(key, block.keys[at]))
+        {
+            return false;
+        }
+
+        std::move(block.keys.begin() + at + 1, block.keys.begin() + block.count,
+            block.keys.begin() + at);
+        std::move(block.values.begin() + at + 1,
+            block.values.begin() + block.count, block.values.begin() + at);
+        --block.count;
+        --size_;
+
+        if (block.count == 0)
+        {
+            freeBlocks_.push_back(order_[b]);
+            order_.erase(order_.begin() + b);
+            firstKeys_.erase(firstKeys_.begin() + b);
+            rebuild();
+        }
+        else
+        {
+            firstKeys_[b] = block.keys[0];
+            add(b, -1);
+        }
+        return true;
+    }
+
+    /**
+     * @brief 1-based position of key in ascending order, 0 if absent.
+     */
+    std::size_t rank(const Key& key) const
+    {
+        if (order_.empty())
+        {
+            return 0;
+        }
+
+        std::size_t b = blockOf(key);
+        const Block& block = pool_[order_[b]];
+        std::size_t at = lowerBound(block, key);
+        if (at == block.count || compare_(key, block.keys[at]))
+        {
+            return 0;
+        }
+        return prefix(b) + at + 1;
+    }
+
+    /**
+     * @brief Number of keys strictly lower than key, key need not be present.
+     */
+    std::size_t countBelow(const Key& key) const
+    {
+        if (order_.empty())
+        {
+            return 0;
+        }
+
+        std::size_t b = blockOf(key);
+        return prefix(b) + lowerBound(pool_[order_[b]], key);
+    }
+
+    /**
+     * @brief Item at the 1-based position, false if out of range.
+     */
+    bool select(std::size_t position, Item& item) const
+    {
+        if (position == 0 || position > size_)
+        {
+            return false;
+        }
+        auto [b, offset] = locate(position - 1);
+        const Block& block = pool_[order_[b]];
+        item = Item {block.keys[offset], block.values[offset]};
+        return true;
+    }
+
+    /**
+     * @brief Calls visit(key, value) for at most count items in ascending
+     *        order, starting at the 1-based position first.
+     */
+    template <typename Visitor>
+    void forEach(std::size_t first, std::size_t count, Visitor visit) const
+    {
+        if (first == 0 || first > size_)
+        {
+            return;
+        }
+
+        auto [b, offset] = locate(first - 1);
+        for (; b < order_.size() && count > 0; ++b, offset = 0)
+        {
+            const Block& block = pool_[order_[b]];
+            for (; offset < block.count && count > 0; ++offset, --count)
+            {
+                visit(block.keys[offset], block.values[offset]);
+            }
+        }
+    }
+
+  private:
+    static constexpr std::size_t Capacity = BlockSize * 2;
+
+    struct Block
+    {
+        std::uint32_t count {0};
+        std::array<Key, Capacity> keys;
+        std::array<Value, Capacity> values;
+    };
+
+    Compare compare_;
+    std::vector<Block> pool_;
+    std::vector<std::uint32_t> freeBlocks_;
+    std::vector<std::uint32_t> order_;   // pool ids, in key order
+    std::vector<Key> firstKeys_;         // first key of every block, in order
+    std::vector<std::uint32_t> fenwick_; // 1-based, over block sizes
+    std::size_t size_ {0};
+
+    std::uint32_t allocate()
+    {
+        if (!freeBlocks_.empty())
+        {
+            std::uint32_t id = freeBlocks_.back();
+            freeBlocks_.pop_back();
+            pool_[id].count = 0;
+            return id;
+        }
+        pool_.emplace_back();
+        return static_cast<std::uint32_t>(pool_.size() - 1);
+    }
+
+    /**
+     * Branchless binary search: the loop has a fixed trip count and the
+     * comparison feeds a conditional move, so there is no misprediction to
+     * pay on each level. Returns the first position where key < data[i]
+     * (upper) or !(data[i] < key) (lower).
+     */
+    template <bool Upper>
+    std::size_t search(const Key* data, std::size_t count, const Key& key) const
+    {
+        if (count == 0)
+        {
+            return 0;
+        }
+
+        const Key* first = data;
+        while (count > 1)
+        {
+            std::size_t half = count / 2;
+            bool right = Upper ? !compare_(key, first[half])
+                               : compare_(first[half - 1], key);
+            first = right ? first + half : first;
+            count -= half;
+        }
+        bool past = Upper ? !compare_(key, *first) : compare_(*first, key);
+        return static_cast<std::size_t>(first - data) + past;
+    }
+
+    std::size_t lowerBound(const Block& block, const Key& key) const
+    {
+        // Pull every key line of the block at once: the misses overlap
+        // instead of stacking up along the binary search.
+        const char* data = reinterpret_cast<const char*>(block.keys.data());
+        for (std::size_t offset = 0; offset < block.count * sizeof(Key);
+             offset += 64)
+        {
+            __builtin_prefetch(data + offset);
+        }
+        return search<false>(block.keys.data(), block.count, key);
+    }
+
+    /// Position in order_ of the block that holds key, or would hold it.
+    std::size_t blockOf(const Key& key) const
+    {
+        std::size_t after =
+            search<true>(firstKeys_.data(), firstKeys_.size(), key);
+        return after == 0 ? 0 : after - 1;
+    }
+
+    /// Number of items in blocks [0, block).
+    std::size_t prefix(std::size_t block) const
+    {
+        std::size_t sum = 0;
+        for (std::size_t i = block; i > 0; i &= i - 1)
+        {
+            sum += fenwick_[i];
+        }
+        return sum;
+    }
+
+    void add(std::size_t block, int delta)
+    {
+        for (std::size_t i = block + 1; i < fenwick_.size(); i += i & (~i + 1))
+        {
+            fenwick_[i] += static_cast<std::uint32_t>(delta);
+        }
+    }
+
+    /// Block and offset of the 0-based position.
+    std::pair<std::size_t, std::size_t> locate(std::size_t position) const
+    {
+        std::size_t block = 0;
+        std::size_t step = 1;
+        while (step * 2 < fenwick_.size())
+        {
+            step *= 2;
+        }
+        for (; step > 0; step /= 2)
+        {
+            if (block + step < fenwick_.size() &&
+                fenwick_[block + step] <= position)
+            {
+                block += step;
+                position -= fenwick_[block];
+            }
+        }
+        return {block, position};
+    }
+
+    void splitBlock(std::size_t b)
+    {
+        std::uint32_t id = allocate(); // may move pool_, index it afterwards
+        Block& lower = pool_[order_[b]];
+        Block& upper = pool_[id];
+        std::move(lower.keys.begin() + BlockSize, lower.keys.end(),
+            upper.keys.begin());
+        std::move(lower.values.begin() + BlockSize, lower.values.end(),
+            upper.values.begin());
+        upper.count = static_cast<std::uint32_t>(Capacity - BlockSize);
+        lower.count = static_cast<std::uint32_t>(BlockSize);
+
+        order_.insert(order_.begin() + b + 1, id);
+        firstKeys_.insert(firstKeys_.begin() + b + 1, upper.keys[0]);
+        rebuild();
+    }
+
+    /// Rebuilds the Fenwick tree in O(blocks).
+    void rebuild()
+    {
+        fenwick_.assign(order_.size() + 1, 0);
+        for (std::size_t i = 1; i < fenwick_.size(); ++i)
+        {
+            fenwick_[i] += pool_[order_[i - 1]].count;
+            std::size_t parent = i + (i & (~i + 1));
+            if (parent < fenwick_.size())
+            {
+                fenwick_[parent] += fenwick_[i];
+            }
+        }
+    }
+};
+} // namespace utils
+
+#endif
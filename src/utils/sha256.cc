@@ -0,0 +1,154 @@
+#include "sha256.h"
+
+#include <algorithm>
+#include <cstring>
+
+namespace utils
+{
+namespace
+{
+constexpr std::array<std::uint32_t, 64> kRounds = {0x428a2f98, 0x71374491,
+    0xb5c0fbcf, 0xe9b5dba5, 0x3956c25b, 0x59f111f1, 0x923f82a4, 0xab1c5ed5,
+    0xd807aa98, 0x12835b01, 0x243185be, 0x550c7dc3, 0x72be5d74, 0x80deb1fe,
+    0x9bdc06a7, 0xc19bf174, 0xe49b69c1, 0xefbe4786, 0x0fc19dc6, 0x240ca1cc,
+    0x2de92c6f, 0x4a7484aa, 0x5cb0a9dc, 0x76f988da, 0x983e5152, 0xa831c66d,
+    0xb00327c8, 0xbf597fc7, 0xc6e00bf3, 0xd5a79147, 0x06ca6351, 0x14292967,
+    0x27b70a85, 0x2e1b2138, 0x4d2c6dfc, 0x53380d13, 0x650a7354, 0x766a0abb,
+    0x81c2c92e, 0x92722c85, 0xa2bfe8a1, 0xa81a664b, 0xc24b8b70, 0xc76c51a3,
+    0xd192e819, 0xd6990624, 0xf40e3585, 0x106aa070, 0x19a4c116, 0x1e376c08,
+    0x2748774c, 0x34b0bcb5, 0x391c0cb3, 0x4ed8aa4a, 0x5b9cca4f, 0x682e6ff3,
+    0x748f82ee, 0x78a5636f, 0x84c87814, 0x8cc70208, 0x90befffa, 0xa4506ceb,
+    0xbef9a3f7, 0xc67178f2};
+
+std::uint32_t rotr(std::uint32_t value, int bits)
+{
+    return (value >> bits) | (value << (32 - bits));
+}
+} // namespace
+
+void Sha256::update(std::string_view data)
+{
+    auto bytes = reinterpret_cast<const std::uint8_t*>(data.data());
+    std::size_t size = data.size();
+    length_ += size;
+
+    if (used_ != 0)
+    {
+        std::size_t take = std::min(size, block_.size() - used_);
+        std::memcpy(block_.data() + used_, bytes, take);
+        used_ += take;
+        bytes += take;
+        size -= take;
+        if (used_ < block_.size())
+        {
+            return;
+        }
+        compress(block_.data());
+        used_ = 0;
+    }
+    // Whole blocks straight from the input
+    for (; size >= block_.size(); bytes += 64, size -= 64)
+    {
+        compress(bytes);
+    }
+    std::memcpy(block_.data(), bytes, size);
+    used_ = size;
+}
+
+Sha256::Digest Sha256::finish()
+{
+    std::uint64_t bits = length_ * 8;
+    const std::uint8_t one = 0x80;
+    update(std::string_view(reinterpret_cast<const char*>(&one), 1));
+    const std::array<std::uint8_t, 64> zeros {};
+    std::size_t padding = (used_ <= 56 ? 56 : 120) - used_;
+    update(std::string_view(
+        reinterpret_cast<const char*>(zeros.data()), padding));
+
+    std::array<std::uint8_t, 8> length;
+    for (std::size_t i = 0; i < 8; ++i)
+    {
+        length[i] = static_cast<std::uint8_t>(bits >> (56 - 8 * i));
+    }
+    update(std::string_view(
+        reinterpret_cast<const char*>(length.data()), length.size()));
+
+    Digest digest;
+    for (std::size_t i = 0; i < state_.size(); ++i)
+    {
+        for (std::size_t b = 0; b < 4; ++b)
+        {
+            digest[i * 4 + b] =
+                static_cast<std::uint8_t>(state_[i] >> (24 - 8 * b));
+        }
+    }
+    *this = Sha256();
+    return digest;
+}
+
+Sha256::Digest Sha256::of(std::string_view data)
+{
+    Sha256 hash;
+    hash.update(data);
+    return hash.finish();
+}
+
+std::string Sha256::toHex(const Digest& digest)
+{
+    constexpr char kDigits[] = "0123456789abcdef";
+    std::string hex;
+    hex.reserve(digest.size() * 2);
+    for (std::uint8_t byte : digest)
+    {
+        hex += kDigits[byte >> 4];
+        hex += kDigits[byte & 15];
+    }
+    return hex;
+}
+
+void Sha256::compress(const std::uint8_t* block)
+{
+    std::array<std::uint32_t, 64> w;
+    for (std::size_t i = 0; i < 16; ++i)
+    {
+        w[i] = std::uint32_t {block[i * 4]} << 24 |
+            std::uint32_t {block[i * 4 + 1]} << 16 |
+            std::uint32_t {block[i * 4 + 2]} << 8 | block[i * 4 + 3];
+    }
+    for (std::size_t i = 16; i < 64; ++i)
+    {
+        std::uint32_t s0 =
+            rotr(w[i - 15], 7) ^ rotr(w[i - 15], 18) ^ (w[i - 15] >> 3);
+        std::uint32_t s1 =
+            rotr(w[i - 2], 17) ^ rotr(w[i - 2], 19) ^ (w[i - 2] >> 10);
+        w[i] = w[i - 16] + s0 + w[i - 7] + s1;
+    }
+
+    auto [a, b, c, d, e, f, g, h] = state_;
+    for (std::size_t i = 0; i < 64; ++i)
+    {
+        std::uint32_t s1 = rotr(e, 6) ^ rotr(e, 11) ^ rotr(e, 25);
+        std::uint32_t choice = (e & f) ^ (~e & g);
+        std::uint32_t t1 = h + s1 + choice + kRounds[i] + w[i];
+        std::uint32_t s0 = rotr(a, 2) ^ rotr(a, 13) ^ rotr(a, 22);
+        std::uint32_t majority = (a & b) ^ (a & c) ^ (b & c);
+        std::uint32_t t2 = s0 + majority;
+        h = g;
+        g = f;
+        f = e;
+        e = d + t1;
+        d = c;
+        c = b;
+        b = a;
+        a = t1 + t2;
+    }
+    state_[0] += a;
+    state_[1] += b;
+    state_[2] += c;
+    state_[3] += d;
+    state_[4] += e;
+    state_[5] += f;
+    state_[6] += g;
+    state_[7] += h;
+}
+} // namespace utils
@@ -0,0 +1,49 @@
+#ifndef SHA256_H
+#define SHA256_H
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+
+namespace utils
+{
+/**
+ * @brief SHA-256, to name content by what it is (see replays::Store).
+ *
+ *     utils::Sha256 hash;
+ *     hash.update(data);
+ *     utils::Sha256::Digest digest = hash.finish();
+ */
+class Sha256
+{
+  public:
+    using Digest = std::array<std::uint8_t, 32>;
+
+    void update(std::string_view data);
+
+    /**
+     * @brief The digest of everything updated, the hash is reset after.
+     */
+    Digest finish();
+
+    static Digest of(std::string_view data);
+
+    /**
+     * @brief Lowercase hexadecimal, 64 characters.
+     */
+    static std::string toHex(const Digest& digest);
+
+  private:
+    std::array<std::uint32_t, 8> state_ {0x6a09e667, 0xbb67ae85, 0x3c6ef372,
+        0xa54ff53a, 0x510e527f, 0x9b05688c, 0x1f83d9ab, 0x5be0cd19};
+    std::array<std::uint8_t, 64> block_ {};
+    std::size_t used_ {0};     // bytes in block_
+    std::uint64_t length_ {0}; // bytes updated
+
+    void compress(const std::uint8_t* block);
+};
+} // namespace utils
+
+#endif
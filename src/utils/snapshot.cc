@@ -0,0 +1,280 @@
+#include "snapshot.h"
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <chrono>
+#include <cstdio>
+#include <fstream>
+
+namespace snapshot
+{
+namespace
+{
+constexpr char kMagic[4] = {'P', 'P', 'S', 'S'};
+constexpr std::uint32_t kVersion = 1;
+
+struct Header
+{
+    char magic[4];
+    std::uint32_t version;
+    std::uint64_t size;     // of the whole file
+    std::uint64_t checksum; // of everything after the header
+    std::int64_t written;   // unix time
+    std::uint32_t sections;
+    std::uint32_t reserved;
+};
+
+struct SectionEntry
+{
+    std::uint32_t id;
+    std::uint32_t reserved;
+    std::uint64_t offset; // from the start of the file
+    std::uint64_t size;
+};
+
+constexpr std::uint64_t kChecksumSeed = 0xcbf29ce484222325;
+
+/// FNV-1a over 64-bit words: fast enough to check a file on every start,
+/// only meant to catch truncated or damaged files. Goes on from hash, so
+/// blocks whose size is a multiple of 8 can be checked one after the other.
+std::uint64_t checksum(
+    const char* data, std::size_t size, std::uint64_t hash = kChecksumSeed)
+{
+    constexpr std::uint64_t kPrime = 0x100000001b3;
+    std::size_t i = 0;
+    for (; i + sizeof(std::uint64_t) <= size; i += sizeof(std::uint64_t))
+    {
+        std::uint64_t word;
+        std::memcpy(&word, data + i, sizeof(word));
+        hash = (hash ^ word) * kPrime;
+    }
+    for (; i < size; ++i)
+    {
+        hash = (hash ^ static_cast<unsigned char>(data[i])) * kPrime;
+    }
+    return hash;
+}
+} // namespace
+
+void appendVarint(std::string& out, std::uint64_t value)
+{
+    while (value >= 0x80)
+    {
+        out += static_cast<char>((value & 0x7F) | 0x80);
+        value >>= 7;
+    }
+    out += static_cast<char>(value);
+}
+
+void Writer::begin(Section section)
+{
+    sections_.push_back(Entry {section, data_.size()});
+}
+
+void Writer::putString(std::string_view value)
+{
+    put<std::uint32_t>(static_cast<std::uint32_t>(value.size()));
+    data_.append(value);
+}
+
+void Writer::putVarint(std::uint64_t value)
+{
+    appendVarint(data_, value);
+}
+
+void Writer::putBytes(std::string_view bytes)
+{
+    data_.append(bytes);
+}
+
+std::size_t Writer::offset() const
+{
+    return sections_.empty() ? 0 : data_.size() - sections_.back().offset;
+}
+
+bool Writer::save(const std::string& path)
+{
+    std::size_t tableSize = sections_.size() * sizeof(SectionEntry);
+    std::size_t start = sizeof(Header) + tableSize;
+
+    std::string table(tableSize, '\0');
+    for (std::size_t i = 0; i < sections_.size(); ++i)
+    {
+        std::size_t end = i + 1 < sections_.size() ? sections_[i + 1].offset
+                                                   : data_.size();
+        SectionEntry entry {static_cast<std::uint32_t>(sections_[i].section),
+            0, start + sections_[i].offset, end - sections_[i].offset};
+        std::memcpy(table.data() + i * sizeof(entry), &entry, sizeof(entry));
+    }
+
+    Header header {};
+    std::memcpy(header.magic, kMagic, sizeof(kMagic));
+    header.version = kVersion;
+    header.size = start + data_.size();
+    header.written = std::chrono::duration_cast<std::chrono::seconds>(
+        std::chrono::system_clock::now().time_since_epoch())
+                         .count();
+    header.sections = static_cast<std::uint32_t>(sections_.size());
+    // The table is whole words: as if the table and the data were one block
+    static_assert(sizeof(SectionEntry) % sizeof(std::uint64_t) == 0);
+    header.checksum = checksum(
+        data_.data(), data_.size(), checksum(table.data(), table.size()));
+
+    std::string tmpPath = path + ".tmp";
+    {
+        std::ofstream out(tmpPath, std::ios::binary | std::ios::trunc);
+        if (!out.is_open())
+        {
+            return false;
+        }
+        out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+        out.write(table.data(), static_cast<std::streamsize>(table.size()));
+        out.write(data_.data(), static_cast<std::streamsize>(data_.size()));
+        if (!out)
+        {
+            return false;
+        }
+    }
+    return std::rename(tmpPath.c_str(), path.c_str()) == 0;
+}
+
+Cursor::Cursor(const char* data, std::size_t size)
+    : data_(data)
+    , size_(size)
+{
+}
+
+bool Cursor::getString(std::string_view& value)
+{
+    std::uint32_t length = 0;
+    if (!get(length) || size_ - offset_ < length)
+    {
+        ok_ = false;
+        return false;
+    }
+    value = std::string_view(data_ + offset_, length);
+    offset_ += length;
+    return true;
+}
+
+bool Cursor::getVarint(std::uint64_t& value)
+{
+    value = 0;
+    for (unsigned shift = 0; ok_ && offset_ < size_ && shift < 64;
+         shift += 7)
+    {
+        auto byte = static_cast<unsigned char>(data_[offset_++]);
+        value |= static_cast<std::uint64_t>(byte & 0x7F) << shift;
+        if ((byte & 0x80) == 0)
+        {
+            return true;
+        }
+    }
+    ok_ = false;
+    return false;
+}
+
+bool Cursor::seek(std::size_t offset)
+{
+    if (offset > size_)
+    {
+        ok_ = false;
+        return false;
+    }
+    offset_ = offset;
+    ok_ = true;
+    return true;
+}
+
+std::size_t Cursor::offset() const
+{
+    return offset_;
+}
+
+Reader::~Reader()
+{
+    if (data_ != nullptr)
+    {
+        ::munmap(const_cast<char*>(data_), size_);
+    }
+}
+
+bool Reader::open(const std::string& path)
+{
+    int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0)
+    {
+        return false;
+    }
+
+    struct stat st;
+    if (::fstat(fd, &st) != 0 ||
+        static_cast<std::size_t>(st.st_size) < sizeof(Header))
+    {
+        ::close(fd);
+        return false;
+    }
+
+    auto size = static_cast<std::size_t>(st.st_size);
+    void* data = ::mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+    ::close(fd);
+    if (data == MAP_FAILED)
+    {
+        return false;
+    }
+    // Read once from start to end, by the checksum then by the sections
+    ::madvise(data, size, MADV_SEQUENTIAL);
+
+    const char* bytes = static_cast<const char*>(data);
+    Header header;
+    std::memcpy(&header, bytes, sizeof(header));
+    if (std::memcmp(header.magic, kMagic, sizeof(kMagic)) != 0 ||
+        header.version != kVersion || header.size != size ||
+        (size - sizeof(Header)) / sizeof(SectionEntry) < header.sections ||
+        checksum(bytes + sizeof(Header), size - sizeof(Header)) !=
+            header.checksum)
+    {
+        ::munmap(data, size);
+        return false;
+    }
+
+    data_ = bytes;
+    size_ = size;
+    written_ = header.written;
+    return true;
+}
+
+std::int64_t Reader::written() const
+{
+    return written_;
+}
+
+std::optional<Cursor> Reader::section(Section section) const
+{
+    if (data_ == nullptr)
+    {
+        return std::nullopt;
+    }
+    Header header;
+    std::memcpy(&header, data_, sizeof(header));
+    for (std::uint32_t i = 0; i < header.sections; ++i)
+    {
+        SectionEntry entry;
+        std::memcpy(&entry, data_ + sizeof(Header) + i * sizeof(entry),
+            sizeof(entry));
+        if (entry.id != static_cast<std::uint32_t>(section))
+        {
+            continue;
+        }
+        if (entry.offset > size_ || size_ - entry.offset < entry.size)
+        {
+            return std::nullopt;
+        }
+        return Cursor(data_ + entry.offset, entry.size);
+    }
+    return std::nullopt;
+}
+} // namespace snapshot
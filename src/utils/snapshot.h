@@ -0,0 +1,165 @@
+#ifndef SNAPSHOT_H
+#define SNAPSHOT_H
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <type_traits>
+#include <vector>
+
+namespace snapshot
+{
+/**
+ * @brief What a section of a snapshot holds. Values are stored, never
+ *        reuse one.
+ */
+enum class Section : std::uint32_t
+{
+    STATS_PLAYERS = 1,
+    STATS_MAPS = 2,
+    STATS_FINISHERS = 3,
+
+    // records::ArchiveWriter
+    RECORDS_LOGINS = 16,
+    RECORDS_MAPS = 17,
+    RECORDS_LOGIN_IDS = 18,
+    RECORDS_TIMES = 19,
+    RECORDS_TIMESTAMPS = 20
+};
+
+/**
+ * @brief Appends value to out in LEB128: one byte below 128, at most ten.
+ */
+void appendVarint(std::string& out, std::uint64_t value);
+
+/**
+ * @brief Builds a snapshot file, one section after the other.
+ *
+ *     snapshot::Writer writer;
+ *     writer.begin(snapshot::Section::STATS_MAPS);
+ *     writer.put<std::uint64_t>(maps.size());
+ *     ...
+ *     writer.save(path);
+ */
+class Writer
+{
+  public:
+    void begin(Section section);
+
+    template <typename T>
+    void put(T value)
+    {
+        static_assert(std::is_trivially_copyable_v<T>);
+        data_.append(reinterpret_cast<const char*>(&value), sizeof(value));
+    }
+
+    void putString(std::string_view value);
+
+    void putVarint(std::uint64_t value);
+
+    /**
+     * @brief Bytes as they are, e.g. values encoded beforehand.
+     */
+    void putBytes(std::string_view bytes);
+
+    /**
+     * @brief Bytes put in the current section, where the next value goes.
+     */
+    std::size_t offset() const;
+
+    /**
+     * @brief Writes the file atomically, through a temporary file.
+     */
+    bool save(const std::string& path);
+
+  private:
+    struct Entry
+    {
+        Section section;
+        std::size_t offset; // in data_
+    };
+
+    std::string data_;
+    std::vector<Entry> sections_;
+};
+
+/**
+ * @brief Reads a section of a mapped snapshot, in the order it was put.
+ *
+ * Strings are views into the mapping. Reading past the end of the section
+ * fails, and so does every read after.
+ */
+class Cursor
+{
+  public:
+    Cursor(const char* data, std::size_t size);
+
+    template <typename T>
+    bool get(T& value)
+    {
+        static_assert(std::is_trivially_copyable_v<T>);
+        if (!ok_ || size_ - offset_ < sizeof(T))
+        {
+            ok_ = false;
+            return false;
+        }
+        std::memcpy(&value, data_ + offset_, sizeof(T));
+        offset_ += sizeof(T);
+        return true;
+    }
+
+    bool getString(std::string_view& value);
+    bool getVarint(std::uint64_t& value);
+
+    /**
+     * @brief Moves to offset bytes from the start of the section, e.g. a
+     *        Writer::offset() stored in another section.
+     */
+    bool seek(std::size_t offset);
+
+    std::size_t offset() const;
+
+  private:
+    const char* data_;
+    std::size_t size_;
+    std::size_t offset_ {0};
+    bool ok_ {true};
+};
+
+/**
+ * @brief A snapshot file mapped read-only.
+ *
+ * open() checks the magic, the version, the size and a checksum of the
+ * whole content, so a file cut short by a crash or written by another
+ * version is refused and the state is read from the database instead.
+ * Sections are then read in place, without copying the file.
+ */
+class Reader
+{
+  public:
+    Reader() = default;
+    ~Reader();
+
+    Reader(const Reader&) = delete;
+    Reader& operator=(const Reader&) = delete;
+
+    bool open(const std::string& path);
+
+    /**
+     * @brief Unix time the snapshot was written at.
+     */
+    std::int64_t written() const;
+
+    std::optional<Cursor> section(Section section) const;
+
+  private:
+    const char* data_ {nullptr};
+    std::size_t size_ {0};
+    std::int64_t written_ {0};
+};
+} // namespace snapshot
+
+#endif
@@ -1,5 +1,7 @@
 #include "utils.h"
 
+#include <array>
+#include <cstdint>
 #include <string>
 #include <vector>
 
@@ -37,4 +39,66 @@ std::string join(const std::vector<std::string>& vec, const std::string& delimit
     }
     return result;
 }
-} // namespace utils
\ No newline at end of file
+
+bool decodeBase64(std::string_view encoded, std::string& out)
+{
+    static const std::array<std::int8_t, 256> kValues = [] {
+        std::array<std::int8_t, 256> values {};
+        values.fill(-1);
+        const char* digits =
+            "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+        for (int i = 0; i < 64; ++i)
+        {
+            values[static_cast<unsigned char>(digits[i])] =
+                static_cast<std::int8_t>(i);
+        }
+        return values;
+    }();
+
+    out.clear();
+    out.reserve(encoded.size() / 4 * 3);
+    std::uint32_t bits = 0;
+    int count = 0;
+    std::size_t padding = 0;
+    for (char c : encoded)
+    {
+        if (c == ' ' || c == '\n' || c == '\r' || c == '\t')
+        {
+            continue;
+        }
+        if (c == '=')
+        {
+            ++padding;
+            continue;
+        }
+        std::int8_t value = kValues[static_cast<unsigned char>(c)];
+        if (value < 0 || padding != 0)
+        {
+            return false; // not a digit, or a digit after the padding
+        }
+        bits = bits << 6 | static_cast<std::uint32_t>(value);
+        if (++count == 4)
+        {
+            out += static_cast<char>(bits >> 16);
+            out += static_cast<char>(bits >> 8);
+            out += static_cast<char>(bits);
+            bits = 0;
+            count = 0;
+        }
+    }
+    if (count == 1 || padding > 2)
+    {
+        return false;
+    }
+    if (count >= 2)
+    {
+        bits <<= 6 * (4 - count);
+        out += static_cast<char>(bits >> 16);
+        if (count == 3)
+        {
+            out += static_cast<char>(bits >> 8);
+        }
+    }
+    return true;
+}
+} // namespace utils
@@ -2,6 +2,7 @@
 #define UTILS_H
 
 #include <string>
+#include <string_view>
 #include <vector>
 
 namespace utils
@@ -9,6 +10,12 @@ namespace utils
     void trim(std::string& str);
     std::vector<std::string> split(const std::string& str, const std::string& delimiter);
     std::string join(const std::vector<std::string>& vec, const std::string& delimiter);
+
+    /**
+     * @brief Decodes base64 (e.g. an XML-RPC <base64> value), whitespace is
+     *        skipped. False if encoded is not valid base64.
+     */
+    bool decodeBase64(std::string_view encoded, std::string& out);
 } // namespace utils
 
 #endif
\ No newline at end of file